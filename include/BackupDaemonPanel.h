@@ -62,6 +62,7 @@ class BackupDaemonPanel
 	wxTextCtrl* mpClientConnStatus;
 	wxTextCtrl* mpClientError;
 	wxTextCtrl* mpClientState;
+	wxTextCtrl* mpLastSync;
 	ClientConnection mClientConn;
 	wxButton* mpStartButton;
 	wxButton* mpStopButton;
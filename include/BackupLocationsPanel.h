@@ -33,10 +33,12 @@
 #include "ConfigChangeListener.h"
 
 class BackupTreeNode;
+class ExclusionsPanel;
 class LocalFileTree;
 class ClientConfig;
 class LocationsPanel;
 class MainFrame;
+class wxNotebookEvent;
 class wxTreeEvent;
 
 class BackupLocationsPanel : public wxPanel, public ConfigChangeListener 
@@ -61,6 +63,7 @@ class BackupLocationsPanel : public wxPanel, public ConfigChangeListener
 	BackupTreeNode* mpRootNode;
 	MainFrame*      mpMainFrame;
 	wxPanel*        mpPanelToShowOnClose;
+	ExclusionsPanel* mpExclusionsPanel;
 	
 	// LocationsPanel* mpLocationsPanel;
 	/*
@@ -88,6 +91,7 @@ class BackupLocationsPanel : public wxPanel, public ConfigChangeListener
 	*/
 
 	void OnClickCloseButton    (wxCommandEvent& rEvent);
+	void OnNotebookPageChanged (wxNotebookEvent& rEvent);
 	
 	// void OnTreeNodeExpand   (wxTreeEvent&    rEvent);
 	// void OnTreeNodeCollapse (wxTreeEvent&    rEvent);
@@ -36,6 +36,7 @@
 class BackupLocationsPanel;
 class BackupProgressPanel;
 	
+class wxChoice;
 class wxNotebook;
 class wxStaticText;
 
@@ -64,6 +65,7 @@ class BackupPanel : public FunctionPanel
 	wxStaticText* mpDestLabel;
 	wxSizer*      mpDestCtrlSizer;
 	wxButton*     mpDestEditButton;
+	wxChoice*     mpCountChoice;
 
 	virtual void Update();
 	virtual void OnClickSourceButton(wxCommandEvent& rEvent);
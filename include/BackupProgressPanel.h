@@ -25,6 +25,13 @@
 #ifndef _BACKUP_PROGRESS_PANEL_H
 #define _BACKUP_PROGRESS_PANEL_H
 
+#include <map>
+#include <string>
+#include <vector>
+
+#include <wx/arrstr.h>
+#include <wx/thread.h>
+
 #include "TLSContext.h"
 #include "BackupDaemon.h"
 #include "BackupDaemonInterface.h"
@@ -38,10 +45,19 @@
 
 class BackupClientDirectoryRecord;
 class BackupClientContext;
+class BoxiExcludeRules;
+class BackupWorkerThread;
+class BackupCountThread;
 
 class ClientConfig;
 class ServerConnection;
 
+// Interval between flushes of queued progress to the user interface
+#define BACKUP_PROGRESS_FLUSH_MILLIS 200
+
+// Where the totals from the last backup are kept, in the data directory
+#define BACKUP_LAST_TOTALS_FILE "boxi_last_backup_totals"
+
 class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 	ProgressNotifier
 {
@@ -53,7 +69,18 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		wxWindow*         pParent
 	);
 
-	void StartBackup();
+	// When to count the files to be backed up, for the progress
+	// gauge. Without counting first, the gauge starts with the
+	// totals from the last backup, until the count catches up.
+	typedef enum
+	{
+		BCM_COUNT_FIRST = 0,
+		BCM_COUNT_ALONGSIDE,
+		BCM_DONT_COUNT,
+	}
+	CountMode;
+
+	void StartBackup(CountMode countMode = BCM_COUNT_ALONGSIDE);
 
 	private:
 	ClientConfig*     mpConfig;
@@ -63,12 +90,88 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 	bool              mStorageLimitExceeded;
 	*/
 	bool              mBackupRunning;
+	// Set on the GUI thread and read on the backup and count threads,
+	// so protected by mProgressMutex, like mCountStopRequested.
 	bool              mBackupStopRequested;
 		
-	virtual bool IsStopRequested() { return mBackupStopRequested; }
+	virtual bool IsStopRequested()
+	{
+		wxMutexLocker lock(mProgressMutex);
+		return mBackupStopRequested || mCountStopRequested;
+	}
+	void SetStopRequested(bool* pFlag, bool value)
+	{
+		wxMutexLocker lock(mProgressMutex);
+		*pFlag = value;
+	}
 		
 	std::auto_ptr<BackupDaemon> mapDaemon;
+
+	// A copy of each location's exclude entries, by path, and rules
+	// compiled from them, made on the GUI thread before the backup
+	// starts, for counting. The configuration's own rules can't be
+	// used, as they are freed if the entries are edited while the
+	// backup is running.
+	class LocationRules;
+	std::map<std::string, LocationRules*> mLocationRules;
+	void ClearLocationRules();
+
+	CountMode mCountMode;
+	bool      mCountStopRequested; // protected by mProgressMutex
+
+	bool ReadLastTotals(size_t* pNumFiles, int64_t* pNumBytes);
+	void WriteLastTotals();
+	void CountAllLocations(BackupClientContext* pContext);
+
+	// Progress is handed from the backup thread to the GUI thread
+	// through these, and flushed to the panel in batches, so that
+	// the backup never waits for the screen to be updated. The
+	// current action is only formatted when it's flushed, and only
+	// the latest one is kept. All are protected by mProgressMutex.
+	wxMutex       mProgressMutex;
+	wxCondition   mProgressCondition;
+	wxArrayString mPendingErrors;
+	size_t        mPendingNumErrors;
+	const wxChar* mpCurrentActionFormat;
+	std::string   mCurrentActionPath;
+	int64_t       mCurrentActionBytes;
+	size_t        mPendingFilesCounted;
+	int64_t       mPendingBytesCounted;
+	size_t        mPendingFilesDone;
+	int64_t       mPendingBytesDone;
+	bool          mCountFinished;
+	bool          mSyncStarted;
+	bool          mWorkerFinished;
+	RunHistory::Run mRun; // only the uploads, until it's recorded
+
+	void SetCurrentAction(const wxChar* pFormat,
+		const std::string& rLocalPath, int64_t numBytes = 0)
+	{
+		wxMutexLocker lock(mProgressMutex);
+		mpCurrentActionFormat = pFormat;
+		mCurrentActionPath    = rLocalPath;
+		mCurrentActionBytes   = numBytes;
+	}
+
+	// Called by the backup thread to queue a message for the
+	// error list
+	void AddError(const wxString& rMessage)
+	{
+		wxMutexLocker lock(mProgressMutex);
+		// take a deep copy, as wxString is not thread-safe
+		mPendingErrors.Add(rMessage.c_str());
+		mPendingNumErrors++;
+	}
+
+	friend class BackupWorkerThread;
+	friend class BackupCountThread;
+	friend class TestProgressPanel;
+	void NotifyWorkerFinished();
+	bool WaitForProgress(long timeoutMillis);
+	void FlushProgress();
+	RunHistory::Result ReportResult(BackupWorkerThread& rWorker);
 	
+
 	// BackupDaemon      mBackupDaemon;
 	// std::vector<LocationRecord *> mLocations;
 
@@ -89,13 +192,17 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 	*/
 	
 	/* RunStatusProvider interface */
-	virtual bool StopRun() { return mBackupStopRequested; }
+	virtual bool StopRun()
+	{
+		wxMutexLocker lock(mProgressMutex);
+		return mBackupStopRequested;
+	}
 	
 	virtual void OnStopCloseClicked(wxCommandEvent& event) 
 	{ 
 		if (mBackupRunning)
 		{
-			mBackupStopRequested = TRUE;
+			SetStopRequested(&mBackupStopRequested, true);
 		}
 		else
 		{
@@ -123,19 +230,33 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 	void DeleteUnusedRootDirEntries(BackupClientContext &rContext);
 	*/
 	
-	/* ProgressNotifier interface */
+	/* ProgressPanel counting, done on the backup thread */
+	virtual void NotifyCountDirectory(const std::string& rLocalPath)
+	{
+		if (mCountMode == BCM_COUNT_FIRST)
+		{
+			// otherwise the backup's own actions are more useful
+			SetCurrentAction(wxT("Counting files in directory "
+				"'%s'"), rLocalPath);
+		}
+	}
+	virtual void NotifyCountStatFailed(const std::string& rFileName);
+	virtual void NotifyMoreFilesCounted(size_t numAdditionalFiles,
+		int64_t numAdditionalBytes)
+	{
+		wxMutexLocker lock(mProgressMutex);
+		mPendingFilesCounted += numAdditionalFiles;
+		mPendingBytesCounted += numAdditionalBytes;
+	}
+
+	/* ProgressNotifier interface, called on the backup thread */
 	virtual void NotifyIDMapsSetup(BackupClientContext& rContext);
 
 	virtual void NotifyScanDirectory(
 		const BackupClientDirectoryRecord* pDirRecord,
 		const std::string& rLocalPath)
 	{
-		wxString msg;
-		msg.Printf(wxT("Scanning directory '%s'"), 
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		SetCurrentText(msg);
-		Layout();
-		wxYield();
+		SetCurrentAction(wxT("Scanning directory '%s'"), rLocalPath);
 	}
 
 	virtual void NotifyDirStatFailed(
@@ -147,8 +268,7 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		msg.Printf(wxT("Failed to read directory '%s': %s"), 
 			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
 			wxString(rErrorMsg.c_str(),  wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileStatFailed(
@@ -168,8 +288,7 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		msg.Printf(wxT("Failed to list directory '%s': %s"), 
 			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
 			wxString(rErrorMsg.c_str(),  wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileReadFailed(
@@ -181,8 +300,7 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		msg.Printf(wxT("Failed to read file '%s': %s"), 
 			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
 			wxString(rErrorMsg.c_str(),  wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileModifiedInFuture(
@@ -193,8 +311,7 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		msg.Printf(wxT("Warning: file modified in the future "
 				"(check your system clock): '%s'"), 
 			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileSkippedServerFull(
@@ -204,8 +321,7 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		wxString msg;
 		msg.Printf(wxT("Failed to send file '%s': no more space available"), 
 			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileUploadException(
@@ -226,20 +342,14 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 				wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
 				wxString(rException.what(),  wxConvBoxi).c_str());
 		}
-		mpErrorList->Append(msg);
-		wxYield();
+		AddError(msg);
 	}
 
 	virtual void NotifyFileUploading(
 		const BackupClientDirectoryRecord* pDirRecord,
 		const std::string& rLocalPath)
 	{
-		wxString msg;
-		msg.Printf(wxT("Backing up file '%s'"), 
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		SetCurrentText(msg);
-		Layout();
-		wxYield();
+		SetCurrentAction(wxT("Backing up file '%s'"), rLocalPath);
 	}
 
 	virtual void NotifyFileUploadingPatch(
@@ -247,26 +357,21 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		const std::string& rLocalPath,
 		int64_t EstimatedBytesToUpload)
 	{
-		wxString msg;
-		msg.Printf(wxT("Backing up file '%s' (sending patch, estimated size %d)"),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-			EstimatedBytesToUpload);
-		SetCurrentText(msg);
-		Layout();
-		wxYield();
+		{
+			wxMutexLocker lock(mProgressMutex);
+			mRun.mNumPatchUploads++;
+		}
+		SetCurrentAction(wxT("Backing up file '%s' (sending patch, "
+			"estimated size %" wxLongLongFmtSpec "d)"),
+			rLocalPath, EstimatedBytesToUpload);
 	}
 
 	virtual void NotifyFileUploadingAttributes(
 		const BackupClientDirectoryRecord* pDirRecord,
 		const std::string& rLocalPath)
 	{
-		wxString msg;
-		msg.Printf(wxT("Backing up file '%s' (uploading new "
-			"attributes)"),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		SetCurrentText(msg);
-		Layout();
-		wxYield();
+		SetCurrentAction(wxT("Backing up file '%s' (uploading new "
+			"attributes)"), rLocalPath);
 	}
 
 	virtual void NotifyFileUploaded(
@@ -274,10 +379,9 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		const std::string& rLocalPath,
 		int64_t FileSize, int64_t UploadedSize, int64_t ObjectID)
 	{
-		/*
-		mNumFilesUploaded++;
-		mNumBytesUploaded += FileSize;
-		*/
+		wxMutexLocker lock(mProgressMutex);
+		mRun.mNumFilesUploaded++;
+		mRun.mNumBytesUploaded += UploadedSize;
 	}
 
 	virtual void NotifyFileSynchronised(
@@ -285,7 +389,9 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		const std::string& rLocalPath,
 		int64_t FileSize) 
 	{
-		NotifyMoreFilesDone(1, FileSize);
+		wxMutexLocker lock(mProgressMutex);
+		mPendingFilesDone++;
+		mPendingBytesDone += FileSize;
 	}
 
 	virtual void NotifyDirectoryCreated(int64_t ObjectID,
@@ -314,19 +420,10 @@ class BackupProgressPanel : public ProgressPanel, RunStatusProvider,
 		int64_t ObjectID,
 		const std::string& rRemotePath) { }
 	virtual void NotifyReadProgress(int64_t readSize, int64_t offset,
-		int64_t length, box_time_t elapsed, box_time_t finish)
-	{
-		wxYield();
-	}
+		int64_t length, box_time_t elapsed, box_time_t finish) { }
 	virtual void NotifyReadProgress(int64_t readSize, int64_t offset,
-		int64_t length)
-	{
-		wxYield();
-	}
-	virtual void NotifyReadProgress(int64_t readSize, int64_t offset)
-	{
-		wxYield();
-	}
+		int64_t length) { }
+	virtual void NotifyReadProgress(int64_t readSize, int64_t offset) { }
 
 	DECLARE_EVENT_TABLE()
 };
@@ -30,6 +30,7 @@
 #include "main.h"
 #include "ConfigChangeListener.h"
 #include "Location.h"
+#include "LocationIndex.h"
 #include "Property.h"
 
 class ClientConfig : 
@@ -80,6 +81,8 @@ class ClientConfig :
 	BoxiLocation* GetLocation(const BoxiLocation& rConstLocation);
 	BoxiLocation* GetLocation(const wxString& rName);
 	BoxiLocation* GetLocation(int index);
+	const BoxiLocationIndex& GetLocationIndex();
+	unsigned long GetLocationsGeneration() { return mLocationsGeneration; }
 	
 	void AddListener   (ConfigChangeListener* pNewListener);
 	void RemoveListener(ConfigChangeListener* pOldListener);
@@ -104,8 +107,11 @@ class ClientConfig :
 	wxString mConfigFileName;
 	std::auto_ptr<Configuration> mapOriginalConfig;
 	BoxiLocation::List mLocations;
+	std::auto_ptr<BoxiLocationIndex> mapLocationIndex;
+	unsigned long mLocationsGeneration;
 	std::vector<ConfigChangeListener*> mListeners;
 	
+	void OnLocationsChange();
 	static BoxiLocation::List GetConfigurationLocations
 		(const Configuration& conf);
 	
@@ -26,18 +26,26 @@
 #define _CLIENTCONNECTION_H
 
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include <wx/longlong.h>
 #include <wx/process.h>
 #include <wx/log.h>
 #include <wx/thread.h>
 
-#define NDEBUG
-#include "Socket.h"
-#include "IOStreamGetLine.h"
-#include "SocketStream.h"
-#undef NDEBUG
-
 #include "ClientConfig.h"
+#include "CommandSocketEventQueue.h"
+#include "CommandSocketParser.h"
+#include "ConfigChangeListener.h"
+
+// The command socket is a Unix socket, waited for with poll(), so the
+// worker thread only talks to the daemon on other platforms
+#ifndef WIN32
+#include "CommandSocketClient.h"
+#include "CommandSocketPoller.h"
+#endif
 
 static const wxChar* mStateStrings[] = {
 	wxT("Unknown"),
@@ -94,7 +102,7 @@ static const wxChar* mClientStateStrings[] = {
 	wxT("Store limit exceeded, sleeping"),
 };
 
-class ClientConnection : public wxThread
+class ClientConnection : public wxThread, public ConfigChangeListener
 {
 	public:
 	class Listener {
@@ -172,6 +180,25 @@ class ClientConnection : public wxThread
 	Error         mLastError;
 	wxString      mExecutablePath;
 	int           mClientPid;
+
+	// copied from mpConfig by the GUI thread, as the worker mustn't
+	// read it while the user is changing it; empty if not configured
+	std::string   mPidFilePath;
+	std::string   mCommandSocketPath;
+
+	// logged by the GUI thread, as the worker mustn't use wxLog
+	class LogMessage
+	{
+		public:
+		wxLogLevel mLevel;
+		wxString   mText;
+		// a deep copy, as wxString's reference counting
+		// isn't thread safe
+		LogMessage(wxLogLevel level, const wxString& rText)
+		: mLevel(level), mText(rText.c_str()) { }
+	};
+	std::vector<LogMessage> mLogMessages;
+	bool          mNewLogMessages; // since the listener was notified
 	
 	public:
 	ClientConnection(ClientConfig* pConfig, 
@@ -221,33 +248,62 @@ class ClientConnection : public wxThread
 	long GetClientPidFast(); // returns -1 if unknown
 	Error GetClientPidSlow(long& rDestPid);
 
+	// Takes the state changes and syncs that the daemon has reported
+	// since last time, oldest first. The listener's
+	// NotifyClientStateChange() is called when there are new ones.
+	// Returns the number that were lost because they weren't taken
+	// quickly enough.
+	size_t GetEvents(std::vector<CommandSocketEvent>* pEvents)
+	{
+		return mEvents.Drain(pEvents);
+	}
+
+	// Logs the messages that the worker thread has queued, in the
+	// GUI thread. The listener's NotifyError() is called when there
+	// are new ones.
+	void LogMessages();
+
+	// implement ConfigChangeListener
+	virtual void NotifyChange();
+
 	private:
 	bool SetWorkerState(WorkerState newState, 
 						WorkerState mOldState, const char *cmd);
 	Error _GetClientPidSlow(long& rDestPid);
+	void _CopyConfigPaths();
+	void QueueLog(wxLogLevel level, const wxString& rText);
+	void _QueueLog(wxLogLevel level, const wxString& rText);
 	
 	virtual void * Entry();
 
 	void OnStartClient();
 	void OnStopClient();
 	Error DoStartClient();
-	Error DoReadLine();
+#ifndef WIN32
 	Error DoConnect();
 	void OnConnect();
-	void OnConnectedIdle();
+	void OnDisconnect();
+	void ProcessLines();
+	Error HandleEvent(const CommandSocketEvent& rEvent);
+	int GetWaitMillis();
+#endif
 	void OnRestartClient();
 	void OnSyncClient();
 	void OnReloadClient();
 
 	bool _sendCommand(const char * cmd) 
 	{
-		mpSocket->Write(cmd, strlen(cmd));
-		const char *newline = "\n";
-		mpSocket->Write(newline, strlen(newline));
+#ifdef WIN32
+		return FALSE;
+#else
+		if (!mCommandSocket.SendCommand(cmd))
+			return FALSE;
 		
 		wxString cmd2(cmd, wxConvBoxi);
-		wxLogDebug(wxT("wrote to daemon: '%s'"), cmd2.c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			wxT("wrote to daemon: '%s'"), cmd2.c_str()));
 		return TRUE;
+#endif
 	}
 
 	class ClientProcess : public wxProcess 
@@ -267,9 +323,24 @@ class ClientConnection : public wxThread
 		}
 	};
 
+	// from the worker thread to the GUI
+	CommandSocketEventQueue mEvents;
+
+#ifndef WIN32
+	// The worker thread sleeps in mPoller until the daemon sends
+	// something, the GUI changes the state, or one of these times
+	// comes round.
+	CommandSocketPoller mPoller;
+
 	// only for use in worker thread
-	SocketStream* mpSocket;
-	std::auto_ptr<IOStreamGetLine> mapReader;
+	CommandSocketClient mCommandSocket;
+	CommandSocketParser mParser;
+	size_t     mNumUnknownLines; // since connecting
+	bool       mSocketOpen;
+	wxLongLong mNextConnectMillis;
+	wxLongLong mConnectDeadlineMillis;
+	wxLongLong mNextPidCheckMillis;
+#endif
 	std::auto_ptr<ClientProcess> mapBackupClientProcess;
 	friend class ClientDaemonProcess;
 	void OnClientTerminate(wxProcess* pProcess, int pid, int status);
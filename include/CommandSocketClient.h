@@ -0,0 +1,94 @@
+/***************************************************************************
+ *            CommandSocketClient.h
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMMANDSOCKETCLIENT_H
+#define _COMMANDSOCKETCLIENT_H
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CommandSocketClient
+//		Purpose: A non-blocking connection to the command socket of
+//			 a bbackupd, which splits what the daemon sends into
+//			 lines and queues the commands sent to it. It never
+//			 waits for anything itself: a CommandSocketPoller
+//			 waits for the socket, and calls OnReadable() and
+//			 OnWritable() when there's something to do, so one
+//			 thread can look after any number of them.
+//
+//			 What the daemon sends is read into one buffer, which
+//			 is allocated once and reused, and GetLine() returns
+//			 each line where it lies in the buffer, so reading
+//			 doesn't allocate anything however much is sent. If
+//			 the buffer fills up with lines that haven't been
+//			 taken yet, reading stops until they have, and the
+//			 daemon has to wait.
+//
+//			 Only to be used from one thread at a time.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+class CommandSocketClient
+{
+	public:
+	CommandSocketClient();
+	~CommandSocketClient();
+
+	bool Connect(const std::string& rSocketPath);
+	void Attach(int handle);
+	void Close();
+	bool IsConnected() const { return mSocket != -1; }
+	int  GetFileHandle() const { return mSocket; }
+	int  GetLastErrno() const { return mLastErrno; }
+
+	bool SendCommand(const std::string& rCommand);
+	bool HasPendingOutput() const { return mOutput.size() > 0; }
+	bool WantsInput() const
+	{ return mLineStart > 0 || mDataEnd < mBuffer.size(); }
+	bool GetLine(const char** ppLine, size_t* pLength);
+
+	// Called by CommandSocketPoller
+	void OnReadable();
+	void OnWritable();
+
+	private:
+	int mSocket;
+	int mLastErrno;
+	std::string mOutput; // not written yet
+	// Lines not yet returned by GetLine() are from mLineStart to
+	// mDataEnd, the last of which may not have ended yet
+	std::vector<char> mBuffer;
+	size_t mLineStart;
+	size_t mDataEnd;
+
+	CommandSocketClient(const CommandSocketClient& rToCopy)
+	{ /* forbidden */ }
+	CommandSocketClient& operator=(const CommandSocketClient& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _COMMANDSOCKETCLIENT_H */
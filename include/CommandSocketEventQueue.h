@@ -0,0 +1,67 @@
+/***************************************************************************
+ *            CommandSocketEventQueue.h
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMMANDSOCKETEVENTQUEUE_H
+#define _COMMANDSOCKETEVENTQUEUE_H
+
+#include <vector>
+
+#include <wx/thread.h>
+
+#include "CommandSocketParser.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CommandSocketEventQueue
+//		Purpose: Passes CommandSocketEvents from the thread that
+//			 talks to a daemon to the GUI thread. It holds a
+//			 fixed number of events, allocated once, and if the
+//			 GUI falls behind, the oldest are dropped and counted
+//			 rather than letting the queue grow without limit.
+//
+//			 The text of CSE_UNKNOWN and CSE_MALFORMED events
+//			 doesn't outlive the line, so they shouldn't be
+//			 queued.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+class CommandSocketEventQueue
+{
+	public:
+	CommandSocketEventQueue(size_t capacity);
+
+	bool   Push(const CommandSocketEvent& rEvent);
+	size_t Drain(std::vector<CommandSocketEvent>* pEvents);
+	void   Clear();
+
+	private:
+	wxMutex mMutex;
+	std::vector<CommandSocketEvent> mEvents;
+	size_t  mFirst;      // index of the oldest event
+	size_t  mCount;
+	size_t  mNumDropped; // since the last Drain()
+};
+
+#endif /* _COMMANDSOCKETEVENTQUEUE_H */
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *            CommandSocketParser.h
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMMANDSOCKETPARSER_H
+#define _COMMANDSOCKETPARSER_H
+
+#include <time.h>
+
+class CommandSocketClient;
+
+// One thing that a bbackupd said on its command socket. Plain data,
+// so that it can be copied and queued without allocating anything.
+class CommandSocketEvent
+{
+	public:
+	typedef enum
+	{
+		CSE_UNKNOWN = 0, // a line that this version doesn't know
+		CSE_MALFORMED,   // a known line, but with bad arguments
+		CSE_SUMMARY,     // the configuration, sent on connecting
+		CSE_OK,          // a command succeeded
+		CSE_ERROR,       // a command failed
+		CSE_STATE,       // the daemon's state changed
+		CSE_SYNC_START,
+		CSE_SYNC_FINISH,
+	}
+	Type;
+
+	Type   mType;
+	time_t mTime;  // when it was received
+
+	// Only for CSE_STATE
+	int    mState;
+
+	// Only for CSE_SUMMARY
+	bool   mAutomaticBackup;
+	int    mUpdateStoreInterval;
+	int    mMinimumFileAge;
+	int    mMaxUploadWait;
+
+	// Only for CSE_UNKNOWN and CSE_MALFORMED: the line itself, in the
+	// client's buffer, so only until the next line is parsed. NULL
+	// for the others, which may be queued.
+	const char* mpText;
+	size_t      mTextLength;
+
+	CommandSocketEvent()
+	: mType(CSE_UNKNOWN),
+	  mTime(0),
+	  mState(0),
+	  mAutomaticBackup(false),
+	  mUpdateStoreInterval(0),
+	  mMinimumFileAge(0),
+	  mMaxUploadWait(0),
+	  mpText(NULL),
+	  mTextLength(0)
+	{ }
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CommandSocketParser
+//		Purpose: Turns the lines that a CommandSocketClient has
+//			 received into CommandSocketEvents. The lines are
+//			 parsed where they lie in the client's buffer, and
+//			 nothing is allocated, so a daemon that sends a lot
+//			 during a sync costs nothing more than the parsing.
+//
+//			 Reset() should be called whenever the client
+//			 connects, as the first line of a connection is
+//			 different from the rest.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+class CommandSocketParser
+{
+	public:
+	CommandSocketParser(CommandSocketClient& rClient);
+
+	void Reset();
+	bool GetEvent(CommandSocketEvent* pEvent);
+	bool HasSummary() const { return mHaveSummary; }
+
+	private:
+	CommandSocketClient& mrClient;
+	bool mHaveSummary;
+
+	void Parse(const char* pLine, size_t length,
+		CommandSocketEvent* pEvent);
+};
+
+#endif /* _COMMANDSOCKETPARSER_H */
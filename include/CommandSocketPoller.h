@@ -0,0 +1,68 @@
+/***************************************************************************
+ *            CommandSocketPoller.h
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMMANDSOCKETPOLLER_H
+#define _COMMANDSOCKETPOLLER_H
+
+#include <vector>
+
+class CommandSocketClient;
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CommandSocketPoller
+//		Purpose: Waits, in one call to poll(), until any of a set
+//			 of CommandSocketClients has data to read or room to
+//			 write, another thread calls Wake(), or a timeout
+//			 expires. It then lets each client whose socket is
+//			 ready read or write as much as it can.
+//
+//			 A worker thread that owns the clients can sleep in
+//			 Wait() for as long as nothing happens, and still
+//			 answer the user interface straight away.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+class CommandSocketPoller
+{
+	public:
+	CommandSocketPoller();
+	~CommandSocketPoller();
+
+	void Wake();
+	bool Wait(const std::vector<CommandSocketClient*>& rClients,
+		int timeoutMillis);
+
+	private:
+	int mWakeReadHandle;
+	int mWakeWriteHandle;
+
+	CommandSocketPoller(const CommandSocketPoller& rToCopy)
+	{ /* forbidden */ }
+	CommandSocketPoller& operator=(const CommandSocketPoller& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _COMMANDSOCKETPOLLER_H */
@@ -27,25 +27,69 @@
 
 #include <wx/filename.h>
 
+#include "CompareReport.h"
 #include "FunctionPanel.h"
 
 class CompareProgressPanel;
 class CompareResultsPanel;
 class ServerConnection;
 
+class wxCheckBox;
 class wxChoice;
 class wxFileName;
 class wxGenericDirCtrl;
 class wxNotebook;
 class wxRadioButton;
+class wxSpinCtrl;
+class wxTextCtrl;
 class wxTreeCtrl;
 
 class BoxiCompareParams
 {
 	public:
-	BoxiCompareParams() { }
+	BoxiCompareParams()
+	: mQuickCompare(false),
+	  mReportFormat(CompareReport::CRF_JSON_LINES),
+	  mSampleFraction(0),
+	  mSampleCount(0),
+	  mSampleSeed(0)
+	{ }
+	
+	// Quick compare checks local files against the block index
+	// (block sizes and strong checksums) held by the store, instead
+	// of downloading and decoding the entire file.
+	bool IsQuickCompare() const { return mQuickCompare; }
+	void SetQuickCompare(bool enabled) { mQuickCompare = enabled; }
+	
+	// If a report file name is set, every difference found is also
+	// written to that file, in the chosen format.
+	const wxString& GetReportFileName() const { return mReportFileName; }
+	void SetReportFileName(const wxString& rFileName)
+	{ mReportFileName = rFileName; }
+	CompareReport::Format GetReportFormat() const { return mReportFormat; }
+	void SetReportFormat(CompareReport::Format format)
+	{ mReportFormat = format; }
+	
+	// A sampled compare checks the contents of only some of the files
+	// in each location: either a fraction of them, or a fixed number
+	// if the count is not zero. The same seed chooses the same files.
+	bool   IsSampled() const
+	{ return (mSampleFraction > 0 || mSampleCount > 0); }
+	double GetSampleFraction() const { return mSampleFraction; }
+	void   SetSampleFraction(double fraction) { mSampleFraction = fraction; }
+	size_t GetSampleCount() const { return mSampleCount; }
+	void   SetSampleCount(size_t count) { mSampleCount = count; }
+	uint32_t GetSampleSeed() const { return mSampleSeed; }
+	void     SetSampleSeed(uint32_t seed) { mSampleSeed = seed; }
 	
 	private:
+	bool mQuickCompare;
+	wxString mReportFileName;
+	CompareReport::Format mReportFormat;
+	double   mSampleFraction;
+	size_t   mSampleCount;
+	uint32_t mSampleSeed;
+	
 	BoxiCompareParams(const BoxiCompareParams& rToCopy) { /* forbidden */ }
 	BoxiCompareParams& operator=(const BoxiCompareParams& rToCopy)
 	{ return *this; /* forbidden */ }
@@ -74,6 +118,12 @@ class ComparePanel : public wxPanel, public ConfigChangeListener
 	wxRadioButton* mpDirRadio;
 	
 	wxChoice* mpOneLocChoice;
+	wxCheckBox* mpQuickCompareCheck;
+	wxCheckBox* mpSampleCheck;
+	wxSpinCtrl* mpSamplePercentSpin;
+	wxSpinCtrl* mpSampleSeedSpin;
+	wxTextCtrl* mpReportFileText;
+	wxChoice*   mpReportFormatChoice;
 	
 	wxGenericDirCtrl* mpDirLocalTree;
 	wxTreeCtrl*       mpDirRemoteTree;
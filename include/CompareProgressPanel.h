@@ -25,12 +25,16 @@
 #ifndef _COMPARE_PROGRESS_PANEL_H
 #define _COMPARE_PROGRESS_PANEL_H
 
+#include <memory>
+#include <vector>
+
 #include <wx/wx.h>
+#include <wx/listctrl.h>
 #include <wx/thread.h>
 
-#include "BoxBackupCompareParams.h"
-
+#include "CompareReport.h"
 #include "ProgressPanel.h"
+#include "ReportingCompareParams.h"
 
 class wxFileName;
 
@@ -39,7 +43,27 @@ class ServerConnection;
 class ServerCacheNode;
 class BoxiCompareParams;
 
-class CompareProgressPanel : public ProgressPanel
+// A virtual list control showing the differences found by a compare.
+// Only the visible rows are ever rendered, so appending a large batch
+// of results costs no more than appending a single one.
+class CompareDifferencesList : public wxListCtrl
+{
+	public:
+	CompareDifferencesList(wxWindow* pParent, wxWindowID id);
+	
+	void Clear();
+	void Append(const wxArrayString& rMessages);
+	size_t GetCount() const { return mMessages.GetCount(); }
+	const wxString& GetString(size_t index) const
+	{ return mMessages[index]; }
+	
+	private:
+	wxArrayString mMessages;
+	virtual wxString OnGetItemText(long item, long column) const;
+};
+
+class CompareProgressPanel : public ProgressPanel,
+	public ReportingCompareParams::Sink
 {
 	public:
 	CompareProgressPanel
@@ -58,7 +82,12 @@ class CompareProgressPanel : public ProgressPanel
 	bool mCompareRunning;
 	bool mCompareStopRequested;
 
-	virtual bool IsStopRequested() { return mCompareStopRequested; }
+	// Also read by the compare thread, so protected by mResultsMutex
+	virtual bool IsStopRequested()
+	{
+		wxMutexLocker lock(mResultsMutex);
+		return mCompareStopRequested;
+	}
 
 	/*
 	void CountDirectory(const BoxiCompareParams& rParams,
@@ -69,7 +98,7 @@ class CompareProgressPanel : public ProgressPanel
 	{ 
 		if (mCompareRunning)
 		{
-			mCompareStopRequested = TRUE;
+			RequestStop();
 		}
 		else
 		{
@@ -90,259 +119,58 @@ class CompareProgressPanel : public ProgressPanel
 	int GetConnectionIndex() { return mpConnection->GetConnectionIndex(); }
 	*/
 	
-	void NotifyComparing(const wxString& rLocalPath, bool IsFile)
+	/* ReportingCompareParams::Sink interface, called by the
+	compare thread */
+
+	virtual void NotifyComparing(const wxString& rLocalPath, bool IsFile)
 	{
 		wxString msg;
 		msg.Printf(wxT("Comparing %s '%s'"),
 			IsFile ? _("file") : _("directory"), rLocalPath.c_str());
-		SetCurrentText(msg);
-		Layout();
-		wxYield();
-	}
-	
-	public:
-
-	virtual void NotifyLocalDirMissing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		wxString msg;
-		msg.Printf(_("Local directory '%s' does not exist, "
-			"but remote directory does."),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		// mDifferences ++;
+		wxMutexLocker lock(mResultsMutex);
+		mCurrentAction = msg.c_str();
 	}
 
-	virtual wxString GetNativeErrorMessage()
-	{
-#ifdef WIN32
-		return wxString(GetErrorMessage(GetLastError()).c_str(),
-			wxConvBoxi);
-#else
-		std::ostringstream _box_log_line;
-		_box_log_line << std::strerror(errno) << " (" << errno << ")";
-		return wxString(_box_log_line.str().c_str(), wxConvBoxi);
-#endif
-	}
+	// Called by the compare thread to queue a result for display.
+	// Blocks while the ring is full, until the GUI thread has
+	// drained it, or discards the result if stopping.
+	virtual void AddDifference(const wxString& rMessage);
 	
-	virtual void NotifyLocalDirAccessFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to access local directory '%s': %s"),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-			GetNativeErrorMessage().c_str());
-		mpErrorList->Append(msg);
-		// mUncheckedFiles ++;
-	}
-
-	virtual void NotifyStoreDirMissingAttributes(
-		const std::string& rLocalPath, const std::string& rRemotePath)
+	// Called by the compare thread after each file, to update the
+	// counters on the next flush.
+	virtual void AddFileDone(int64_t NumBytes)
 	{
-		wxString msg;
-		msg.Printf(_("Store directory '%s' doesn't have attributes."),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-	}
-
-	virtual void NotifyRemoteFileMissing(const std::string& rLocalPath,
-		const std::string& rRemotePath,	bool modifiedAfterLastSync)
-	{
-		wxString msg;
-		msg.Printf(_("Local file '%s' exists, but remote file '%s' "
-			"does not."),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-		
-		// mDifferences ++;
-		
-		if(modifiedAfterLastSync)
-		{
-			// mDifferencesExplainedByModTime ++;
-			msg += _(" (modified since the last backup)");
-		}
-
-		mpErrorList->Append(msg);
-	}
-
-	virtual void NotifyLocalFileMissing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		wxString msg;
-		msg.Printf(_("Remote file '%s' exists, but local file '%s' "
-			"does not."),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		// mDifferences ++;
-	}
-
-	virtual void NotifyExcludedFileNotDeleted(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		wxString msg;
-		msg.Printf(_("Local file '%s' is excluded, but remote file "
-			"'%s' still exists."),
-			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		// mDifferences ++;
+		wxMutexLocker lock(mResultsMutex);
+		mPendingFilesDone++;
+		mPendingBytesDone += NumBytes;
 	}
 	
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		BoxException& rException)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to download remote file '%s': "
-			"%s (%d/%d)"),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
-			wxString(rException.what(), wxConvBoxi).c_str(),
-			rException.GetType(), rException.GetSubType());
-		mpErrorList->Append(msg);
-		// mUncheckedFiles ++;
-	}
-
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		std::exception& rException)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to download remote file '%s': %s"),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
-			wxString(rException.what(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		// mUncheckedFiles ++;
-	}
-
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to download remote file '%s'"),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-		// mUncheckedFiles ++;
-	}
-
-	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		std::exception& rException)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to download remote file '%s': %s"),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
-			wxString(rException.what(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-	}
-
-	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes)
-	{
-		wxString msg;
-		msg.Printf(_("Failed to download remote file '%s'"),
-			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-		mpErrorList->Append(msg);
-	}
-
-	virtual void NotifyExcludedFile(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		// mExcludedFiles ++;
-	}
-
-	virtual void NotifyExcludedDir(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		// mExcludedDirs ++;
-	}
-
-	virtual void NotifyDirComparing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		NotifyComparing(wxString(rLocalPath.c_str(), wxConvBoxi), false);
-	}
+	friend class BoxiCompareParamsShim;
+	friend class CompareWorkerThread;
+	friend class CompareWorkerWaiter;
+	void RequestStop();
+	void NotifyWorkerFinished();
+	bool WaitForResults(long timeoutMillis);
+	void FlushResults();
+
+	// Results are handed from the compare thread to the GUI thread
+	// through a fixed-size ring, and flushed to the differences list
+	// in batches. All of these are protected by mResultsMutex.
+	wxMutex     mResultsMutex;
+	wxCondition mResultsCondition;
+	std::vector<wxString> mResultsRing;
+	size_t      mResultsHead;
+	size_t      mResultsCount;
+	size_t      mPendingFilesDone;
+	int64_t     mPendingBytesDone;
+	wxString    mCurrentAction;
+	bool        mWorkerFinished;
 	
-	virtual void NotifyDirCompared(const std::string& rLocalPath,
-		const std::string& rRemotePath,	bool HasDifferentAttributes,
-		bool modifiedAfterLastSync)
-	{
-		if (HasDifferentAttributes)
-		{
-			wxString msg;
-			
-			msg.Printf(_("Local directory '%s' has different "
-				"attributes to store directory '%s'."),
-				wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-				wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-			// mDifferences ++;
-			
-			if(modifiedAfterLastSync)
-			{
-				msg += _(" (modified since the last backup)");
-				// mDifferencesExplainedByModTime ++;
-			}
-			
-			mpErrorList->Append(msg);
-		}
-	}
+	CompareDifferencesList* mpDifferencesList;
 	
-	virtual void NotifyFileComparing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{
-		NotifyComparing(wxString(rLocalPath.c_str(), wxConvBoxi), true);
-	}
+	// Optional machine-readable report, written by the compare thread
+	std::auto_ptr<CompareReport> mapReport;
 	
-	virtual void NotifyFileCompared(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		bool HasDifferentAttributes, bool HasDifferentContents,
-		bool modifiedAfterLastSync, bool newAttributesApplied)
-	{
-		if (HasDifferentAttributes)
-		{
-			wxString msg;
-			
-			msg.Printf(_("Local file '%s' has different attributes "
-				"to store file '%s'."),
-				wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-				wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-			// mDifferences ++;
-			
-			if(modifiedAfterLastSync)
-			{
-				msg += _(" (modified since the last backup)");
-				// mDifferencesExplainedByModTime ++;
-			}
-			else if(newAttributesApplied)
-			{
-				msg += _(" (new attributes applied)");
-			}
-			
-			mpErrorList->Append(msg);
-		}
-
-		if (HasDifferentContents)
-		{
-			wxString msg;
-			
-			msg.Printf(_("Local file '%s' has different contents "
-				"to store file '%s'."),
-				wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
-				wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
-			// mDifferences ++;
-			
-			if(modifiedAfterLastSync)
-			{
-				// mDifferencesExplainedByModTime ++;
-				msg += _(" (modified since the last backup)");
-			}
-
-			mpErrorList->Append(msg);
-		}
-		
-		NotifyMoreFilesDone(1, NumBytes);
-	}
-
 	DECLARE_EVENT_TABLE()
 };
 
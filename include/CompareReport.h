@@ -0,0 +1,105 @@
+/***************************************************************************
+ *            CompareReport.h
+ *
+ *  Sat Jan  3 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMPAREREPORT_H
+#define _COMPAREREPORT_H
+
+#include <stdio.h>
+
+#include <string>
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CompareReport
+//		Purpose: Writes compare results to a file as they are found,
+//			 one record per line, in JSON Lines or CSV format.
+//			 Nothing is kept in memory between records.
+//
+//			 Paths are written as they are stored on disk. In
+//			 JSON, any bytes which are not part of a valid UTF-8
+//			 sequence are written as \u0080 to \u00ff, so the
+//			 file is always valid JSON, but such names can't be
+//			 told apart from names containing those characters.
+//		Created: 2009/01/03
+//
+// --------------------------------------------------------------------------
+class CompareReport
+{
+	public:
+	typedef enum
+	{
+		CRF_JSON_LINES = 0,
+		CRF_CSV,
+	}
+	Format;
+
+	typedef enum
+	{
+		CRK_LOCAL_DIR_MISSING = 0,
+		CRK_LOCAL_DIR_ACCESS_FAILED,
+		CRK_STORE_DIR_MISSING_ATTRIBUTES,
+		CRK_REMOTE_FILE_MISSING,
+		CRK_LOCAL_FILE_MISSING,
+		CRK_EXCLUDED_FILE_NOT_DELETED,
+		CRK_DOWNLOAD_FAILED,
+		CRK_LOCAL_FILE_READ_FAILED,
+		CRK_DIFFERENT_ATTRIBUTES,
+		CRK_DIFFERENT_CONTENTS,
+	}
+	Kind;
+
+	CompareReport(Format format);
+	~CompareReport() { Close(); }
+
+	bool Open(const std::string& rFileName);
+	bool Close();
+	bool IsOpen() { return (mpFile != NULL); }
+
+	// The errno value of the first write that failed, or 0. No more
+	// records are written after a failure.
+	int GetErrno() { return mErrno; }
+
+	void Add(Kind kind, const std::string& rLocalPath,
+		const std::string& rRemotePath, bool isDirectory,
+		int64_t numBytes, bool modifiedAfterLastSync,
+		const std::string& rDetail = "");
+
+	static const char* GetKindName(Kind kind);
+
+	private:
+	Format mFormat;
+	FILE*  mpFile;
+	int    mErrno;
+
+	void CheckWriteError();
+	void WriteJsonString(const std::string& rValue);
+	void WriteCsvString (const std::string& rValue);
+
+	CompareReport(const CompareReport& rToCopy) { /* forbidden */ }
+	CompareReport& operator=(const CompareReport& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _COMPAREREPORT_H */
@@ -0,0 +1,96 @@
+/***************************************************************************
+ *            CompareSampler.h
+ *
+ *  Sun Jan  4 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMPARESAMPLER_H
+#define _COMPARESAMPLER_H
+
+#include <string>
+#include <vector>
+
+#include "ProgressPanel.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    CompareSampler
+//		Purpose: Chooses a random subset of the files in a location
+//			 for a sampled compare. Larger files and recently
+//			 modified files are more likely to be chosen.
+//
+//			 The choice for each file depends only on the seed
+//			 and the file's path relative to the location, not
+//			 on the order in which directories are read, so the
+//			 same seed always picks the same files from an
+//			 unchanged tree.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+class CompareSampler
+{
+	public:
+	class Sample
+	{
+		public:
+		typedef std::vector<Sample> Vector;
+		typedef Vector::iterator Iterator;
+		typedef Vector::const_iterator ConstIterator;
+
+		std::string mRelativePath;
+		int64_t     mSize;
+		time_t      mModTime;
+		double      mKey;
+
+		Sample(const std::string& rRelativePath, int64_t size,
+			time_t modTime, double key)
+		: mRelativePath(rRelativePath),
+		  mSize(size),
+		  mModTime(modTime),
+		  mKey(key)
+		{ }
+	};
+
+	CompareSampler(uint32_t seed, time_t now);
+
+	void SampleLocation(ProgressPanel::ExclusionOracle& rExclusionOracle,
+		const std::string& rLocalRoot, size_t numSamples,
+		Sample::Vector& rSamples);
+
+	double GetWeight(int64_t size, time_t modTime);
+
+	static size_t GetSampleSize(size_t population, double fraction,
+		size_t count);
+	static double GetDifferenceRateUpperBound(size_t numSampled,
+		size_t numDifferent, size_t population);
+
+	private:
+	uint32_t mSeed;
+	time_t   mNow;
+
+	double GetUniformRandom(const std::string& rRelativePath);
+	void SampleDirectory(ProgressPanel::ExclusionOracle& rExclusionOracle,
+		const std::string& rLocalRoot, const std::string& rRelativeDir,
+		size_t numSamples, Sample::Vector& rHeap);
+};
+
+#endif /* _COMPARESAMPLER_H */
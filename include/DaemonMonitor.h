@@ -0,0 +1,140 @@
+/***************************************************************************
+ *            DaemonMonitor.h
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DAEMONMONITOR_H
+#define _DAEMONMONITOR_H
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <wx/longlong.h>
+#include <wx/thread.h>
+
+#include "CommandSocketClient.h"
+#include "CommandSocketParser.h"
+#include "CommandSocketPoller.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    DaemonMonitor
+//		Purpose: Watches the command sockets of any number of
+//			 bbackupd daemons at once, and keeps track of what
+//			 each one says: its state, when it last started and
+//			 finished a sync, and how many errors it has had.
+//			 Daemons that aren't running are retried every few
+//			 seconds.
+//
+//			 All of the sockets are handled by one thread, which
+//			 sleeps in a CommandSocketPoller until one of them
+//			 has something to say, so watching a hundred daemons
+//			 takes no more threads than watching one.
+//
+//			 The listener is called from that thread, and only
+//			 once until GetStatus() is next called, however many
+//			 changes there have been in between.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+class DaemonMonitor : public wxThread
+{
+	public:
+	class Listener
+	{
+		public:
+		virtual void NotifyDaemonsChanged() = 0;
+		virtual ~Listener() { }
+	};
+
+	class Status
+	{
+		public:
+		std::string mName;
+		std::string mSocketPath;
+		bool   mConnected;
+		std::string mConnectError; // why it's not connected
+		int    mClientState; // a ClientConnection::ClientState
+		bool   mSyncing;
+		time_t mLastSyncStarted;  // or 0 if not seen yet
+		time_t mLastSyncFinished; // or 0 if not seen yet
+		size_t mNumSyncs;
+		size_t mNumErrors;
+		std::string mLastError;
+
+		Status();
+	};
+
+	DaemonMonitor(Listener* pListener);
+	~DaemonMonitor();
+
+	void AddDaemon(const std::string& rName,
+		const std::string& rSocketPath);
+	bool AddDaemons(const std::string& rListFileName);
+	bool Start();
+	void GetStatus(std::vector<Status>* pStatus);
+
+	private:
+	class Daemon
+	{
+		public:
+		Status mStatus; // protected by mMutex
+		// only for use in worker thread
+		CommandSocketClient mSocket;
+		CommandSocketParser mParser;
+		bool       mSocketOpen;
+		wxLongLong mNextConnectMillis;
+
+		Daemon()
+		: mParser(mSocket),
+		  mSocketOpen(false),
+		  mNextConnectMillis(0)
+		{ }
+	};
+
+	Listener* mpListener;
+	wxMutex   mMutex;
+	bool      mStarted;
+	bool      mShutdownRequested;
+	bool      mNotifyPending;
+	std::vector<Daemon*> mDaemons; // fixed once started
+	CommandSocketPoller  mPoller;
+
+	virtual void * Entry();
+	bool Connect(Daemon* pDaemon);
+	bool ProcessLines(Daemon* pDaemon);
+	static bool HandleEvent(Status* pStatus,
+		const CommandSocketEvent& rEvent);
+	void NotifyChanged();
+
+	friend class TestDaemonMonitor;
+
+	DaemonMonitor(const DaemonMonitor& rToCopy)
+	: wxThread(wxTHREAD_JOINABLE) { /* forbidden */ }
+	DaemonMonitor& operator=(const DaemonMonitor& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _DAEMONMONITOR_H */
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *            DaemonMonitorFrame.h
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DAEMONMONITORFRAME_H
+#define _DAEMONMONITORFRAME_H
+
+#include <vector>
+
+#include <wx/frame.h>
+#include <wx/listctrl.h>
+
+#include "DaemonMonitor.h"
+
+// A virtual list control showing one row per monitored daemon, sorted
+// by whichever column was last clicked. Clicking it again reverses the
+// order. Only the visible rows are ever rendered, so it costs the same
+// to show a thousand daemons as ten.
+class DaemonMonitorList : public wxListCtrl
+{
+	public:
+	DaemonMonitorList(wxWindow* pParent, wxWindowID id);
+
+	void SetStatus(const std::vector<DaemonMonitor::Status>& rStatus);
+
+	private:
+	std::vector<DaemonMonitor::Status> mStatus; // in display order
+	int  mSortColumn;
+	bool mSortAscending;
+
+	void Sort();
+	void OnColumnClick(wxListEvent& rEvent);
+	virtual wxString OnGetItemText(long item, long column) const;
+
+	DECLARE_EVENT_TABLE()
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    DaemonMonitorFrame
+//		Purpose: A window listing a set of bbackupd daemons, with
+//			 the state of each, its latest syncs and errors, as
+//			 reported by a DaemonMonitor. Opened instead of the
+//			 main window by the --monitor option.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+class DaemonMonitorFrame
+: public wxFrame,
+  private DaemonMonitor::Listener
+{
+	public:
+	DaemonMonitorFrame(const wxString& rListFileName,
+		const wxPoint& rPos, const wxSize& rSize);
+
+	virtual void NotifyDaemonsChanged();
+
+	private:
+	DaemonMonitorList* mpList;
+	DaemonMonitor      mMonitor;
+
+	void OnMonitorNotify(wxCommandEvent& rEvent);
+	void RefreshStatus();
+
+	DECLARE_EVENT_TABLE()
+};
+
+#endif /* _DAEMONMONITORFRAME_H */
@@ -0,0 +1,123 @@
+/***************************************************************************
+ *            ExcludeProfiler.h
+ *
+ *  Wed Jan  7 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _EXCLUDEPROFILER_H
+#define _EXCLUDEPROFILER_H
+
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "Location.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BoxiExcludeProfiler
+//		Purpose: Walks a location once without backing anything up,
+//			 trying every exclude entry against every file and
+//			 directory that a backup would see, and records how
+//			 often each entry matches, how much it excludes, and
+//			 how long it takes to evaluate.
+//
+//			 Entries that never match, and entries that match
+//			 but are always beaten by an earlier entry of the
+//			 same kind, are probably mistakes, and are flagged
+//			 in the report.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+class BoxiExcludeProfiler
+{
+	public:
+	class RuleStats
+	{
+		public:
+		typedef std::vector<RuleStats> Vector;
+		typedef Vector::const_iterator ConstIterator;
+
+		const BoxiExcludeEntry* mpEntry;
+		regex_t* mpRegex;       // NULL for exact matches
+		bool     mRegexInvalid; // failed to compile, never tried
+		size_t   mNumMatches;   // paths matched at all
+		size_t   mNumFirstMatches; // paths where it was the one used
+		size_t   mNumFiles;     // files excluded by it, or for an
+		int64_t  mNumBytes;     // AlwaysInclude, saved from exclusion
+		int64_t  mTimeUsed;     // total evaluation time, box_time_t
+
+		RuleStats(const BoxiExcludeEntry* pEntry)
+		: mpEntry(pEntry),
+		  mpRegex(NULL),
+		  mRegexInvalid(false),
+		  mNumMatches(0),
+		  mNumFirstMatches(0),
+		  mNumFiles(0),
+		  mNumBytes(0),
+		  mTimeUsed(0)
+		{ }
+
+		bool IsNeverMatched() const
+		{ return !mRegexInvalid && mNumMatches == 0; }
+		bool IsShadowed() const
+		{ return mNumMatches > 0 && mNumFirstMatches == 0; }
+	};
+
+	BoxiExcludeProfiler(const BoxiLocation& rLocation);
+	~BoxiExcludeProfiler();
+
+	void Run();
+
+	const RuleStats::Vector& GetRuleStats() const { return mRuleStats; }
+	size_t  GetNumFilesScanned() const { return mNumFilesScanned; }
+	size_t  GetNumDirsScanned()  const { return mNumDirsScanned; }
+	size_t  GetNumFilesExcluded() const { return mNumFilesExcluded; }
+	int64_t GetNumBytesScanned() const { return mNumBytesScanned; }
+	int64_t GetNumBytesExcluded() const { return mNumBytesExcluded; }
+
+	wxString GetReport() const;
+
+	private:
+	std::string mLocationPath;
+	wxString    mLocationName;
+	RuleStats::Vector mRuleStats;
+	size_t  mNumFilesScanned;
+	size_t  mNumDirsScanned;
+	size_t  mNumFilesExcluded;
+	int64_t mNumBytesScanned;
+	int64_t mNumBytesExcluded;
+
+	void ScanDirectory(const std::string& rLocalPath);
+	bool EvaluatePath(const std::string& rLocalPath, bool isDirectory,
+		int64_t numBytes);
+	void CountExcludedDirectory(const std::string& rLocalPath,
+		size_t* pNumFiles, int64_t* pNumBytes);
+
+	BoxiExcludeProfiler(const BoxiExcludeProfiler& rToCopy)
+	{ /* forbidden */ }
+	BoxiExcludeProfiler& operator=(const BoxiExcludeProfiler& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _EXCLUDEPROFILER_H */
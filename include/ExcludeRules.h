@@ -0,0 +1,115 @@
+/***************************************************************************
+ *            ExcludeRules.h
+ *
+ *  Tue Jan  6 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _EXCLUDERULES_H
+#define _EXCLUDERULES_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ExcludeList.h"
+
+#include "Location.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BoxiExcludeRules
+//		Purpose: A compiled form of a BoxiExcludeList, built once
+//			 each time the list changes. Regular expressions are
+//			 compiled up front, exact paths are looked up in a
+//			 map, and rules are grouped by sense and by whether
+//			 they apply to files or directories, so that each
+//			 path is checked only against the rules that could
+//			 match it.
+//
+//			 Holds pointers into the list's entries, so it must
+//			 be discarded whenever the list changes.
+//		Created: 2009/01/06
+//
+// --------------------------------------------------------------------------
+class BoxiExcludeRules
+{
+	public:
+	BoxiExcludeRules(const BoxiExcludeEntry::List& rEntries);
+	~BoxiExcludeRules();
+
+	void Match(const std::string& rPath, bool isDirectory,
+		const BoxiExcludeEntry** ppExcludedBy,
+		const BoxiExcludeEntry** ppIncludedBy) const;
+	bool IsExcluded(const std::string& rPath, bool isDirectory) const;
+
+	static std::string CombinePatterns(
+		const std::vector<std::string>& rPatterns);
+
+	private:
+	class Rule
+	{
+		public:
+		size_t mIndex;
+		const BoxiExcludeEntry* mpEntry;
+		regex_t* mpRegex;
+
+		Rule(size_t index, const BoxiExcludeEntry* pEntry,
+			regex_t* pRegex)
+		: mIndex(index),
+		  mpEntry(pEntry),
+		  mpRegex(pRegex)
+		{ }
+	};
+
+	// All the rules with the same sense and file/dir type. Only
+	// the first entry for each exact path is kept, as a later one
+	// could never be reported.
+	//
+	// If there is more than one regex, they are also compiled
+	// together into a single alternation, so that a path which
+	// matches none of them (the usual case) is rejected with one
+	// regexec() call however many rules there are. Only when that
+	// matches are the rules tried one by one, to find which.
+	class Group
+	{
+		public:
+		std::map<std::string, Rule> mExact;
+		std::vector<Rule> mRegex; // in list order
+		regex_t* mpCombinedRegex;
+
+		Group() : mpCombinedRegex(NULL) { }
+	};
+
+	// indexed by [sense is AlwaysInclude][applies to directories]
+	Group mGroups[2][2];
+
+	const BoxiExcludeEntry* MatchGroup(const Group& rGroup,
+		const std::string& rPath) const;
+
+	friend class TestExcludeRules;
+
+	BoxiExcludeRules(const BoxiExcludeRules& rToCopy) { /* forbidden */ }
+	BoxiExcludeRules& operator=(const BoxiExcludeRules& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _EXCLUDERULES_H */
@@ -25,6 +25,10 @@
 #ifndef _FILETREE_H
 #define _FILETREE_H
 
+#include <map>
+#include <set>
+#include <vector>
+
 #include <wx/image.h>
 #include <wx/imaglist.h>
 #include <wx/mstream.h>
@@ -32,6 +36,9 @@
 
 #include "StaticImage.h"
 
+// Number of children added to a tree node at a time
+#define FILE_TREE_PAGE_SIZE 1000
+
 class FileImageList : public wxImageList
 {
 	private:
@@ -64,26 +71,70 @@ class FileImageList : public wxImageList
 	int GetAlwaysGreyImageId()  { return mAlwaysGreyImageId;  }
 };
 
+class FileTree;
+
 class FileNode : public wxTreeItemData 
 {
 	private:
 	FileNode* mpParentNode;
+
+	// Children are added to the tree a page at a time, as they come
+	// into view, with a placeholder item standing in for the rest.
+	size_t       mNumChildren;
+	size_t       mNumChildrenAdded;
+	wxTreeItemId mMoreItemId;
+	FileTree*    mpPagingTree;
 	
 	public:
 	FileNode() 
-	: mpParentNode(NULL)
+	: mpParentNode(NULL),
+	  mNumChildren(0),
+	  mNumChildrenAdded(0),
+	  mpPagingTree(NULL)
 	{ }
 
 	FileNode(FileNode* pParent)
-	: mpParentNode(pParent)
+	: mpParentNode(pParent),
+	  mNumChildren(0),
+	  mNumChildrenAdded(0),
+	  mpPagingTree(NULL)
 	{ }
 
+	virtual ~FileNode();
+
 	FileNode* GetParentNode() const { return mpParentNode; }
 	virtual const wxString& GetFileName() const = 0;
 	virtual const wxString& GetFullPath() const = 0;
 	
 	bool AddChildren(wxTreeCtrl* pTreeCtrl, bool recurse);
 	virtual int UpdateState(FileImageList& rImageList, bool updateParents) = 0;
+
+	// Returns true if the last UpdateState() found that nothing this
+	// node or any of its descendants depend on had changed, so that
+	// their icons need not be updated.
+	virtual bool IsSubtreeStateCurrent() const { return false; }
+
+	// Returns the number of times UpdateState() has worked out this
+	// node's state afresh, rather than reusing the last result.
+	virtual size_t GetNumStateChecks() const { return 0; }
+
+	const wxTreeItemId& GetMoreItemId() const { return mMoreItemId; }
+	bool AddNextPage(FileTree* pTreeCtrl, bool recurse,
+		wxTreeItemId* pFirstNewId = NULL);
+
+	protected:
+	bool StartPaging(FileTree* pTreeCtrl, size_t numChildren,
+		bool recurse);
+	void StopPaging();
+
+	// Called before adding children [start, end) to the tree, to
+	// put at least those in order, if they weren't already.
+	virtual void PrepareChildren(size_t start, size_t end) { }
+	// Adds the child with the given index to the tree, and returns
+	// its new node.
+	virtual FileNode* AddChild(FileTree* pTreeCtrl, size_t index) = 0;
+	// Called when all the children have been added, or discarded.
+	virtual void OnPagingFinished() { }
 	
 	private:
 	virtual bool _AddChildrenSlow(wxTreeCtrl* pTreeCtrl, bool recurse) = 0;
@@ -101,18 +152,47 @@ class FileTree : public wxTreeCtrl
 		FileNode* pRootNode,
 		const wxString& rRootLabel
 		);
+	~FileTree();
 
 	// do not use this constructor! IMPLEMENT_DYNAMIC_CLASS
 	// requires it, but it doesn't work!
 	FileTree() { }
 
+	// Marks the node's icon (and optionally those of its parents
+	// and children) as needing to be updated. The updates are done
+	// together, on the next idle event or FlushStateIcons().
 	void UpdateStateIcon(FileNode* pNode, bool updateParents, 
 		bool updateChildren);
+	// Icons inside collapsed nodes are left until they're expanded,
+	// unless includeHidden is true.
+	void FlushStateIcons(bool includeHidden = false);
+
+	// Nodes with children still waiting to be added
+	void AddPagedNode   (FileNode* pNode) { mPagedNodes.insert(pNode); }
+	void RemovePagedNode(FileNode* pNode) { mPagedNodes.erase(pNode); }
 
 	private:
+	enum
+	{
+		DIRTY_PARENTS  = 1,
+		DIRTY_CHILDREN = 2,
+	};
+
 	FileImageList mImages;
+	std::set<FileNode*> mPagedNodes;
+	// Nodes waiting for FlushStateIcons(), with DIRTY_* flags
+	std::map<FileNode*, int> mDirtyNodes;
+	// Collapsed nodes whose own icons are current, but whose
+	// descendants' icons were not updated as they can't be seen
+	std::set<FileNode*> mStaleNodes;
 
+	void SetStateIcon(FileNode* pNode);
+	void UpdateChildStateIcons(FileNode* pNode, bool onlyVisible);
+	void RefreshStaleAncestor(FileNode* pNode);
+	void RefreshStaleNodes();
 	void OnTreeNodeExpand(wxTreeEvent& event);
+	void OnTreeNodeDelete(wxTreeEvent& event);
+	void OnIdle(wxIdleEvent& rEvent);
 	
 	DECLARE_EVENT_TABLE()
 };
@@ -121,18 +201,44 @@ class LocalFileTree;
 	
 class LocalFileNode : public FileNode 
 {
+	public:
+	// A directory entry that has been read, but not added to the
+	// tree yet. Sorts directories first, then by name.
+	class Entry
+	{
+		public:
+		wxString mName;
+		bool     mIsDirectory;
+
+		Entry(const wxString& rName, bool isDirectory)
+		: mName(rName),
+		  mIsDirectory(isDirectory)
+		{ }
+
+		bool operator<(const Entry& rOther) const
+		{
+			if (mIsDirectory != rOther.mIsDirectory)
+			{
+				return mIsDirectory;
+			}
+			return mName.Cmp(rOther.mName) < 0;
+		}
+	};
+
 	private:
 	wxString mFileName;
 	wxString mFullPath;
 	bool     mIsRoot;
 	bool     mIsDirectory;
+	std::vector<Entry> mPendingEntries;
 	
 	public:
 	LocalFileNode(const wxString& path);
-	LocalFileNode(LocalFileNode* pParent, const wxString& path);
+	LocalFileNode(LocalFileNode* pParent, const wxString& path,
+		bool isDirectory);
 
 	virtual LocalFileNode* CreateChildNode(LocalFileNode* pParent, 
-		const wxString& rPath);
+		const wxString& rPath, bool isDirectory);
 	
 	virtual const wxString& GetFileName() const { return mFileName; }
 	virtual const wxString& GetFullPath() const { return mFullPath; }
@@ -143,7 +249,13 @@ class LocalFileNode : public FileNode
 	// void SetDirectory(bool value = true) { mIsDirectory = value; }
 	virtual int UpdateState(FileImageList& rImageList, bool updateParents);
 
+	protected:
+	virtual void PrepareChildren(size_t start, size_t end);
+	virtual FileNode* AddChild(FileTree* pTreeCtrl, size_t index);
+	virtual void OnPagingFinished();
+
 	private:
+	bool ReadEntries();
 	virtual bool _AddChildrenSlow(LocalFileTree* pTreeCtrl, bool recurse);
 	virtual bool _AddChildrenSlow(wxTreeCtrl*    pTreeCtrl, bool recurse)
 	{
@@ -161,9 +273,6 @@ class LocalFileTree : public FileTree
 		LocalFileNode* pRootNode,
 		const wxString& rRootLabel
 	);
-	
-	virtual int OnCompareItems(const wxTreeItemId& item1, 
-		const wxTreeItemId& item2);
 };
 
 #endif /* _FILETREE_H */
@@ -0,0 +1,85 @@
+/***************************************************************************
+ *            HeadlessRunner.h
+ *
+ *  Mon Jan  5 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _HEADLESSRUNNER_H
+#define _HEADLESSRUNNER_H
+
+#include <memory>
+
+#include <wx/string.h>
+
+#include "CompareReport.h"
+
+class ClientConfig;
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    HeadlessRunner
+//		Purpose: Runs a compare, restore, exclude profile or schedule
+//			 simulation from the command line, without creating
+//			 any windows, for use from cron or scripts. Progress
+//			 and results are printed to stdout, errors to stderr,
+//			 and the outcome is returned as a process exit code.
+//		Created: 2009/01/05
+//
+// --------------------------------------------------------------------------
+class HeadlessRunner
+{
+	public:
+	typedef enum
+	{
+		HR_EXIT_OK = 0,
+		HR_EXIT_DIFFERENCES,
+		HR_EXIT_USAGE,
+		HR_EXIT_CONFIG_ERROR,
+		HR_EXIT_CONNECTION_FAILED,
+		HR_EXIT_FAILED,
+	}
+	ExitCode;
+
+	HeadlessRunner(const wxString& rConfigFileName);
+	~HeadlessRunner();
+
+	ExitCode RunCompare(const wxString& rLocationName, bool quickCompare,
+		const wxString& rReportFileName,
+		CompareReport::Format reportFormat);
+	ExitCode RunRestore(const wxString& rStorePath,
+		const wxString& rLocalPath, bool resume);
+	ExitCode RunExcludeProfile(const wxString& rLocationName);
+	ExitCode RunSimulation(const wxString& rTraceFileName,
+		long numClients, const wxString& rReportFileName);
+
+	private:
+	wxString mConfigFileName;
+	std::auto_ptr<ClientConfig> mapConfig;
+
+	bool LoadConfig(bool checkConfig = true);
+
+	HeadlessRunner(const HeadlessRunner& rToCopy) { /* forbidden */ }
+	HeadlessRunner& operator=(const HeadlessRunner& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _HEADLESSRUNNER_H */
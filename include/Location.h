@@ -223,6 +223,7 @@ class BoxiExcludeEntry
 };
 
 class BoxiExcludeList;
+class BoxiExcludeRules;
 
 class LocationChangeListener 
 {
@@ -237,30 +238,47 @@ class BoxiExcludeList
 	private:
 	BoxiExcludeEntry::List mEntries;
 	LocationChangeListener* mpListener;
+	
+	// compiled from mEntries on first use after each change
+	mutable BoxiExcludeRules* mpRules;
+
+	// unique to this list and its current contents, so that anyone
+	// caching results derived from it can tell when they are stale
+	unsigned long mGeneration;
 
 	public:
 	BoxiExcludeList(LocationChangeListener* pListener) 
-	: mpListener(pListener) { };
+	: mpListener(pListener), mpRules(NULL),
+	  mGeneration(NewGeneration()) { };
 	
 	BoxiExcludeList(const Configuration& conf,
 		LocationChangeListener* pListener);
 	
 	BoxiExcludeList(const BoxiExcludeList& rToCopy)
-	: mpListener(rToCopy.mpListener)
+	: mpListener(rToCopy.mpListener),
+	  mpRules(NULL),
+	  mGeneration(NewGeneration())
 	{
 		mEntries = rToCopy.mEntries;
 	}
+	~BoxiExcludeList() { ClearRules(); }
+	BoxiExcludeList& operator=(const BoxiExcludeList& rToCopy)
+	{
+		mEntries   = rToCopy.mEntries;
+		mpListener = rToCopy.mpListener;
+		mGeneration = NewGeneration();
+		ClearRules();
+		return *this;
+	}
 	void CopyFrom(const BoxiExcludeList& rToCopy)
 	{
 		mEntries = rToCopy.mEntries;
-
-		if (mpListener)
-		{
-			mpListener->OnExcludeListChange(this);
-		}
+		OnChange();
 	}
 	
 	const BoxiExcludeEntry::List& GetEntries() const { return mEntries; }
+	const BoxiExcludeRules& GetRules() const;
+	unsigned long GetGeneration() const { return mGeneration; }
 	void AddEntry(const BoxiExcludeEntry& rNewEntry);
 	void InsertEntry(int index, const BoxiExcludeEntry& rNewEntry);
 	void ReplaceEntry(const BoxiExcludeEntry& rOldEntry, 
@@ -306,6 +324,9 @@ class BoxiExcludeList
 	{ mpListener = pListener; }
 	
 	private:
+	static unsigned long NewGeneration();
+	void ClearRules();
+	void OnChange();
 	void _AddConfigList(const Configuration& conf, const std::string& keyName,
 		BoxiExcludeType& rType);
 	void _AddSeparatedList(const std::string& entries, BoxiExcludeType& rType);
@@ -389,6 +410,8 @@ class BoxiLocation
 		bool* pMatched);
 	
 	ExcludeList* GetBoxExcludeList(bool listDirs) const;
+	static void AddBoxRegexEntries(ExcludeList& rList,
+		const std::vector<std::string>& rRegexes);
 	
 	void SetListener(LocationChangeListener* pListener)
 	{ mpListener = pListener; mExcluded.SetListener(pListener); }
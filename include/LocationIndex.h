@@ -0,0 +1,81 @@
+/***************************************************************************
+ *            LocationIndex.h
+ *
+ *  Wed Jan  7 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _LOCATIONINDEX_H
+#define _LOCATIONINDEX_H
+
+#include <map>
+
+#include <wx/string.h>
+
+#include "Location.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BoxiLocationIndex
+//		Purpose: The root paths of all locations, stored as a tree
+//			 of path components, so that finding the location
+//			 rooted at a path, or whether a path is a parent of
+//			 any location root, takes one walk down the path
+//			 instead of a string comparison per location.
+//
+//			 Repeated and trailing separators are ignored, so
+//			 "/home/" and "/home" are the same path.
+//
+//			 Holds pointers to the locations, so it must be
+//			 discarded whenever the list of locations changes.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+class BoxiLocationIndex
+{
+	public:
+	BoxiLocationIndex(BoxiLocation::List& rLocations);
+	~BoxiLocationIndex() { }
+
+	BoxiLocation* GetLocationAt(const wxString& rPath) const;
+	bool IsParentOfLocation(const wxString& rPath) const;
+
+	private:
+	class Node
+	{
+		public:
+		std::map<wxString, Node*> mChildren;
+		BoxiLocation* mpLocation;
+
+		Node() : mpLocation(NULL) { }
+		~Node();
+	};
+
+	Node mRoot;
+
+	const Node* FindNode(const wxString& rPath) const;
+
+	BoxiLocationIndex(const BoxiLocationIndex& rToCopy) { /* forbidden */ }
+	BoxiLocationIndex& operator=(const BoxiLocationIndex& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+#endif /* _LOCATIONINDEX_H */
@@ -0,0 +1,138 @@
+/***************************************************************************
+ *            ProgressModel.h
+ *
+ *  Sat Jan 10 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _PROGRESSMODEL_H
+#define _PROGRESSMODEL_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// how far back the throughput is measured
+#define PROGRESS_WINDOW_MILLIS 10000
+// no rate is shown until the samples span at least this long
+#define PROGRESS_MIN_SPAN_MILLIS 1000
+// updates closer together than this are merged into one sample
+#define PROGRESS_SAMPLE_MILLIS 250
+// the time it takes to handle a file, however small, in bytes' worth
+#define PROGRESS_FILE_OVERHEAD_BYTES 4096
+#define PROGRESS_HISTORY_INTERVAL_MILLIS 1000
+#define PROGRESS_HISTORY_MAX_POINTS 4096
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    ProgressModel
+//		Purpose: Works out the throughput of a backup, restore or
+//			 compare, in files and bytes per second over the
+//			 last few seconds, and how long the rest of it
+//			 should take.
+//
+//			 Each file costs some time however small it is, so
+//			 the estimate counts every file as a fixed number of
+//			 bytes of work on top of its size. A run of small
+//			 files then doesn't make the end look nearer than it
+//			 is, and nor does a run of large ones.
+//
+//			 Also keeps a history of the run, one point every
+//			 second or so, which can be written out as CSV. Times
+//			 are in milliseconds, from any fixed origin.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+class ProgressModel
+{
+	public:
+	ProgressModel();
+
+	void Start(int64_t nowMillis);
+	void Update(int64_t nowMillis, size_t numFilesDone,
+		int64_t numBytesDone, size_t numFilesTotal,
+		int64_t numBytesTotal);
+
+	bool    IsRateKnown()         const { return mRateKnown; }
+	double  GetFilesPerSecond()   const { return mFilesPerSecond; }
+	double  GetBytesPerSecond()   const { return mBytesPerSecond; }
+	int64_t GetSecondsRemaining() const { return mSecondsRemaining; }
+	int64_t GetSecondsElapsed()   const { return mLatest.mMillis / 1000; }
+	int64_t GetMillisElapsed()    const { return mLatest.mMillis; }
+
+	bool WriteCsv(const std::string& rFileName) const;
+
+	private:
+	friend class TestProgressModel;
+
+	class Sample
+	{
+		public:
+		int64_t mMillis;
+		size_t  mNumFiles;
+		int64_t mNumBytes;
+
+		Sample(int64_t millis, size_t numFiles, int64_t numBytes)
+		: mMillis(millis),
+		  mNumFiles(numFiles),
+		  mNumBytes(numBytes)
+		{ }
+	};
+
+	class HistoryPoint
+	{
+		public:
+		int64_t mMillis; // since Start()
+		size_t  mNumFilesDone;
+		int64_t mNumBytesDone;
+		double  mFilesPerSecond;
+		double  mBytesPerSecond;
+		int64_t mSecondsRemaining;
+
+		HistoryPoint()
+		: mMillis(0),
+		  mNumFilesDone(0),
+		  mNumBytesDone(0),
+		  mFilesPerSecond(0),
+		  mBytesPerSecond(0),
+		  mSecondsRemaining(-1)
+		{ }
+	};
+
+	int64_t mStartMillis;
+	std::deque<Sample> mWindow; // oldest first
+	bool    mRateKnown;
+	double  mFilesPerSecond;
+	double  mBytesPerSecond;
+	int64_t mSecondsRemaining; // or -1 if not known
+
+	// Thinned out, and the interval doubled, whenever it fills up,
+	// so that a long run keeps its whole shape in bounded memory
+	std::vector<HistoryPoint> mHistory;
+	int64_t mHistoryIntervalMillis;
+	HistoryPoint mLatest;
+
+	void AddHistory(const HistoryPoint& rPoint);
+};
+
+#endif /* _PROGRESSMODEL_H */
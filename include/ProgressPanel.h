@@ -27,7 +27,15 @@
 
 #include <wx/log.h>
 #include <wx/panel.h>
+#include <wx/thread.h>
+#include <wx/timer.h>
 
+#include "ProgressModel.h"
+#include "RunHistory.h"
+
+class BoxiExcludeRules;
+class ClientConfig;
+class ThroughputChart;
 class wxButton;
 class wxGauge;
 class wxListBox;
@@ -52,17 +60,39 @@ class ProgressPanel : public wxPanel
 		virtual bool IsExcludedDir (const std::string& rDirName)  = 0;
 		virtual ~ExclusionOracle() { }
 	};
+
+	// Answers from the compiled exclude rules of a Boxi location,
+	// the same ones that the backup locations tree uses.
+	class RulesExclusionOracle : public ExclusionOracle
+	{
+		private:
+		const BoxiExcludeRules& mrRules;
+
+		public:
+		RulesExclusionOracle(const BoxiExcludeRules& rRules)
+		: mrRules(rRules)
+		{ }
+		virtual bool IsExcludedFile(const std::string& rFileName);
+		virtual bool IsExcludedDir (const std::string& rDirName);
+	};
+	
+	static wxString FormatNumBytes(int64_t bytes);
+	static wxString FormatDuration(int64_t seconds);
 	
 	protected:
 	wxListBox* mpErrorList;
 	wxGauge*   mpProgressGauge;
 
 	int GetNumFilesTotal() { return mNumFilesCounted; }
+	int64_t GetNumBytesTotal() { return mNumBytesCounted; }
+	size_t  GetNumFilesDone()  { return mNumFilesDone; }
+	int64_t GetNumBytesDone()  { return mNumBytesDone; }
 
 	private:
 	friend class TestBackup;
 	friend class TestRestore;
 	friend class TestCompare;
+	friend class TestProgressPanel;
 	int GetProgressMax();
 	int GetProgressPos();
 	wxString GetNumFilesTotalString();
@@ -81,6 +111,11 @@ class ProgressPanel : public wxPanel
 	wxTextCtrl* mpNumBytesDone;
 	wxTextCtrl* mpNumBytesRemaining;
 	wxTextCtrl* mpNumBytesTotal;
+	wxTextCtrl* mpTimeElapsed;
+	wxTextCtrl* mpTimeRemaining;
+	wxTextCtrl* mpTimeTotal;
+	wxTextCtrl* mpSpeed;
+	wxButton*   mpExportButton;
 	wxButton*   mpStopCloseButton;
 
 	size_t  mNumFilesCounted;
@@ -88,19 +123,36 @@ class ProgressPanel : public wxPanel
 
 	size_t  mNumFilesDone;
 	int64_t mNumBytesDone;
+	size_t  mNumErrors;
+	time_t  mStartTime;
+
+	ProgressModel mProgressModel;
+	ThroughputChart* mpThroughputChart;
+	wxTimer mRateTimer;
 	
-	wxString FormatNumBytes(int64_t bytes);
+	void UpdateDoneAndRemaining();
+	void UpdateRates();
+	void OnExportClicked(wxCommandEvent& rEvent);
+	void OnRateTimer(wxTimerEvent& rEvent);
+
+	DECLARE_EVENT_TABLE()
 
 	protected:	
-	void NotifyMoreFilesCounted(size_t numAdditionalFiles, 
+	virtual void NotifyMoreFilesCounted(size_t numAdditionalFiles, 
 		int64_t numAdditionalBytes);
 
 	void NotifyMoreFilesDone(size_t numAdditionalFiles, 
 		int64_t numAdditionalBytes);
 
+	void SetTotals(size_t numFiles, int64_t numBytes);
+
 	void ReportFatalError(message_t messageId, wxString msg);
+	void NotifyErrors(size_t numErrors) { mNumErrors += numErrors; }
 	
 	void ResetCounters();
+	void StopTiming();
+	void RecordRun(ClientConfig* pConfig, RunHistory::Run& rRun);
+	void AddThroughputChart();
 	void SetSummaryText    (const wxString& rText);
 	void SetCurrentText    (const wxString& rText);
 	void SetStopButtonLabel(const wxString& rLabel);
@@ -110,7 +162,10 @@ class ProgressPanel : public wxPanel
 	void CountLocalFiles(ExclusionOracle& rExclusionOracle,
 		const std::string &rLocalPath);
 	
-	void NotifyCountDirectory(const std::string& rLocalPath)
+	// Called by CountLocalFiles(), and overridden by panels that
+	// count away from the GUI thread
+	virtual void NotifyCountStatFailed(const std::string& rFileName);
+	virtual void NotifyCountDirectory(const std::string& rLocalPath)
 	{
 		wxString msg;
 		msg.Printf(wxT("Counting files in directory '%s'"), 
@@ -121,11 +176,16 @@ class ProgressPanel : public wxPanel
 	}	
 };
 
+// Messages logged by other threads can't go straight into the list
+// box, so they're queued until FlushQueued() is called on the GUI
+// thread, or the target is removed.
 class LogToListBox : public wxLog
 {
 	private:
 	wxListBox* mpTarget;
 	wxLog* mpOldTarget;
+	wxMutex mQueueMutex;
+	wxArrayString mQueued;
 	
 	public:
 	LogToListBox(wxListBox* pTarget)
@@ -133,10 +193,15 @@ class LogToListBox : public wxLog
 	{
 		wxLog::SetActiveTarget(this);		
 	}
-	virtual ~LogToListBox() { wxLog::SetActiveTarget(mpOldTarget); }
+	virtual ~LogToListBox()
+	{
+		wxLog::SetActiveTarget(mpOldTarget);
+		FlushQueued();
+	}
 	
 	virtual void DoLog(wxLogLevel level, const wxChar *msg, 
 		time_t timestamp);
+	void FlushQueued();
 };
 
 #endif /* _PROGRESSPANEL_H */
@@ -0,0 +1,126 @@
+/***************************************************************************
+ *            ReportingCompareParams.h
+ *
+ *  Wed Jan 14 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _REPORTINGCOMPAREPARAMS_H
+#define _REPORTINGCOMPAREPARAMS_H
+
+#include <string>
+
+#include <wx/string.h>
+
+#include "BoxBackupCompareParams.h"
+
+#include "CompareReport.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    ReportingCompareParams
+//		Purpose: Receives compare results from Box Backup, turns
+//			 each difference into a message for the user, and
+//			 passes it to a Sink. Also writes each difference
+//			 to a CompareReport, if there is one. Shared by the
+//			 Compare panel and the headless compare, so that
+//			 both describe differences in the same words.
+//		Created: 2009/01/14
+//
+// --------------------------------------------------------------------------
+class ReportingCompareParams : public BoxBackupCompareParams
+{
+	public:
+	class Sink
+	{
+		public:
+		virtual ~Sink() { }
+
+		// Called once for each difference found
+		virtual void AddDifference(const wxString& rMessage) = 0;
+
+		// Called before each file or directory is compared
+		virtual void NotifyComparing(const wxString& rLocalPath,
+			bool IsFile) { }
+
+		// Called after each file has been compared
+		virtual void AddFileDone(int64_t NumBytes) { }
+	};
+
+	ReportingCompareParams(Sink& rSink, CompareReport* pReport,
+		bool QuickCompare, bool IgnoreExcludes, bool IgnoreAttributes,
+		box_time_t LatestFileUploadTime);
+
+	static wxString GetNativeErrorMessage();
+
+	virtual void NotifyLocalDirMissing(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyLocalDirAccessFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyStoreDirMissingAttributes(
+		const std::string& rLocalPath, const std::string& rRemotePath);
+	virtual void NotifyRemoteFileMissing(const std::string& rLocalPath,
+		const std::string& rRemotePath,	bool modifiedAfterLastSync);
+	virtual void NotifyLocalFileMissing(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyExcludedFileNotDeleted(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes,
+		BoxException& rException);
+	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes,
+		std::exception& rException);
+	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes);
+	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes,
+		std::exception& rException);
+	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes);
+	virtual void NotifyExcludedFile(const std::string& rLocalPath,
+		const std::string& rRemotePath) { }
+	virtual void NotifyExcludedDir(const std::string& rLocalPath,
+		const std::string& rRemotePath) { }
+	virtual void NotifyDirComparing(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyDirCompared(const std::string& rLocalPath,
+		const std::string& rRemotePath,	bool HasDifferentAttributes,
+		bool modifiedAfterLastSync);
+	virtual void NotifyFileComparing(const std::string& rLocalPath,
+		const std::string& rRemotePath);
+	virtual void NotifyFileCompared(const std::string& rLocalPath,
+		const std::string& rRemotePath, int64_t NumBytes,
+		bool HasDifferentAttributes, bool HasDifferentContents,
+		bool modifiedAfterLastSync, bool newAttributesApplied);
+
+	private:
+	Sink& mrSink;
+	CompareReport* mpReport;
+
+	void AddDifference(const wxString& rMessage,
+		CompareReport::Kind kind, const std::string& rLocalPath,
+		const std::string& rRemotePath, bool isDirectory,
+		int64_t numBytes = -1, bool modifiedAfterLastSync = false,
+		const std::string& rDetail = "");
+};
+
+#endif /* _REPORTINGCOMPAREPARAMS_H */
@@ -0,0 +1,129 @@
+/***************************************************************************
+ *            RunHistory.h
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _RUNHISTORY_H
+#define _RUNHISTORY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+
+// the name of the history file in the client's data directory
+#define RUN_HISTORY_FILE "boxi_run_history"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RunHistory
+//		Purpose: A record of past backup, restore and compare runs,
+//			 with how long each took and how much it did, kept
+//			 in a file in the client's data directory, one line
+//			 per run. New runs are appended, and only the most
+//			 recent few hundred of each kind are kept.
+//
+//			 Runs can be read back by kind and date, for trend
+//			 charts, and a finished run can be compared with the
+//			 ones before it, to notice when runs are getting
+//			 slower long before they miss the backup window.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+class RunHistory
+{
+	public:
+	typedef enum
+	{
+		RK_BACKUP = 0,
+		RK_RESTORE,
+		RK_COMPARE,
+	}
+	Kind;
+
+	typedef enum
+	{
+		RR_SUCCEEDED = 0,
+		RR_FAILED,
+		RR_STOPPED,
+	}
+	Result;
+
+	class Run
+	{
+		public:
+		Kind    mKind;
+		Result  mResult;
+		time_t  mStartTime;
+		int64_t mDurationMillis;
+		size_t  mNumFilesScanned;
+		int64_t mNumBytesScanned;
+		size_t  mNumFilesUploaded; // by a backup
+		int64_t mNumBytesUploaded;
+		size_t  mNumPatchUploads;  // of mNumFilesUploaded
+		size_t  mNumErrors;
+		int64_t mPeakMemoryBytes;  // of the process, or -1 if unknown
+
+		Run(Kind kind = RK_BACKUP)
+		: mKind(kind),
+		  mResult(RR_FAILED),
+		  mStartTime(0),
+		  mDurationMillis(0),
+		  mNumFilesScanned(0),
+		  mNumBytesScanned(0),
+		  mNumFilesUploaded(0),
+		  mNumBytesUploaded(0),
+		  mNumPatchUploads(0),
+		  mNumErrors(0),
+		  mPeakMemoryBytes(-1)
+		{ }
+
+		double GetFilesPerSecond() const;
+	};
+
+	RunHistory(const std::string& rFileName);
+
+	bool Add(const Run& rRun);
+	bool GetRuns(Kind kind, time_t since, std::vector<Run>* pRuns) const;
+	bool IsSlowerThanUsual(const Run& rRun, double* pUsualFilesPerSecond)
+		const;
+	bool RecordAndCheck(const Run& rRun, wxString* pWarning,
+		wxString* pError);
+
+	static int64_t GetPeakMemoryBytes();
+	static const char* GetKindName(Kind kind);
+
+	private:
+	std::string mFileName;
+
+	bool ReadAll(std::vector<Run>* pRuns) const;
+	bool WriteAll(const std::vector<Run>& rRuns) const;
+	static void WriteRun(FILE* pFile, const Run& rRun);
+	static bool ReadRun(const char* pLine, Run* pRun);
+};
+
+#endif /* _RUNHISTORY_H */
@@ -0,0 +1,155 @@
+/***************************************************************************
+ *            ScheduleSimulator.h
+ *
+ *  Tue Jan 13 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _SCHEDULESIMULATOR_H
+#define _SCHEDULESIMULATOR_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    ScheduleSimulator
+//		Purpose: Predicts what bbackupd would upload with a given
+//			 set of timing and diffing settings, by replaying a
+//			 trace of file changes against them: how much each
+//			 sync would send, how many files would be diffed
+//			 rather than sent whole, and how many would be held
+//			 back by MinimumFileAge until MaxUploadWait forced
+//			 them out.
+//
+//			 It can also spread any number of identical clients
+//			 evenly over the sync interval, to estimate the
+//			 busiest minute for a store shared by all of them.
+//
+//			 The trace is a text file, one change per line:
+//			 the time in seconds from any fixed origin, the size
+//			 of the file after the change, the number of bytes
+//			 changed, and the path. A file whose first change is
+//			 the whole of it is new, and must be sent whole;
+//			 otherwise it's assumed to be on the store already.
+//			 Blank lines and lines starting with # are ignored.
+//			 A synthetic trace can be generated instead.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+class ScheduleSimulator
+{
+	public:
+	// The bbackupd settings that affect what's uploaded and when,
+	// all in seconds or bytes as in the configuration file
+	class Settings
+	{
+		public:
+		int mUpdateStoreInterval;
+		int mMinimumFileAge;
+		int mMaxUploadWait;
+		int mDiffingUploadSizeThreshold;
+		int mMaximumDiffingTime; // or 0 for no limit
+
+		Settings()
+		: mUpdateStoreInterval(3600),
+		  mMinimumFileAge(21600),
+		  mMaxUploadWait(86400),
+		  mDiffingUploadSizeThreshold(8192),
+		  mMaximumDiffingTime(0)
+		{ }
+	};
+
+	class Change
+	{
+		public:
+		int64_t mTime;
+		int64_t mSize;
+		int64_t mChangedBytes;
+		std::string mPath;
+
+		Change(int64_t time, int64_t size, int64_t changedBytes,
+			const std::string& rPath)
+		: mTime(time),
+		  mSize(size),
+		  mChangedBytes(changedBytes),
+		  mPath(rPath)
+		{ }
+	};
+
+	class Sync
+	{
+		public:
+		int64_t mTime;
+		size_t  mNumFullUploads;
+		size_t  mNumDiffUploads;
+		size_t  mNumForcedUploads; // by MaxUploadWait
+		size_t  mNumDeferred;      // too recently changed
+		int64_t mBytesUploaded;
+
+		Sync(int64_t time)
+		: mTime(time),
+		  mNumFullUploads(0),
+		  mNumDiffUploads(0),
+		  mNumForcedUploads(0),
+		  mNumDeferred(0),
+		  mBytesUploaded(0)
+		{ }
+	};
+
+	class StoreLoad
+	{
+		public:
+		size_t  mNumClients;
+		int64_t mPeakBytesPerMinute;
+		int64_t mPeakTime; // start of the busiest minute
+		size_t  mPeakUploadingClients; // in any one minute
+
+		StoreLoad()
+		: mNumClients(0),
+		  mPeakBytesPerMinute(0),
+		  mPeakTime(0),
+		  mPeakUploadingClients(0)
+		{ }
+	};
+
+	ScheduleSimulator();
+
+	bool LoadTrace(const std::string& rFileName, std::string* pError);
+	void GenerateTrace(size_t numFiles, int64_t durationSeconds,
+		unsigned int seed);
+	const std::vector<Change>& GetTrace() const { return mTrace; }
+
+	void Run(const Settings& rSettings, int64_t syncOffset,
+		std::vector<Sync>* pSyncs) const;
+	void GetStoreLoad(const Settings& rSettings, size_t numClients,
+		StoreLoad* pLoad) const;
+
+	static bool WriteCsv(const std::vector<Sync>& rSyncs,
+		const std::string& rFileName);
+
+	private:
+	std::vector<Change> mTrace; // in time order
+};
+
+#endif /* _SCHEDULESIMULATOR_H */
@@ -0,0 +1,171 @@
+/***************************************************************************
+ *            SizeEstimator.h
+ *
+ *  Thu Jan  8 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _SIZEESTIMATOR_H
+#define _SIZEESTIMATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+#include "Location.h"
+
+class BoxiExcludeRules;
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BoxiSizeEstimator
+//		Purpose: Works out, on a background thread, how many files
+//			 and bytes a backup of each location would include
+//			 with its current exclude entries, and how much each
+//			 entry excludes (or, for AlwaysInclude, keeps).
+//
+//			 Each location's directory tree is read from disk
+//			 only once, the first time it's estimated, and kept
+//			 in memory. After that, editing the exclude entries
+//			 only re-applies them to the cached tree, which is
+//			 quick, so estimates can follow every change. Call
+//			 Invalidate() to read the trees again, for example
+//			 when the locations have changed.
+//		Created: 2009/01/08
+//
+// --------------------------------------------------------------------------
+class BoxiSizeEstimator : public wxThread
+{
+	public:
+	class Estimate
+	{
+		public:
+		unsigned long mRulesGeneration; // of the list it's based on
+		size_t  mNumFiles;  // that would be backed up
+		int64_t mNumBytes;
+		// one each per exclude entry, in list order: files excluded
+		// by it or, for an AlwaysInclude entry, saved from exclusion
+		std::vector<size_t>  mRuleNumFiles;
+		std::vector<int64_t> mRuleNumBytes;
+
+		Estimate()
+		: mRulesGeneration(0),
+		  mNumFiles(0),
+		  mNumBytes(0)
+		{ }
+	};
+
+	BoxiSizeEstimator();
+	~BoxiSizeEstimator();
+
+	bool Request(const BoxiLocation& rLocation);
+	bool GetEstimate(const wxString& rLocationName,
+		Estimate* pEstimate);
+	void Invalidate();
+	void Stop();
+
+	private:
+	class ScannedFile
+	{
+		public:
+		std::string mName;
+		int64_t     mSize;
+
+		ScannedFile(const std::string& rName, int64_t size)
+		: mName(rName),
+		  mSize(size)
+		{ }
+	};
+
+	class ScannedDir
+	{
+		public:
+		std::string mName;
+		std::vector<ScannedFile> mFiles;
+		std::vector<ScannedDir*> mSubDirs;
+		size_t  mTotalFiles; // in the whole subtree
+		int64_t mTotalBytes;
+
+		ScannedDir(const std::string& rName)
+		: mName(rName),
+		  mTotalFiles(0),
+		  mTotalBytes(0)
+		{ }
+		~ScannedDir();
+
+		private:
+		ScannedDir(const ScannedDir& rToCopy) { /* forbidden */ }
+		ScannedDir& operator=(const ScannedDir& rToCopy)
+		{ return *this; /* forbidden */ }
+	};
+
+	// Everything the worker needs to know about a location, copied
+	// so that the GUI thread can carry on editing the original. No
+	// wxStrings, as their reference counts aren't thread safe. The
+	// rules are compiled on the GUI thread, where any errors in them
+	// can be logged, from the job's own copy of the entries, which
+	// they point into.
+	class Job
+	{
+		public:
+		std::string mName;
+		std::string mPath;
+		BoxiExcludeEntry::List mEntries;
+		unsigned long mRulesGeneration;
+		BoxiExcludeRules* mpRules;
+
+		Job(const BoxiLocation& rLocation);
+		~Job();
+
+		private:
+		Job(const Job& rToCopy) { /* forbidden */ }
+		Job& operator=(const Job& rToCopy)
+		{ return *this; /* forbidden */ }
+	};
+
+	// mPendingJobs, mEstimates, mScansInvalid and mStopRequested are
+	// shared with the worker, and protected by mMutex. Only the
+	// worker touches mScans.
+	wxMutex     mMutex;
+	wxCondition mCondition;
+	std::map<std::string, Job*>     mPendingJobs;
+	std::map<std::string, Estimate> mEstimates;
+	bool mScansInvalid;
+	bool mStopRequested;
+	bool mStarted;
+	bool mStartFailed;
+	std::map<std::string, ScannedDir*> mScans;
+
+	virtual void* Entry();
+	bool IsStopRequested();
+	ScannedDir* GetScan(const std::string& rPath);
+	void ClearScans();
+	bool ScanDirectory(const std::string& rLocalPath, ScannedDir* pDir);
+	void Evaluate(const std::string& rLocalPath, const ScannedDir& rDir,
+		const BoxiExcludeRules& rRules,
+		const std::map<const BoxiExcludeEntry*, size_t>& rIndexes,
+		Estimate* pEstimate);
+};
+
+#endif /* _SIZEESTIMATOR_H */
@@ -56,6 +56,7 @@ class TestBackupConfig : public TestWithConfig
 	std::auto_ptr<FileImageList> mapImages;
 	wxFileName mTestDataDir;
 	wxTreeItemId mTestDataDirItem;
+	wxFileName mTestOtherDir;
 	wxFileName mTestDepth1Dir;
 	wxFileName mTestAnotherDir;
 	wxFileName mTestFile1;
@@ -81,6 +82,8 @@ class TestBackupConfig : public TestWithConfig
 
 	void TestAddAndRemoveSimpleLocationInTree();
 	void TestAddLocationInTree();
+	void TestExcludeCacheIsPrecise();
+	void TestPagedDirectoryInTree();
 	void TestSimpleExcludeInTree();
 	void TestDeepIncludePattern();
 	void TestAlwaysIncludeFileDeepInTree();
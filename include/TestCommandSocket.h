@@ -0,0 +1,54 @@
+/***************************************************************************
+ *            TestCommandSocket.h
+ *
+ *  Sat Jan 17 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TESTCOMMANDSOCKET_H
+#define _TESTCOMMANDSOCKET_H
+
+#include "TestFrame.h"
+
+class CommandSocketClient;
+class CommandSocketPoller;
+
+class TestCommandSocket : public GuiTestBase
+{
+	public:
+	TestCommandSocket() { }
+	virtual void RunTest();
+	static CppUnit::Test *suite();
+
+	private:
+	void TestWake();
+	void TestPartialReads();
+	void TestFullBuffer();
+	void TestLongLine();
+	void TestParser();
+	void TestQueuedEvents();
+	void TestEventQueue();
+	int  ConnectClient(CommandSocketClient& rClient);
+	void WriteToClient(int handle, const char* pData,
+		CommandSocketPoller& rPoller, CommandSocketClient& rClient);
+	void AssertLine(CommandSocketClient& rClient, const char* pExpected);
+};
+
+#endif /* _TESTCOMMANDSOCKET_H */
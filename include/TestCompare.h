@@ -40,6 +40,7 @@ class TestCompare : public TestWithServer
 	wxListBox* mpErrorList;
 
 	void AssertCompareOK(int files, const std::string& rBytes);
+	void TestHeadlessExitCodes();
 };
 
 #endif /* _TESTCOMPARE_H */
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *            TestExcludeRules.h
+ *
+ *  Tue Jan 20 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TESTEXCLUDERULES_H
+#define _TESTEXCLUDERULES_H
+
+#include <string>
+
+#include "Location.h"
+#include "TestFrame.h"
+
+class BoxiExcludeRules;
+
+class TestExcludeRules : public GuiTestBase
+{
+	public:
+	TestExcludeRules() { }
+	virtual void RunTest();
+	static CppUnit::Test *suite();
+
+	private:
+	void TestCombinePatterns();
+	void TestMatchesOneByOne();
+	void TestFallback();
+	void CheckPath(const BoxiExcludeEntry::List& rEntries,
+		const BoxiExcludeRules& rRules, const std::string& rPath,
+		bool isDirectory);
+	static bool HasCombinedRegex(const BoxiExcludeRules& rRules,
+		ExcludeSense sense, ExcludeFileDir fileDir);
+};
+
+#endif /* _TESTEXCLUDERULES_H */
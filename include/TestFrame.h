@@ -251,6 +251,9 @@ class GuiTestBase : public CppUnit::TestCase
 	void ActivateTreeItemWaitEvent(wxTreeCtrl* pTree, wxTreeItemId& rItem);
 	void ExpandTreeItemWaitEvent  (wxTreeCtrl* pTree, wxTreeItemId& rItem);
 	void CollapseTreeItemWaitEvent(wxTreeCtrl* pTree, wxTreeItemId& rItem);
+	// Flushes a FileTree's pending icon updates, including those
+	// hidden in collapsed nodes, and returns the item's icon.
+	int  GetStateIcon(wxTreeCtrl* pTree, const wxTreeItemId& rItem);
 	void SetTextCtrlValue(wxTextCtrl* pTextCtrl, const wxString& rValue);
 	void SetValueAndDefocus(wxTextCtrl* pTextCtrl, const wxString& rValue);
 	void SetValueDefocusCheck(wxTextCtrl* pTextCtrl, const wxString& rValue);
@@ -0,0 +1,45 @@
+/***************************************************************************
+ *            TestProgressModel.h
+ *
+ *  Thu Jan 22 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TESTPROGRESSMODEL_H
+#define _TESTPROGRESSMODEL_H
+
+#include "TestFrame.h"
+
+class TestProgressModel : public GuiTestBase
+{
+	public:
+	TestProgressModel() { }
+	virtual void RunTest();
+	static CppUnit::Test *suite();
+
+	private:
+	void TestRate();
+	void TestTimeRemaining();
+	void TestWindowExpiry();
+	void TestHistoryThinning();
+	void TestWriteCsv();
+};
+
+#endif /* _TESTPROGRESSMODEL_H */
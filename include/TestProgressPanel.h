@@ -0,0 +1,44 @@
+/***************************************************************************
+ *            TestProgressPanel.h
+ *
+ *  Wed Jan 21 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TESTPROGRESSPANEL_H
+#define _TESTPROGRESSPANEL_H
+
+#include "TestFrame.h"
+
+class TestProgressPanel : public GuiTestBase
+{
+	public:
+	TestProgressPanel() { }
+	virtual void RunTest();
+	static CppUnit::Test *suite();
+
+	private:
+	void TestCountLocalFiles();
+	void TestQueuedBackupProgress();
+	void TestLastBackupTotals();
+	void TestBackupCountModes();
+};
+
+#endif /* _TESTPROGRESSPANEL_H */
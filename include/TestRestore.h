@@ -57,6 +57,7 @@ class TestRestore : public TestWithServer
 	void TestRestoreServerRoot();
 	void TestOldAndDeletedFilesNotRestored();
 	void TestRestoreToDate();
+	void TestPagedServerDirectory();
 	void CleanUp();
 };
 
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *            TestScheduleSimulator.h
+ *
+ *  Mon Jan 19 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TESTSCHEDULESIMULATOR_H
+#define _TESTSCHEDULESIMULATOR_H
+
+#include <string>
+
+#include "ScheduleSimulator.h"
+#include "TestFrame.h"
+
+class TestScheduleSimulator : public GuiTestBase
+{
+	public:
+	TestScheduleSimulator() { }
+	virtual void RunTest();
+	static CppUnit::Test *suite();
+
+	private:
+	std::string mFileName;
+	ScheduleSimulator::Settings mSettings;
+	void TestMinimumFileAge();
+	void TestMaxUploadWait();
+	void TestDiffingThreshold();
+	void TestMaximumDiffingTime();
+	void TestStoreLoad();
+	void LoadTrace(ScheduleSimulator& rSimulator, const std::string& rTrace);
+};
+
+#endif /* _TESTSCHEDULESIMULATOR_H */
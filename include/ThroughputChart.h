@@ -0,0 +1,65 @@
+/***************************************************************************
+ *            ThroughputChart.h
+ *
+ *  Sat Jan 10 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _THROUGHPUTCHART_H
+#define _THROUGHPUTCHART_H
+
+#include "wx/chartctrl.h"
+#include "wx/points.h"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    ThroughputChart
+//		Purpose: A wxChart bar chart of the bytes and files per
+//			 second over the last minute or so, one bar of each
+//			 per sample, newest on the right. The two series
+//			 share one Y axis, so each is drawn as a percentage
+//			 of its own peak, which is shown in its legend
+//			 label, rather than the files being dwarfed by the
+//			 bytes.
+//
+//			 The samples are kept in wxPoints with a fixed
+//			 capacity, so a long run doesn't use any more memory
+//			 than a short one.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+class ThroughputChart : public wxChartCtrl
+{
+	public:
+	ThroughputChart(wxWindow* pParent, wxWindowID id = wxID_ANY);
+
+	void Reset();
+	void AddSample(double bytesPerSecond, double filesPerSecond);
+
+	private:
+	wxPoints mBytesPerSecond;
+	wxPoints mFilesPerSecond;
+	size_t mNumSamples; // ever added, used as the x value
+
+	void Redraw();
+};
+
+#endif /* _THROUGHPUTCHART_H */
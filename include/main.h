@@ -144,6 +144,21 @@ enum {
 	ID_Compare_Panel_Dir_Splitter,
 	ID_Compare_Panel_Dir_Local_Tree,
 	ID_Compare_Panel_Dir_Remote_Tree,
+	ID_Compare_Panel_Quick_Compare_Checkbox,
+	ID_Compare_Differences_List,
+	ID_Compare_Panel_Report_File_Text,
+	ID_Compare_Panel_Report_Format_Choice,
+	ID_Compare_Panel_Sample_Checkbox,
+	ID_Compare_Panel_Sample_Percent_Spin,
+	ID_Compare_Panel_Sample_Seed_Spin,
+	ID_BackupLoc_ExcludeProfileButton,
+	ID_BackupLoc_ExcludeEstimateTimer,
+	ID_Backup_Locations_Notebook,
+	ID_Backup_Panel_Count_Choice,
+	ID_Progress_Export_Button,
+	ID_Progress_Rate_Timer,
+	ID_Daemon_Monitor_Frame,
+	ID_Daemon_Monitor_List,
 };
 
 typedef enum
@@ -204,6 +219,9 @@ typedef enum
 	BM_RESTORE_FAILED_OBJECT_ALREADY_EXISTS,
 	BM_RESTORE_FAILED_TO_CREATE_OBJECT,
 	BM_TEST_WAIT_FOR_THREAD_FAILED,
+	BM_COMPARE_FAILED_CANNOT_OPEN_REPORT,
+	BM_EXCLUDE_PROFILE_REPORT,
+	BM_COMPARE_FAILED_CANNOT_WRITE_REPORT,
 }
 message_t;
 
@@ -27,6 +27,7 @@
 
 #include "SandBox.h"
 
+#include <wx/datetime.h>
 #include <wx/html/htmlwin.h>
 
 #include "main.h"
@@ -81,6 +82,11 @@ BackupDaemonPanel::BackupDaemonPanel(
 		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
 	AddParam(this, _("Client State:"), mpClientState, TRUE,
 		pParamSizer);
+
+	mpLastSync = new wxTextCtrl(this, -1, wxT(""),
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	AddParam(this, _("Last Sync:"), mpLastSync, TRUE,
+		pParamSizer);
 #else
 	wxTextCtrl* pBoxLocationCtrl = new wxTextCtrl(this, -1);
 	AddParam(this, _("Client Location:").wx_str(), pBoxLocationCtrl, TRUE,
@@ -100,6 +106,11 @@ BackupDaemonPanel::BackupDaemonPanel(
 		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
 	AddParam(this, _("Client State:").wx_str(), mpClientState, TRUE,
 		pParamSizer);
+
+	mpLastSync = new wxTextCtrl(this, -1, wxT(""),
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	AddParam(this, _("Last Sync:").wx_str(), mpLastSync, TRUE,
+		pParamSizer);
 #endif
 	pMainSizer->Add(pParamSizer, 0, wxGROW | wxALL, 8);
 
@@ -150,6 +161,8 @@ BackupDaemonPanel::BackupDaemonPanel(
 }
 
 void BackupDaemonPanel::HandleClientEvent() {
+	mClientConn.LogMessages();
+
 	mpClientConnStatus->SetValue(
 		wxString(mClientConn.GetStateStr(), wxConvBoxi));
 	mpClientError->SetValue(mClientConn.GetLastErrorMsg());
@@ -159,6 +172,29 @@ void BackupDaemonPanel::HandleClientEvent() {
 		mClientConn.GetClientStateString(),
 		mClientConn.GetClientPidFast());
 	mpClientState->SetValue(ClientState);
+
+	std::vector<CommandSocketEvent> Events;
+	if (mClientConn.GetEvents(&Events) > 0)
+	{
+		wxLogDebug(_("Missed some events from the client"));
+	}
+
+	for (std::vector<CommandSocketEvent>::iterator
+		i = Events.begin(); i != Events.end(); i++)
+	{
+		wxString Time = wxDateTime(i->mTime).Format();
+		if (i->mType == CommandSocketEvent::CSE_SYNC_START)
+		{
+			mpLastSync->SetValue(wxString::Format(
+				_("Started at %s"), Time.c_str()));
+		}
+		else if (i->mType == CommandSocketEvent::CSE_SYNC_FINISH)
+		{
+			mpLastSync->SetValue(wxString::Format(
+				_("Finished at %s"), Time.c_str()));
+		}
+	}
+
 	EnableButtons();
 }
 
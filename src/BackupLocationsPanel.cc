@@ -27,12 +27,17 @@
 #include <wx/dynarray.h>
 #include <wx/filename.h>
 #include <wx/notebook.h>
+#include <wx/utils.h>
 // #include <wx/mstream.h>
 
 #include "BackupLocationsPanel.h"
 #include "FileTree.h"
 #include "MainFrame.h"
 #include "BoxiApp.h"
+#include "ExcludeProfiler.h"
+#include "LocationIndex.h"
+#include "ProgressPanel.h"
+#include "SizeEstimator.h"
 
 class BackupTreeNode : public LocalFileNode
 {
@@ -43,11 +48,23 @@ class BackupTreeNode : public LocalFileNode
 	ClientConfig* mpConfig;
 	int mIconId;
 
+	// The inputs used to work out the state above, last time. If
+	// they are the same next time, so is the result, and there's
+	// no need to check the path against the exclude list again.
+	BoxiLocation*           mpCachedParentLocation;
+	const BoxiExcludeEntry* mpCachedParentExcludedBy;
+	const BoxiExcludeEntry* mpCachedParentIncludedBy;
+	unsigned long mCachedLocationsGeneration;
+	unsigned long mCachedRulesGeneration;
+	bool mStateUnchanged;
+	size_t mNumStateChecks;
+
 	public:
 	BackupTreeNode(ClientConfig* pConfig,   const wxString& path);
-	BackupTreeNode(BackupTreeNode* pParent, const wxString& path);
+	BackupTreeNode(BackupTreeNode* pParent, const wxString& path,
+		bool isDirectory);
 	virtual LocalFileNode* CreateChildNode(LocalFileNode* pParent,
-		const wxString& rPath);
+		const wxString& rPath, bool isDirectory);
 
 	BoxiLocation*           GetLocation()   const { return mpLocation; }
 	ClientConfig*           GetConfig()     const { return mpConfig; }
@@ -55,6 +72,12 @@ class BackupTreeNode : public LocalFileNode
 	const BoxiExcludeEntry*   GetIncludedBy() const { return mpIncludedBy; }
 
 	virtual int UpdateState(FileImageList& rImageList, bool updateParents);
+
+	// Everything below a node inside a location depends only on
+	// that location, so if it hasn't changed, nor has the subtree.
+	virtual bool IsSubtreeStateCurrent() const
+	{ return mStateUnchanged && mpLocation != NULL; }
+	virtual size_t GetNumStateChecks() const { return mNumStateChecks; }
 };
 
 BackupTreeNode::BackupTreeNode(ClientConfig* pConfig, const wxString& path)
@@ -63,22 +86,38 @@ BackupTreeNode::BackupTreeNode(ClientConfig* pConfig, const wxString& path)
   mpExcludedBy   (NULL),
   mpIncludedBy   (NULL),
   mpConfig       (pConfig),
-  mIconId        (-1)
+  mIconId        (-1),
+  mpCachedParentLocation   (NULL),
+  mpCachedParentExcludedBy (NULL),
+  mpCachedParentIncludedBy (NULL),
+  mCachedLocationsGeneration(0),
+  mCachedRulesGeneration   (0),
+  mStateUnchanged          (false),
+  mNumStateChecks          (0)
 { }
 
-BackupTreeNode::BackupTreeNode(BackupTreeNode* pParent, const wxString& path)
-: LocalFileNode  (pParent, path),
+BackupTreeNode::BackupTreeNode(BackupTreeNode* pParent, const wxString& path,
+	bool isDirectory)
+: LocalFileNode  (pParent, path, isDirectory),
   mpLocation     (pParent->GetLocation()),
   mpExcludedBy   (pParent->GetExcludedBy()),
   mpIncludedBy   (pParent->GetIncludedBy()),
   mpConfig       (pParent->GetConfig()),
-  mIconId        (-1)
+  mIconId        (-1),
+  mpCachedParentLocation   (NULL),
+  mpCachedParentExcludedBy (NULL),
+  mpCachedParentIncludedBy (NULL),
+  mCachedLocationsGeneration(0),
+  mCachedRulesGeneration   (0),
+  mStateUnchanged          (false),
+  mNumStateChecks          (0)
 { }
 
 LocalFileNode* BackupTreeNode::CreateChildNode(LocalFileNode* pParent,
-	const wxString& rPath)
+	const wxString& rPath, bool isDirectory)
 {
-	return new BackupTreeNode((BackupTreeNode *)pParent, rPath);
+	return new BackupTreeNode((BackupTreeNode *)pParent, rPath,
+		isDirectory);
 }
 
 int BackupTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
@@ -87,6 +126,36 @@ int BackupTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
 
 	BackupTreeNode* pParentNode = (BackupTreeNode*)GetParentNode();
 
+	BoxiLocation*           pParentLocation   = NULL;
+	const BoxiExcludeEntry* pParentExcludedBy = NULL;
+	const BoxiExcludeEntry* pParentIncludedBy = NULL;
+
+	if (pParentNode)
+	{
+		pParentLocation   = pParentNode->mpLocation;
+		pParentExcludedBy = pParentNode->mpExcludedBy;
+		pParentIncludedBy = pParentNode->mpIncludedBy;
+	}
+
+	// While the locations are unchanged, mpLocation still points to
+	// the location that this node would find again.
+	unsigned long locationsGeneration = mpConfig->GetLocationsGeneration();
+
+	if (mIconId != -1 &&
+		mCachedLocationsGeneration == locationsGeneration &&
+		mpCachedParentLocation     == pParentLocation     &&
+		mpCachedParentExcludedBy   == pParentExcludedBy   &&
+		mpCachedParentIncludedBy   == pParentIncludedBy   &&
+		(!mpLocation || mCachedRulesGeneration ==
+			mpLocation->GetExcludeList().GetGeneration()))
+	{
+		mStateUnchanged = true;
+		return mIconId;
+	}
+
+	mStateUnchanged = false;
+	mNumStateChecks++;
+
 	// by default, inherit our include/exclude state
 	// from our parent node, if we have one
 
@@ -103,27 +172,13 @@ int BackupTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
 		mpIncludedBy = NULL;
 	}
 
-	const BoxiLocation::List& rLocations = mpConfig->GetLocations();
+	const BoxiLocationIndex& rLocationIndex = mpConfig->GetLocationIndex();
 
 	if (!mpLocation)
 	{
 		// determine whether or not this node's path
 		// is inside a backup location.
-
-		for (BoxiLocation::ConstIterator
-			pLoc  = rLocations.begin();
-			pLoc != rLocations.end(); pLoc++)
-		{
-			const wxString& rPath = pLoc->GetPath();
-			// std::cout << "Compare " << mFullPath
-			//	<< " against " << rPath << "\n";
-			if (GetFullPath().CompareTo(rPath.wx_str()) == 0)
-			{
-				// std::cout << "Found location: " << pLoc->GetName() << "\n";
-				mpLocation = mpConfig->GetLocation(*pLoc);
-				break;
-			}
-		}
+		mpLocation = rLocationIndex.GetLocationAt(GetFullPath());
 	}
 
 	if (mpLocation && !(GetFullPath().StartsWith(mpLocation->GetPath())))
@@ -198,50 +253,10 @@ int BackupTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
 		// this node is not included in any location, but we need to
 		// check whether our path is a prefix to any configured location,
 		// to decide whether to display a blank or a partially included icon.
+		// On Windows, the root node (My Computer) has an empty path,
+		// which is a prefix of every location.
 
-		const BoxiLocation::List& rLocations = mpConfig->GetLocations();
-		wxFileName thisNodePath(GetFullPath());
-		bool found = false;
-
-		for (BoxiLocation::ConstIterator
-			pLoc  = rLocations.begin();
-			pLoc != rLocations.end() && !found; pLoc++)
-		{
-			#ifdef WIN32
-			if (IsRoot())
-			{
-				// root node is always included if there is
-				// at least one location, even though its
-				// empty path (for My Computer) does not
-				// match in the algorithm below.
-				found = true;
-			}
-			#endif
-
-			wxFileName locPath(pLoc->GetPath(), wxT(""));
-
-			while(locPath.GetDirCount() > 0 && !found)
-			{
-				locPath.RemoveLastDir();
-
-				wxString fn1 = locPath.GetFullPath();
-				wxString fn2 = thisNodePath.GetFullPath();
-
-				while (fn1.Length() > 1 &&
-					wxFileName::IsPathSeparator(fn1.GetChar(fn1.Length() - 1)))
-				{
-					fn1.Truncate(fn1.Length() - 1);
-				}
-
-				while (fn2.Length() > 1 &&
-					wxFileName::IsPathSeparator(fn2.GetChar(fn2.Length() - 1)))
-				{
-					fn2.Truncate(fn2.Length() - 1);
-				}
-
-				found = fn1.IsSameAs(fn2);
-			}
-		}
+		bool found = rLocationIndex.IsParentOfLocation(GetFullPath());
 
 		if (found)
 		{
@@ -249,6 +264,14 @@ int BackupTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
 		}
 	}
 
+	mpCachedParentLocation     = pParentLocation;
+	mpCachedParentExcludedBy   = pParentExcludedBy;
+	mpCachedParentIncludedBy   = pParentIncludedBy;
+	mCachedLocationsGeneration = locationsGeneration;
+	mCachedRulesGeneration     = mpLocation
+		? mpLocation->GetExcludeList().GetGeneration() : 0;
+	mIconId = iconId;
+
 	return iconId;
 }
 
@@ -604,15 +627,26 @@ void LocationsPanel::SelectLocation(const BoxiLocation& rLocation)
 	}
 }
 
+// Interval between checks for a new backup size estimate
+#define ESTIMATE_POLL_MILLIS 500
+
 class ExclusionsPanel : public EditorPanel
 {
 	private:
 	wxChoice*   mpLocationList;
+	wxButton*   mpProfileButton;
+	wxStaticText* mpEstimateText;
 	wxChoice*   mpTypeList;
 	wxTextCtrl* mpValueText;
+	BoxiSizeEstimator mEstimator;
+	wxTimer     mEstimateTimer;
+	bool        mEstimating;
+	// of the locations that mEstimator's cached trees were read for
+	unsigned long mEstimatorLocationsGeneration;
 
 	public:
 	ExclusionsPanel(wxWindow* pParent, ClientConfig *pConfig);
+	void StartEstimating();
 	virtual void PopulateList();
 	virtual void PopulateControls();
 	virtual void UpdateEnabledState();
@@ -622,8 +656,12 @@ class ExclusionsPanel : public EditorPanel
 	virtual void OnClickButtonEdit     (wxCommandEvent& rEvent);
 	virtual void OnClickButtonRemove   (wxCommandEvent& rEvent);
 	virtual void OnChangeExcludeDetails(wxCommandEvent& rEvent);
+	virtual void OnClickButtonProfile  (wxCommandEvent& rEvent);
+	virtual void OnEstimateTimer       (wxTimerEvent&   rEvent);
 
 	private:
+	void RequestEstimate();
+	bool ShowEstimate();
 	void SelectExclusion(const BoxiExcludeEntry& rEntry);
 	BoxiLocation* GetSelectedLocation();
 	BoxiExcludeEntry* GetSelectedEntry();
@@ -634,15 +672,29 @@ class ExclusionsPanel : public EditorPanel
 };
 
 ExclusionsPanel::ExclusionsPanel(wxWindow* pParent, ClientConfig *pConfig)
-: EditorPanel(pParent, pConfig, ID_BackupLoc_Excludes_Panel)
+: EditorPanel(pParent, pConfig, ID_BackupLoc_Excludes_Panel),
+  mEstimateTimer(this, ID_BackupLoc_ExcludeEstimateTimer),
+  mEstimating(false),
+  mEstimatorLocationsGeneration(pConfig->GetLocationsGeneration())
 {
 	wxStaticBoxSizer* pLocationListBox = new wxStaticBoxSizer(wxVERTICAL,
 		this, _("&Locations"));
 	mpTopSizer->Insert(0, pLocationListBox, 0,
 		wxGROW | wxTOP | wxLEFT | wxRIGHT, 8);
 
+	wxSizer* pLocationSizer = new wxBoxSizer(wxHORIZONTAL);
+	pLocationListBox->Add(pLocationSizer, 0, wxGROW | wxALL, 8);
+
 	mpLocationList = new wxChoice(this, ID_BackupLoc_ExcludeLocList);
-	pLocationListBox->Add(mpLocationList, 0, wxGROW | wxALL, 8);
+	pLocationSizer->Add(mpLocationList, 1, wxALIGN_CENTER_VERTICAL, 0);
+
+	mpProfileButton = new wxButton(this, ID_BackupLoc_ExcludeProfileButton,
+		_("&Profile"));
+	pLocationSizer->Add(mpProfileButton, 0, wxLEFT, 8);
+
+	mpEstimateText = new wxStaticText(this, wxID_ANY, wxT(""));
+	pLocationListBox->Add(mpEstimateText, 0,
+		wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
 
 	mpListBoxSizer   ->GetStaticBox()->SetLabel(_("&Exclusions"));
 	mpDetailsBoxSizer->GetStaticBox()->SetLabel(_("&Selected or New Exclusion"));
@@ -746,6 +798,7 @@ void ExclusionsPanel::PopulateList()
 		mpList->SetSelection(0);
 	}
 
+	RequestEstimate();
 	PopulateControls();
 }
 
@@ -754,6 +807,7 @@ void ExclusionsPanel::UpdateEnabledState()
 	if (mpLocationList->GetSelection() == wxNOT_FOUND)
 	{
 		mpList->Disable();
+		mpProfileButton->Disable();
 		mpTypeList->Disable();
 		mpValueText->Disable();
 		mpAddButton->Disable();
@@ -763,6 +817,7 @@ void ExclusionsPanel::UpdateEnabledState()
 	}
 
 	mpList->Enable();
+	mpProfileButton->Enable();
 	mpTypeList->Enable();
 	mpValueText->Enable();
 
@@ -822,6 +877,10 @@ BEGIN_EVENT_TABLE(ExclusionsPanel, EditorPanel)
 		ExclusionsPanel::OnChangeExcludeDetails)
 	EVT_TEXT(ID_BackupLoc_ExcludePathCtrl,
 		ExclusionsPanel::OnChangeExcludeDetails)
+	EVT_BUTTON(ID_BackupLoc_ExcludeProfileButton,
+		ExclusionsPanel::OnClickButtonProfile)
+	EVT_TIMER(ID_BackupLoc_ExcludeEstimateTimer,
+		ExclusionsPanel::OnEstimateTimer)
 END_EVENT_TABLE()
 
 void ExclusionsPanel::OnSelectLocationItem(wxCommandEvent &event)
@@ -954,6 +1013,149 @@ void ExclusionsPanel::OnClickButtonRemove(wxCommandEvent &event)
 	PopulateControls();
 }
 
+void ExclusionsPanel::OnClickButtonProfile(wxCommandEvent &event)
+{
+	BoxiLocation* pLocation = GetSelectedLocation();
+	if (!pLocation)
+	{
+		wxGetApp().ShowMessageBox(BM_INTERNAL_LOCATION_DOES_NOT_EXIST,
+			_("No location selected!"), _("Boxi Error"),
+			wxICON_ERROR | wxOK, this);
+		return;
+	}
+
+	BoxiExcludeProfiler profiler(*pLocation);
+	{
+		wxBusyCursor busy;
+		profiler.Run();
+	}
+
+	wxGetApp().ShowMessageBox(BM_EXCLUDE_PROFILE_REPORT,
+		profiler.GetReport(), _("Exclusion Profile"),
+		wxICON_INFORMATION | wxOK, this);
+}
+
+// Called when the panel is first shown, so that locations aren't
+// scanned in the background unless someone wants to see the estimates.
+void ExclusionsPanel::StartEstimating()
+{
+	if (mEstimating)
+	{
+		return;
+	}
+
+	mEstimating = true;
+	RequestEstimate();
+}
+
+void ExclusionsPanel::RequestEstimate()
+{
+	BoxiLocation* pLocation = GetSelectedLocation();
+	if (!mEstimating || !pLocation)
+	{
+		mpEstimateText->SetLabel(wxT(""));
+		mEstimateTimer.Stop();
+		return;
+	}
+
+	// a location may have been removed, or its path changed
+	if (mEstimatorLocationsGeneration != mpConfig->GetLocationsGeneration())
+	{
+		mEstimator.Invalidate();
+		mEstimatorLocationsGeneration =
+			mpConfig->GetLocationsGeneration();
+	}
+
+	if (!mEstimator.Request(*pLocation))
+	{
+		mpEstimateText->SetLabel(_("Unable to estimate backup size."));
+		mEstimateTimer.Stop();
+		return;
+	}
+
+	if (!ShowEstimate() && !mEstimateTimer.IsRunning())
+	{
+		mEstimateTimer.Start(ESTIMATE_POLL_MILLIS);
+	}
+}
+
+void ExclusionsPanel::OnEstimateTimer(wxTimerEvent& rEvent)
+{
+	if (ShowEstimate())
+	{
+		mEstimateTimer.Stop();
+	}
+}
+
+// Shows the latest estimate for the selected location, with the amount
+// excluded or kept by each entry appended to it in the list. Returns
+// false if it's not up to date with the entries yet.
+bool ExclusionsPanel::ShowEstimate()
+{
+	BoxiLocation* pLocation = GetSelectedLocation();
+	if (!pLocation)
+	{
+		return true;
+	}
+
+	const BoxiExcludeList& rExcludeList = pLocation->GetExcludeList();
+	const BoxiExcludeEntry::List& rEntries = rExcludeList.GetEntries();
+
+	BoxiSizeEstimator::Estimate estimate;
+	bool found = mEstimator.GetEstimate(pLocation->GetName(), &estimate);
+	bool current = found &&
+		estimate.mRulesGeneration == rExcludeList.GetGeneration();
+
+	wxString label;
+	if (current)
+	{
+		label.Printf(_("A backup would include %d files (%s)."),
+			(int)estimate.mNumFiles,
+			ProgressPanel::FormatNumBytes(estimate.mNumBytes).c_str());
+	}
+	else if (found)
+	{
+		label.Printf(_("Estimating backup size (was %d files, %s)..."),
+			(int)estimate.mNumFiles,
+			ProgressPanel::FormatNumBytes(estimate.mNumBytes).c_str());
+	}
+	else
+	{
+		label = _("Estimating backup size...");
+	}
+	mpEstimateText->SetLabel(label);
+
+	// The list items are in the same order as the entries, as
+	// PopulateList() adds them.
+	size_t index = 0;
+	for (BoxiExcludeEntry::ConstIterator pEntry = rEntries.begin();
+		pEntry != rEntries.end() && index < mpList->GetCount();
+		pEntry++, index++)
+	{
+		wxString itemText(pEntry->ToString().c_str(), wxConvBoxi);
+
+		if (current)
+		{
+			itemText.Printf(
+				(pEntry->GetSense() == ES_ALWAYSINCLUDE)
+				? _("%s (keeps %d files, %s)")
+				: _("%s (excludes %d files, %s)"),
+				wxString(pEntry->ToString().c_str(),
+					wxConvBoxi).c_str(),
+				(int)estimate.mRuleNumFiles[index],
+				ProgressPanel::FormatNumBytes(
+					estimate.mRuleNumBytes[index]).c_str());
+		}
+
+		if (mpList->GetString(index) != itemText)
+		{
+			mpList->SetString(index, itemText);
+		}
+	}
+
+	return current;
+}
+
 void ExclusionsPanel::SelectExclusion(const BoxiExcludeEntry& rEntry)
 {
 	for (size_t i = 0; i < mpList->GetCount(); i++)
@@ -972,6 +1174,8 @@ BEGIN_EVENT_TABLE(BackupLocationsPanel, wxPanel)
 	EVT_TREE_ITEM_ACTIVATED(ID_Backup_Locations_Tree,
 		BackupLocationsPanel::OnTreeNodeActivate)
 	EVT_BUTTON(wxID_CANCEL, BackupLocationsPanel::OnClickCloseButton)
+	EVT_NOTEBOOK_PAGE_CHANGED(ID_Backup_Locations_Notebook,
+		BackupLocationsPanel::OnNotebookPageChanged)
 END_EVENT_TABLE()
 
 BackupLocationsPanel::BackupLocationsPanel
@@ -996,7 +1200,8 @@ BackupLocationsPanel::BackupLocationsPanel
 	wxBoxSizer* pTopSizer = new wxBoxSizer(wxVERTICAL);
 	SetSizer(pTopSizer);
 
-	wxNotebook* pNotebook = new wxNotebook(this, wxID_ANY);
+	wxNotebook* pNotebook = new wxNotebook(this,
+		ID_Backup_Locations_Notebook);
 	pTopSizer->Add(pNotebook, 1, wxGROW | wxALL, 8);
 
 	wxPanel* pBasicPanel = new wxPanel(pNotebook);
@@ -1020,8 +1225,8 @@ BackupLocationsPanel::BackupLocationsPanel
 	LocationsPanel* pLocationsPanel = new LocationsPanel(pNotebook, mpConfig);
 	pNotebook->AddPage(pLocationsPanel, _("Locations"));
 
-	ExclusionsPanel* pExclusionsPanel = new ExclusionsPanel(pNotebook, mpConfig);
-	pNotebook->AddPage(pExclusionsPanel, _("Exclusions"));
+	mpExclusionsPanel = new ExclusionsPanel(pNotebook, mpConfig);
+	pNotebook->AddPage(mpExclusionsPanel, _("Exclusions"));
 
 	wxSizer* pActionCtrlSizer = new wxBoxSizer(wxHORIZONTAL);
 	pTopSizer->Add(pActionCtrlSizer, 0,
@@ -1046,6 +1251,15 @@ void BackupLocationsPanel::OnTreeNodeActivate(wxTreeEvent& event)
 	wxTreeItemId item = event.GetItem();
 	BackupTreeNode* pTreeNode = (BackupTreeNode *)(mpTree->GetItemData(item));
 
+	if (!pTreeNode)
+	{
+		// placeholder for more entries, added as it comes into view
+		return;
+	}
+
+	// the node's state must be current, to know what to change
+	mpTree->FlushStateIcons();
+
 	#ifdef WIN32
 	if (pTreeNode->IsRoot()) return;
 	#endif
@@ -1351,6 +1565,18 @@ void BackupLocationsPanel::OnTreeNodeActivate(wxTreeEvent& event)
 	event.Skip();
 }
 
+void BackupLocationsPanel::OnNotebookPageChanged(wxNotebookEvent& rEvent)
+{
+	wxNotebook* pNotebook = (wxNotebook*)rEvent.GetEventObject();
+	if (rEvent.GetSelection() != wxNOT_FOUND &&
+		pNotebook->GetPage(rEvent.GetSelection()) == mpExclusionsPanel)
+	{
+		mpExclusionsPanel->StartEstimating();
+	}
+
+	rEvent.Skip();
+}
+
 void BackupLocationsPanel::OnClickCloseButton(wxCommandEvent& rEvent)
 {
 	Hide();
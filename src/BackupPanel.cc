@@ -28,6 +28,7 @@
 #include "SandBox.h"
 
 #include <wx/button.h>
+#include <wx/choice.h>
 #include <wx/listbox.h>
 #include <wx/notebook.h>
 #include <wx/statbox.h>
@@ -71,6 +72,25 @@ BackupPanel::BackupPanel
 		_("&Change Server"));
 	mpDestCtrlSizer->Add(mpDestEditButton, 0, wxGROW, 0);
 
+	wxStaticBoxSizer* pOptionsBox = new wxStaticBoxSizer(wxVERTICAL, this,
+		_("Backup options"));
+	mpMainSizer->Insert(2, pOptionsBox, 0,
+		wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+
+	wxSizer* pCountSizer = new wxBoxSizer(wxHORIZONTAL);
+	pOptionsBox->Add(pCountSizer, 0, wxGROW | wxALL, 8);
+
+	pCountSizer->Add(new wxStaticText(this, wxID_ANY,
+		_("C&ount files:")), 0, wxALIGN_CENTER_VERTICAL, 0);
+
+	mpCountChoice = new wxChoice(this, ID_Backup_Panel_Count_Choice);
+	// the order must match BackupProgressPanel::CountMode
+	mpCountChoice->Append(_("Before backing up (slower to start)"));
+	mpCountChoice->Append(_("While backing up"));
+	mpCountChoice->Append(_("Don't count (use the last backup's totals)"));
+	mpCountChoice->SetSelection(BackupProgressPanel::BCM_COUNT_ALONGSIDE);
+	pCountSizer->Add(mpCountChoice, 1, wxGROW | wxLEFT, 8);
+
 	mpSourceEditButton->SetLabel(_("&Edit List"));
 	mpStartButton     ->SetLabel(_("&Start Backup"));
 	
@@ -131,5 +151,6 @@ void BackupPanel::OnClickStartButton(wxCommandEvent& rEvent)
 {
 	mpMainFrame->ShowPanel(mpProgressPanel);
 	wxYield();
-	mpProgressPanel->StartBackup();
+	mpProgressPanel->StartBackup((BackupProgressPanel::CountMode)
+		mpCountChoice->GetSelection());
 }
@@ -30,6 +30,8 @@
 #include <errno.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 #ifdef HAVE_MNTENT_H
 	#include <mntent.h>
 #endif
@@ -55,11 +57,121 @@
 
 #include "main.h"
 #include "BackupProgressPanel.h"
+#include "ClientConfig.h"
+#include "ExcludeRules.h"
 #include "ServerConnection.h"
 
 //DECLARE_EVENT_TYPE(myEVT_CLIENT_NOTIFY, -1)
 //DEFINE_EVENT_TYPE(myEVT_CLIENT_NOTIFY)
 
+// Runs the backup away from the GUI thread. Progress comes back through
+// the panel's ProgressNotifier callbacks, which queue it to be flushed
+// to the screen in batches.
+class BackupWorkerThread : public wxThread
+{
+	public:
+	typedef enum
+	{
+		BWE_NONE = 0,
+		BWE_CONNECTION,
+		BWE_INTERRUPTED,
+		BWE_STORE,
+		BWE_EXCEPTION,
+		BWE_UNKNOWN,
+	}
+	Error;
+	
+	private:
+	BackupProgressPanel* mpPanel;
+	BackupDaemon& mrDaemon;
+	Error mError;
+	std::string mErrorMessage;
+	
+	public:
+	BackupWorkerThread(BackupProgressPanel* pPanel, BackupDaemon& rDaemon)
+	: wxThread(wxTHREAD_JOINABLE),
+	  mpPanel(pPanel),
+	  mrDaemon(rDaemon),
+	  mError(BWE_NONE)
+	{ }
+	
+	Error GetError() { return mError; }
+	const std::string& GetErrorMessage() { return mErrorMessage; }
+	
+	virtual void* Entry()
+	{
+		try
+		{
+			// Touch a file to record times in filesystem.
+			// This is the ONLY part of OnBackupStart() that Boxi runs
+			mrDaemon.TouchFileInWorkingDir("last_sync_start");
+			
+			mrDaemon.RunSyncNow();
+
+			// Touch a file to record times in filesystem.
+			// This is the ONLY part of OnBackupFinish() that Boxi runs
+			mrDaemon.TouchFileInWorkingDir("last_sync_finish");
+		}
+		catch (ConnectionException& e)
+		{
+			mError = BWE_CONNECTION;
+			mErrorMessage = e.what();
+		}
+		catch (BackupStoreException& e)
+		{
+			if (e.GetSubType() == BackupStoreException::SignalReceived)
+			{
+				mError = BWE_INTERRUPTED;
+			}
+			else
+			{
+				mError = BWE_STORE;
+			}
+			mErrorMessage = e.what();
+		}
+		catch (std::exception& e)
+		{
+			mError = BWE_EXCEPTION;
+			mErrorMessage = e.what();
+		}
+		catch (...)
+		{
+			mError = BWE_UNKNOWN;
+		}
+		
+		mpPanel->NotifyWorkerFinished();
+		return NULL;
+	}
+};
+
+// Counts the files to be backed up at the same time as the backup
+// itself, so that the backup doesn't have to wait for the count.
+class BackupCountThread : public wxThread
+{
+	private:
+	BackupProgressPanel* mpPanel;
+
+	public:
+	BackupCountThread(BackupProgressPanel* pPanel)
+	: wxThread(wxTHREAD_JOINABLE),
+	  mpPanel(pPanel)
+	{ }
+	
+	virtual void* Entry()
+	{
+		try
+		{
+			mpPanel->CountAllLocations(NULL);
+		}
+		catch (...)
+		{
+			// stopped, or failed, so the estimate will have to do
+		}
+		
+		return NULL;
+	}
+};
+
 BEGIN_EVENT_TABLE(BackupProgressPanel, ProgressPanel)
 	EVT_BUTTON(wxID_CANCEL, BackupProgressPanel::OnStopCloseClicked)
 END_EVENT_TABLE()
@@ -73,10 +185,286 @@ BackupProgressPanel::BackupProgressPanel
 : ProgressPanel(pParent, ID_Backup_Progress_Panel, _("Backup Progress Panel")),
   mpConfig(pConfig),
   mBackupRunning(false),
-  mBackupStopRequested(false)
-{ }
+  mBackupStopRequested(false),
+  mCountMode(BCM_COUNT_FIRST),
+  mCountStopRequested(false),
+  mProgressMutex(),
+  mProgressCondition(mProgressMutex),
+  mpCurrentActionFormat(NULL),
+  mCurrentActionBytes(0),
+  mPendingNumErrors(0),
+  mPendingFilesCounted(0),
+  mPendingBytesCounted(0),
+  mPendingFilesDone(0),
+  mPendingBytesDone(0),
+  mCountFinished(false),
+  mSyncStarted(false),
+  mWorkerFinished(false)
+{
+	AddThroughputChart();
+}
+
+void BackupProgressPanel::NotifyWorkerFinished()
+{
+	wxMutexLocker lock(mProgressMutex);
+	mWorkerFinished = true;
+	mProgressCondition.Broadcast();
+}
+
+// Wait until the backup thread has finished, or the timeout expires.
+// Returns false if the backup thread has finished.
+bool BackupProgressPanel::WaitForProgress(long timeoutMillis)
+{
+	wxMutexLocker lock(mProgressMutex);
+	
+	if (!mWorkerFinished)
+	{
+		mProgressCondition.WaitTimeout(timeoutMillis);
+	}
+	
+	return !mWorkerFinished;
+}
+
+// Move everything queued by the backup thread into the user interface,
+// in a single batch. Must be called on the GUI thread.
+void BackupProgressPanel::FlushProgress()
+{
+	wxArrayString errors;
+	size_t numErrors;
+	const wxChar* pActionFormat;
+	std::string actionPath;
+	int64_t actionBytes;
+	size_t  filesCounted, filesDone;
+	int64_t bytesCounted, bytesDone;
+	bool countFinished, syncStarted;
+	
+	{
+		wxMutexLocker lock(mProgressMutex);
+
+		errors = mPendingErrors;
+		mPendingErrors.Clear();
+		numErrors = mPendingNumErrors;
+		mPendingNumErrors = 0;
+
+		pActionFormat = mpCurrentActionFormat;
+		actionPath    = mCurrentActionPath;
+		actionBytes   = mCurrentActionBytes;
+		mpCurrentActionFormat = NULL;
+
+		countFinished  = mCountFinished;
+		syncStarted    = mSyncStarted;
+		mCountFinished = false;
+		mSyncStarted   = false;
+
+		// A count alongside the backup is held back until it's
+		// complete, rather than replacing an estimate with a
+		// partial count.
+		filesCounted = 0;
+		bytesCounted = 0;
+		if (mCountMode == BCM_COUNT_FIRST || countFinished)
+		{
+			filesCounted = mPendingFilesCounted;
+			bytesCounted = mPendingBytesCounted;
+			mPendingFilesCounted = 0;
+			mPendingBytesCounted = 0;
+		}
+
+		filesDone    = mPendingFilesDone;
+		bytesDone    = mPendingBytesDone;
+		mPendingFilesDone    = 0;
+		mPendingBytesDone    = 0;
+	}
+	
+	if (mCountMode == BCM_COUNT_FIRST)
+	{
+		if (filesCounted > 0 || bytesCounted > 0)
+		{
+			ProgressPanel::NotifyMoreFilesCounted(filesCounted,
+				bytesCounted);
+		}
+
+		if (countFinished)
+		{
+			mpProgressGauge->SetRange(GetNumFilesTotal());
+			mpProgressGauge->SetValue(0);
+			mpProgressGauge->Show();
+		}
+	}
+	else if (countFinished)
+	{
+		SetTotals(filesCounted, bytesCounted);
+		mpProgressGauge->Show();
+	}
+	
+	if (syncStarted)
+	{
+		SetSummaryText(_("Backing up files"));
+	}
+	
+	if (pActionFormat)
+	{
+		wxString msg;
+		msg.Printf(pActionFormat,
+			wxString(actionPath.c_str(), wxConvBoxi).c_str(),
+			actionBytes);
+		SetCurrentText(msg);
+	}
+	
+	for (size_t i = 0; i < errors.GetCount(); i++)
+	{
+		mpErrorList->Append(errors[i]);
+	}
+	NotifyErrors(numErrors);
+	
+	if (filesDone > 0 || bytesDone > 0)
+	{
+		// The count may be behind the backup, or the estimate too
+		// low, but the total can't be less than what's been done
+		if (mCountMode != BCM_COUNT_FIRST && GetNumFilesDone() +
+			filesDone > (size_t)GetNumFilesTotal())
+		{
+			SetTotals(GetNumFilesDone() + filesDone,
+				std::max(GetNumBytesTotal(),
+					GetNumBytesDone() + bytesDone));
+		}
+
+		NotifyMoreFilesDone(filesDone, bytesDone);
+	}
+}
+
+// Reads the totals saved by the last successful backup, for use as an
+// estimate until this one has counted its files.
+bool BackupProgressPanel::ReadLastTotals(size_t* pNumFiles,
+	int64_t* pNumBytes)
+{
+	std::string dataDir;
+	if (!mpConfig->DataDirectory.GetInto(dataDir))
+	{
+		return false;
+	}
+
+	std::string fileName = dataDir + DIRECTORY_SEPARATOR
+		BACKUP_LAST_TOTALS_FILE;
+	FILE* pFile = ::fopen(fileName.c_str(), "r");
+	if (!pFile)
+	{
+		return false;
+	}
+
+	unsigned long numFiles;
+	long long numBytes;
+	bool result = (::fscanf(pFile, "%lu %lld", &numFiles,
+		&numBytes) == 2);
+	::fclose(pFile);
+
+	if (result)
+	{
+		*pNumFiles = numFiles;
+		*pNumBytes = numBytes;
+	}
+
+	return result;
+}
+
+void BackupProgressPanel::WriteLastTotals()
+{
+	std::string dataDir;
+	if (!mpConfig->DataDirectory.GetInto(dataDir))
+	{
+		return;
+	}
 
-void BackupProgressPanel::StartBackup()
+	std::string fileName = dataDir + DIRECTORY_SEPARATOR
+		BACKUP_LAST_TOTALS_FILE;
+	FILE* pFile = ::fopen(fileName.c_str(), "w");
+	if (!pFile)
+	{
+		// only an estimate for next time, so not worth reporting
+		return;
+	}
+
+	::fprintf(pFile, "%lu %lld\n", (unsigned long)GetNumFilesDone(),
+		(long long)GetNumBytesDone());
+	::fclose(pFile);
+}
+
+// Shows how the backup ended, once the backup thread has finished
+RunHistory::Result BackupProgressPanel::ReportResult(
+	BackupWorkerThread& rWorker)
+{
+	wxString errorMessage(rWorker.GetErrorMessage().c_str(), wxConvBoxi);
+	
+	switch (rWorker.GetError())
+	{
+		case BackupWorkerThread::BWE_NONE:
+		{
+			if (mapDaemon->StorageLimitExceeded())
+			{
+				ReportFatalError(BM_BACKUP_FAILED_STORE_FULL,
+					_("Error: cannot finish backup: "
+					"out of space on server"));
+				SetSummaryText(_("Backup Failed"));
+				return RunHistory::RR_FAILED;
+			}
+			else
+			{
+				// The backup has seen every file now, so its
+				// own totals are exact, and the best estimate
+				// for next time.
+				if (mCountMode != BCM_COUNT_FIRST)
+				{
+					SetTotals(GetNumFilesDone(),
+						GetNumBytesDone());
+				}
+				WriteLastTotals();
+
+				SetSummaryText(_("Backup Finished"));
+				mpErrorList->Append(_("Backup Finished"));
+				return RunHistory::RR_SUCCEEDED;
+			}
+		}
+
+		case BackupWorkerThread::BWE_CONNECTION:
+		{
+			SetSummaryText(_("Backup Failed"));
+			wxString msg;
+			msg.Printf(_("Error: cannot start backup: "
+				"Failed to connect to server\n\n%s"),
+				errorMessage.c_str());
+			ReportFatalError(BM_BACKUP_FAILED_CONNECT_FAILED, msg);
+		}
+		return RunHistory::RR_FAILED;
+
+		case BackupWorkerThread::BWE_INTERRUPTED:
+		{
+			SetSummaryText(_("Backup Interrupted"));
+			ReportFatalError(BM_BACKUP_FAILED_INTERRUPTED,
+				_("Backup interrupted by user"));
+		}
+		return RunHistory::RR_STOPPED;
+
+		case BackupWorkerThread::BWE_STORE:
+		case BackupWorkerThread::BWE_EXCEPTION:
+		{
+			SetSummaryText(_("Backup Failed"));
+			wxString msg;
+			msg.Printf(_("Backup Failed: %s"),
+				errorMessage.c_str());
+			ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+		}
+		return RunHistory::RR_FAILED;
+
+		default:
+		{
+			SetSummaryText(_("Backup Failed"));
+			wxString msg = _("Backup Failed: caught unknown exception");
+			ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+		}
+		return RunHistory::RR_FAILED;
+	}
+}
+
+void BackupProgressPanel::StartBackup(CountMode countMode)
 {
 	mpErrorList->Clear();
 	
@@ -94,11 +482,37 @@ void BackupProgressPanel::StartBackup()
 	SetStopButtonLabel(_("Stop Backup"));
 	
 	mBackupRunning = true;
-	mBackupStopRequested = false;
+	SetStopRequested(&mBackupStopRequested, false);
+	mCountMode = countMode;
+	SetStopRequested(&mCountStopRequested, false);
+	mRun = RunHistory::Run(RunHistory::RK_BACKUP);
+
+	size_t  lastNumFiles;
+	int64_t lastNumBytes;
+	if (mCountMode != BCM_COUNT_FIRST &&
+		ReadLastTotals(&lastNumFiles, &lastNumBytes))
+	{
+		SetTotals(lastNumFiles, lastNumBytes);
+		mpProgressGauge->Show();
+	}
 
 	Layout();
 	wxYield();
 
+	// Copy each location's exclude entries here, as the backup
+	// thread must not touch the configuration's wxStrings, and the
+	// configuration may be edited while the backup runs
+	ClearLocationRules();
+	const BoxiLocation::List& rLocations = mpConfig->GetLocations();
+	for (BoxiLocation::ConstIterator i = rLocations.begin();
+		i != rLocations.end(); i++)
+	{
+		LocationRules*& rpRules = mLocationRules[
+			std::string(i->GetPath().mb_str(wxConvBoxi))];
+		delete rpRules;
+		rpRules = new LocationRules(i->GetExcludeList());
+	}
+
 	Timers::Init();
 	
 	mapDaemon.reset(new BackupDaemon());
@@ -107,92 +521,112 @@ void BackupProgressPanel::StartBackup()
 	mapDaemon->SetProgressNotifier(this);
 	mapDaemon->SetRunStatusProvider(this);
 	
-	try
-	{
-		// Touch a file to record times in filesystem.
-		// This is the ONLY part of OnBackupStart() that Boxi runs
-		mapDaemon->TouchFileInWorkingDir("last_sync_start");
-		
-		mapDaemon->RunSyncNow();
+	// Back up on a separate thread, so that the time spent updating
+	// the user interface doesn't slow the backup down. Progress is
+	// flushed in batches.
+	mWorkerFinished = false;
+	BackupWorkerThread worker(this, *mapDaemon);
+	RunHistory::Result result = RunHistory::RR_FAILED;
 
-		// Touch a file to record times in filesystem.
-		// This is the ONLY part of OnBackupFinish() that Boxi runs
-		mapDaemon->TouchFileInWorkingDir("last_sync_finish");
-
-		if (mapDaemon->StorageLimitExceeded())
-		{
-			ReportFatalError(BM_BACKUP_FAILED_STORE_FULL,
-				_("Error: cannot finish backup: "
-				"out of space on server"));
-			SetSummaryText(_("Backup Failed"));
-		}
-		else
-		{
-			SetSummaryText(_("Backup Finished"));
-			mpErrorList->Append(_("Backup Finished"));
-		}
-		
-	}
-	catch (ConnectionException& e) 
+	if (worker.Create() != wxTHREAD_NO_ERROR ||
+		worker.Run() != wxTHREAD_NO_ERROR)
 	{
 		SetSummaryText(_("Backup Failed"));
-		wxString msg;
-		msg.Printf(_("Error: cannot start backup: "
-			"Failed to connect to server\n\n%s"),
-			wxString(e.what(), wxConvBoxi).c_str());
-		ReportFatalError(BM_BACKUP_FAILED_CONNECT_FAILED, msg);
+		ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR,
+			_("Backup Failed: failed to start backup thread"));
 	}
-	catch (BackupStoreException& be)
+	else
 	{
-		if (be.GetSubType() == BackupStoreException::SignalReceived)
+		BackupCountThread counter(this);
+		bool counting = false;
+		if (mCountMode == BCM_COUNT_ALONGSIDE)
 		{
-			SetSummaryText(_("Backup Interrupted"));
-			ReportFatalError(BM_BACKUP_FAILED_INTERRUPTED,
-				_("Backup interrupted by user"));
+			counting = (counter.Create() == wxTHREAD_NO_ERROR &&
+				counter.Run() == wxTHREAD_NO_ERROR);
 		}
-		else		
+
+		while (WaitForProgress(BACKUP_PROGRESS_FLUSH_MILLIS))
 		{
-			SetSummaryText(_("Backup Failed"));
-			wxString msg;
-			msg.Printf(_("Backup Failed: %s"),
-				wxString(be.what(), wxConvBoxi).c_str());
-			ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+			FlushProgress();
+			wxYield();
 		}
-	}
-	catch (std::exception& e) 
-	{
-		SetSummaryText(_("Backup Failed"));
-		wxString msg;
-		msg.Printf(_("Backup Failed: %s"),
-			wxString(e.what(), wxConvBoxi).c_str());
-		ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
-	}
-	catch (...) 
-	{
-		SetSummaryText(_("Backup Failed"));
-		wxString msg = _("Backup Failed: caught unknown exception");
-		ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+
+		worker.Wait();
+
+		if (counting)
+		{
+			// the count is no use once the backup has finished
+			SetStopRequested(&mCountStopRequested, true);
+			counter.Wait();
+		}
+
+		FlushProgress();
+		result = ReportResult(worker);
 	}
 
 	mapDaemon.reset();
 	Timers::Cleanup();
+	ClearLocationRules();
 
 	mBackupRunning = false;
-	mBackupStopRequested = false;
+	SetStopRequested(&mBackupStopRequested, false);
 	
 	SetCurrentText(_("Idle (nothing to do)"));
+	StopTiming();
+
+	mRun.mResult = result;
+	RecordRun(mpConfig, mRun);
+
 	SetStopButtonLabel(_("Close"));
 	mpProgressGauge->Hide();	
 }
 
+class BackupProgressPanel::LocationRules
+{
+	public:
+	BoxiExcludeEntry::List mEntries;
+	BoxiExcludeRules* mpRules; // points into mEntries
+
+	LocationRules(const BoxiExcludeList& rList)
+	: mEntries(rList.GetEntries()),
+	  mpRules(NULL)
+	{
+		mpRules = new BoxiExcludeRules(mEntries);
+	}
+	~LocationRules() { delete mpRules; }
+
+	private:
+	LocationRules(const LocationRules& rToCopy) { /* forbidden */ }
+	LocationRules& operator=(const LocationRules& rToCopy)
+	{ return *this; /* forbidden */ }
+};
+
+void BackupProgressPanel::ClearLocationRules()
+{
+	for (std::map<std::string, LocationRules*>::iterator
+		i  = mLocationRules.begin();
+		i != mLocationRules.end(); i++)
+	{
+		delete i->second;
+	}
+
+	mLocationRules.clear();
+}
+
 class BackupExclusionOracle : public ProgressPanel::ExclusionOracle
 {
 	private:
 	BackupClientContext& mrContext;
+	const BoxiExcludeRules* mpRules;
 	
 	public:
-	BackupExclusionOracle(BackupClientContext& rContext)
-	: mrContext(rContext)
+	// If pRules is not NULL, it's used instead of the context's
+	// exclude lists, which are equivalent, but not shared with the
+	// locations tree.
+	BackupExclusionOracle(BackupClientContext& rContext,
+		const BoxiExcludeRules* pRules)
+	: mrContext(rContext),
+	  mpRules(pRules)
 	{ }
 
 	// This appears to be the easiest place to do keepalives during
@@ -203,33 +637,78 @@ class BackupExclusionOracle : public ProgressPanel::ExclusionOracle
 	virtual bool IsExcludedFile(const std::string& rFileName)
 	{
 		mrContext.DoKeepAlive();
+		if (mpRules)
+		{
+			return mpRules->IsExcluded(rFileName, false);
+		}
 		return mrContext.ExcludeFile(rFileName);
 	}
 	virtual bool IsExcludedDir(const std::string& rDirName)
 	{
 		mrContext.DoKeepAlive();
+		if (mpRules)
+		{
+			return mpRules->IsExcluded(rDirName, true);
+		}
 		return mrContext.ExcludeDir(rDirName);
 	}
 };
 
-void BackupProgressPanel::NotifyIDMapsSetup(BackupClientContext& rContext)
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProgressPanel::CountAllLocations(
+//			 BackupClientContext* pContext)
+//		Purpose: Counts the files in every location, with its
+//			 compiled exclude rules. Runs on the backup thread,
+//			 which passes its context to keep the connection
+//			 alive, or on its own thread alongside the backup,
+//			 without one.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+void BackupProgressPanel::CountAllLocations(BackupClientContext* pContext)
 {
-	BackupDaemon::Locations locs(mapDaemon->GetLocations());
+	for (std::map<std::string, LocationRules*>::const_iterator
+		i  = mLocationRules.begin();
+		i != mLocationRules.end(); i++)
+	{
+		if (pContext)
+		{
+			BackupExclusionOracle oracle(*pContext,
+				i->second->mpRules);
+			CountLocalFiles(oracle, i->first);
+		}
+		else
+		{
+			RulesExclusionOracle oracle(*(i->second->mpRules));
+			CountLocalFiles(oracle, i->first);
+		}
+	}
+	
+	wxMutexLocker lock(mProgressMutex);
+	mCountFinished = true;
+}
 
-	// Go through the records, counting files and bytes
-	for (BackupDaemon::Locations::const_iterator
-		i  = locs.begin();
-		i != locs.end(); i++)
+// Called on the backup thread, once it has connected to the store
+void BackupProgressPanel::NotifyIDMapsSetup(BackupClientContext& rContext)
+{
+	if (mCountMode == BCM_COUNT_FIRST)
 	{
-		Location* pLocation = *i;
-		BackupExclusionOracle oracle(rContext);
-		CountLocalFiles(oracle,	pLocation->mPath);
+		CountAllLocations(&rContext);
 	}
 	
-	mpProgressGauge->SetRange(GetNumFilesTotal());
-	mpProgressGauge->SetValue(0);
-	mpProgressGauge->Show();
+	wxMutexLocker lock(mProgressMutex);
+	mSyncStarted = true;
+}
 
-	SetSummaryText(_("Backing up files"));
-	wxYield();
+void BackupProgressPanel::NotifyCountStatFailed(const std::string& rFileName)
+{
+	wxString msg;
+	msg.Printf(_("Error counting files in '%s': %s"),
+		wxString(rFileName.c_str(), wxConvBoxi).c_str(),
+		wxString(strerror(errno),  wxConvBoxi).c_str());
+	// counted in mNumErrors when it's flushed, as the base class's
+	// mNumErrors++ would race with the GUI thread
+	AddError(msg);
 }
@@ -72,13 +72,15 @@
 	INIT_PROP(AutomaticBackup, true)
 
 ClientConfig::ClientConfig()
-: INIT_PROPS_DEFAULTS
+: INIT_PROPS_DEFAULTS,
+  mLocationsGeneration(0)
 {
 	SetClean();	
 }
 
 ClientConfig::ClientConfig(const wxString& rConfigFileName) 
-: INIT_PROPS_DEFAULTS
+: INIT_PROPS_DEFAULTS,
+  mLocationsGeneration(0)
 {
 	Load(rConfigFileName);
 }
@@ -174,6 +176,8 @@ void ClientConfig::Load(const Configuration& rBoxConfig)
 	{
 		i->SetListener(this);
 	}
+
+	OnLocationsChange();
 	
 	mapOriginalConfig.reset(new Configuration(rBoxConfig));
 
@@ -294,6 +298,7 @@ Configuration ClientConfig::GetBoxConfig()
 void ClientConfig::AddLocation(const BoxiLocation& rNewLoc) 
 {
 	mLocations.push_back(rNewLoc);
+	OnLocationsChange();
 	NotifyListeners();
 }
 
@@ -312,6 +317,7 @@ void ClientConfig::ReplaceLocation(int target, const BoxiLocation& rNewLoc)
 	if (i == target)
 	{
 		*current = rNewLoc;
+		OnLocationsChange();
 		NotifyListeners();
 	}
 }
@@ -331,6 +337,7 @@ void ClientConfig::RemoveLocation(int target)
 	if (i == target)
 	{
 		mLocations.erase(current);
+		OnLocationsChange();
 		NotifyListeners();
 	}
 }
@@ -346,6 +353,7 @@ void ClientConfig::RemoveLocation(const BoxiLocation& rOldLocation)
 		if (current->IsSameAs(rOldLocation))
 		{
 			mLocations.erase(current);
+			OnLocationsChange();
 			NotifyListeners();
 			return;
 		}
@@ -400,6 +408,26 @@ BoxiLocation* ClientConfig::GetLocation(int target)
 	return NULL;
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ClientConfig::GetLocationIndex()
+//		Purpose: Returns an index of the location root paths,
+//			 building it the first time it's needed after any
+//			 change to the locations.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+const BoxiLocationIndex& ClientConfig::GetLocationIndex()
+{
+	if (!mapLocationIndex.get())
+	{
+		mapLocationIndex.reset(new BoxiLocationIndex(mLocations));
+	}
+
+	return *mapLocationIndex;
+}
+
 void ClientConfig::AddListener(ConfigChangeListener* pNewListener)
 {
 	for (std::vector<ConfigChangeListener*>::iterator i = mListeners.begin();
@@ -576,6 +604,7 @@ void ClientConfig::Reset()
 	mConfigFileName = wxT("");
 	mapOriginalConfig.reset();
 	mLocations.clear();
+	OnLocationsChange();
 }
 
 void ClientConfig::SetClean() 
@@ -643,9 +672,19 @@ void ClientConfig::OnPropertyChange(Property* pProp)
 
 void ClientConfig::OnLocationChange(BoxiLocation* pLocation)
 {
+	OnLocationsChange();
 	NotifyListeners();
 }
 
+// Called whenever a location is added, removed, replaced or changed,
+// but not when only an exclude list changes, which has its own
+// generation number.
+void ClientConfig::OnLocationsChange()
+{
+	mapLocationIndex.reset();
+	mLocationsGeneration++;
+}
+
 void ClientConfig::OnExcludeListChange(BoxiExcludeList* pExcludeList)
 {
 	NotifyListeners();
@@ -26,6 +26,8 @@
 
 #include "SandBox.h"
 
+#include <errno.h>
+
 #include <iostream>
 
 #include <wx/file.h>
@@ -38,10 +40,29 @@
 #include "BoxException.h"
 #include "ClientConnection.h"
 
+// how often to look for a daemon that isn't running yet
+#define CLIENT_CONNECT_RETRY_MILLIS 1000
+// how long a daemon has to send its configuration summary
+#define CLIENT_RESPONSE_TIMEOUT_MILLIS 10000
+// how often to look at the PID file, as a daemon may be started or
+// killed without ever connecting to us
+#define CLIENT_PID_CHECK_MILLIS 5000
+// events kept for the GUI, if it doesn't take them
+#define CLIENT_EVENT_QUEUE_SIZE 64
+// lines that aren't understood are only logged this many times
+// per connection
+#define CLIENT_MAX_UNKNOWN_LINES_LOGGED 10
+// messages kept for the GUI to log, if it doesn't take them
+#define CLIENT_LOG_QUEUE_SIZE 64
+
 ClientConnection::ClientConnection(ClientConfig* pConfig, 
 				 const wxString& rExecutablePath,
 				 Listener* pListener)
-: wxThread(wxTHREAD_JOINABLE)
+: wxThread(wxTHREAD_JOINABLE),
+  mEvents(CLIENT_EVENT_QUEUE_SIZE)
+#ifndef WIN32
+  , mParser(mCommandSocket)
+#endif
 {
 	mpConfig = pConfig;
 	mpListener = pListener;
@@ -50,47 +71,72 @@ ClientConnection::ClientConnection(ClientConfig* pConfig,
 	mCurrentState = BST_CONNECTING;
 	mExecutablePath = rExecutablePath;
 	mClientPid = -1;
+	mNewLogMessages = FALSE;
+#ifndef WIN32
+	mNumUnknownLines = 0;
+	mSocketOpen = FALSE;
+	mNextConnectMillis = 0;
+	mConnectDeadlineMillis = 0;
+	mNextPidCheckMillis = 0;
+#endif
+	{
+		wxMutexLocker lock(mMutex);
+		_CopyConfigPaths();
+	}
+	mpConfig->AddListener(this);
 	Create();
 	Run();
 }
 
 ClientConnection::~ClientConnection() 
 {
-	// Delete();
-	// Wait();
+	mpConfig->RemoveListener(this);
+	{
+		wxMutexLocker lock(mMutex);
+		mCurrentState = BST_SHUTDOWN;
+	}
+#ifndef WIN32
+	mPoller.Wake();
+#endif
+	Wait();
 }
 
-// temporary hack since the old GetClientBinaryPath doesn't compile
+#ifdef WIN32
+// There's no Unix command socket to talk to the daemon through, so the
+// worker thread has nothing to do yet, as before it used one.
 void* ClientConnection::Entry() { return NULL; }
-
-/*
+#else
+// The worker thread only runs when there's something to do: a line
+// from the daemon, a request from the GUI (which wakes mPoller), or a
+// connection retry or PID file check falling due. Listeners are only
+// notified of things that have changed.
 void* ClientConnection::Entry()
 {
-	wxLogDebug(_("Client worker thread starting"));
+	QueueLog(wxLOG_Debug, _("Client worker thread starting"));
 
-	// unlocked use of mCurrentState, might possibly be dangerous?
-	while (mCurrentState != BST_SHUTDOWN)
+	while (TRUE)
 	{
 		WorkerState PrevWorkerState;
 		ClientState PrevClientState;
+		Error       PrevError;
+		long        PrevPid;
 		
 		{
 			wxMutexLocker lock(mMutex);
 			PrevWorkerState = mCurrentState;
 			PrevClientState = mClientState;
-			mLastError = ERR_NONE;
+			PrevError       = mLastError;
+			PrevPid         = mClientPid;
 		}
-		
-		// wxLogDebug("Current worker state: %s", GetStateStr(PrevState));
+
+		if (PrevWorkerState == BST_SHUTDOWN)
+			break;
 		
 		try {
 			switch (PrevWorkerState)
 			{
 				case BST_CONNECTING:
 					OnConnect(); break;
-				case BST_CONNECTED:
-				case BST_RESTARTING:
-					OnConnectedIdle(); break;
 				case BST_START:
 					OnStartClient(); break;
 				case BST_STOP:
@@ -101,24 +147,23 @@ void* ClientConnection::Entry()
 					OnSyncClient(); break;
 				case BST_RELOAD:
 					OnReloadClient(); break;
-				case BST_SHUTDOWN:
-					break;
 				default:
-					wxLogError(
-						_("Unknown client worker "
-							"state %d"), 
-						PrevWorkerState);
+					// waiting for the daemon
+					break;
 			}
+
+			ProcessLines();
 		} catch (...) {
-			wxLogError(_("Caught exception"));
+			QueueLog(wxLOG_Error, _("Caught exception"));
 		}
 
+		if (wxGetLocalTimeMillis() >= mNextPidCheckMillis)
 		{
 			long Dummy;
 			GetClientPidSlow(Dummy);
-		}
+			mNextPidCheckMillis = wxGetLocalTimeMillis() + 
+				CLIENT_PID_CHECK_MILLIS;
 
-		{
 			wxMutexLocker lock(mMutex);
 		
 			if (mapBackupClientProcess.get() &&
@@ -129,49 +174,147 @@ void* ClientConnection::Entry()
 			}
 		}
 
-		if (TestDestroy()) {
+		WorkerState NewWorkerState;
+		ClientState NewClientState;
+		Error       NewError;
+		long        NewPid;
+
+		{
 			wxMutexLocker lock(mMutex);
-			mCurrentState = BST_SHUTDOWN;
-			PrevWorkerState = mCurrentState;
-			break;
+			NewWorkerState = mCurrentState;
+			NewClientState = mClientState;
+			NewError       = mLastError;
+			NewPid         = mClientPid;
 		}
 		
+		if (NewWorkerState != PrevWorkerState) {
+			QueueLog(wxLOG_Debug, wxString::Format(
+				_("Worker state change: '%s' to '%s'"),
+				GetStateStr(PrevWorkerState),
+				GetStateStr(NewWorkerState)));
+		}
+		if (NewError != PrevError && NewError != ERR_NONE) {
+			QueueLog(wxLOG_Debug, wxString::Format(
+				_("Worker error: '%s'"),
+				mErrorStrings[NewError]));
+		}
+
+		bool NewLogMessages;
+		{
+			wxMutexLocker lock(mMutex);
+			NewLogMessages = mNewLogMessages;
+			mNewLogMessages = FALSE;
+		}
+
 		if (mpListener)
 		{
-			if (mCurrentState != PrevWorkerState) {
+			if (NewWorkerState != PrevWorkerState) {
 				mpListener->NotifyStateChange();
-				wxLogDebug(_(
-					"Worker state change: '%s' to '%s'"),
-					GetStateStr(PrevWorkerState),
-					GetStateStr(mCurrentState));
 			}
-			if (mClientState != PrevClientState) {
+			if (NewClientState != PrevClientState ||
+				NewPid != PrevPid) {
 				mpListener->NotifyClientStateChange();
 			}
-			mpListener->NotifyError();
-			if (mLastError != ERR_NONE) {
-				wxLogDebug(_("Worker error: '%s'"),
-					GetLastErrorMsg());
+			if (NewError != PrevError || NewLogMessages) {
+				mpListener->NotifyError();
 			}
 		}
-			
-		if (mCurrentState == BST_CONNECTING || 
-			mCurrentState == BST_STARTWAIT)
-		{
-			Sleep(1000);
-		}
+
+		std::vector<CommandSocketClient*> sockets;
+		sockets.push_back(&mCommandSocket);
+		mPoller.Wait(sockets, GetWaitMillis());
 	}
 	
-	wxLogDebug(_("Client worker thread shutdown"));
+	mCommandSocket.Close();
+	QueueLog(wxLOG_Debug, _("Client worker thread shutdown"));
 	return NULL;
 }
-*/
+
+// Returns how long the worker can sleep before it has anything to do,
+// unless woken up sooner
+int ClientConnection::GetWaitMillis()
+{
+	wxLongLong next = mNextPidCheckMillis;
+
+	if (GetState() == BST_CONNECTING)
+	{
+		wxLongLong connect = mSocketOpen ? mConnectDeadlineMillis
+			: mNextConnectMillis;
+		if (connect < next)
+			next = connect;
+	}
+
+	wxLongLong now = wxGetLocalTimeMillis();
+	if (next <= now)
+		return 0;
+	
+	return (next - now).ToLong();
+}
+#endif // WIN32
 
 long ClientConnection::GetClientPidFast()
 {
 	wxMutexLocker lock(mMutex);
 	return mClientPid;
 }
+
+// Called in the GUI thread, with mMutex held, so that the worker can
+// use the paths without touching the configuration.
+void ClientConnection::_CopyConfigPaths()
+{
+	if (!mpConfig->PidFile.GetInto(mPidFilePath))
+		mPidFilePath.clear();
+	if (!mpConfig->CommandSocket.GetInto(mCommandSocketPath))
+		mCommandSocketPath.clear();
+}
+
+void ClientConnection::NotifyChange()
+{
+	wxMutexLocker lock(mMutex);
+	_CopyConfigPaths();
+#ifndef WIN32
+	// check the PID file and try the socket again soon
+	mPoller.Wake();
+#endif
+}
+
+// wxLog isn't safe to use outside the GUI thread, so the worker
+// queues its messages here instead, and LogMessages() logs them.
+// Debug messages are only kept in debug builds, as wxLogDebug does.
+void ClientConnection::QueueLog(wxLogLevel level, const wxString& rText)
+{
+	wxMutexLocker lock(mMutex);
+	_QueueLog(level, rText);
+}
+
+void ClientConnection::_QueueLog(wxLogLevel level, const wxString& rText)
+{
+#ifndef __WXDEBUG__
+	if (level == wxLOG_Debug)
+		return;
+#endif
+
+	if (mLogMessages.size() >= CLIENT_LOG_QUEUE_SIZE)
+		return;
+
+	mLogMessages.push_back(LogMessage(level, rText));
+	mNewLogMessages = TRUE;
+}
+
+void ClientConnection::LogMessages()
+{
+	std::vector<LogMessage> messages;
+	{
+		wxMutexLocker lock(mMutex);
+		messages.swap(mLogMessages);
+	}
+
+	for (std::vector<LogMessage>::iterator i = messages.begin();
+		i != messages.end(); i++)
+	{
+		wxLogGeneric(i->mLevel, wxT("%s"), i->mText.c_str());
+	}
+}
     
 ClientConnection::Error ClientConnection::GetClientPidSlow(long& rPid)
 {
@@ -190,23 +333,29 @@ ClientConnection::Error ClientConnection::GetClientPidSlow(long& rPid)
 ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 {
 	std::string PidFilePathStr;
-	if (!mpConfig->PidFile.GetInto(PidFilePathStr))
+	{
+		wxMutexLocker lock(mMutex);
+		PidFilePathStr = mPidFilePath;
+	}
+	if (PidFilePathStr.empty())
 		return ERR_NOPIDCONFIG;
 	wxString PidFilePath(PidFilePathStr.c_str(), wxConvBoxi);
 		
 	wxFileName DaemonPidFile(PidFilePath);
 	if (!wxFileName::FileExists(DaemonPidFile.GetFullPath()))
 	{
-		wxLogDebug(_("PID file not found (%s)"), 
-			DaemonPidFile.GetFullPath().c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			_("PID file not found (%s)"),
+			DaemonPidFile.GetFullPath().c_str()));
 		return ERR_FILENOTFOUND;
 	}
 	
 	wxFile PidFile(PidFilePath);
 	if (!PidFile.IsOpened())
 	{
-		wxLogDebug(_("Unable to read PID file (%s)"), 
-			PidFilePath.c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			_("Unable to read PID file (%s)"),
+			PidFilePath.c_str()));
 		return ERR_ACCESSDENIED;
 	}
 	
@@ -214,8 +363,9 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 	char *buffer = new char [length + 1];
 	if (!buffer)
 	{
-		wxLogDebug(_("Out of memory reading PID file (%s)"), 
-			PidFilePath.c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			_("Out of memory reading PID file (%s)"),
+			PidFilePath.c_str()));
 		return ERR_RESOURCES;
 	}
 	memset(buffer, 0, length + 1);
@@ -223,8 +373,9 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 	int BytesRead = PidFile.Read(buffer, length);
 	if (BytesRead != length)
 	{
-		wxLogDebug(_("Short read on PID file (%s)"), 
-			PidFilePath.c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			_("Short read on PID file (%s)"),
+			PidFilePath.c_str()));
 		delete[] buffer;
 		return ERR_PIDFORMAT;
 	}
@@ -233,8 +384,9 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 	long ProcessID = ::strtol(buffer, &endptr, 10);
 	if (ProcessID <= 0)
 	{
-		wxLogDebug(_("Invalid character code %d in PID file (%s)"),
-			*endptr, PidFilePath.c_str());
+		QueueLog(wxLOG_Debug, wxString::Format(
+			_("Invalid character code %d in PID file (%s)"),
+			*endptr, PidFilePath.c_str()));
 		delete[] buffer;
 		return ERR_PIDFORMAT;
 	}
@@ -250,7 +402,7 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 			return ERR_NONE;
 
 		case wxKILL_BAD_SIGNAL: // no such signal
-			wxLogDebug(_("No such signal wxSIGTERM?"));
+			QueueLog(wxLOG_Debug, _("No such signal wxSIGTERM?"));
 			return ERR_INTERNAL;
 
 		case wxKILL_ACCESS_DENIED: // permission denied
@@ -265,8 +417,9 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 		
 		case wxKILL_ERROR: // another, unspecified error
 		default:
-			wxLogDebug(_("Failed to kill process %ld: "
-				"unspecified error"), ProcessID);
+			QueueLog(wxLOG_Debug, wxString::Format(
+				_("Failed to kill process %ld: "
+				"unspecified error"), ProcessID));
 			return ERR_UNKNOWN;
 	}			
 
@@ -281,138 +434,163 @@ ClientConnection::Error ClientConnection::_GetClientPidSlow(long& rPid)
 	}
 */
 
+#ifndef WIN32
+// Connects to the daemon, if it's time to try again, or gives up on
+// a daemon that hasn't sent its configuration summary in time. The
+// summary itself is handled by HandleEvent().
 void ClientConnection::OnConnect() {
+	wxLongLong now = wxGetLocalTimeMillis();
+
+	if (mSocketOpen)
 	{
+		if (now < mConnectDeadlineMillis)
+			return;
+
+		QueueLog(wxLOG_Debug, _("Failed to read status from client"));
+		mCommandSocket.Close();
+		mSocketOpen = FALSE;
+		mNextConnectMillis = now + CLIENT_CONNECT_RETRY_MILLIS;
+
 		wxMutexLocker lock(mMutex);
-		assert(mCurrentState == BST_CONNECTING);
+		if (mCurrentState == BST_CONNECTING)
+			mLastError = ERR_NORESPONSE;
+		return;
 	}
+
+	if (now < mNextConnectMillis)
+		return;
+
 	Error result = DoConnect();
+	mNextConnectMillis = now + CLIENT_CONNECT_RETRY_MILLIS;
+	mConnectDeadlineMillis = now + CLIENT_RESPONSE_TIMEOUT_MILLIS;
 	{
 		wxMutexLocker lock(mMutex);
 		if (mCurrentState != BST_CONNECTING) {
-			wxLogDebug(_("Client connect interrupted"));
+			_QueueLog(wxLOG_Debug, _("Client connect interrupted"));
+			mCommandSocket.Close();
+			mSocketOpen = FALSE;
 			return;
 		}
-		if (result == ERR_NONE)
-			mCurrentState = BST_CONNECTED;
-		if (result != ERR_INTERRUPTED)
-			mLastError = result;
+		mLastError = result;
 	}
 }
 
 ClientConnection::Error ClientConnection::DoConnect()
 {
 	std::string CommandSocket;
-	if (!mpConfig->CommandSocket.GetInto(CommandSocket))
 	{
-		return ERR_NOSOCKETCONFIG;
+		wxMutexLocker lock(mMutex);
+		CommandSocket = mCommandSocketPath;
 	}
-
-	mapReader->DetachFile();
-	mapReader.reset();
-
-	// should be freed by the IOStreamGetLine that controls it
-	mpSocket = NULL;
-	
-	// apSocket is a smart pointer and should dispose of the
-	// old object if we return before release()ing it to
-	// the control of the IOStreamGetLine
-	std::auto_ptr<SocketStream> apSocket(new SocketStream());
-
-	// wxLogDebug("open socket to client");
-	
-	try
+	if (CommandSocket.empty())
 	{
-		apSocket->Open(Socket::TypeUNIX, CommandSocket.c_str());
+		return ERR_NOSOCKETCONFIG;
 	}
-	catch(...)
+
+	if (!mCommandSocket.Connect(CommandSocket))
 	{
+		if (mCommandSocket.GetLastErrno() == ENOENT)
+			return ERR_SOCKETNOTFOUND;
 		return ERR_SOCKETREFUSED;
 	}
 
+	mParser.Reset();
+	mNumUnknownLines = 0;
+	mSocketOpen = TRUE;
+	return ERR_NONE;
+}
+
+// Handles everything the daemon has sent since last time, and notices
+// if it has gone away.
+void ClientConnection::ProcessLines()
+{
+	CommandSocketEvent Event;
+	while (mParser.GetEvent(&Event))
 	{
+		Error result = HandleEvent(Event);
+
 		wxMutexLocker lock(mMutex);
-		if (mCurrentState != BST_CONNECTING) {
-			wxLogDebug(_("DoConnect interrupted"));
-			return ERR_INTERRUPTED;
-		}
+		mLastError = result;
 	}
-	
-	mpSocket = apSocket.release();
-	mapReader.reset(new IOStreamGetLine(*mpSocket));
 
-	// Wait for the configuration summary
-	std::string ConfigSummary;
-	
-	try {
-		if (!mapReader->GetLine(ConfigSummary)) {
-			wxLogDebug(_("Failed to read status from client"));
-			return ERR_NORESPONSE;
-		}
-	} catch (...) {
-		wxLogDebug(_("Exception while reading status from client"));
-		return ERR_NORESPONSE;
+	if (mSocketOpen && !mCommandSocket.IsConnected())
+	{
+		mSocketOpen = FALSE;
+		OnDisconnect();
 	}
+}
 
+// The daemon can say a lot during a sync, so nothing here allocates
+// or logs for an ordinary line. State changes and syncs are queued
+// for the GUI, which is only told when the queue stops being empty.
+ClientConnection::Error ClientConnection::HandleEvent(
+	const CommandSocketEvent& rEvent)
+{
+	if (rEvent.mType == CommandSocketEvent::CSE_UNKNOWN ||
+		rEvent.mType == CommandSocketEvent::CSE_MALFORMED)
 	{
-		wxMutexLocker lock(mMutex);
-		if (mCurrentState != BST_CONNECTING) {
-			wxLogDebug(_("GetLine interrupted"));
-			return ERR_INTERRUPTED;
+		if (mNumUnknownLines++ < CLIENT_MAX_UNKNOWN_LINES_LOGGED)
+		{
+			wxString line2(std::string(rEvent.mpText,
+				rEvent.mTextLength).c_str(), wxConvBoxi);
+			QueueLog(wxLOG_Debug, wxString::Format(
+				_("read from daemon: '%s'"), line2.c_str()));
 		}
 	}
-	
-	// Was the connection rejected by the server?
-	if (mapReader->IsEOF())
-		return ERR_DISCONNECTED;
 
-	return ERR_NONE;
-}
+	Error result = ERR_NONE;
+	bool queue = FALSE;
 
-ClientConnection::Error ClientConnection::DoReadLine()
-{
-	std::string Line;
-	bool result = FALSE;
-	
-	try {
-		result = mapReader->GetLine(Line, 0, 1000);
-	} catch (BoxException& be) {
-		return ERR_DISCONNECTED;
-	}
-	
-	if (!result)
-		return ERR_READTIMEOUT;
-	
-	if (mapReader->IsEOF())
-		return ERR_DISCONNECTED;
+	{
+		wxMutexLocker lock(mMutex);
 
-	if (Line == "ok")
-		return ERR_NONE;
-	
-	if (Line == "error")
-		return ERR_CMDFAILED;
-	
-	wxString line2(Line.c_str(), wxConvBoxi);
-	wxString rest;
-	if (line2.StartsWith(_("state "), &rest)) 
-	{
-		long value;
-		if (!rest.ToLong(&value))
-			return ERR_BADRESPONSE;
-		if (value >= CS_INIT && value <= CS_STORELIMIT)
+		if (mCurrentState == BST_CONNECTING)
 		{
-			mClientState = (ClientState)value;
+			// the first line is the configuration summary, which
+			// means that the daemon has accepted us
+			mCurrentState = BST_CONNECTED;
+			mNextPidCheckMillis = 0;
+			queue = (rEvent.mType == CommandSocketEvent::CSE_SUMMARY);
 		}
 		else
 		{
-			mClientState = CS_UNKNOWN;
-			return ERR_BADRESPONSE;
+			switch (rEvent.mType)
+			{
+				case CommandSocketEvent::CSE_ERROR:
+					result = ERR_CMDFAILED; break;
+				case CommandSocketEvent::CSE_MALFORMED:
+					result = ERR_BADRESPONSE; break;
+				case CommandSocketEvent::CSE_STATE:
+					if (rEvent.mState >= CS_INIT &&
+						rEvent.mState <= CS_STORELIMIT)
+					{
+						mClientState =
+							(ClientState)rEvent.mState;
+					}
+					else
+					{
+						mClientState = CS_UNKNOWN;
+						result = ERR_BADRESPONSE;
+					}
+					queue = TRUE;
+					break;
+				case CommandSocketEvent::CSE_SYNC_START:
+				case CommandSocketEvent::CSE_SYNC_FINISH:
+					queue = TRUE; break;
+				default:
+					break;
+			}
 		}
 	}
 
-	wxLogDebug(_("read from daemon: '%s'"), line2.c_str());
-	return ERR_NONE;
+	if (queue && mEvents.Push(rEvent) && mpListener)
+	{
+		mpListener->NotifyClientStateChange();
+	}
+
+	return result;
 }
+#endif // !WIN32
 
 /*
 bool ClientConnection::GetClientBinaryPath(wxString& rDestPath)
@@ -465,39 +643,41 @@ bool ClientConnection::GetClientBinaryPath(wxString& rDestPath)
 }
 */
 
-void ClientConnection::OnConnectedIdle() {
+#ifndef WIN32
+void ClientConnection::OnDisconnect() {
+	mNextConnectMillis = wxGetLocalTimeMillis() + 
+		CLIENT_CONNECT_RETRY_MILLIS;
+	// it has probably exited
+	mNextPidCheckMillis = 0;
+
+	wxMutexLocker lock(mMutex);
+	mClientState = CS_UNKNOWN;
+
+	if (mCurrentState == BST_SHUTDOWN)
+		return;
+
+	if (mCurrentState == BST_RESTARTING)
 	{
-		wxMutexLocker lock(mMutex);
-		assert(mCurrentState == BST_CONNECTED ||
-			mCurrentState == BST_RESTARTING);
+		mCurrentState = BST_START;
+		mLastError = ERR_NONE;
 	}
-	Error result = DoReadLine();
+	else
 	{
-		wxMutexLocker lock(mMutex);
-		if (mCurrentState != BST_CONNECTED &&
-			mCurrentState != BST_RESTARTING)
-		{
-			mLastError = ERR_INTERRUPTED;
-			return;
-		}
-		if (result == ERR_DISCONNECTED) {
-			mClientState = CS_UNKNOWN;
-			if (mCurrentState == BST_CONNECTED)
-				mCurrentState = BST_CONNECTING;
-			else if (mCurrentState == BST_RESTARTING)
-			{
-				mCurrentState = BST_START;
-				result = ERR_NONE;
-			}
-			else
-				assert(FALSE);
-		}
-		if (result == ERR_READTIMEOUT)
-			mLastError = ERR_NONE;
-		else
-			mLastError = result;
+		mCurrentState = BST_CONNECTING;
+		mLastError = ERR_DISCONNECTED;
 	}
 }
+#endif // !WIN32
+
+// Until GetClientBinaryPath() and DoStartClient() below are working
+// again, the client can't be started from here, so go back to waiting
+// for it to be started some other way.
+void ClientConnection::OnStartClient() {
+	wxMutexLocker lock(mMutex);
+	assert(mCurrentState == BST_START);
+	mCurrentState = BST_CONNECTING;
+	mLastError = ERR_FILEUNKNOWN;
+}
 
 /*
 void ClientConnection::OnStartClient() {
@@ -621,6 +801,8 @@ void ClientConnection::OnReloadClient() {
 	}
 }
 
+// Called with mMutex held, in either thread. The output is logged
+// when the GUI next calls LogMessages().
 void ClientConnection::LogProcessOutput(wxProcess* pProcess)
 {
 	{
@@ -629,7 +811,7 @@ void ClientConnection::LogProcessOutput(wxProcess* pProcess)
 
 		wxString line = InputText.ReadLine();
 		while (line.Length() != 0) {
-			wxLogWarning(line);
+			_QueueLog(wxLOG_Warning, line);
 			line = InputText.ReadLine();
 		}
 	}
@@ -640,7 +822,7 @@ void ClientConnection::LogProcessOutput(wxProcess* pProcess)
 
 		wxString line = ErrorText.ReadLine();
 		while (line.Length() != 0) {
-			wxLogError(line);
+			_QueueLog(wxLOG_Error, line);
 			line = ErrorText.ReadLine();
 		}
 	}
@@ -678,6 +860,9 @@ void ClientConnection::OnClientTerminate(wxProcess *pProcess,
 		mCurrentState = BST_START;
 	else
 		mCurrentState = BST_CONNECTING;
+#ifndef WIN32
+	mPoller.Wake();
+#endif
 	
 	if (status == 0)
 	{
@@ -708,6 +893,9 @@ bool ClientConnection::SetWorkerState(WorkerState oldState,
 	}
 	
 	mCurrentState = newState;
+#ifndef WIN32
+	mPoller.Wake();
+#endif
 	return TRUE;
 }
 
@@ -0,0 +1,279 @@
+/***************************************************************************
+ *            CommandSocketClient.cc
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+// bbackupd's command socket is a Unix socket, which Windows doesn't have
+#ifndef WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "CommandSocketClient.h"
+
+// bbackupd's lines are short, so this holds hundreds of them, and
+// a line that doesn't fit isn't from a bbackupd
+#define COMMAND_SOCKET_BUFFER_SIZE 16384
+
+CommandSocketClient::CommandSocketClient()
+: mSocket(-1),
+  mLastErrno(0),
+  mBuffer(COMMAND_SOCKET_BUFFER_SIZE),
+  mLineStart(0),
+  mDataEnd(0)
+{ }
+
+CommandSocketClient::~CommandSocketClient()
+{
+	Close();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketClient::Connect(
+//			 const std::string& rSocketPath)
+//		Purpose: Connects to the daemon's command socket, closing
+//			 any previous connection first. Connecting to a Unix
+//			 socket doesn't wait for the daemon to answer, so
+//			 this returns straight away. Returns false if there
+//			 is no daemon listening, with the reason in
+//			 GetLastErrno().
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool CommandSocketClient::Connect(const std::string& rSocketPath)
+{
+	Close();
+
+	struct sockaddr_un address;
+	if (rSocketPath.size() >= sizeof(address.sun_path))
+	{
+		mLastErrno = ENAMETOOLONG;
+		return false;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, rSocketPath.c_str());
+
+	int handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (handle == -1)
+	{
+		mLastErrno = errno;
+		return false;
+	}
+
+	if (::connect(handle, (struct sockaddr *)&address,
+		sizeof(address)) != 0)
+	{
+		mLastErrno = errno;
+		::close(handle);
+		return false;
+	}
+
+	Attach(handle);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketClient::Attach(int handle)
+//		Purpose: Takes over a socket that's already connected to a
+//			 daemon, such as one end of a socketpair(), closing
+//			 any previous connection first. The socket is closed
+//			 by Close() or the destructor.
+//		Created: 2009/01/17
+//
+// --------------------------------------------------------------------------
+void CommandSocketClient::Attach(int handle)
+{
+	Close();
+
+	::fcntl(handle, F_SETFD, FD_CLOEXEC);
+	::fcntl(handle, F_SETFL, ::fcntl(handle, F_GETFL) | O_NONBLOCK);
+
+	mSocket = handle;
+	mLineStart = 0;
+	mDataEnd = 0;
+	mLastErrno = 0;
+}
+
+// Lines that were read before the connection was closed can still be
+// had from GetLine(), but anything not yet sent is thrown away.
+void CommandSocketClient::Close()
+{
+	if (mSocket != -1)
+	{
+		::close(mSocket);
+		mSocket = -1;
+	}
+
+	mOutput.clear();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketClient::SendCommand(
+//			 const std::string& rCommand)
+//		Purpose: Queues a command for the daemon, and sends as much
+//			 of it as the socket will take now. The rest is sent
+//			 from OnWritable(). Returns false if not connected.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool CommandSocketClient::SendCommand(const std::string& rCommand)
+{
+	if (!IsConnected())
+	{
+		return false;
+	}
+
+	mOutput += rCommand;
+	mOutput += "\n";
+	OnWritable();
+	return IsConnected();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketClient::GetLine(const char** ppLine,
+//			 size_t* pLength)
+//		Purpose: Finds the oldest complete line that hasn't been
+//			 returned yet, and sets *ppLine to point to it in the
+//			 buffer, without its line ending, and nul-terminated.
+//			 It stays there until the next call to OnReadable()
+//			 or Connect(). Returns false if there isn't a
+//			 complete line.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+bool CommandSocketClient::GetLine(const char** ppLine, size_t* pLength)
+{
+	char* pStart = &mBuffer[0] + mLineStart;
+	char* pEnd = (char *)memchr(pStart, '\n', mDataEnd - mLineStart);
+
+	if (pEnd == NULL)
+	{
+		return false;
+	}
+
+	mLineStart += pEnd - pStart + 1;
+
+	if (pEnd > pStart && pEnd[-1] == '\r')
+	{
+		pEnd--;
+	}
+
+	*pEnd = 0;
+	*ppLine = pStart;
+	*pLength = pEnd - pStart;
+	return true;
+}
+
+void CommandSocketClient::OnReadable()
+{
+	// make room for more after whatever hasn't been taken yet
+	if (mLineStart > 0)
+	{
+		memmove(&mBuffer[0], &mBuffer[0] + mLineStart,
+			mDataEnd - mLineStart);
+		mDataEnd -= mLineStart;
+		mLineStart = 0;
+	}
+
+	while (IsConnected())
+	{
+		if (mDataEnd == mBuffer.size())
+		{
+			if (memchr(&mBuffer[0], '\n', mDataEnd) == NULL)
+			{
+				// one line that doesn't fit in the buffer
+				mLastErrno = EPROTO;
+				Close();
+			}
+
+			// otherwise wait for the lines to be taken
+			break;
+		}
+
+		ssize_t bytes = ::read(mSocket, &mBuffer[0] + mDataEnd,
+			mBuffer.size() - mDataEnd);
+
+		if (bytes == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (bytes == -1 && (errno == EAGAIN ||
+			errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		else if (bytes <= 0)
+		{
+			// closed by the daemon, or broken
+			mLastErrno = (bytes == 0) ? 0 : errno;
+			Close();
+			break;
+		}
+
+		mDataEnd += bytes;
+	}
+}
+
+void CommandSocketClient::OnWritable()
+{
+	while (IsConnected() && mOutput.size() > 0)
+	{
+		ssize_t bytes = ::write(mSocket, mOutput.c_str(),
+			mOutput.size());
+
+		if (bytes == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (bytes == -1 && (errno == EAGAIN ||
+			errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		else if (bytes <= 0)
+		{
+			mLastErrno = errno;
+			Close();
+			break;
+		}
+
+		mOutput.erase(0, bytes);
+	}
+}
+
+#endif // !WIN32
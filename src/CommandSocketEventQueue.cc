@@ -0,0 +1,102 @@
+/***************************************************************************
+ *            CommandSocketEventQueue.cc
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include "CommandSocketEventQueue.h"
+
+CommandSocketEventQueue::CommandSocketEventQueue(size_t capacity)
+: mEvents(capacity),
+  mFirst(0),
+  mCount(0),
+  mNumDropped(0)
+{ }
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketEventQueue::Push(
+//			 const CommandSocketEvent& rEvent)
+//		Purpose: Adds an event to the end of the queue, dropping
+//			 the oldest if it's full. Returns true if the queue
+//			 was empty before, and so the reader needs to be
+//			 told that there's something to read; otherwise it
+//			 has been told already.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+bool CommandSocketEventQueue::Push(const CommandSocketEvent& rEvent)
+{
+	wxMutexLocker lock(mMutex);
+	bool wasEmpty = (mCount == 0);
+
+	if (mCount == mEvents.size())
+	{
+		mFirst = (mFirst + 1) % mEvents.size();
+		mCount--;
+		mNumDropped++;
+	}
+
+	mEvents[(mFirst + mCount) % mEvents.size()] = rEvent;
+	mCount++;
+
+	return wasEmpty;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketEventQueue::Drain(
+//			 std::vector<CommandSocketEvent>* pEvents)
+//		Purpose: Moves all the queued events, oldest first, into
+//			 *pEvents, replacing what was there. Returns the
+//			 number of events that were dropped since the last
+//			 call, because the queue was full.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+size_t CommandSocketEventQueue::Drain(std::vector<CommandSocketEvent>* pEvents)
+{
+	wxMutexLocker lock(mMutex);
+
+	pEvents->clear();
+	for (size_t i = 0; i < mCount; i++)
+	{
+		pEvents->push_back(mEvents[(mFirst + i) % mEvents.size()]);
+	}
+
+	size_t numDropped = mNumDropped;
+	mFirst = 0;
+	mCount = 0;
+	mNumDropped = 0;
+	return numDropped;
+}
+
+void CommandSocketEventQueue::Clear()
+{
+	wxMutexLocker lock(mMutex);
+	mFirst = 0;
+	mCount = 0;
+	mNumDropped = 0;
+}
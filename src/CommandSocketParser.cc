@@ -0,0 +1,162 @@
+/***************************************************************************
+ *            CommandSocketParser.cc
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+// Parses what CommandSocketClient reads, so only built alongside it
+#ifndef WIN32
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CommandSocketClient.h"
+#include "CommandSocketParser.h"
+
+CommandSocketParser::CommandSocketParser(CommandSocketClient& rClient)
+: mrClient(rClient),
+  mHaveSummary(false)
+{ }
+
+void CommandSocketParser::Reset()
+{
+	mHaveSummary = false;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketParser::GetEvent(
+//			 CommandSocketEvent* pEvent)
+//		Purpose: Parses the next line received by the client, if
+//			 there is one, into *pEvent, and returns true.
+//			 Returns false if there are no more complete lines.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+bool CommandSocketParser::GetEvent(CommandSocketEvent* pEvent)
+{
+	const char* pLine;
+	size_t length;
+
+	if (!mrClient.GetLine(&pLine, &length))
+	{
+		return false;
+	}
+
+	*pEvent = CommandSocketEvent();
+	pEvent->mTime = time(NULL);
+	Parse(pLine, length, pEvent);
+	return true;
+}
+
+// Parses a decimal integer that takes up the whole of pText, which
+// is nul-terminated, into *pValue. Returns false if it doesn't, or if
+// it doesn't fit in an int.
+static bool ParseInt(const char* pText, int* pValue)
+{
+	char* pEnd;
+	errno = 0;
+	long value = ::strtol(pText, &pEnd, 10);
+
+	if (pEnd == pText || *pEnd != 0 || errno == ERANGE ||
+		value < INT_MIN || value > INT_MAX)
+	{
+		return false;
+	}
+
+	*pValue = value;
+	return true;
+}
+
+#define STARTS_WITH(pLine, length, prefix) \
+	(length >= sizeof(prefix) - 1 && \
+	 memcmp(pLine, prefix, sizeof(prefix) - 1) == 0)
+
+#define IS(pLine, length, text) \
+	(length == sizeof(text) - 1 && memcmp(pLine, text, length) == 0)
+
+void CommandSocketParser::Parse(const char* pLine, size_t length,
+	CommandSocketEvent* pEvent)
+{
+	if (!mHaveSummary && STARTS_WITH(pLine, length, "bbackupd: "))
+	{
+		// bbackupd: <automatic> <update store interval>
+		//	<minimum file age> <max upload wait>
+		int automatic;
+		mHaveSummary = true;
+
+		if (::sscanf(pLine + 10, "%d %d %d %d", &automatic,
+			&pEvent->mUpdateStoreInterval,
+			&pEvent->mMinimumFileAge,
+			&pEvent->mMaxUploadWait) != 4)
+		{
+			pEvent->mType = CommandSocketEvent::CSE_MALFORMED;
+		}
+		else
+		{
+			pEvent->mType = CommandSocketEvent::CSE_SUMMARY;
+			pEvent->mAutomaticBackup = (automatic != 0);
+		}
+	}
+	else if (IS(pLine, length, "ok"))
+	{
+		pEvent->mType = CommandSocketEvent::CSE_OK;
+	}
+	else if (IS(pLine, length, "error"))
+	{
+		pEvent->mType = CommandSocketEvent::CSE_ERROR;
+	}
+	else if (STARTS_WITH(pLine, length, "state "))
+	{
+		pEvent->mType = ParseInt(pLine + 6, &pEvent->mState)
+			? CommandSocketEvent::CSE_STATE
+			: CommandSocketEvent::CSE_MALFORMED;
+	}
+	else if (IS(pLine, length, "start-sync"))
+	{
+		pEvent->mType = CommandSocketEvent::CSE_SYNC_START;
+	}
+	else if (IS(pLine, length, "finish-sync"))
+	{
+		pEvent->mType = CommandSocketEvent::CSE_SYNC_FINISH;
+	}
+	else
+	{
+		pEvent->mType = CommandSocketEvent::CSE_UNKNOWN;
+	}
+
+	// The line is overwritten by the next one, so only the events
+	// that are never queued point to it
+	if (pEvent->mType == CommandSocketEvent::CSE_UNKNOWN ||
+		pEvent->mType == CommandSocketEvent::CSE_MALFORMED)
+	{
+		pEvent->mpText      = pLine;
+		pEvent->mTextLength = length;
+	}
+}
+
+#endif // !WIN32
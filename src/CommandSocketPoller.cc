@@ -0,0 +1,204 @@
+/***************************************************************************
+ *            CommandSocketPoller.cc
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+// poll() and pipes are only used for Unix command sockets
+#ifndef WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "CommandSocketClient.h"
+#include "CommandSocketPoller.h"
+
+CommandSocketPoller::CommandSocketPoller()
+: mWakeReadHandle(-1),
+  mWakeWriteHandle(-1)
+{
+	int handles[2];
+	if (::pipe(handles) != 0)
+	{
+		// Wait() still works, but only wakes up on its timeout
+		return;
+	}
+
+	mWakeReadHandle  = handles[0];
+	mWakeWriteHandle = handles[1];
+
+	for (int i = 0; i < 2; i++)
+	{
+		::fcntl(handles[i], F_SETFD, FD_CLOEXEC);
+		::fcntl(handles[i], F_SETFL,
+			::fcntl(handles[i], F_GETFL) | O_NONBLOCK);
+	}
+}
+
+CommandSocketPoller::~CommandSocketPoller()
+{
+	if (mWakeReadHandle != -1)
+	{
+		::close(mWakeReadHandle);
+		::close(mWakeWriteHandle);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketPoller::Wake()
+//		Purpose: Makes the current or next call to Wait() return
+//			 early. May be called from any thread, and any
+//			 number of times: however many calls are made while
+//			 Wait() isn't running, it only returns early once.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+void CommandSocketPoller::Wake()
+{
+	if (mWakeWriteHandle == -1)
+	{
+		return;
+	}
+
+	char wake = 0;
+	// if the pipe is full, Wait() is going to wake up anyway
+	while (::write(mWakeWriteHandle, &wake, 1) == -1 && errno == EINTR)
+	{ }
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CommandSocketPoller::Wait(
+//			 const std::vector<CommandSocketClient*>& rClients,
+//			 int timeoutMillis)
+//		Purpose: Waits for up to timeoutMillis milliseconds, or
+//			 forever if it's negative, for any of the connected
+//			 clients to become readable, or writable if they
+//			 have commands waiting to be sent, or for Wake() to
+//			 be called. Clients that aren't connected are
+//			 ignored. Each client that is ready has OnReadable()
+//			 or OnWritable() called on it before this returns.
+//			 Returns true if Wake() was called, false otherwise.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool CommandSocketPoller::Wait(
+	const std::vector<CommandSocketClient*>& rClients, int timeoutMillis)
+{
+	std::vector<struct pollfd> handles;
+	std::vector<CommandSocketClient*> polled;
+
+	struct pollfd handle;
+
+	if (mWakeReadHandle != -1)
+	{
+		handle.fd      = mWakeReadHandle;
+		handle.events  = POLLIN;
+		handle.revents = 0;
+		handles.push_back(handle);
+		polled.push_back(NULL);
+	}
+
+	for (std::vector<CommandSocketClient*>::const_iterator
+		i = rClients.begin(); i != rClients.end(); i++)
+	{
+		if (!(*i)->IsConnected())
+		{
+			continue;
+		}
+
+		handle.fd      = (*i)->GetFileHandle();
+		handle.events  = 0;
+		handle.revents = 0;
+
+		// not if it already has as many lines as it can hold
+		if ((*i)->WantsInput())
+		{
+			handle.events |= POLLIN;
+		}
+
+		if ((*i)->HasPendingOutput())
+		{
+			handle.events |= POLLOUT;
+		}
+
+		handles.push_back(handle);
+		polled.push_back(*i);
+	}
+
+	int result;
+	do
+	{
+		result = ::poll(handles.empty() ? NULL : &handles[0],
+			handles.size(), timeoutMillis);
+	}
+	while (result == -1 && errno == EINTR);
+
+	if (result <= 0)
+	{
+		return false;
+	}
+
+	bool woken = false;
+
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		short events = handles[i].revents;
+		if (events == 0)
+		{
+			continue;
+		}
+
+		CommandSocketClient* pClient = polled[i];
+
+		if (pClient == NULL)
+		{
+			char buffer[64];
+			while (::read(mWakeReadHandle, buffer, sizeof(buffer))
+				> 0)
+			{ }
+			woken = true;
+			continue;
+		}
+
+		if (events & POLLOUT)
+		{
+			pClient->OnWritable();
+		}
+
+		// a hangup may leave the daemon's last lines still to read
+		if (events & (POLLIN | POLLHUP | POLLERR | POLLNVAL))
+		{
+			pClient->OnReadable();
+		}
+	}
+
+	return woken;
+}
+
+#endif // !WIN32
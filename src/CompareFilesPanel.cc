@@ -40,9 +40,10 @@ class CompareTreeNode : public LocalFileNode
 	
 	public:
 	CompareTreeNode(CompareParams& rParams,   const wxString& path);
-	CompareTreeNode(CompareTreeNode* pParent, const wxString& path);
+	CompareTreeNode(CompareTreeNode* pParent, const wxString& path,
+		bool isDirectory);
 	virtual LocalFileNode* CreateChildNode(LocalFileNode* pParent, 
-		const wxString& rPath);
+		const wxString& rPath, bool isDirectory);
 
 	virtual int UpdateState(FileImageList& rImageList, bool updateParents);
 };
@@ -53,16 +54,18 @@ CompareTreeNode::CompareTreeNode(CompareParams& rParams, const wxString& path)
   mIconId       (-1)
 { }
 
-CompareTreeNode::CompareTreeNode(CompareTreeNode* pParent, const wxString& path) 
-: LocalFileNode (pParent, path),
+CompareTreeNode::CompareTreeNode(CompareTreeNode* pParent, const wxString& path,
+	bool isDirectory) 
+: LocalFileNode (pParent, path, isDirectory),
   mrParams      (pParent->mrParams),
   mIconId       (-1)
 { }
 
 LocalFileNode* CompareTreeNode::CreateChildNode(LocalFileNode* pParent, 
-	const wxString& rPath)
+	const wxString& rPath, bool isDirectory)
 {
-	return new CompareTreeNode((CompareTreeNode *)pParent, rPath);
+	return new CompareTreeNode((CompareTreeNode *)pParent, rPath,
+		isDirectory);
 }
 
 int CompareTreeNode::UpdateState(FileImageList& rImageList, bool updateParents) 
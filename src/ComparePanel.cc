@@ -25,10 +25,12 @@
 #include "SandBox.h"
 
 // #include <wx/arrstr.h>
+#include <wx/checkbox.h>
 #include <wx/dir.h>
 #include <wx/dirctrl.h>
 #include <wx/filename.h>
 #include <wx/notebook.h>
+#include <wx/spinctrl.h>
 #include <wx/splitter.h>
 
 #include "ComparePanel.h"
@@ -147,6 +149,63 @@ ComparePanel::ComparePanel
 	pSplitter->SplitVertically(mpDirLocalTree, mpDirRemoteTree);
 	pSplitter->SetMinimumPaneSize(20);
 	
+	wxStaticBoxSizer* pOptionsBox = new wxStaticBoxSizer(wxVERTICAL, this, 
+		_("Compare options"));
+	pMainSizer->Add(pOptionsBox, 0, wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+
+	mpQuickCompareCheck = new wxCheckBox(this, 
+		ID_Compare_Panel_Quick_Compare_Checkbox, 
+		_("Compare &block checksums only (don't download file contents)"));
+	pOptionsBox->Add(mpQuickCompareCheck, 0, wxGROW | wxALL, 8);
+	
+	wxSizer* pSampleSizer = new wxBoxSizer(wxHORIZONTAL);
+	pOptionsBox->Add(pSampleSizer, 0, wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+
+	mpSampleCheck = new wxCheckBox(this, ID_Compare_Panel_Sample_Checkbox, 
+		_("Compare only a random &sample of"));
+	pSampleSizer->Add(mpSampleCheck, 0, wxALIGN_CENTER, 0);
+
+	mpSamplePercentSpin = new wxSpinCtrl(this, 
+		ID_Compare_Panel_Sample_Percent_Spin, 
+		wxEmptyString, wxDefaultPosition, wxDefaultSize, 
+		wxSP_ARROW_KEYS, 1, 100, 5);
+	pSampleSizer->Add(mpSamplePercentSpin, 0, wxGROW | wxLEFT, 8);
+
+	pSampleSizer->Add(new wxStaticText(this, wxID_ANY, 
+		_("% of files, s&eed")), 0, wxALIGN_CENTER | wxLEFT, 4);
+
+	mpSampleSeedSpin = new wxSpinCtrl(this, 
+		ID_Compare_Panel_Sample_Seed_Spin, 
+		wxEmptyString, wxDefaultPosition, wxDefaultSize, 
+		wxSP_ARROW_KEYS, 0, 0x7FFFFFFF, 0);
+	pSampleSizer->Add(mpSampleSeedSpin, 0, wxGROW | wxLEFT, 8);
+	
+	wxSizer* pReportSizer = new wxBoxSizer(wxHORIZONTAL);
+	pOptionsBox->Add(pReportSizer, 0, wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+	
+	pReportSizer->Add(new wxStaticText(this, wxID_ANY, 
+		_("Write &report to:")), 0, wxALIGN_CENTER_VERTICAL, 0);
+
+	mpReportFileText = new wxTextCtrl(this, 
+		ID_Compare_Panel_Report_File_Text, wxEmptyString);
+	pReportSizer->Add(mpReportFileText, 1, wxGROW | wxLEFT, 8);
+	
+	FileSelButton* pReportFileButton = new FileSelButton(this, wxID_ANY,
+		mpReportFileText, 
+		_("JSON Lines files (*.jsonl)|*.jsonl|"
+			"CSV files (*.csv)|*.csv"),
+		wxT("jsonl"), _("Save Compare Report"));
+	pReportFileButton->SetFileMustExist(FALSE);
+	pReportSizer->Add(pReportFileButton, 0, wxGROW | wxLEFT, 4);
+	
+	mpReportFormatChoice = new wxChoice(this, 
+		ID_Compare_Panel_Report_Format_Choice);
+	// the order must match CompareReport::Format
+	mpReportFormatChoice->Append(_("JSON Lines"));
+	mpReportFormatChoice->Append(_("CSV"));
+	mpReportFormatChoice->SetSelection(0);
+	pReportSizer->Add(mpReportFormatChoice, 0, wxGROW | wxLEFT, 8);
+	
 	wxSizer* pActionCtrlSizer = new wxBoxSizer(wxHORIZONTAL);
 	pMainSizer->Add(pActionCtrlSizer, 0, 
 		wxALIGN_RIGHT | wxLEFT | wxRIGHT | wxBOTTOM, 8);
@@ -271,6 +330,15 @@ void ComparePanel::OnClickStartButton(wxCommandEvent& rEvent)
 	wxYield();
 	
 	BoxiCompareParams params;
+	params.SetQuickCompare(mpQuickCompareCheck->GetValue());
+	if (mpSampleCheck->GetValue())
+	{
+		params.SetSampleFraction(mpSamplePercentSpin->GetValue() / 100.0);
+		params.SetSampleSeed(mpSampleSeedSpin->GetValue());
+	}
+	params.SetReportFileName(mpReportFileText->GetValue());
+	params.SetReportFormat((CompareReport::Format)
+		mpReportFormatChoice->GetSelection());
 	mpProgressPanel->StartCompare(params);
 }
 
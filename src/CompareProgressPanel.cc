@@ -29,6 +29,10 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
 
 #include <wx/statbox.h>
 #include <wx/listbox.h>
@@ -39,12 +43,22 @@
 #include <wx/filename.h>
 
 #include "BackupQueries.h"
+#include "BackupStoreDirectory.h"
 #include "BackupStoreException.h"
+#include "BackupStoreFile.h"
+#include "BackupStoreFilenameClear.h"
+#include "CommonException.h"
+#include "FileStream.h"
 #include "TLSContext.h"
 #include "BoxBackupCompareParams.h"
 
 #include "main.h"
+#include "ClientConfig.h"
+#include "ComparePanel.h"
 #include "CompareProgressPanel.h"
+#include "CompareSampler.h"
+#include "ExcludeRules.h"
+#include "ReportingCompareParams.h"
 #include "ServerConnection.h"
 
 #include "BoxiApp.h"
@@ -54,7 +68,13 @@
 //DECLARE_EVENT_TYPE(myEVT_CLIENT_NOTIFY, -1)
 //DEFINE_EVENT_TYPE(myEVT_CLIENT_NOTIFY)
 
-class BoxiCompareParamsShim : public BoxBackupCompareParams,
+// Thrown through Box Backup's compare code by BoxiCompareParamsShim when
+// the user stops the compare. Deliberately not derived from
+// std::exception, so that the compare code doesn't catch it and report
+// it as a download failure.
+class CompareStoppedException { };
+
+class BoxiCompareParamsShim : public ReportingCompareParams,
 	public ProgressPanel::ExclusionOracle
 {
 	private:
@@ -62,143 +82,526 @@ class BoxiCompareParamsShim : public BoxBackupCompareParams,
 	
 	public:
 	BoxiCompareParamsShim(CompareProgressPanel* pProgress,
-		bool QuickCompare, bool IgnoreExcludes, bool IgnoreAttributes,
-		box_time_t LatestFileUploadTime)
-	: BoxBackupCompareParams(QuickCompare, IgnoreExcludes, IgnoreAttributes,
-		LatestFileUploadTime),
+		CompareReport* pReport, bool QuickCompare, bool IgnoreExcludes,
+		bool IgnoreAttributes, box_time_t LatestFileUploadTime)
+	: ReportingCompareParams(*pProgress, pReport, QuickCompare,
+		IgnoreExcludes, IgnoreAttributes, LatestFileUploadTime),
 	  mpProgress(pProgress)
 	{ }
 	
-	/*
-	BoxBackupCompareParams interface implementation, forwarding
-	events to CompareProgressPanel
-	*/
-	
-	virtual void NotifyLocalDirMissing(const std::string& rLocalPath,
+	virtual void NotifyDirComparing(const std::string& rLocalPath,
 		const std::string& rRemotePath)
 	{
-		mpProgress->NotifyLocalDirMissing(rLocalPath, rRemotePath);
+		CheckStopRequested();
+		ReportingCompareParams::NotifyDirComparing(rLocalPath,
+			rRemotePath);
 	}
-	
-	virtual void NotifyLocalDirAccessFailed(const std::string& rLocalPath,
+
+	virtual void NotifyFileComparing(const std::string& rLocalPath,
 		const std::string& rRemotePath)
 	{
-		mpProgress->NotifyLocalDirAccessFailed(rLocalPath, rRemotePath);
+		CheckStopRequested();
+		ReportingCompareParams::NotifyFileComparing(rLocalPath,
+			rRemotePath);
 	}
 
-	virtual void NotifyStoreDirMissingAttributes(
-		const std::string& rLocalPath, const std::string& rRemotePath)
+	/* ProgressPanel::ExclusionOracle interface implementation */
+	
+	virtual bool IsExcludedFile(const std::string& rFileName)
 	{
-		mpProgress->NotifyStoreDirMissingAttributes(rLocalPath,
-			rRemotePath);
+		return BoxBackupCompareParams::IsExcludedFile(rFileName);
 	}
-
-	virtual void NotifyRemoteFileMissing(const std::string& rLocalPath,
-		const std::string& rRemotePath,	bool modifiedAfterLastSync)
+	
+	virtual bool IsExcludedDir(const std::string& rDirName)
 	{
-		mpProgress->NotifyRemoteFileMissing(rLocalPath, rRemotePath,
-			modifiedAfterLastSync);
+		return BoxBackupCompareParams::IsExcludedDir(rDirName);
 	}
 
-	virtual void NotifyLocalFileMissing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
+	private:
+	// Called on the compare thread before each file and directory,
+	// which is between requests to the store, so abandoning the
+	// compare here leaves the connection usable.
+	void CheckStopRequested()
 	{
-		mpProgress->NotifyLocalFileMissing(rLocalPath, rRemotePath);
+		if (mpProgress->IsStopRequested())
+		{
+			throw CompareStoppedException();
+		}
 	}
+};
 
-	virtual void NotifyExcludedFileNotDeleted(const std::string& rLocalPath,
-		const std::string& rRemotePath)
+// Size of each read when comparing a sampled file with the store
+#define SAMPLE_COMPARE_BUFFER_SIZE 65536
+
+// Checks the contents of the files chosen for a sampled compare against
+// the store. Runs on the compare thread, and reports through the same
+// BoxBackupCompareParams callbacks as BackupQueries::CompareLocation.
+class SampleVerifier
+{
+	private:
+	BackupProtocolClient&   mrClient;
+	BoxBackupCompareParams& mrParams;
+	bool       mQuickCompare;
+	box_time_t mLatestFileUploadTime;
+	size_t     mNumVerified;
+	size_t     mNumDifferent;
+	
+	// Store directory IDs already looked up, by path (0 if missing),
+	// and the most recently listed directory. Samples are sorted by
+	// path, so most lookups hit one or the other.
+	std::map<std::string, int64_t> mDirectoryIds;
+	int64_t mListedDirectoryId;
+	std::auto_ptr<BackupStoreDirectory> mapListedDirectory;
+	
+	public:
+	SampleVerifier(BackupProtocolClient& rClient,
+		BoxBackupCompareParams& rParams, bool quickCompare,
+		box_time_t latestFileUploadTime)
+	: mrClient(rClient),
+	  mrParams(rParams),
+	  mQuickCompare(quickCompare),
+	  mLatestFileUploadTime(latestFileUploadTime),
+	  mNumVerified(0),
+	  mNumDifferent(0),
+	  mListedDirectoryId(0)
+	{ }
+	
+	size_t GetNumVerified()  { return mNumVerified; }
+	size_t GetNumDifferent() { return mNumDifferent; }
+	
+	void VerifyLocation(const std::string& rLocationName,
+		const std::string& rLocalRoot,
+		const CompareSampler::Sample::Vector& rSamples)
 	{
-		mpProgress->NotifyExcludedFileNotDeleted(rLocalPath,
-			rRemotePath);
+		for (CompareSampler::Sample::ConstIterator i = rSamples.begin();
+			i != rSamples.end(); i++)
+		{
+			VerifyFile(rLocationName, rLocalRoot, *i);
+		}
 	}
 	
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		BoxException& rException)
+	private:
+	BackupStoreDirectory& ListDirectory(int64_t directoryId)
 	{
-		mpProgress->NotifyDownloadFailed(rLocalPath, rRemotePath,
-			NumBytes, rException);
+		if (mapListedDirectory.get() && 
+			mListedDirectoryId == directoryId)
+		{
+			return *mapListedDirectory;
+		}
+		
+		mapListedDirectory.reset();
+		mrClient.QueryListDirectory(directoryId,
+			BackupProtocolListDirectory::Flags_INCLUDE_EVERYTHING,
+			BackupProtocolListDirectory::Flags_Deleted |
+			BackupProtocolListDirectory::Flags_OldVersion,
+			false /* no attributes */);
+		std::auto_ptr<IOStream> apStream(mrClient.ReceiveStream());
+		
+		mapListedDirectory.reset(new BackupStoreDirectory);
+		mapListedDirectory->ReadFromStream(*apStream,
+			mrClient.GetTimeout());
+		mListedDirectoryId = directoryId;
+		return *mapListedDirectory;
 	}
-
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		std::exception& rException)
+	
+	// Returns the ID of a store directory, given its path such as
+	// "/location/sub/dir", or 0 if it doesn't exist.
+	int64_t FindDirectory(const std::string& rStorePath)
 	{
-		mpProgress->NotifyDownloadFailed(rLocalPath, rRemotePath,
-			NumBytes, rException);
+		if (rStorePath.empty())
+		{
+			return BackupProtocolListDirectory::RootDirectory;
+		}
+		
+		std::map<std::string, int64_t>::iterator i =
+			mDirectoryIds.find(rStorePath);
+		if (i != mDirectoryIds.end())
+		{
+			return i->second;
+		}
+		
+		std::string::size_type slash = rStorePath.rfind('/');
+		int64_t parentId = FindDirectory(rStorePath.substr(0, slash));
+		int64_t id = 0;
+		
+		if (parentId != 0)
+		{
+			BackupStoreDirectory::Iterator entries(
+				ListDirectory(parentId));
+			BackupStoreFilenameClear name(
+				rStorePath.substr(slash + 1));
+			BackupStoreDirectory::Entry* pEntry =
+				entries.FindMatchingClearName(name,
+					BackupStoreDirectory::Entry::Flags_Dir);
+			if (pEntry)
+			{
+				id = pEntry->GetObjectID();
+			}
+		}
+		
+		mDirectoryIds[rStorePath] = id;
+		return id;
 	}
-
-	virtual void NotifyDownloadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes)
+	
+	bool CompareContents(FileStream& rLocalFile, 
+		const std::string& rLocalPath, int64_t directoryId,
+		int64_t fileId)
+	{
+		if (mQuickCompare)
+		{
+			mrClient.QueryGetBlockIndexByID(fileId);
+			std::auto_ptr<IOStream> apIndex(mrClient.ReceiveStream());
+			return BackupStoreFile::CompareFileContentsAgainstBlockIndex(
+				rLocalPath.c_str(), *apIndex, mrClient.GetTimeout());
+		}
+		
+		mrClient.QueryGetFile(directoryId, fileId);
+		std::auto_ptr<IOStream> apObject(mrClient.ReceiveStream());
+		std::auto_ptr<BackupStoreFile::DecodedStream> apRemote(
+			BackupStoreFile::DecodeFileStream(*apObject,
+				mrClient.GetTimeout()));
+		
+		std::vector<char> remoteBuffer(SAMPLE_COMPARE_BUFFER_SIZE);
+		std::vector<char> localBuffer (SAMPLE_COMPARE_BUFFER_SIZE);
+		bool equal = true;
+		
+		// Always read the whole remote stream, even after finding
+		// a difference, to keep the protocol in step.
+		while (apRemote->StreamDataLeft())
+		{
+			int remoteBytes = apRemote->Read(&remoteBuffer[0],
+				remoteBuffer.size(), mrClient.GetTimeout());
+			if (!equal || remoteBytes == 0)
+			{
+				continue;
+			}
+			
+			int localBytes = 0;
+			if (!rLocalFile.ReadFullBuffer(&localBuffer[0],
+				remoteBytes, &localBytes) ||
+				::memcmp(&localBuffer[0], &remoteBuffer[0],
+					remoteBytes) != 0)
+			{
+				equal = false;
+			}
+		}
+		
+		if (equal)
+		{
+			// local file must not be any longer
+			char extra;
+			if (rLocalFile.Read(&extra, 1) != 0)
+			{
+				equal = false;
+			}
+		}
+		
+		return equal;
+	}
+	
+	void VerifyFile(const std::string& rLocationName,
+		const std::string& rLocalRoot,
+		const CompareSampler::Sample& rSample)
 	{
-		mpProgress->NotifyDownloadFailed(rLocalPath, rRemotePath,
-			NumBytes);
+		std::string localPath = rLocalRoot + DIRECTORY_SEPARATOR + 
+			rSample.mRelativePath;
+		
+		std::string storePath = "/" + rLocationName + "/" +
+			rSample.mRelativePath;
+		std::replace(storePath.begin(), storePath.end(),
+			DIRECTORY_SEPARATOR_ASCHAR, '/');
+		
+		bool modifiedAfterLastSync = 
+			SecondsToBoxTime(rSample.mModTime) > mLatestFileUploadTime;
+		
+		mrParams.NotifyFileComparing(localPath, storePath);
+		mNumVerified++;
+		
+		std::string::size_type slash = storePath.rfind('/');
+		int64_t directoryId = FindDirectory(storePath.substr(0, slash));
+		int64_t fileId = 0;
+		
+		if (directoryId != 0)
+		{
+			BackupStoreDirectory::Iterator entries(
+				ListDirectory(directoryId));
+			BackupStoreFilenameClear name(storePath.substr(slash + 1));
+			BackupStoreDirectory::Entry* pEntry =
+				entries.FindMatchingClearName(name,
+					BackupStoreDirectory::Entry::Flags_File);
+			if (pEntry)
+			{
+				fileId = pEntry->GetObjectID();
+			}
+		}
+		
+		if (fileId == 0)
+		{
+			mNumDifferent++;
+			mrParams.NotifyRemoteFileMissing(localPath, storePath,
+				modifiedAfterLastSync);
+			return;
+		}
+		
+		// Open the local file before asking the store for anything,
+		// so that a failure here doesn't leave a stream unread.
+		std::auto_ptr<FileStream> apLocalFile;
+		try
+		{
+			apLocalFile.reset(new FileStream(localPath.c_str()));
+		}
+		catch (std::exception& e)
+		{
+			mNumDifferent++;
+			mrParams.NotifyLocalFileReadFailed(localPath, storePath,
+				rSample.mSize, e);
+			return;
+		}
+		
+		try
+		{
+			bool equal = CompareContents(*apLocalFile, localPath,
+				directoryId, fileId);
+			if (!equal)
+			{
+				mNumDifferent++;
+			}
+			mrParams.NotifyFileCompared(localPath, storePath,
+				rSample.mSize, false, !equal, modifiedAfterLastSync,
+				false);
+		}
+		catch (BoxException& e)
+		{
+			mNumDifferent++;
+			mrParams.NotifyDownloadFailed(localPath, storePath,
+				rSample.mSize, e);
+		}
+		catch (std::exception& e)
+		{
+			mNumDifferent++;
+			mrParams.NotifyDownloadFailed(localPath, storePath,
+				rSample.mSize, e);
+		}
 	}
+};
 
-	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		std::exception& rException)
+// Runs BackupQueries::CompareLocation for each location away from the
+// GUI thread, or verifies the chosen files for a sampled compare.
+// Results come back through the panel's ring buffer, via the
+// BoxiCompareParamsShim callbacks.
+class CompareWorkerThread : public wxThread
+{
+	public:
+	typedef enum
 	{
-		mpProgress->NotifyLocalFileReadFailed(rLocalPath, rRemotePath,
-			NumBytes, rException);
+		CWE_NONE = 0,
+		CWE_STOPPED,
+		CWE_CONNECTION,
+		CWE_EXCEPTION,
+		CWE_UNKNOWN,
 	}
-
-	virtual void NotifyLocalFileReadFailed(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes)
+	Error;
+	
+	private:
+	CompareProgressPanel* mpPanel;
+	BackupQueries& mrQueries;
+	BoxiCompareParamsShim& mrParams;
+	const std::vector<std::string>& mrLocNames;
+	SampleVerifier* mpVerifier;
+	const std::vector<std::string>* mpLocalRoots;
+	const std::vector<CompareSampler::Sample::Vector>* mpSamples;
+	Error mError;
+	std::string mErrorMessage;
+	
+	public:
+	CompareWorkerThread(CompareProgressPanel* pPanel,
+		BackupQueries& rQueries, BoxiCompareParamsShim& rParams,
+		const std::vector<std::string>& rLocNames)
+	: wxThread(wxTHREAD_JOINABLE),
+	  mpPanel(pPanel),
+	  mrQueries(rQueries),
+	  mrParams(rParams),
+	  mrLocNames(rLocNames),
+	  mpVerifier(NULL),
+	  mpLocalRoots(NULL),
+	  mpSamples(NULL),
+	  mError(CWE_NONE)
+	{ }
+	
+	// Verify only the given samples, one vector per location,
+	// instead of comparing everything.
+	void SetSamples(SampleVerifier* pVerifier,
+		const std::vector<std::string>* pLocalRoots,
+		const std::vector<CompareSampler::Sample::Vector>* pSamples)
 	{
-		mpProgress->NotifyLocalFileReadFailed(rLocalPath, rRemotePath,
-			NumBytes);
+		mpVerifier   = pVerifier;
+		mpLocalRoots = pLocalRoots;
+		mpSamples    = pSamples;
 	}
+	
+	Error GetError() { return mError; }
+	const std::string& GetErrorMessage() { return mErrorMessage; }
+	
+	virtual void* Entry()
+	{
+		try
+		{
+			for(size_t i = 0; i < mrLocNames.size(); i++)
+			{
+				if (mpVerifier)
+				{
+					mpVerifier->VerifyLocation(mrLocNames[i],
+						(*mpLocalRoots)[i],
+						(*mpSamples)[i]);
+				}
+				else
+				{
+					mrQueries.CompareLocation(mrLocNames[i],
+						mrParams);
+				}
+			}
+		}
+		catch (CompareStoppedException&)
+		{
+			mError = CWE_STOPPED;
+		}
+		catch (ConnectionException& e)
+		{
+			mError = CWE_CONNECTION;
+			mErrorMessage = e.what();
+		}
+		catch (std::exception& e)
+		{
+			mError = CWE_EXCEPTION;
+			mErrorMessage = e.what();
+		}
+		catch (...)
+		{
+			mError = CWE_UNKNOWN;
+		}
+		
+		mpPanel->NotifyWorkerFinished();
+		return NULL;
+	}
+};
 
-	virtual void NotifyExcludedFile(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{ mpProgress->NotifyExcludedFile(rLocalPath, rRemotePath); }
-
-	virtual void NotifyExcludedDir(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{ mpProgress->NotifyExcludedDir(rLocalPath, rRemotePath); }
+// Makes sure that the compare thread is stopped and joined before
+// anything that it uses goes out of scope, even if the GUI thread
+// leaves StartCompare() with an exception.
+class CompareWorkerWaiter
+{
+	private:
+	CompareProgressPanel* mpPanel;
+	CompareWorkerThread& mrWorker;
+	bool mRunning;
 
-	virtual void NotifyDirComparing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{ mpProgress->NotifyDirComparing(rLocalPath, rRemotePath); }
+	public:
+	CompareWorkerWaiter(CompareProgressPanel* pPanel,
+		CompareWorkerThread& rWorker)
+	: mpPanel(pPanel),
+	  mrWorker(rWorker),
+	  mRunning(false)
+	{ }
 
-	virtual void NotifyDirCompared(const std::string& rLocalPath,
-		const std::string& rRemotePath,	bool HasDifferentAttributes,
-		bool modifiedAfterLastSync)
+	~CompareWorkerWaiter()
 	{
-		mpProgress->NotifyDirCompared(rLocalPath, rRemotePath,
-			HasDifferentAttributes, modifiedAfterLastSync);
+		if (mRunning)
+		{
+			mpPanel->RequestStop();
+			Wait();
+		}
 	}
-	
-	virtual void NotifyFileComparing(const std::string& rLocalPath,
-		const std::string& rRemotePath)
-	{ mpProgress->NotifyFileComparing(rLocalPath, rRemotePath); }
-	
-	virtual void NotifyFileCompared(const std::string& rLocalPath,
-		const std::string& rRemotePath, int64_t NumBytes,
-		bool HasDifferentAttributes, bool HasDifferentContents,
-		bool modifiedAfterLastSync, bool newAttributesApplied)
+
+	void SetRunning() { mRunning = true; }
+
+	void Wait()
 	{
-		mpProgress->NotifyFileCompared(rLocalPath, rRemotePath,
-			NumBytes, HasDifferentAttributes, HasDifferentContents,
-			modifiedAfterLastSync, newAttributesApplied);
+		mrWorker.Wait();
+		mRunning = false;
 	}
+};
 
-	/* ProgressPanel::ExclusionOracle interface implementation */
-	
-	virtual bool IsExcludedFile(const std::string& rFileName)
+// Disables the other pages of the notebook that the panel is on, for
+// as long as it exists. They all share the panel's connection to the
+// store, so while the compare thread is using it, the user mustn't be
+// able to start anything else on it from inside a wxYield().
+class SiblingPanelsDisabler
+{
+	private:
+	std::vector<wxWindow*> mDisabled;
+
+	public:
+	SiblingPanelsDisabler(wxWindow* pPanel)
 	{
-		return BoxBackupCompareParams::IsExcludedFile(rFileName);
+		wxWindow* pParent = pPanel->GetParent();
+		if (!pParent)
+		{
+			return;
+		}
+
+		for (wxWindowList::compatibility_iterator
+			pNode = pParent->GetChildren().GetFirst();
+			pNode; pNode = pNode->GetNext())
+		{
+			wxWindow* pSibling = pNode->GetData();
+			if (pSibling != pPanel && pSibling->IsEnabled())
+			{
+				pSibling->Disable();
+				mDisabled.push_back(pSibling);
+			}
+		}
 	}
-	
-	virtual bool IsExcludedDir(const std::string& rDirName)
+
+	~SiblingPanelsDisabler()
 	{
-		return BoxBackupCompareParams::IsExcludedDir(rDirName);
+		for (std::vector<wxWindow*>::iterator i = mDisabled.begin();
+			i != mDisabled.end(); i++)
+		{
+			(*i)->Enable();
+		}
 	}
 };
 
-BEGIN_EVENT_TABLE(CompareProgressPanel, wxPanel)
+// Maximum number of results queued between the compare thread and the
+// GUI thread. The compare thread waits when the ring is full.
+static const size_t COMPARE_RESULTS_RING_SIZE = 4096;
+
+// Interval between flushes of queued results to the user interface
+static const long COMPARE_RESULTS_FLUSH_MILLIS = 200;
+
+CompareDifferencesList::CompareDifferencesList(wxWindow* pParent,
+	wxWindowID id)
+: wxListCtrl(pParent, id, wxDefaultPosition, wxDefaultSize,
+	wxLC_REPORT | wxLC_VIRTUAL | wxLC_NO_HEADER | wxLC_SINGLE_SEL)
+{
+	// virtual list controls can't autosize columns
+	InsertColumn(0, _("Difference"), wxLIST_FORMAT_LEFT, 2000);
+}
+
+void CompareDifferencesList::Clear()
+{
+	mMessages.Clear();
+	SetItemCount(0);
+	Refresh();
+}
+
+void CompareDifferencesList::Append(const wxArrayString& rMessages)
+{
+	for (size_t i = 0; i < rMessages.GetCount(); i++)
+	{
+		mMessages.Add(rMessages[i]);
+	}
+	
+	SetItemCount(mMessages.GetCount());
+	Refresh();
+}
+
+wxString CompareDifferencesList::OnGetItemText(long item, long column) const
+{
+	return mMessages[item];
+}
+
+BEGIN_EVENT_TABLE(CompareProgressPanel, ProgressPanel)
 	EVT_BUTTON(wxID_CANCEL, CompareProgressPanel::OnStopCloseClicked)
 END_EVENT_TABLE()
 
@@ -212,8 +615,129 @@ CompareProgressPanel::CompareProgressPanel
   mpConfig(pConfig),
   mpConnection(pConnection),
   mCompareRunning(false),
-  mCompareStopRequested(false)
+  mCompareStopRequested(false),
+  mResultsMutex(),
+  mResultsCondition(mResultsMutex),
+  mResultsRing(COMPARE_RESULTS_RING_SIZE),
+  mResultsHead(0),
+  mResultsCount(0),
+  mPendingFilesDone(0),
+  mPendingBytesDone(0),
+  mWorkerFinished(false)
 {
+	wxStaticBoxSizer* pDifferencesBox = new wxStaticBoxSizer(wxVERTICAL,
+		this, _("Differences"));
+	GetSizer()->Insert(2, pDifferencesBox, 1,
+		wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+
+	mpDifferencesList = new CompareDifferencesList(this,
+		ID_Compare_Differences_List);
+	pDifferencesBox->Add(mpDifferencesList, 1, wxGROW | wxALL, 4);
+}
+
+void CompareProgressPanel::AddDifference(const wxString& rMessage)
+{
+	wxMutexLocker lock(mResultsMutex);
+
+	while (mResultsCount == mResultsRing.size())
+	{
+		if (mCompareStopRequested)
+		{
+			// The GUI thread may be waiting for us to finish,
+			// rather than draining the ring, so don't wait
+			// for space. Nobody will read this message anyway.
+			return;
+		}
+
+		// Ring is full. Wake up the GUI thread to drain it,
+		// and wait until it has done so.
+		mResultsCondition.Broadcast();
+		mResultsCondition.Wait();
+	}
+	
+	// take a deep copy, as wxString is not thread-safe
+	size_t index = (mResultsHead + mResultsCount) % mResultsRing.size();
+	mResultsRing[index] = rMessage.c_str();
+	mResultsCount++;
+}
+
+// Ask the compare thread to stop at the next file or directory. Called
+// on the GUI thread.
+void CompareProgressPanel::RequestStop()
+{
+	wxMutexLocker lock(mResultsMutex);
+	mCompareStopRequested = true;
+	
+	// release the compare thread if it was waiting for space
+	mResultsCondition.Broadcast();
+}
+
+void CompareProgressPanel::NotifyWorkerFinished()
+{
+	wxMutexLocker lock(mResultsMutex);
+	mWorkerFinished = true;
+	mResultsCondition.Broadcast();
+}
+
+// Wait until the ring is full, the compare thread has finished, or the
+// timeout expires. Returns false if the compare thread has finished.
+bool CompareProgressPanel::WaitForResults(long timeoutMillis)
+{
+	wxMutexLocker lock(mResultsMutex);
+	
+	if (!mWorkerFinished && mResultsCount < mResultsRing.size())
+	{
+		mResultsCondition.WaitTimeout(timeoutMillis);
+	}
+	
+	return !mWorkerFinished;
+}
+
+// Move everything queued by the compare thread into the user interface,
+// in a single batch. Must be called on the GUI thread.
+void CompareProgressPanel::FlushResults()
+{
+	wxArrayString batch;
+	size_t  filesDone;
+	int64_t bytesDone;
+	wxString currentAction;
+	
+	{
+		wxMutexLocker lock(mResultsMutex);
+
+		batch.Alloc(mResultsCount);
+		for (; mResultsCount > 0; mResultsCount--)
+		{
+			batch.Add(mResultsRing[mResultsHead].c_str());
+			mResultsRing[mResultsHead] = wxEmptyString;
+			mResultsHead = (mResultsHead + 1) % mResultsRing.size();
+		}
+		
+		filesDone = mPendingFilesDone;
+		bytesDone = mPendingBytesDone;
+		mPendingFilesDone = 0;
+		mPendingBytesDone = 0;
+		
+		currentAction = mCurrentAction.c_str();
+		
+		// release the compare thread if it was waiting for space
+		mResultsCondition.Broadcast();
+	}
+	
+	if (batch.GetCount() > 0)
+	{
+		mpDifferencesList->Append(batch);
+	}
+	
+	if (!currentAction.IsEmpty())
+	{
+		SetCurrentText(currentAction);
+	}
+	
+	if (filesDone > 0 || bytesDone > 0)
+	{
+		NotifyMoreFilesDone(filesDone, bytesDone);
+	}
 }
 
 wxFileName MakeLocalPath(wxFileName& base, ServerCacheNode* pTargetNode);
@@ -222,11 +746,36 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 {
 	LogToListBox logTo(mpErrorList);
 	mpErrorList->Clear();
+	mpDifferencesList->Clear();
 
 	ResetCounters();
 	
+	if (!rParams.GetReportFileName().IsEmpty())
+	{
+		mapReport.reset(new CompareReport(rParams.GetReportFormat()));
+		
+		if (!mapReport->Open(std::string(rParams.GetReportFileName()
+			.mb_str(wxConvBoxi))))
+		{
+			wxString error =
+				ReportingCompareParams::GetNativeErrorMessage();
+			wxString msg;
+			msg.Printf(_("Error: cannot start compare: "
+				"failed to open report file '%s': %s"),
+				rParams.GetReportFileName().c_str(),
+				error.c_str());
+			mapReport.reset();
+			SetSummaryText(_("Compare Failed"));
+			ReportFatalError(BM_COMPARE_FAILED_CANNOT_OPEN_REPORT, msg);
+			StopTiming();
+			SetStopButtonLabel(_("Close"));
+			return;
+		}
+	}
+
 	mCompareRunning = true;
 	mCompareStopRequested = false;
+	RunHistory::Run run(RunHistory::RK_COMPARE);
 	SetSummaryText(_("Starting Compare"));
 	SetStopButtonLabel(_("Stop Compare"));
 
@@ -251,7 +800,12 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 			
 		BackupQueries queries(*pClient,	BoxConfig, false);
 		
-		BoxiCompareParamsShim BBParams(this, false, false, false,
+		// A quick compare fetches only the block index of each file
+		// from the store and checks the local file against it, block
+		// by block. Any mismatch is reported as a content difference
+		// without downloading the file itself.
+		BoxiCompareParamsShim BBParams(this, mapReport.get(),
+			rParams.IsQuickCompare(), false, false,
 			GetCurrentBoxTime() /* FIXME last backup time */);
 		const Configuration& rLocations(
 			BoxConfig.GetSubConfiguration("BackupLocations"));
@@ -259,6 +813,14 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 		std::vector<std::string> locNames =
 			rLocations.GetSubConfigurationNames();
 
+		// For a sampled compare, the files to verify in each
+		// location, and the location's local path
+		CompareSampler sampler(rParams.GetSampleSeed(), time(NULL));
+		std::vector<CompareSampler::Sample::Vector> samples;
+		std::vector<std::string> localRoots;
+		size_t  numSampledFiles = 0;
+		int64_t numSampledBytes = 0;
+
 		// Go through the records, counting files and bytes
 		for(std::vector<std::string>::iterator
 			pLocName  = locNames.begin();
@@ -268,7 +830,55 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 			const Configuration& rLocation(
 				rLocations.GetSubConfiguration(*pLocName));
 			BBParams.LoadExcludeLists(rLocation);
-			CountLocalFiles(BBParams, rLocation.GetKeyValue("Path"));
+
+			// Count and sample with the location's compiled rules,
+			// shared with the locations tree, rather than Box
+			// Backup's copy, which is only needed for the compare
+			ExclusionOracle* pOracle = &BBParams;
+			std::auto_ptr<RulesExclusionOracle> apRulesOracle;
+			BoxiLocation* pBoxiLocation = mpConfig->GetLocation(
+				wxString(pLocName->c_str(), wxConvBoxi));
+			if (pBoxiLocation)
+			{
+				apRulesOracle.reset(new RulesExclusionOracle(
+					pBoxiLocation->GetExcludeList().GetRules()));
+				pOracle = apRulesOracle.get();
+			}
+			
+			std::string localRoot = rLocation.GetKeyValue("Path");
+			size_t numFilesBefore = GetNumFilesTotal();
+			CountLocalFiles(*pOracle, localRoot);
+			
+			if (rParams.IsSampled())
+			{
+				SetSummaryText(_("Choosing files to compare"));
+				size_t numSamples = CompareSampler::GetSampleSize(
+					GetNumFilesTotal() - numFilesBefore,
+					rParams.GetSampleFraction(),
+					rParams.GetSampleCount());
+
+				samples.push_back(CompareSampler::Sample::Vector());
+				sampler.SampleLocation(*pOracle, localRoot,
+					numSamples, samples.back());
+				localRoots.push_back(localRoot);
+
+				for (CompareSampler::Sample::ConstIterator
+					i  = samples.back().begin();
+					i != samples.back().end(); i++)
+				{
+					numSampledFiles++;
+					numSampledBytes += i->mSize;
+				}
+			}
+		}
+		
+		// Only the sampled files will be compared, so show
+		// progress relative to those.
+		size_t population = GetNumFilesTotal();
+		if (rParams.IsSampled())
+		{
+			ResetCounters();
+			NotifyMoreFilesCounted(numSampledFiles, numSampledBytes);
 		}
 		
 		mpProgressGauge->SetRange(GetNumFilesTotal());
@@ -278,16 +888,119 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 		SetSummaryText(_("Comparing files"));
 		wxYield();
 
-		for(std::vector<std::string>::iterator
-			pLocName  = locNames.begin();
-			pLocName != locNames.end();
-			pLocName++)
+		// Compare on a separate thread, so that the time spent
+		// updating the user interface doesn't depend on the number
+		// of differences found. Results are flushed in batches.
+		mWorkerFinished = false;
+		CompareWorkerThread worker(this, queries, BBParams, locNames);
+		SampleVerifier verifier(*pClient, BBParams,
+			rParams.IsQuickCompare(), GetCurrentBoxTime());
+		if (rParams.IsSampled())
 		{
-			queries.CompareLocation(*pLocName, BBParams);
+			worker.SetSamples(&verifier, &localRoots, &samples);
 		}
 
-		SetSummaryText(_("Compare Finished"));
-		mpErrorList->Append(_("Compare Finished"));
+		// nothing else may use the connection until the worker
+		// has been joined, which the waiter does first
+		SiblingPanelsDisabler disabler(this);
+
+		// declared after everything that the worker uses, so that
+		// it's destroyed (and joins the worker) before them
+		CompareWorkerWaiter waiter(this, worker);
+
+		if (worker.Create() != wxTHREAD_NO_ERROR)
+		{
+			THROW_EXCEPTION(CommonException, Internal);
+		}
+
+		if (worker.Run() != wxTHREAD_NO_ERROR)
+		{
+			THROW_EXCEPTION(CommonException, Internal);
+		}
+
+		waiter.SetRunning();
+
+		while (WaitForResults(COMPARE_RESULTS_FLUSH_MILLIS))
+		{
+			FlushResults();
+			logTo.FlushQueued();
+			wxYield();
+		}
+		
+		waiter.Wait();
+		FlushResults();
+		logTo.FlushQueued();
+
+		switch (worker.GetError())
+		{
+			case CompareWorkerThread::CWE_NONE:
+			{
+				SetSummaryText(_("Compare Finished"));
+				mpErrorList->Append(_("Compare Finished"));
+				run.mResult = RunHistory::RR_SUCCEEDED;
+				
+				if (rParams.IsSampled())
+				{
+					double upperBound = CompareSampler::
+						GetDifferenceRateUpperBound(
+							verifier.GetNumVerified(),
+							verifier.GetNumDifferent(),
+							population);
+					wxString msg;
+					msg.Printf(_("Compared a sample of %d out "
+						"of %d files, of which %d differed. "
+						"With 95%% confidence, no more than "
+						"%.2f%% of all files differ."),
+						(int)verifier.GetNumVerified(),
+						(int)population,
+						(int)verifier.GetNumDifferent(),
+						upperBound * 100);
+					mpErrorList->Append(msg);
+				}
+			}
+			break;
+
+			case CompareWorkerThread::CWE_STOPPED:
+			{
+				SetSummaryText(_("Compare Stopped"));
+				mpErrorList->Append(_("Compare Stopped"));
+				run.mResult = RunHistory::RR_STOPPED;
+			}
+			break;
+
+			case CompareWorkerThread::CWE_CONNECTION:
+			{
+				SetSummaryText(_("Compare Failed"));
+				wxString msg;
+				msg.Printf(_("Error: cannot start compare: "
+					"Failed to connect to server: %s"),
+					wxString(worker.GetErrorMessage().c_str(),
+						wxConvBoxi).c_str());
+				ReportFatalError(BM_BACKUP_FAILED_CONNECT_FAILED,
+					msg);
+			}
+			break;
+
+			case CompareWorkerThread::CWE_EXCEPTION:
+			{
+				SetSummaryText(_("Compare Failed"));
+				wxString msg;
+				msg.Printf(_("Error: failed to finish compare: %s"),
+					wxString(worker.GetErrorMessage().c_str(),
+						wxConvBoxi).c_str());
+				ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR,
+					msg);
+			}
+			break;
+
+			default:
+			{
+				SetSummaryText(_("Compare Failed"));
+				ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR,
+					_("Error: failed to finish compare: "
+					"unknown error"));
+			}
+		}
 
 		mpProgressGauge->Hide();
 	}
@@ -302,11 +1015,21 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 	}
 	catch (std::exception& e) 
 	{
-		SetSummaryText(_("Compare Failed"));
-		wxString msg;
-		msg.Printf(_("Error: failed to finish compare: %s"),
-			wxString(e.what(), wxConvBoxi).c_str());
-		ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+		if (IsStopRequested())
+		{
+			// CountLocalFiles() throws when stopped
+			SetSummaryText(_("Compare Stopped"));
+			mpErrorList->Append(_("Compare Stopped"));
+			run.mResult = RunHistory::RR_STOPPED;
+		}
+		else
+		{
+			SetSummaryText(_("Compare Failed"));
+			wxString msg;
+			msg.Printf(_("Error: failed to finish compare: %s"),
+				wxString(e.what(), wxConvBoxi).c_str());
+			ReportFatalError(BM_BACKUP_FAILED_UNKNOWN_ERROR, msg);
+		}
 	}
 	catch (...)
 	{
@@ -315,8 +1038,23 @@ void CompareProgressPanel::StartCompare(const BoxiCompareParams& rParams)
 			_("Error: failed to finish compare: unknown error"));
 	}	
 	
+	// close the report file, if any, so that it's complete
+	if (mapReport.get() && !mapReport->Close())
+	{
+		wxString msg;
+		msg.Printf(_("Error: failed to write report file '%s': %s"),
+			rParams.GetReportFileName().c_str(),
+			wxString(strerror(mapReport->GetErrno()),
+				wxConvBoxi).c_str());
+		ReportFatalError(BM_COMPARE_FAILED_CANNOT_WRITE_REPORT, msg);
+		run.mResult = RunHistory::RR_FAILED;
+	}
+	mapReport.reset();
+	
 	SetSummaryText(_("Idle (nothing to do)"));
 	mCompareRunning = false;
 	mCompareStopRequested = false;
+	StopTiming();
+	RecordRun(mpConfig, run);
 	SetStopButtonLabel(_("Close"));
 }
@@ -0,0 +1,347 @@
+/***************************************************************************
+ *            CompareReport.cc
+ *
+ *  Sat Jan  3 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "CompareReport.h"
+
+CompareReport::CompareReport(Format format)
+: mFormat(format),
+  mpFile(NULL),
+  mErrno(0)
+{ }
+
+bool CompareReport::Open(const std::string& rFileName)
+{
+	Close();
+	mErrno = 0;
+
+	mpFile = ::fopen(rFileName.c_str(), "w");
+	if (mpFile == NULL)
+	{
+		return false;
+	}
+
+	if (mFormat == CRF_CSV)
+	{
+		::fputs("kind,local_path,remote_path,is_directory,size,"
+			"local_size,local_mtime,modified_after_last_sync,"
+			"detail\n", mpFile);
+		CheckWriteError();
+	}
+
+	return (mErrno == 0);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareReport::Close()
+//		Purpose: Flush and close the report file. Returns false if
+//			 any write to it failed, including buffered writes
+//			 which only fail when the file is closed, in which
+//			 case GetErrno() says why.
+//		Created: 2009/01/03
+//
+// --------------------------------------------------------------------------
+bool CompareReport::Close()
+{
+	if (mpFile == NULL)
+	{
+		return (mErrno == 0);
+	}
+
+	CheckWriteError();
+
+	if (::fclose(mpFile) != 0 && mErrno == 0)
+	{
+		mErrno = errno;
+	}
+
+	mpFile = NULL;
+	return (mErrno == 0);
+}
+
+// Remember the first failed write, as stdio may not report it again
+void CompareReport::CheckWriteError()
+{
+	if (mErrno == 0 && ::ferror(mpFile))
+	{
+		mErrno = (errno != 0) ? errno : EIO;
+	}
+}
+
+// Returns the length of the valid UTF-8 sequence starting at rValue[pos],
+// or 0 if the byte there doesn't start one. Overlong forms and surrogates
+// are not valid.
+static size_t GetUtf8SequenceLength(const std::string& rValue, size_t pos)
+{
+	unsigned char c = rValue[pos];
+	size_t length;
+	unsigned char min2 = 0x80, max2 = 0xBF;
+
+	if (c < 0x80)
+	{
+		return 1;
+	}
+	else if (c >= 0xC2 && c <= 0xDF)
+	{
+		length = 2;
+	}
+	else if (c >= 0xE0 && c <= 0xEF)
+	{
+		length = 3;
+		if (c == 0xE0) min2 = 0xA0;
+		if (c == 0xED) max2 = 0x9F;
+	}
+	else if (c >= 0xF0 && c <= 0xF4)
+	{
+		length = 4;
+		if (c == 0xF0) min2 = 0x90;
+		if (c == 0xF4) max2 = 0x8F;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (pos + length > rValue.size())
+	{
+		return 0;
+	}
+
+	unsigned char c2 = rValue[pos + 1];
+	if (c2 < min2 || c2 > max2)
+	{
+		return 0;
+	}
+
+	for (size_t i = 2; i < length; i++)
+	{
+		unsigned char cn = rValue[pos + i];
+		if (cn < 0x80 || cn > 0xBF)
+		{
+			return 0;
+		}
+	}
+
+	return length;
+}
+
+const char* CompareReport::GetKindName(Kind kind)
+{
+	switch (kind)
+	{
+		case CRK_LOCAL_DIR_MISSING:
+			return "local_dir_missing";
+		case CRK_LOCAL_DIR_ACCESS_FAILED:
+			return "local_dir_access_failed";
+		case CRK_STORE_DIR_MISSING_ATTRIBUTES:
+			return "store_dir_missing_attributes";
+		case CRK_REMOTE_FILE_MISSING:
+			return "remote_file_missing";
+		case CRK_LOCAL_FILE_MISSING:
+			return "local_file_missing";
+		case CRK_EXCLUDED_FILE_NOT_DELETED:
+			return "excluded_file_not_deleted";
+		case CRK_DOWNLOAD_FAILED:
+			return "download_failed";
+		case CRK_LOCAL_FILE_READ_FAILED:
+			return "local_file_read_failed";
+		case CRK_DIFFERENT_ATTRIBUTES:
+			return "different_attributes";
+		case CRK_DIFFERENT_CONTENTS:
+			return "different_contents";
+	}
+
+	return "unknown";
+}
+
+void CompareReport::WriteJsonString(const std::string& rValue)
+{
+	::fputc('"', mpFile);
+
+	for (size_t i = 0; i < rValue.size(); i++)
+	{
+		unsigned char c = rValue[i];
+		switch (c)
+		{
+			case '"':  ::fputs("\\\"", mpFile); break;
+			case '\\': ::fputs("\\\\", mpFile); break;
+			case '\n': ::fputs("\\n",  mpFile); break;
+			case '\r': ::fputs("\\r",  mpFile); break;
+			case '\t': ::fputs("\\t",  mpFile); break;
+			default:
+				if (c < 0x20)
+				{
+					::fprintf(mpFile, "\\u%04x", c);
+				}
+				else if (c < 0x80)
+				{
+					::fputc(c, mpFile);
+				}
+				else
+				{
+					size_t length = GetUtf8SequenceLength(
+						rValue, i);
+					if (length == 0)
+					{
+						// not UTF-8, write the raw
+						// byte as a code point
+						::fprintf(mpFile, "\\u%04x", c);
+					}
+					else
+					{
+						::fwrite(rValue.data() + i, 1,
+							length, mpFile);
+						i += length - 1;
+					}
+				}
+		}
+	}
+
+	::fputc('"', mpFile);
+}
+
+void CompareReport::WriteCsvString(const std::string& rValue)
+{
+	if (rValue.find_first_of(",\"\r\n") == std::string::npos)
+	{
+		::fputs(rValue.c_str(), mpFile);
+		return;
+	}
+
+	::fputc('"', mpFile);
+
+	for (std::string::const_iterator i = rValue.begin();
+		i != rValue.end(); i++)
+	{
+		if (*i == '"')
+		{
+			::fputc('"', mpFile);
+		}
+		::fputc(*i, mpFile);
+	}
+
+	::fputc('"', mpFile);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareReport::Add(Kind kind,
+//			 const std::string& rLocalPath,
+//			 const std::string& rRemotePath, bool isDirectory,
+//			 int64_t numBytes, bool modifiedAfterLastSync,
+//			 const std::string& rDetail)
+//		Purpose: Write one record to the report. The size and
+//			 modification time of the local file, if it exists,
+//			 are added to the record. numBytes is the size
+//			 reported by the compare, or -1 if not known.
+//		Created: 2009/01/03
+//
+// --------------------------------------------------------------------------
+void CompareReport::Add(Kind kind, const std::string& rLocalPath,
+	const std::string& rRemotePath, bool isDirectory,
+	int64_t numBytes, bool modifiedAfterLastSync,
+	const std::string& rDetail)
+{
+	if (mpFile == NULL || mErrno != 0)
+	{
+		return;
+	}
+
+	EMU_STRUCT_STAT st;
+	bool haveLocal = (EMU_LSTAT(rLocalPath.c_str(), &st) == 0);
+
+	if (mFormat == CRF_JSON_LINES)
+	{
+		::fprintf(mpFile, "{\"kind\":\"%s\",\"local_path\":",
+			GetKindName(kind));
+		WriteJsonString(rLocalPath);
+		::fputs(",\"remote_path\":", mpFile);
+		WriteJsonString(rRemotePath);
+		::fprintf(mpFile, ",\"is_directory\":%s",
+			isDirectory ? "true" : "false");
+
+		if (numBytes >= 0)
+		{
+			::fprintf(mpFile, ",\"size\":%lld",
+				(long long)numBytes);
+		}
+
+		if (haveLocal)
+		{
+			::fprintf(mpFile, ",\"local_size\":%lld"
+				",\"local_mtime\":%lld",
+				(long long)st.st_size, (long long)st.st_mtime);
+		}
+
+		::fprintf(mpFile, ",\"modified_after_last_sync\":%s",
+			modifiedAfterLastSync ? "true" : "false");
+
+		if (!rDetail.empty())
+		{
+			::fputs(",\"detail\":", mpFile);
+			WriteJsonString(rDetail);
+		}
+
+		::fputs("}\n", mpFile);
+	}
+	else
+	{
+		::fprintf(mpFile, "%s,", GetKindName(kind));
+		WriteCsvString(rLocalPath);
+		::fputc(',', mpFile);
+		WriteCsvString(rRemotePath);
+		::fprintf(mpFile, ",%d,", isDirectory ? 1 : 0);
+
+		if (numBytes >= 0)
+		{
+			::fprintf(mpFile, "%lld", (long long)numBytes);
+		}
+
+		if (haveLocal)
+		{
+			::fprintf(mpFile, ",%lld,%lld",
+				(long long)st.st_size, (long long)st.st_mtime);
+		}
+		else
+		{
+			::fputs(",,", mpFile);
+		}
+
+		::fprintf(mpFile, ",%d,", modifiedAfterLastSync ? 1 : 0);
+		WriteCsvString(rDetail);
+		::fputc('\n', mpFile);
+	}
+
+	CheckWriteError();
+}
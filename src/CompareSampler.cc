@@ -0,0 +1,333 @@
+/***************************************************************************
+ *            CompareSampler.cc
+ *
+ *  Sun Jan  4 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "CommonException.h"
+
+#include "CompareSampler.h"
+
+// Files modified within about this many seconds are favoured
+#define SAMPLE_RECENT_SECONDS (7 * 24 * 60 * 60)
+
+// Size in bytes at which a file's weight starts to grow
+#define SAMPLE_SIZE_UNIT 65536
+
+// z value for a 95% two-sided confidence interval
+#define SAMPLE_CONFIDENCE_Z 1.96
+
+// Orders samples so that the one with the smallest key is at the top
+// of a heap, ready to be replaced by a better candidate.
+static bool SampleKeyGreater(const CompareSampler::Sample& a,
+	const CompareSampler::Sample& b)
+{
+	return a.mKey > b.mKey;
+}
+
+static bool SamplePathLess(const CompareSampler::Sample& a,
+	const CompareSampler::Sample& b)
+{
+	return a.mRelativePath < b.mRelativePath;
+}
+
+CompareSampler::CompareSampler(uint32_t seed, time_t now)
+: mSeed(seed),
+  mNow(now)
+{ }
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareSampler::GetUniformRandom(
+//			 const std::string& rRelativePath)
+//		Purpose: Returns a pseudo-random number in (0, 1) which
+//			 depends only on the seed and the path. Uses FNV-1a
+//			 to hash the path, and the SplitMix64 finaliser to
+//			 spread the bits.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+double CompareSampler::GetUniformRandom(const std::string& rRelativePath)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL ^ mSeed;
+
+	for (std::string::const_iterator i = rRelativePath.begin();
+		i != rRelativePath.end(); i++)
+	{
+		hash ^= (unsigned char)*i;
+		hash *= 0x100000001b3ULL;
+	}
+
+	hash += 0x9e3779b97f4a7c15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+	hash =  hash ^ (hash >> 31);
+
+	// top 53 bits, offset by half a step so we never return 0 or 1
+	return ((double)(hash >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareSampler::GetWeight(int64_t size,
+//			 time_t modTime)
+//		Purpose: Returns the relative chance of choosing a file.
+//			 Grows with the logarithm of the file size, and is
+//			 up to four times higher for recently modified files.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+double CompareSampler::GetWeight(int64_t size, time_t modTime)
+{
+	double sizeWeight = 1.0 + log(1.0 + (double)size / SAMPLE_SIZE_UNIT);
+
+	double age = difftime(mNow, modTime);
+	if (age < 0)
+	{
+		age = 0;
+	}
+
+	double recentWeight = 1.0 + 3.0 * exp(-age / SAMPLE_RECENT_SECONDS);
+	return sizeWeight * recentWeight;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareSampler::SampleLocation(
+//			 ProgressPanel::ExclusionOracle& rExclusionOracle,
+//			 const std::string& rLocalRoot, size_t numSamples,
+//			 Sample::Vector& rSamples)
+//		Purpose: Walks the location once, choosing numSamples files
+//			 by weighted reservoir sampling (Efraimidis and
+//			 Spirakis). Only numSamples entries are held in
+//			 memory at once. The results are sorted by path, so
+//			 that files in the same directory are together.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+void CompareSampler::SampleLocation(
+	ProgressPanel::ExclusionOracle& rExclusionOracle,
+	const std::string& rLocalRoot, size_t numSamples,
+	Sample::Vector& rSamples)
+{
+	rSamples.clear();
+
+	if (numSamples == 0)
+	{
+		return;
+	}
+
+	rSamples.reserve(numSamples);
+	SampleDirectory(rExclusionOracle, rLocalRoot, "", numSamples,
+		rSamples);
+
+	// sort by path, for efficient lookups on the store
+	std::sort(rSamples.begin(), rSamples.end(), SamplePathLess);
+}
+
+void CompareSampler::SampleDirectory(
+	ProgressPanel::ExclusionOracle& rExclusionOracle,
+	const std::string& rLocalRoot, const std::string& rRelativeDir,
+	size_t numSamples, Sample::Vector& rHeap)
+{
+	std::string localDir = rLocalRoot;
+	if (!rRelativeDir.empty())
+	{
+		localDir += DIRECTORY_SEPARATOR + rRelativeDir;
+	}
+
+	DIR *dirHandle = ::opendir(localDir.c_str());
+	if (dirHandle == 0)
+	{
+		// Ignore this directory, as CountLocalFiles does.
+		return;
+	}
+
+	try
+	{
+		struct dirent *en = 0;
+		EMU_STRUCT_STAT st;
+
+		while ((en = ::readdir(dirHandle)) != 0)
+		{
+			if (en->d_name[0] == '.' &&
+				(en->d_name[1] == '\0' ||
+				(en->d_name[1] == '.' && en->d_name[2] == '\0')))
+			{
+				// ignore, it's . or ..
+				continue;
+			}
+
+			std::string relativePath = rRelativeDir.empty()
+				? std::string(en->d_name)
+				: rRelativeDir + DIRECTORY_SEPARATOR + en->d_name;
+			std::string localPath = rLocalRoot +
+				DIRECTORY_SEPARATOR + relativePath;
+
+			if (EMU_LSTAT(localPath.c_str(), &st) != 0)
+			{
+				continue;
+			}
+
+			int type = st.st_mode & S_IFMT;
+			if (type == S_IFDIR)
+			{
+				if (!rExclusionOracle.IsExcludedDir(localPath))
+				{
+					SampleDirectory(rExclusionOracle,
+						rLocalRoot, relativePath,
+						numSamples, rHeap);
+				}
+				continue;
+			}
+
+			// Symbolic links have no contents to compare
+			if (type != S_IFREG ||
+				rExclusionOracle.IsExcludedFile(localPath))
+			{
+				continue;
+			}
+
+			double key = log(GetUniformRandom(relativePath)) /
+				GetWeight(st.st_size, st.st_mtime);
+
+			if (rHeap.size() < numSamples)
+			{
+				rHeap.push_back(Sample(relativePath,
+					st.st_size, st.st_mtime, key));
+				std::push_heap(rHeap.begin(), rHeap.end(),
+					SampleKeyGreater);
+			}
+			else if (key > rHeap.front().mKey)
+			{
+				std::pop_heap(rHeap.begin(), rHeap.end(),
+					SampleKeyGreater);
+				rHeap.back() = Sample(relativePath,
+					st.st_size, st.st_mtime, key);
+				std::push_heap(rHeap.begin(), rHeap.end(),
+					SampleKeyGreater);
+			}
+		}
+	}
+	catch (...)
+	{
+		::closedir(dirHandle);
+		throw;
+	}
+
+	if (::closedir(dirHandle) != 0)
+	{
+		THROW_EXCEPTION(CommonException, OSFileError)
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareSampler::GetSampleSize(size_t population,
+//			 double fraction, size_t count)
+//		Purpose: Returns the number of files to sample from a
+//			 location: count if it's not zero, otherwise the
+//			 given fraction of the population, rounded up.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+size_t CompareSampler::GetSampleSize(size_t population, double fraction,
+	size_t count)
+{
+	size_t size = count;
+
+	if (size == 0)
+	{
+		size = (size_t)ceil(population * fraction);
+	}
+
+	if (size > population)
+	{
+		size = population;
+	}
+
+	return size;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    CompareSampler::GetDifferenceRateUpperBound(
+//			 size_t numSampled, size_t numDifferent,
+//			 size_t population)
+//		Purpose: Returns the upper end of the 95% Wilson score
+//			 interval for the fraction of files that differ,
+//			 with a finite population correction, so it drops
+//			 to the observed rate when every file was checked.
+//
+//			 The weighting picks the riskiest files more often,
+//			 so this tends to overstate the true rate.
+//		Created: 2009/01/04
+//
+// --------------------------------------------------------------------------
+double CompareSampler::GetDifferenceRateUpperBound(size_t numSampled,
+	size_t numDifferent, size_t population)
+{
+	if (numSampled == 0)
+	{
+		return 1.0;
+	}
+
+	double n = numSampled;
+	double p = numDifferent / n;
+	double z = SAMPLE_CONFIDENCE_Z;
+
+	double denominator = 1.0 + z * z / n;
+	double centre = (p + z * z / (2 * n)) / denominator;
+	double margin = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n))
+		/ denominator;
+
+	if (population > 1 && numSampled < population)
+	{
+		margin *= sqrt((double)(population - numSampled) /
+			(population - 1));
+		centre = p + (centre - p) *
+			sqrt((double)(population - numSampled) /
+			(population - 1));
+	}
+	else if (numSampled >= population)
+	{
+		return p;
+	}
+
+	double upper = centre + margin;
+	return (upper > 1.0) ? 1.0 : upper;
+}
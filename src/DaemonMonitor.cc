@@ -0,0 +1,401 @@
+/***************************************************************************
+ *            DaemonMonitor.cc
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+// The monitor talks to daemons over Unix command sockets
+#ifndef WIN32
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <wx/utils.h>
+
+#include "ClientConnection.h"
+#include "DaemonMonitor.h"
+
+// how often to try again to connect to a daemon that isn't running
+#define DAEMON_MONITOR_RETRY_MILLIS 5000
+// the longest the worker sleeps, even if nothing is due
+#define DAEMON_MONITOR_IDLE_MILLIS 60000
+
+DaemonMonitor::Status::Status()
+: mConnected(false),
+  mClientState(ClientConnection::CS_UNKNOWN),
+  mSyncing(false),
+  mLastSyncStarted(0),
+  mLastSyncFinished(0),
+  mNumSyncs(0),
+  mNumErrors(0)
+{ }
+
+DaemonMonitor::DaemonMonitor(Listener* pListener)
+: wxThread(wxTHREAD_JOINABLE),
+  mpListener(pListener),
+  mStarted(false),
+  mShutdownRequested(false),
+  mNotifyPending(false)
+{ }
+
+DaemonMonitor::~DaemonMonitor()
+{
+	if (mStarted)
+	{
+		{
+			wxMutexLocker lock(mMutex);
+			mShutdownRequested = true;
+		}
+		mPoller.Wake();
+		Wait();
+	}
+
+	for (std::vector<Daemon*>::iterator i = mDaemons.begin();
+		i != mDaemons.end(); i++)
+	{
+		delete *i;
+	}
+}
+
+// Daemons can only be added before Start() is called.
+void DaemonMonitor::AddDaemon(const std::string& rName,
+	const std::string& rSocketPath)
+{
+	assert(!mStarted);
+	Daemon* pDaemon = new Daemon();
+	pDaemon->mStatus.mName       = rName;
+	pDaemon->mStatus.mSocketPath = rSocketPath;
+	mDaemons.push_back(pDaemon);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    DaemonMonitor::AddDaemons(
+//			 const std::string& rListFileName)
+//		Purpose: Adds the daemons listed in a file, one per line,
+//			 each the path to a command socket, optionally after
+//			 a name for the daemon and a space. The name ends at
+//			 the first space, so the path may contain spaces but
+//			 the name can't. Blank lines and lines starting with
+//			 # are ignored. Returns false if the file can't be
+//			 read.
+//		Created: 2009/01/12
+//
+// --------------------------------------------------------------------------
+bool DaemonMonitor::AddDaemons(const std::string& rListFileName)
+{
+	FILE* pFile = ::fopen(rListFileName.c_str(), "r");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	char buffer[1024];
+	while (::fgets(buffer, sizeof(buffer), pFile) != NULL)
+	{
+		std::string line(buffer);
+
+		std::string::size_type start = line.find_first_not_of(" \t\r\n");
+		std::string::size_type end   = line.find_last_not_of(" \t\r\n");
+		if (start == std::string::npos || line[start] == '#')
+		{
+			continue;
+		}
+
+		line = line.substr(start, end - start + 1);
+
+		std::string::size_type space = line.find_first_of(" \t");
+		if (space == std::string::npos)
+		{
+			AddDaemon(line, line);
+		}
+		else
+		{
+			std::string::size_type path =
+				line.find_first_not_of(" \t", space);
+			AddDaemon(line.substr(0, space), line.substr(path));
+		}
+	}
+
+	bool ok = !::ferror(pFile);
+	::fclose(pFile);
+	return ok;
+}
+
+bool DaemonMonitor::Start()
+{
+	if (Create() != wxTHREAD_NO_ERROR || Run() != wxTHREAD_NO_ERROR)
+	{
+		return false;
+	}
+
+	mStarted = true;
+	return true;
+}
+
+// Returns a copy of the status of every daemon, in the order they
+// were added, and allows the listener to be notified again.
+void DaemonMonitor::GetStatus(std::vector<Status>* pStatus)
+{
+	wxMutexLocker lock(mMutex);
+	mNotifyPending = false;
+
+	pStatus->clear();
+	pStatus->reserve(mDaemons.size());
+
+	for (std::vector<Daemon*>::const_iterator i = mDaemons.begin();
+		i != mDaemons.end(); i++)
+	{
+		pStatus->push_back((*i)->mStatus);
+	}
+}
+
+void DaemonMonitor::NotifyChanged()
+{
+	{
+		wxMutexLocker lock(mMutex);
+		if (mNotifyPending)
+		{
+			return;
+		}
+		mNotifyPending = true;
+	}
+
+	if (mpListener)
+	{
+		mpListener->NotifyDaemonsChanged();
+	}
+}
+
+void* DaemonMonitor::Entry()
+{
+	std::vector<CommandSocketClient*> sockets;
+	for (std::vector<Daemon*>::iterator i = mDaemons.begin();
+		i != mDaemons.end(); i++)
+	{
+		sockets.push_back(&((*i)->mSocket));
+	}
+
+	while (true)
+	{
+		{
+			wxMutexLocker lock(mMutex);
+			if (mShutdownRequested)
+			{
+				break;
+			}
+		}
+
+		wxLongLong now = wxGetLocalTimeMillis();
+		wxLongLong next = now + DAEMON_MONITOR_IDLE_MILLIS;
+		bool changed = false;
+
+		for (std::vector<Daemon*>::iterator i = mDaemons.begin();
+			i != mDaemons.end(); i++)
+		{
+			Daemon* pDaemon = *i;
+
+			if (pDaemon->mSocketOpen && ProcessLines(pDaemon))
+			{
+				changed = true;
+			}
+
+			if (!pDaemon->mSocketOpen &&
+				now >= pDaemon->mNextConnectMillis)
+			{
+				if (Connect(pDaemon))
+				{
+					changed = true;
+				}
+			}
+
+			if (!pDaemon->mSocketOpen &&
+				pDaemon->mNextConnectMillis < next)
+			{
+				next = pDaemon->mNextConnectMillis;
+			}
+		}
+
+		if (changed)
+		{
+			NotifyChanged();
+		}
+
+		long waitMillis = 0;
+		if (next > now)
+		{
+			waitMillis = (next - now).ToLong();
+		}
+
+		mPoller.Wait(sockets, waitMillis);
+	}
+
+	for (std::vector<Daemon*>::iterator i = mDaemons.begin();
+		i != mDaemons.end(); i++)
+	{
+		(*i)->mSocket.Close();
+	}
+
+	return NULL;
+}
+
+// Tries to connect to a daemon that isn't connected, and returns true
+// if its status has changed.
+bool DaemonMonitor::Connect(Daemon* pDaemon)
+{
+	bool connected = pDaemon->mSocket.Connect(
+		pDaemon->mStatus.mSocketPath);
+	pDaemon->mSocketOpen = connected;
+	pDaemon->mNextConnectMillis = wxGetLocalTimeMillis() +
+		DAEMON_MONITOR_RETRY_MILLIS;
+
+	wxMutexLocker lock(mMutex);
+	Status& rStatus(pDaemon->mStatus);
+
+	if (connected)
+	{
+		pDaemon->mParser.Reset();
+		rStatus.mConnected = true;
+		rStatus.mConnectError.clear();
+		return true;
+	}
+
+	// Not counted as an error, as the daemon may just not be
+	// running, but worth showing if the reason has changed.
+	std::string error = strerror(pDaemon->mSocket.GetLastErrno());
+	if (error == rStatus.mConnectError)
+	{
+		return false;
+	}
+
+	rStatus.mConnectError = error;
+	return true;
+}
+
+// Handles everything that a daemon has sent since last time, and
+// notices if it's gone away. Returns true if its status has changed.
+bool DaemonMonitor::ProcessLines(Daemon* pDaemon)
+{
+	bool changed = false;
+	CommandSocketEvent event;
+
+	wxMutexLocker lock(mMutex);
+	Status& rStatus(pDaemon->mStatus);
+
+	while (pDaemon->mParser.GetEvent(&event))
+	{
+		if (HandleEvent(&rStatus, event))
+		{
+			changed = true;
+		}
+	}
+
+	if (!pDaemon->mSocket.IsConnected())
+	{
+		pDaemon->mSocketOpen = false;
+		pDaemon->mNextConnectMillis = wxGetLocalTimeMillis() +
+			DAEMON_MONITOR_RETRY_MILLIS;
+
+		rStatus.mConnected    = false;
+		rStatus.mConnectError = "Disconnected";
+		rStatus.mSyncing      = false;
+		rStatus.mClientState  = ClientConnection::CS_UNKNOWN;
+		changed = true;
+	}
+
+	return changed;
+}
+
+// Updates the status of a daemon with one thing that it sent. Called
+// with mMutex held. Returns true if anything changed.
+bool DaemonMonitor::HandleEvent(Status* pStatus,
+	const CommandSocketEvent& rEvent)
+{
+	switch (rEvent.mType)
+	{
+		case CommandSocketEvent::CSE_STATE:
+		{
+			int state = rEvent.mState;
+
+			if (state < ClientConnection::CS_INIT ||
+				state > ClientConnection::CS_STORELIMIT)
+			{
+				pStatus->mNumErrors++;
+				pStatus->mLastError = "Bad state from daemon";
+				return true;
+			}
+
+			if (state == pStatus->mClientState)
+			{
+				return false;
+			}
+
+			pStatus->mClientState = state;
+
+			if (state == ClientConnection::CS_ERROR)
+			{
+				pStatus->mNumErrors++;
+				pStatus->mLastError = "Sync failed";
+			}
+			else if (state == ClientConnection::CS_STORELIMIT)
+			{
+				pStatus->mNumErrors++;
+				pStatus->mLastError = "Store limit exceeded";
+			}
+
+			return true;
+		}
+
+		case CommandSocketEvent::CSE_SYNC_START:
+			pStatus->mSyncing = true;
+			pStatus->mLastSyncStarted = rEvent.mTime;
+			return true;
+
+		case CommandSocketEvent::CSE_SYNC_FINISH:
+			pStatus->mSyncing = false;
+			pStatus->mLastSyncFinished = rEvent.mTime;
+			pStatus->mNumSyncs++;
+			return true;
+
+		case CommandSocketEvent::CSE_ERROR:
+			pStatus->mNumErrors++;
+			pStatus->mLastError = "Command failed";
+			return true;
+
+		case CommandSocketEvent::CSE_MALFORMED:
+			pStatus->mNumErrors++;
+			pStatus->mLastError = "Bad response: " +
+				std::string(rEvent.mpText, rEvent.mTextLength);
+			return true;
+
+		default:
+			// "ok", the configuration summary, and anything
+			// that this version doesn't know about
+			return false;
+	}
+}
+
+#endif // !WIN32
@@ -0,0 +1,336 @@
+/***************************************************************************
+ *            DaemonMonitorFrame.cc
+ *
+ *  Mon Jan 12 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+// Only built where there is a DaemonMonitor
+#ifndef WIN32
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <wx/datetime.h>
+#include <wx/intl.h>
+#include <wx/log.h>
+
+#include "main.h"
+#include "ClientConnection.h"
+#include "DaemonMonitorFrame.h"
+
+DECLARE_EVENT_TYPE(myEVT_MONITOR_NOTIFY, -1)
+DEFINE_EVENT_TYPE(myEVT_MONITOR_NOTIFY)
+
+typedef enum
+{
+	DMC_NAME = 0,
+	DMC_STATUS,
+	DMC_SYNC_STARTED,
+	DMC_SYNC_FINISHED,
+	DMC_NUM_SYNCS,
+	DMC_NUM_ERRORS,
+	DMC_LAST_ERROR,
+}
+DaemonMonitorColumn;
+
+static wxString GetStatusString(const DaemonMonitor::Status& rStatus)
+{
+	if (!rStatus.mConnected)
+	{
+		if (rStatus.mConnectError.empty())
+		{
+			return _("Connecting");
+		}
+
+		wxString msg;
+		msg.Printf(_("Not connected: %s"),
+			wxString(rStatus.mConnectError.c_str(),
+				wxConvBoxi).c_str());
+		return msg;
+	}
+
+	if (rStatus.mSyncing)
+	{
+		return _("Syncing");
+	}
+
+	return mClientStateStrings[rStatus.mClientState + 2];
+}
+
+// Sorts daemons that need attention first: those whose last sync failed,
+// then those that aren't running, then the rest.
+static int GetStatusRank(const DaemonMonitor::Status& rStatus)
+{
+	if (rStatus.mClientState == ClientConnection::CS_ERROR ||
+		rStatus.mClientState == ClientConnection::CS_STORELIMIT)
+	{
+		return 0;
+	}
+
+	if (!rStatus.mConnected)
+	{
+		return 1;
+	}
+
+	if (rStatus.mSyncing)
+	{
+		return 2;
+	}
+
+	return 3 + rStatus.mClientState - ClientConnection::CS_UNKNOWN;
+}
+
+static int CompareValues(long long a, long long b)
+{
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+class DaemonStatusLess
+{
+	private:
+	int  mColumn;
+	bool mAscending;
+
+	int Compare(const DaemonMonitor::Status& a,
+		const DaemonMonitor::Status& b) const
+	{
+		switch (mColumn)
+		{
+			case DMC_STATUS:
+				return CompareValues(GetStatusRank(a),
+					GetStatusRank(b));
+			case DMC_SYNC_STARTED:
+				return CompareValues(a.mLastSyncStarted,
+					b.mLastSyncStarted);
+			case DMC_SYNC_FINISHED:
+				return CompareValues(a.mLastSyncFinished,
+					b.mLastSyncFinished);
+			case DMC_NUM_SYNCS:
+				return CompareValues(a.mNumSyncs, b.mNumSyncs);
+			case DMC_NUM_ERRORS:
+				return CompareValues(a.mNumErrors, b.mNumErrors);
+			case DMC_LAST_ERROR:
+				return a.mLastError.compare(b.mLastError);
+			default:
+				return 0;
+		}
+	}
+
+	public:
+	DaemonStatusLess(int column, bool ascending)
+	: mColumn(column),
+	  mAscending(ascending)
+	{ }
+
+	bool operator()(const DaemonMonitor::Status& a,
+		const DaemonMonitor::Status& b) const
+	{
+		int result = Compare(a, b);
+		if (result == 0)
+		{
+			result = a.mName.compare(b.mName);
+		}
+		return mAscending ? (result < 0) : (result > 0);
+	}
+};
+
+static wxString FormatTime(time_t time)
+{
+	if (time == 0)
+	{
+		return _("Never");
+	}
+
+	return wxDateTime(time).Format(wxT("%Y-%m-%d %H:%M:%S"));
+}
+
+BEGIN_EVENT_TABLE(DaemonMonitorList, wxListCtrl)
+	EVT_LIST_COL_CLICK(wxID_ANY, DaemonMonitorList::OnColumnClick)
+END_EVENT_TABLE()
+
+DaemonMonitorList::DaemonMonitorList(wxWindow* pParent, wxWindowID id)
+: wxListCtrl(pParent, id, wxDefaultPosition, wxDefaultSize,
+	wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL),
+  mSortColumn(DMC_STATUS),
+  mSortAscending(true)
+{
+	// virtual list controls can't autosize columns
+	InsertColumn(DMC_NAME,          _("Daemon"), wxLIST_FORMAT_LEFT, 150);
+	InsertColumn(DMC_STATUS,        _("Status"), wxLIST_FORMAT_LEFT, 200);
+	InsertColumn(DMC_SYNC_STARTED,  _("Last Sync Started"),
+		wxLIST_FORMAT_LEFT, 140);
+	InsertColumn(DMC_SYNC_FINISHED, _("Last Sync Finished"),
+		wxLIST_FORMAT_LEFT, 140);
+	InsertColumn(DMC_NUM_SYNCS,     _("Syncs"),  wxLIST_FORMAT_RIGHT, 60);
+	InsertColumn(DMC_NUM_ERRORS,    _("Errors"), wxLIST_FORMAT_RIGHT, 60);
+	InsertColumn(DMC_LAST_ERROR,    _("Last Error"),
+		wxLIST_FORMAT_LEFT, 250);
+}
+
+void DaemonMonitorList::SetStatus(
+	const std::vector<DaemonMonitor::Status>& rStatus)
+{
+	mStatus = rStatus;
+	Sort();
+	SetItemCount(mStatus.size());
+	Refresh();
+}
+
+void DaemonMonitorList::Sort()
+{
+	std::sort(mStatus.begin(), mStatus.end(),
+		DaemonStatusLess(mSortColumn, mSortAscending));
+}
+
+void DaemonMonitorList::OnColumnClick(wxListEvent& rEvent)
+{
+	int column = rEvent.GetColumn();
+
+	if (column == mSortColumn)
+	{
+		mSortAscending = !mSortAscending;
+	}
+	else
+	{
+		mSortColumn = column;
+		mSortAscending = true;
+	}
+
+	Sort();
+	Refresh();
+}
+
+wxString DaemonMonitorList::OnGetItemText(long item, long column) const
+{
+	const DaemonMonitor::Status& rStatus(mStatus[item]);
+	wxString text;
+
+	switch (column)
+	{
+		case DMC_NAME:
+			text = wxString(rStatus.mName.c_str(), wxConvBoxi);
+			break;
+		case DMC_STATUS:
+			text = GetStatusString(rStatus);
+			break;
+		case DMC_SYNC_STARTED:
+			text = FormatTime(rStatus.mLastSyncStarted);
+			break;
+		case DMC_SYNC_FINISHED:
+			text = FormatTime(rStatus.mLastSyncFinished);
+			break;
+		case DMC_NUM_SYNCS:
+			text.Printf(wxT("%lu"), (unsigned long)rStatus.mNumSyncs);
+			break;
+		case DMC_NUM_ERRORS:
+			text.Printf(wxT("%lu"), (unsigned long)rStatus.mNumErrors);
+			break;
+		case DMC_LAST_ERROR:
+			text = wxString(rStatus.mLastError.c_str(), wxConvBoxi);
+			break;
+	}
+
+	return text;
+}
+
+BEGIN_EVENT_TABLE(DaemonMonitorFrame, wxFrame)
+	EVT_COMMAND(wxID_ANY, myEVT_MONITOR_NOTIFY,
+		DaemonMonitorFrame::OnMonitorNotify)
+END_EVENT_TABLE()
+
+DaemonMonitorFrame::DaemonMonitorFrame(const wxString& rListFileName,
+	const wxPoint& rPos, const wxSize& rSize)
+: wxFrame(NULL, ID_Daemon_Monitor_Frame, _("Boxi Daemon Monitor"),
+	rPos, rSize),
+  mpList(NULL),
+  mMonitor(this)
+{
+	mpList = new DaemonMonitorList(this, ID_Daemon_Monitor_List);
+	CreateStatusBar();
+
+	std::string listFileName(rListFileName.mb_str(wxConvBoxi));
+
+	if (!mMonitor.AddDaemons(listFileName))
+	{
+		wxLogError(_("Failed to read the list of daemons to "
+			"monitor from '%s': %s"), rListFileName.c_str(),
+			wxString(strerror(errno), wxConvBoxi).c_str());
+	}
+	else if (!mMonitor.Start())
+	{
+		wxLogError(_("Failed to start the daemon monitor thread"));
+	}
+
+	RefreshStatus();
+}
+
+// Called by the monitor thread, so just asks the GUI thread to look
+void DaemonMonitorFrame::NotifyDaemonsChanged()
+{
+	wxCommandEvent event(myEVT_MONITOR_NOTIFY, GetId());
+	event.SetEventObject(this);
+	GetEventHandler()->AddPendingEvent(event);
+}
+
+void DaemonMonitorFrame::OnMonitorNotify(wxCommandEvent& rEvent)
+{
+	RefreshStatus();
+}
+
+void DaemonMonitorFrame::RefreshStatus()
+{
+	std::vector<DaemonMonitor::Status> status;
+	mMonitor.GetStatus(&status);
+	mpList->SetStatus(status);
+
+	size_t numConnected = 0, numSyncing = 0, numFailing = 0;
+
+	for (std::vector<DaemonMonitor::Status>::const_iterator
+		i = status.begin(); i != status.end(); i++)
+	{
+		if (i->mConnected)
+		{
+			numConnected++;
+		}
+
+		if (i->mSyncing)
+		{
+			numSyncing++;
+		}
+
+		if (GetStatusRank(*i) == 0)
+		{
+			numFailing++;
+		}
+	}
+
+	wxString msg;
+	msg.Printf(_("%lu daemons, %lu connected, %lu syncing, %lu failing"),
+		(unsigned long)status.size(), (unsigned long)numConnected,
+		(unsigned long)numSyncing, (unsigned long)numFailing);
+	SetStatusText(msg);
+}
+
+#endif // !WIN32
@@ -0,0 +1,342 @@
+/***************************************************************************
+ *            ExcludeProfiler.cc
+ *
+ *  Wed Jan  7 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include "BoxTime.h"
+
+#include "main.h"
+#include "ExcludeProfiler.h"
+#include "ProgressPanel.h"
+
+BoxiExcludeProfiler::BoxiExcludeProfiler(const BoxiLocation& rLocation)
+: mLocationPath(wxCharBuffer(rLocation.GetPath().mb_str(wxConvBoxi)).data()),
+  mLocationName(rLocation.GetName()),
+  mNumFilesScanned(0),
+  mNumDirsScanned(0),
+  mNumFilesExcluded(0),
+  mNumBytesScanned(0),
+  mNumBytesExcluded(0)
+{
+	const BoxiExcludeEntry::List& rEntries(
+		rLocation.GetExcludeList().GetEntries());
+
+	for (BoxiExcludeEntry::ConstIterator pEntry = rEntries.begin();
+		pEntry != rEntries.end(); pEntry++)
+	{
+		RuleStats stats(&(*pEntry));
+
+		if (pEntry->GetMatch() == EM_REGEX)
+		{
+			// compiled the same way as in BoxiExcludeRules
+			stats.mpRegex = new regex_t;
+			if (::regcomp(stats.mpRegex, pEntry->GetValue().c_str(),
+				REG_EXTENDED | REG_NOSUB) != 0)
+			{
+				delete stats.mpRegex;
+				stats.mpRegex = NULL;
+				stats.mRegexInvalid = true;
+			}
+		}
+
+		mRuleStats.push_back(stats);
+	}
+}
+
+BoxiExcludeProfiler::~BoxiExcludeProfiler()
+{
+	for (RuleStats::Vector::iterator i = mRuleStats.begin();
+		i != mRuleStats.end(); i++)
+	{
+		if (i->mpRegex)
+		{
+			::regfree(i->mpRegex);
+			delete i->mpRegex;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiExcludeProfiler::Run()
+//		Purpose: Walks the whole location, as a backup would, and
+//			 collects the statistics for each exclude entry.
+//			 Directories that would be excluded are not
+//			 descended into for matching, as bbackupd would not
+//			 look inside them either, but their contents are
+//			 counted towards the entry that excluded them.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+void BoxiExcludeProfiler::Run()
+{
+	mNumDirsScanned++;
+	ScanDirectory(mLocationPath);
+}
+
+void BoxiExcludeProfiler::ScanDirectory(const std::string& rLocalPath)
+{
+	DIR *dirHandle = ::opendir(rLocalPath.c_str());
+	if (dirHandle == 0)
+	{
+		// Ignore this directory, as CountLocalFiles does.
+		return;
+	}
+
+	try
+	{
+		struct dirent *en = 0;
+		EMU_STRUCT_STAT st;
+
+		while ((en = ::readdir(dirHandle)) != 0)
+		{
+			if (en->d_name[0] == '.' &&
+				(en->d_name[1] == '\0' ||
+				(en->d_name[1] == '.' && en->d_name[2] == '\0')))
+			{
+				// ignore, it's . or ..
+				continue;
+			}
+
+			std::string localPath = rLocalPath +
+				DIRECTORY_SEPARATOR + en->d_name;
+
+			if (EMU_LSTAT(localPath.c_str(), &st) != 0)
+			{
+				continue;
+			}
+
+			if ((st.st_mode & S_IFMT) == S_IFDIR)
+			{
+				mNumDirsScanned++;
+				if (!EvaluatePath(localPath, true, 0))
+				{
+					ScanDirectory(localPath);
+				}
+			}
+			else
+			{
+				mNumFilesScanned++;
+				mNumBytesScanned += st.st_size;
+				EvaluatePath(localPath, false, st.st_size);
+			}
+		}
+	}
+	catch (...)
+	{
+		::closedir(dirHandle);
+		throw;
+	}
+
+	::closedir(dirHandle);
+}
+
+// Tries every entry that applies to this kind of path, timing each one,
+// and charges the files that end up excluded to the first Exclude entry
+// that matched. Returns true if the path would be excluded.
+bool BoxiExcludeProfiler::EvaluatePath(const std::string& rLocalPath,
+	bool isDirectory, int64_t numBytes)
+{
+	ExcludeFileDir fileDir = isDirectory ? EFD_DIR : EFD_FILE;
+	RuleStats* pExcludedBy = NULL;
+	RuleStats* pIncludedBy = NULL;
+
+	for (RuleStats::Vector::iterator i = mRuleStats.begin();
+		i != mRuleStats.end(); i++)
+	{
+		if (i->mpEntry->GetFileDir() != fileDir || i->mRegexInvalid)
+		{
+			continue;
+		}
+
+		box_time_t start = GetCurrentBoxTime();
+		bool matched = i->mpRegex
+			? (::regexec(i->mpRegex, rLocalPath.c_str(), 0, 0, 0) == 0)
+			: (i->mpEntry->GetValue() == rLocalPath);
+		i->mTimeUsed += GetCurrentBoxTime() - start;
+
+		if (!matched)
+		{
+			continue;
+		}
+
+		i->mNumMatches++;
+
+		RuleStats** ppFirst = (i->mpEntry->GetSense() == ES_ALWAYSINCLUDE)
+			? &pIncludedBy : &pExcludedBy;
+		if (*ppFirst == NULL)
+		{
+			*ppFirst = &(*i);
+			i->mNumFirstMatches++;
+		}
+	}
+
+	if (!pExcludedBy)
+	{
+		return false;
+	}
+
+	size_t numFiles = 1;
+	if (isDirectory)
+	{
+		numFiles = 0;
+		numBytes = 0;
+		if (!pIncludedBy)
+		{
+			CountExcludedDirectory(rLocalPath, &numFiles, &numBytes);
+			mNumFilesScanned += numFiles;
+			mNumBytesScanned += numBytes;
+		}
+	}
+
+	if (pIncludedBy)
+	{
+		pIncludedBy->mNumFiles += numFiles;
+		pIncludedBy->mNumBytes += numBytes;
+		return false;
+	}
+
+	pExcludedBy->mNumFiles += numFiles;
+	pExcludedBy->mNumBytes += numBytes;
+	mNumFilesExcluded += numFiles;
+	mNumBytesExcluded += numBytes;
+	return true;
+}
+
+void BoxiExcludeProfiler::CountExcludedDirectory(const std::string& rLocalPath,
+	size_t* pNumFiles, int64_t* pNumBytes)
+{
+	DIR *dirHandle = ::opendir(rLocalPath.c_str());
+	if (dirHandle == 0)
+	{
+		return;
+	}
+
+	struct dirent *en = 0;
+	EMU_STRUCT_STAT st;
+
+	while ((en = ::readdir(dirHandle)) != 0)
+	{
+		if (en->d_name[0] == '.' &&
+			(en->d_name[1] == '\0' ||
+			(en->d_name[1] == '.' && en->d_name[2] == '\0')))
+		{
+			continue;
+		}
+
+		std::string localPath = rLocalPath + DIRECTORY_SEPARATOR +
+			en->d_name;
+
+		if (EMU_LSTAT(localPath.c_str(), &st) != 0)
+		{
+			continue;
+		}
+
+		if ((st.st_mode & S_IFMT) == S_IFDIR)
+		{
+			CountExcludedDirectory(localPath, pNumFiles, pNumBytes);
+		}
+		else
+		{
+			(*pNumFiles)++;
+			(*pNumBytes) += st.st_size;
+		}
+	}
+
+	::closedir(dirHandle);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiExcludeProfiler::GetReport()
+//		Purpose: Returns the results of Run() as plain text, one
+//			 paragraph per exclude entry in list order, with a
+//			 warning under any entry that looks useless.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+wxString BoxiExcludeProfiler::GetReport() const
+{
+	wxString report, line;
+
+	line.Printf(_("Location %s (%s): scanned %d files (%s) "
+		"in %d directories, of which %d files (%s) are excluded.\n"),
+		mLocationName.c_str(),
+		wxString(mLocationPath.c_str(), wxConvBoxi).c_str(),
+		(int)mNumFilesScanned,
+		ProgressPanel::FormatNumBytes(mNumBytesScanned).c_str(),
+		(int)mNumDirsScanned, (int)mNumFilesExcluded,
+		ProgressPanel::FormatNumBytes(mNumBytesExcluded).c_str());
+	report.Append(line);
+
+	if (mRuleStats.empty())
+	{
+		report.Append(_("This location has no exclude entries.\n"));
+		return report;
+	}
+
+	int index = 1;
+	for (RuleStats::ConstIterator i = mRuleStats.begin();
+		i != mRuleStats.end(); i++, index++)
+	{
+		line.Printf(wxT("\n%d. %s\n"), index,
+			wxString(i->mpEntry->ToString().c_str(),
+				wxConvBoxi).c_str());
+		report.Append(line);
+
+		if (i->mRegexInvalid)
+		{
+			report.Append(_("   Warning: invalid regular expression, "
+				"ignored.\n"));
+			continue;
+		}
+
+		line.Printf(_("   Matched %d paths, first match for %d, "
+			"%s %d files (%s), evaluation time %.3f ms\n"),
+			(int)i->mNumMatches, (int)i->mNumFirstMatches,
+			(i->mpEntry->GetSense() == ES_ALWAYSINCLUDE)
+				? _("kept") : _("excluded"),
+			(int)i->mNumFiles,
+			ProgressPanel::FormatNumBytes(i->mNumBytes).c_str(),
+			i->mTimeUsed / 1000.0);
+		report.Append(line);
+
+		if (i->IsNeverMatched())
+		{
+			report.Append(_("   Warning: never matches anything.\n"));
+		}
+		else if (i->IsShadowed())
+		{
+			report.Append(_("   Warning: shadowed, every path it "
+				"matches is matched by an earlier entry.\n"));
+		}
+	}
+
+	return report;
+}
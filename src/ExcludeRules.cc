@@ -0,0 +1,323 @@
+/***************************************************************************
+ *            ExcludeRules.cc
+ *
+ *  Tue Jan  6 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <wx/log.h>
+
+#include "ExcludeRules.h"
+
+BoxiExcludeRules::BoxiExcludeRules(const BoxiExcludeEntry::List& rEntries)
+{
+	size_t index = 0;
+
+	for (BoxiExcludeEntry::ConstIterator
+		pEntry  = rEntries.begin();
+		pEntry != rEntries.end(); pEntry++, index++)
+	{
+		Group& rGroup(mGroups
+			[pEntry->GetSense()   == ES_ALWAYSINCLUDE ? 1 : 0]
+			[pEntry->GetFileDir() == EFD_DIR          ? 1 : 0]);
+
+		if (pEntry->GetMatch() == EM_EXACT)
+		{
+			// insert() keeps the earlier entry for a duplicate path
+			rGroup.mExact.insert(std::pair<std::string, Rule>(
+				pEntry->GetValue(), Rule(index, &(*pEntry), NULL)));
+		}
+		else if (pEntry->GetMatch() == EM_REGEX)
+		{
+			regex_t* pRegex = new regex_t;
+			if (::regcomp(pRegex, pEntry->GetValue().c_str(),
+				REG_EXTENDED | REG_NOSUB) != 0)
+			{
+				wxLogError(_("Regular expression compile failed (%s)"),
+					pEntry->GetValueString().c_str());
+				delete pRegex;
+				continue;
+			}
+
+			rGroup.mRegex.push_back(Rule(index, &(*pEntry), pRegex));
+		}
+	}
+
+	for (int sense = 0; sense < 2; sense++)
+	{
+		for (int dir = 0; dir < 2; dir++)
+		{
+			Group& rGroup(mGroups[sense][dir]);
+			if (rGroup.mRegex.size() < 2)
+			{
+				continue;
+			}
+
+			std::vector<std::string> patterns;
+			for (std::vector<Rule>::iterator
+				i  = rGroup.mRegex.begin();
+				i != rGroup.mRegex.end(); i++)
+			{
+				patterns.push_back(i->mpEntry->GetValue());
+			}
+
+			std::string combined = CombinePatterns(patterns);
+			if (combined.empty())
+			{
+				continue;
+			}
+
+			regex_t* pRegex = new regex_t;
+			if (::regcomp(pRegex, combined.c_str(),
+				REG_EXTENDED | REG_NOSUB) != 0)
+			{
+				// fall back to trying them one at a time
+				delete pRegex;
+				continue;
+			}
+
+			rGroup.mpCombinedRegex = pRegex;
+		}
+	}
+}
+
+BoxiExcludeRules::~BoxiExcludeRules()
+{
+	for (int sense = 0; sense < 2; sense++)
+	{
+		for (int dir = 0; dir < 2; dir++)
+		{
+			Group& rGroup(mGroups[sense][dir]);
+			for (std::vector<Rule>::iterator
+				i  = rGroup.mRegex.begin();
+				i != rGroup.mRegex.end(); i++)
+			{
+				::regfree(i->mpRegex);
+				delete i->mpRegex;
+			}
+
+			if (rGroup.mpCombinedRegex)
+			{
+				::regfree(rGroup.mpCombinedRegex);
+				delete rGroup.mpCombinedRegex;
+			}
+		}
+	}
+}
+
+// Returns the first entry in the group, in list order, that matches
+// the path, or NULL if none does.
+const BoxiExcludeEntry* BoxiExcludeRules::MatchGroup(const Group& rGroup,
+	const std::string& rPath) const
+{
+	const Rule* pFirst = NULL;
+
+	std::map<std::string, Rule>::const_iterator exact =
+		rGroup.mExact.find(rPath);
+	if (exact != rGroup.mExact.end())
+	{
+		pFirst = &(exact->second);
+	}
+
+	if (rGroup.mpCombinedRegex && ::regexec(rGroup.mpCombinedRegex,
+		rPath.c_str(), 0, 0, 0) != 0)
+	{
+		// none of the regexes match
+		return pFirst ? pFirst->mpEntry : NULL;
+	}
+
+	// Only a regex before the exact match in the list can beat it
+	for (std::vector<Rule>::const_iterator i = rGroup.mRegex.begin();
+		i != rGroup.mRegex.end(); i++)
+	{
+		if (pFirst && i->mIndex > pFirst->mIndex)
+		{
+			break;
+		}
+
+		if (::regexec(i->mpRegex, rPath.c_str(), 0, 0, 0) == 0)
+		{
+			pFirst = &(*i);
+			break;
+		}
+	}
+
+	return pFirst ? pFirst->mpEntry : NULL;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiExcludeRules::Match(const std::string& rPath,
+//			 bool isDirectory,
+//			 const BoxiExcludeEntry** ppExcludedBy,
+//			 const BoxiExcludeEntry** ppIncludedBy)
+//		Purpose: Finds the first Exclude entry and the first
+//			 AlwaysInclude entry, in list order, that match the
+//			 path. Either is set to NULL if there is none.
+//		Created: 2009/01/06
+//
+// --------------------------------------------------------------------------
+void BoxiExcludeRules::Match(const std::string& rPath, bool isDirectory,
+	const BoxiExcludeEntry** ppExcludedBy,
+	const BoxiExcludeEntry** ppIncludedBy) const
+{
+	int dir = isDirectory ? 1 : 0;
+	*ppExcludedBy = MatchGroup(mGroups[0][dir], rPath);
+	*ppIncludedBy = MatchGroup(mGroups[1][dir], rPath);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiExcludeRules::IsExcluded(const std::string& rPath,
+//			 bool isDirectory)
+//		Purpose: Returns true if bbackupd would skip the path,
+//			 because an Exclude entry matches it and no
+//			 AlwaysInclude entry does.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+bool BoxiExcludeRules::IsExcluded(const std::string& rPath,
+	bool isDirectory) const
+{
+	int dir = isDirectory ? 1 : 0;
+	return MatchGroup(mGroups[0][dir], rPath) != NULL &&
+		MatchGroup(mGroups[1][dir], rPath) == NULL;
+}
+
+// Returns true if every parenthesis in the extended regular expression
+// opens or closes a group within it, so that wrapping it in another
+// group can't change its meaning. For example "a)|(b" compiles by
+// itself, but "(a)|(b)" means something else.
+static bool HasBalancedGroups(const std::string& rPattern)
+{
+	int depth = 0;
+
+	for (std::string::size_type i = 0; i < rPattern.size(); i++)
+	{
+		char c = rPattern[i];
+
+		if (c == '\\')
+		{
+			// skip the escaped character
+			i++;
+		}
+		else if (c == '[')
+		{
+			// skip the bracket expression, in which a ']'
+			// straight after the '[' or '[^' is literal
+			i++;
+			if (i < rPattern.size() && rPattern[i] == '^') i++;
+			if (i < rPattern.size() && rPattern[i] == ']') i++;
+
+			for (; i < rPattern.size() && rPattern[i] != ']'; i++)
+			{
+				// skip [:class:], [.coll.] and [=equiv=]
+				if (rPattern[i] == '[' && i + 1 < rPattern.size()
+					&& (rPattern[i + 1] == ':' ||
+					rPattern[i + 1] == '.' ||
+					rPattern[i + 1] == '='))
+				{
+					std::string end;
+					end += rPattern[i + 1];
+					end += ']';
+					i = rPattern.find(end, i + 2);
+					if (i == std::string::npos)
+					{
+						return false;
+					}
+					i++;
+				}
+			}
+
+			if (i >= rPattern.size())
+			{
+				return false;
+			}
+		}
+		else if (c == '(')
+		{
+			depth++;
+		}
+		else if (c == ')')
+		{
+			if (--depth < 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return (depth == 0);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiExcludeRules::CombinePatterns(
+//			 const std::vector<std::string>& rPatterns)
+//		Purpose: Joins extended regular expressions into a single
+//			 one that matches whatever any of them would match.
+//			 Returns an empty string if they can't be combined,
+//			 because one uses back-references, whose numbering
+//			 would be changed by the extra groups, or has a
+//			 parenthesis that doesn't belong to a group of its
+//			 own. Each pattern must also have been compiled on
+//			 its own by the caller, as an invalid one could
+//			 still produce a valid combination.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+std::string BoxiExcludeRules::CombinePatterns(
+	const std::vector<std::string>& rPatterns)
+{
+	std::string combined;
+
+	for (std::vector<std::string>::const_iterator i = rPatterns.begin();
+		i != rPatterns.end(); i++)
+	{
+		for (std::string::size_type pos = i->find('\\');
+			pos != std::string::npos && pos + 1 < i->size();
+			pos = i->find('\\', pos + 2))
+		{
+			if ((*i)[pos + 1] >= '1' && (*i)[pos + 1] <= '9')
+			{
+				return "";
+			}
+		}
+
+		if (!HasBalancedGroups(*i))
+		{
+			return "";
+		}
+
+		if (!combined.empty())
+		{
+			combined += "|";
+		}
+
+		combined += "(" + *i + ")";
+	}
+
+	return combined;
+}
@@ -24,12 +24,15 @@
 
 #include "SandBox.h"
 
-#include <wx/dir.h>
+#include <algorithm>
+
 #include <wx/filename.h>
 #include <wx/intl.h>
+#include <wx/log.h>
 #include <wx/string.h>
 #include <wx/volume.h>
 
+#include "main.h"
 #include "FileTree.h"
 
 FileImageList::FileImageList()
@@ -68,6 +71,107 @@ bool FileNode::AddChildren(wxTreeCtrl* pTreeCtrl, bool recurse)
 	return result;
 }
 
+FileNode::~FileNode()
+{
+	StopPaging();
+}
+
+// Called by _AddChildrenSlow() implementations, once they have deleted
+// any old children and know how many new ones there are, to add the
+// first page of them.
+bool FileNode::StartPaging(FileTree* pTreeCtrl, size_t numChildren,
+	bool recursive)
+{
+	mNumChildren = numChildren;
+	mNumChildrenAdded = 0;
+	return AddNextPage(pTreeCtrl, recursive);
+}
+
+// Forgets any children not added yet. The placeholder item must
+// already have been deleted, or be about to be.
+void FileNode::StopPaging()
+{
+	mNumChildren = 0;
+	mNumChildrenAdded = 0;
+	mMoreItemId = wxTreeItemId();
+
+	if (mpPagingTree)
+	{
+		mpPagingTree->RemovePagedNode(this);
+		mpPagingTree = NULL;
+	}
+
+	OnPagingFinished();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    FileNode::AddNextPage(FileTree* pTreeCtrl,
+//			 bool recursive, wxTreeItemId* pFirstNewId)
+//		Purpose: Adds the next FILE_TREE_PAGE_SIZE children to the
+//			 tree, followed by a placeholder item if there are
+//			 any more, so that a huge directory costs little more
+//			 than a small one until the user scrolls through it.
+//			 Sets *pFirstNewId to the first item added.
+//		Created: 2009/01/08
+//
+// --------------------------------------------------------------------------
+bool FileNode::AddNextPage(FileTree* pTreeCtrl, bool recursive,
+	wxTreeItemId* pFirstNewId)
+{
+	if (mMoreItemId.IsOk())
+	{
+		pTreeCtrl->Delete(mMoreItemId);
+		mMoreItemId = wxTreeItemId();
+	}
+
+	size_t pageStart = mNumChildrenAdded;
+	size_t pageEnd   = std::min(pageStart + FILE_TREE_PAGE_SIZE,
+		mNumChildren);
+
+	PrepareChildren(pageStart, pageEnd);
+
+	bool success = true;
+	size_t i;
+
+	for (i = pageStart; i < pageEnd && success; i++)
+	{
+		FileNode* pNewNode = AddChild(pTreeCtrl, i);
+		wxTreeItemId newId = pNewNode->GetId();
+
+		if (pFirstNewId && i == pageStart)
+		{
+			*pFirstNewId = newId;
+		}
+
+		if (recursive && pTreeCtrl->ItemHasChildren(newId))
+		{
+			success = pNewNode->_AddChildrenSlow(pTreeCtrl, false);
+		}
+	}
+
+	// Count the child whose own children failed, as it's in the tree
+	// now, so that the next page doesn't add it again.
+	mNumChildrenAdded = i;
+
+	if (mNumChildrenAdded < mNumChildren)
+	{
+		wxString label;
+		label.Printf(_("(%d more entries...)"),
+			(int)(mNumChildren - mNumChildrenAdded));
+		mMoreItemId = pTreeCtrl->AppendItem(GetId(), label);
+		mpPagingTree = pTreeCtrl;
+		mpPagingTree->AddPagedNode(this);
+	}
+	else
+	{
+		StopPaging();
+	}
+
+	return success;
+}
+
 FileTree::FileTree
 (
 	wxWindow* pParent,
@@ -87,33 +191,275 @@ FileTree::FileTree
 	UpdateStateIcon(pRootNode, false, false);
 }
 
+FileTree::~FileTree()
+{
+	// delete the nodes while mPagedNodes still exists, as they
+	// remove themselves from it
+	DeleteAllItems();
+}
+
 void FileTree::UpdateStateIcon(FileNode* pNode, bool updateParents,
 	bool updateChildren)
 {
-	int iconId = pNode->UpdateState(mImages, updateParents);
-	SetItemImage(pNode->GetId(), iconId, wxTreeItemIcon_Normal);
+	int& rFlags(mDirtyNodes[pNode]);
 
-	if (updateParents && pNode->GetParentNode() != NULL)
+	if (updateParents)
 	{
-		UpdateStateIcon(pNode->GetParentNode(), TRUE, FALSE);
+		rFlags |= DIRTY_PARENTS;
 	}
 
 	if (updateChildren)
 	{
-		wxTreeItemId thisId = pNode->GetId();
-		wxTreeItemIdValue cookie;
+		rFlags |= DIRTY_CHILDREN;
+	}
+}
+
+static size_t GetNodeDepth(FileNode* pNode)
+{
+	size_t depth = 0;
+
+	for (FileNode* pParent = pNode->GetParentNode(); pParent != NULL;
+		pParent = pParent->GetParentNode())
+	{
+		depth++;
+	}
+
+	return depth;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    FileTree::FlushStateIcons(bool includeHidden)
+//		Purpose: Updates the icons of all nodes marked by
+//			 UpdateStateIcon() since the last flush, with the
+//			 tree frozen so that it's repainted only once.
+//
+//			 Each node is visited only once, however many of its
+//			 descendants asked for their parents to be updated,
+//			 and nodes are visited from the root down, so that
+//			 each one can rely on its parent's state being
+//			 current. The children of collapsed nodes are left
+//			 until they're expanded, unless includeHidden is
+//			 true, when all of those skipped so far are updated
+//			 too.
+//		Created: 2009/01/09
+//
+// --------------------------------------------------------------------------
+void FileTree::FlushStateIcons(bool includeHidden)
+{
+	if (mDirtyNodes.empty())
+	{
+		if (includeHidden)
+		{
+			RefreshStaleNodes();
+		}
+		return;
+	}
+
+	// taken first, in case updating a node marks any more
+	std::map<FileNode*, int> dirtyNodes;
+	dirtyNodes.swap(mDirtyNodes);
+
+	// nodes in here have been queued, and so have all their parents
+	std::set<FileNode*> parentsQueued;
+	std::set<FileNode*> queued;
+	std::vector<std::pair<size_t, FileNode*> > toUpdate;
+
+	for (std::map<FileNode*, int>::iterator i = dirtyNodes.begin();
+		i != dirtyNodes.end(); i++)
+	{
+		FileNode* pNode = i->first;
+
+		if (queued.insert(pNode).second)
+		{
+			toUpdate.push_back(std::pair<size_t, FileNode*>(
+				GetNodeDepth(pNode), pNode));
+		}
+
+		if (!(i->second & DIRTY_PARENTS))
+		{
+			continue;
+		}
+
+		for (FileNode* pParent = pNode->GetParentNode();
+			pParent != NULL && parentsQueued.insert(pNode).second;
+			pNode = pParent, pParent = pParent->GetParentNode())
+		{
+			if (queued.insert(pParent).second)
+			{
+				toUpdate.push_back(std::pair<size_t, FileNode*>(
+					GetNodeDepth(pParent), pParent));
+			}
+		}
+	}
+
+	std::sort(toUpdate.begin(), toUpdate.end());
+
+	Freeze();
+
+	for (std::vector<std::pair<size_t, FileNode*> >::iterator
+		i = toUpdate.begin(); i != toUpdate.end(); i++)
+	{
+		SetStateIcon(i->second);
+	}
+
+	for (std::vector<std::pair<size_t, FileNode*> >::iterator
+		i = toUpdate.begin(); i != toUpdate.end(); i++)
+	{
+		FileNode* pNode = i->second;
+		std::map<FileNode*, int>::iterator pFlags =
+			dirtyNodes.find(pNode);
+
+		if (pFlags == dirtyNodes.end() ||
+			!(pFlags->second & DIRTY_CHILDREN))
+		{
+			continue;
+		}
+
+		// skip it if an ancestor's children are being updated too,
+		// as that will reach this one
+		bool covered = false;
+
+		for (FileNode* pParent = pNode->GetParentNode();
+			pParent != NULL && !covered;
+			pParent = pParent->GetParentNode())
+		{
+			pFlags = dirtyNodes.find(pParent);
+			covered = (pFlags != dirtyNodes.end() &&
+				(pFlags->second & DIRTY_CHILDREN));
+		}
+
+		if (!covered)
+		{
+			UpdateChildStateIcons(pNode, true);
+		}
+	}
+
+	Thaw();
+
+	if (includeHidden)
+	{
+		RefreshStaleNodes();
+	}
+}
+
+void FileTree::SetStateIcon(FileNode* pNode)
+{
+	// parents have already been updated, from the root down
+	int iconId = pNode->UpdateState(mImages, false);
+	if (GetItemImage(pNode->GetId(), wxTreeItemIcon_Normal)
+		!= iconId)
+	{
+		SetItemImage(pNode->GetId(), iconId, wxTreeItemIcon_Normal);
+	}
+}
+
+void FileTree::UpdateChildStateIcons(FileNode* pNode, bool onlyVisible)
+{
+	wxTreeItemId thisId = pNode->GetId();
+	wxTreeItemIdValue cookie;
+	wxTreeItemId childId = GetFirstChild(thisId, cookie);
+
+	if (!childId.IsOk())
+	{
+		return;
+	}
+
+	if (onlyVisible && !IsExpanded(thisId))
+	{
+		// updated when it's expanded, or by RefreshStaleAncestor()
+		mStaleNodes.insert(pNode);
+		return;
+	}
+
+	mStaleNodes.erase(pNode);
+
+	for (; childId.IsOk(); childId = GetNextChild(thisId, cookie))
+	{
+		FileNode* pChildNode = (FileNode*)GetItemData(childId);
+		if (!pChildNode)
+		{
+			// placeholder for children not added yet
+			continue;
+		}
+
+		SetStateIcon(pChildNode);
+
+		// Any grandchildren were added by expanding the child,
+		// which updated them, so if nothing they depend on has
+		// changed since then, they need not be visited at all.
+		if (!pChildNode->IsSubtreeStateCurrent())
+		{
+			UpdateChildStateIcons(pChildNode, onlyVisible);
+		}
+	}
+}
+
+// Brings the icon of a node hidden inside a collapsed one up to date,
+// by updating the whole of the outermost collapsed subtree that was
+// skipped over.
+void FileTree::RefreshStaleAncestor(FileNode* pNode)
+{
+	while (!mStaleNodes.empty())
+	{
+		FileNode* pOutermost = NULL;
+
+		for (FileNode* pParent = pNode->GetParentNode();
+			pParent != NULL; pParent = pParent->GetParentNode())
+		{
+			if (mStaleNodes.find(pParent) != mStaleNodes.end())
+			{
+				pOutermost = pParent;
+			}
+		}
+
+		if (!pOutermost)
+		{
+			return;
+		}
+
+		Freeze();
+		UpdateChildStateIcons(pOutermost, false);
+		Thaw();
+	}
+}
+
+// Brings the icons inside all collapsed nodes up to date, outermost first.
+void FileTree::RefreshStaleNodes()
+{
+	if (mStaleNodes.empty())
+	{
+		return;
+	}
+
+	Freeze();
+
+	while (!mStaleNodes.empty())
+	{
+		FileNode* pOutermost = *(mStaleNodes.begin());
 
-		for (wxTreeItemId childId = GetFirstChild(thisId, cookie);
-			childId.IsOk(); childId = GetNextChild(thisId, cookie))
+		for (FileNode* pParent = pOutermost->GetParentNode();
+			pParent != NULL; pParent = pParent->GetParentNode())
 		{
-			FileNode* pChildNode = (FileNode*)GetItemData(childId);
-			UpdateStateIcon(pChildNode, false, true);
+			if (mStaleNodes.find(pParent) != mStaleNodes.end())
+			{
+				pOutermost = pParent;
+			}
 		}
+
+		// erased here, as it may have no children to update
+		mStaleNodes.erase(pOutermost);
+		UpdateChildStateIcons(pOutermost, false);
 	}
+
+	Thaw();
 }
 
 BEGIN_EVENT_TABLE(FileTree, wxTreeCtrl)
 	EVT_TREE_ITEM_EXPANDING(wxID_ANY, FileTree::OnTreeNodeExpand)
+	EVT_TREE_DELETE_ITEM(wxID_ANY, FileTree::OnTreeNodeDelete)
+	EVT_IDLE(FileTree::OnIdle)
 END_EVENT_TABLE()
 
 void FileTree::OnTreeNodeExpand(wxTreeEvent& event)
@@ -123,7 +469,15 @@ void FileTree::OnTreeNodeExpand(wxTreeEvent& event)
 
 	if (pNode->AddChildren(this, false))
 	{
-		UpdateStateIcon(pNode, false, true);
+		// The new children are about to be seen, so update them
+		// now, even though the node isn't expanded yet.
+		FlushStateIcons();
+		RefreshStaleAncestor(pNode);
+
+		Freeze();
+		SetStateIcon(pNode);
+		UpdateChildStateIcons(pNode, false);
+		Thaw();
 	}
 	else
 	{
@@ -131,6 +485,70 @@ void FileTree::OnTreeNodeExpand(wxTreeEvent& event)
 	}
 }
 
+void FileTree::OnTreeNodeDelete(wxTreeEvent& event)
+{
+	event.Skip();
+
+	FileNode *pNode = (FileNode *)GetItemData(event.GetItem());
+	if (pNode)
+	{
+		mDirtyNodes.erase(pNode);
+		mStaleNodes.erase(pNode);
+	}
+}
+
+// Adds another page of children to any node whose placeholder item has
+// been scrolled, or moved by the keyboard, into view.
+void FileTree::OnIdle(wxIdleEvent& rEvent)
+{
+	rEvent.Skip();
+
+	// copied, as adding the last page removes a node from the set
+	std::vector<FileNode*> nodes(mPagedNodes.begin(),
+		mPagedNodes.end());
+
+	for (std::vector<FileNode*>::iterator i = nodes.begin();
+		i != nodes.end(); i++)
+	{
+		FileNode* pNode = *i;
+		wxTreeItemId moreId = pNode->GetMoreItemId();
+
+		if (!moreId.IsOk() || !IsVisible(moreId))
+		{
+			continue;
+		}
+
+		bool wasSelected = IsSelected(moreId);
+		wxTreeItemId firstNewId;
+
+		if (!pNode->AddNextPage(this, false, &firstNewId) ||
+			!firstNewId.IsOk())
+		{
+			continue;
+		}
+
+		for (wxTreeItemId newId = firstNewId; newId.IsOk();
+			newId = GetNextSibling(newId))
+		{
+			FileNode* pNewNode = (FileNode*)GetItemData(newId);
+			if (pNewNode)
+			{
+				UpdateStateIcon(pNewNode, false, false);
+			}
+		}
+
+		if (wasSelected)
+		{
+			SelectItem(firstNewId);
+		}
+
+		// the next placeholder may be visible too
+		rEvent.RequestMore();
+	}
+
+	FlushStateIcons();
+}
+
 LocalFileNode::LocalFileNode(const wxString& path)
 : FileNode     (),
   mFileName    (wxFileName(path).GetFullName()),
@@ -139,40 +557,27 @@ LocalFileNode::LocalFileNode(const wxString& path)
   mIsDirectory (wxFileName::DirExists(mFullPath))
 { }
 
-LocalFileNode::LocalFileNode(LocalFileNode* pParent, const wxString& path)
+// isDirectory comes from the parent's directory listing, to save
+// checking it again for every child.
+LocalFileNode::LocalFileNode(LocalFileNode* pParent, const wxString& path,
+	bool isDirectory)
 : FileNode     (pParent),
   mFileName    (wxFileName(path).GetFullName()),
   mFullPath    (path),
   mIsRoot      (false),
-  mIsDirectory (wxFileName::DirExists(mFullPath))
-{
-	if (path.Length() == 3 && path.Mid(1, 2).IsSameAs(_(":\\")))
-	{
-		mIsDirectory = true;
-	}
-	else
-	{
-		mIsDirectory = wxFileName::DirExists(mFullPath);
-	}
-}
+  mIsDirectory (isDirectory)
+{ }
 
 LocalFileNode* LocalFileNode::CreateChildNode(LocalFileNode* pParent,
-	const wxString& rPath)
+	const wxString& rPath, bool isDirectory)
 {
-	return new LocalFileNode(pParent, rPath);
+	return new LocalFileNode(pParent, rPath, isDirectory);
 }
 
-WX_DECLARE_OBJARRAY(wxFileName, FileNameArray);
-#include <wx/arrimpl.cpp>
-WX_DEFINE_OBJARRAY(FileNameArray);
-
-bool LocalFileNode::_AddChildrenSlow(LocalFileTree* pTreeCtrl, bool recursive)
+// Reads the names and types of all children into mPendingEntries,
+// without creating any nodes or tree items for them yet.
+bool LocalFileNode::ReadEntries()
 {
-	// delete any existing children of the parent
-	pTreeCtrl->DeleteChildren(GetId());
-
-	FileNameArray entries;
-
 #ifdef WIN32
 #	if wxUSE_FSVOLUME != 1
 #		error Please enable wxUSE_FSVOLUME in wxWidgets setup.h.in and recompile it
@@ -184,82 +589,129 @@ bool LocalFileNode::_AddChildrenSlow(LocalFileTree* pTreeCtrl, bool recursive)
 		wxArrayString volumes = wxFSVolumeBase::GetVolumes();
 		for (size_t i = 0; i < volumes.GetCount(); i++)
 		{
-			wxFileName fn(volumes.Item(i));
-			entries.Add(fn);
+			mPendingEntries.push_back(Entry(volumes.Item(i), true));
 		}
+		return true;
 	}
-	else
-	{
 #endif // WIN32
-		wxDir dir(mFullPath);
 
-		if (!dir.IsOpened())
+	std::string path(wxCharBuffer(mFullPath.mb_str(wxConvBoxi)).data());
+
+	DIR *dirHandle = ::opendir(path.c_str());
+	if (dirHandle == 0)
+	{
+		// the user can always click [+] another time :-)
+		wxLogError(_("Failed to read directory '%s': %s"),
+			mFullPath.c_str(), wxSysErrorMsg());
+		return false;
+	}
+
+	struct dirent *en = 0;
+
+	while ((en = ::readdir(dirHandle)) != 0)
+	{
+		if (en->d_name[0] == '.' &&
+			(en->d_name[1] == '\0' ||
+			(en->d_name[1] == '.' && en->d_name[2] == '\0')))
 		{
-			// wxDir would already show an error message explaining the
-			// exact reason of the failure, and the user can always click
-			// [+] another time :-)
-			return false;
+			// ignore, it's . or ..
+			continue;
 		}
 
-		wxString theCurrentFileName;
+		wxString name(en->d_name, wxConvBoxi);
+		bool isDirectory;
 
-		bool doContinue = dir.GetFirst(&theCurrentFileName);
-		while (doContinue)
+#ifdef HAVE_VALID_DIRENT_D_TYPE
+		if (en->d_type == DT_DIR)
 		{
-			wxFileName fn = wxFileName(mFullPath,
-				theCurrentFileName);
-			entries.Add(fn);
-			doContinue = dir.GetNext(&theCurrentFileName);
+			isDirectory = true;
 		}
-#ifdef WIN32
-	}
+		else if (en->d_type == DT_LNK || en->d_type == DT_UNKNOWN)
+		{
+			// follow links to directories, as before
+			isDirectory = wxFileName::DirExists(
+				wxFileName(mFullPath, name).GetFullPath());
+		}
+		else
+		{
+			isDirectory = false;
+		}
+#else
+		isDirectory = wxFileName::DirExists(
+			wxFileName(mFullPath, name).GetFullPath());
 #endif
 
-	for (size_t i = 0; i < entries.GetCount(); i++)
+		mPendingEntries.push_back(Entry(name, isDirectory));
+	}
+
+	::closedir(dirHandle);
+	return true;
+}
+
+bool LocalFileNode::_AddChildrenSlow(LocalFileTree* pTreeCtrl, bool recursive)
+{
+	// delete any existing children of the parent
+	pTreeCtrl->DeleteChildren(GetId());
+	StopPaging();
+
+	if (!ReadEntries())
 	{
-		wxFileName fileNameObject = entries.Item(i);
+		return false;
+	}
+
+	return StartPaging(pTreeCtrl, mPendingEntries.size(), recursive);
+}
 
-		// add to the tree
-		LocalFileNode *pNewNode = CreateChildNode(this,
-			fileNameObject.GetFullPath());
+// Only the entries about to be added are sorted, so the cost of sorting
+// a huge directory is spread over the pages that are actually viewed.
+void LocalFileNode::PrepareChildren(size_t start, size_t end)
+{
+	std::partial_sort(mPendingEntries.begin() + start,
+		mPendingEntries.begin() + end, mPendingEntries.end());
+}
 
-		wxString label = fileNameObject.GetFullName();
+FileNode* LocalFileNode::AddChild(FileTree* pTreeCtrl, size_t index)
+{
+	const Entry& rEntry(mPendingEntries[index]);
+	wxFileName fileNameObject(mFullPath, rEntry.mName);
 
-		#ifdef WIN32
-		if (label.IsSameAs(wxEmptyString))
-		{
-			wxFSVolumeBase vol(fileNameObject.GetFullPath());
-			label = vol.GetDisplayName();
-		}
-		#endif
+	#ifdef WIN32
+	if (GetParentNode() == NULL && mFullPath.IsSameAs(wxEmptyString))
+	{
+		fileNameObject = wxFileName(rEntry.mName);
+	}
+	#endif
 
-		wxTreeItemId newId = pTreeCtrl->AppendItem(GetId(),
-			label, -1, -1, pNewNode);
+	// add to the tree
+	LocalFileNode *pNewNode = CreateChildNode(this,
+		fileNameObject.GetFullPath(), rEntry.mIsDirectory);
 
-		pNewNode->SetId(newId);
+	wxString label = fileNameObject.GetFullName();
 
-		if (pNewNode->IsDirectory())
-		{
-			if (recursive)
-			{
-				if (!pNewNode->_AddChildrenSlow(pTreeCtrl,
-					false))
-				{
-					return false;
-				}
-			}
-			else
-			{
-				pTreeCtrl->SetItemHasChildren(pNewNode->GetId(),
-					true);
-			}
-		}
+	#ifdef WIN32
+	if (label.IsSameAs(wxEmptyString))
+	{
+		wxFSVolumeBase vol(fileNameObject.GetFullPath());
+		label = vol.GetDisplayName();
 	}
+	#endif
 
-	// sort out the kids
-	pTreeCtrl->SortChildren(GetId());
+	wxTreeItemId newId = pTreeCtrl->AppendItem(GetId(),
+		label, -1, -1, pNewNode);
 
-	return true;
+	pNewNode->SetId(newId);
+
+	if (pNewNode->IsDirectory())
+	{
+		pTreeCtrl->SetItemHasChildren(newId, true);
+	}
+
+	return pNewNode;
+}
+
+void LocalFileNode::OnPagingFinished()
+{
+	std::vector<Entry>().swap(mPendingEntries);
 }
 
 int LocalFileNode::UpdateState(FileImageList& rImageList, bool updateParents)
@@ -283,33 +735,3 @@ LocalFileTree::LocalFileTree
 )
 : FileTree(pParent, id, pRootNode, rRootLabel)
 { }
-
-int LocalFileTree::OnCompareItems
-(
-	const wxTreeItemId& item1,
-	const wxTreeItemId& item2
-)
-{
-	LocalFileNode *pNode1 = (LocalFileNode*)GetItemData(item1);
-	LocalFileNode *pNode2 = (LocalFileNode*)GetItemData(item2);
-
-	{
-		bool dir1 = pNode1->IsDirectory();
-		bool dir2 = pNode2->IsDirectory();
-
-		if ( dir1 && !dir2 )
-		{
-			return -1;
-		}
-
-		if ( dir2 && !dir1 )
-		{
-			return 1;
-		}
-	}
-
-	wxString name1 = pNode1->GetFullPath();
-	wxString name2 = pNode2->GetFullPath();
-
-	return name1.CompareTo(name2.wx_str() );
-}
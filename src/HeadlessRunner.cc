@@ -0,0 +1,767 @@
+/***************************************************************************
+ *            HeadlessRunner.cc
+ *
+ *  Mon Jan  5 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <wx/timer.h>
+#include <wx/tokenzr.h>
+
+#include "BackupClientRestore.h"
+#include "BackupQueries.h"
+#include "BackupStoreDirectory.h"
+#include "BackupStoreFilenameClear.h"
+
+#include "main.h"
+#include "ClientConfig.h"
+#include "ExcludeProfiler.h"
+#include "HeadlessRunner.h"
+#include "ProgressModel.h"
+#include "ProgressPanel.h"
+#include "ReportingCompareParams.h"
+#include "RunHistory.h"
+#include "ScheduleSimulator.h"
+#include "ServerConnection.h"
+
+// Print a progress line at most this often, to keep cron logs short
+#define PROGRESS_INTERVAL_SECONDS 5
+// the synthetic trace for --simulate: a week of changes to this many files
+#define SIMULATE_SYNTHETIC_FILES 10000
+#define SIMULATE_SYNTHETIC_SECONDS (7 * 86400)
+
+static void PrintLine(FILE* pFile, const wxString& rMessage)
+{
+	wxCharBuffer buf = rMessage.mb_str(wxConvBoxi);
+	::fprintf(pFile, "%s\n", buf.data());
+	::fflush(pFile);
+}
+
+// Prints each difference found by RunCompare to stdout, and counts the
+// files compared, printing progress now and then
+class HeadlessCompareProgress : public ReportingCompareParams::Sink
+{
+	private:
+	size_t  mNumFilesDone;
+	int64_t mNumBytesDone;
+	size_t  mNumDifferences;
+	time_t  mLastProgressTime;
+	ProgressModel mProgressModel;
+
+	public:
+	HeadlessCompareProgress()
+	: mNumFilesDone(0),
+	  mNumBytesDone(0),
+	  mNumDifferences(0),
+	  mLastProgressTime(time(NULL))
+	{
+		mProgressModel.Start(wxGetLocalTimeMillis().GetValue());
+	}
+
+	size_t  GetNumFilesDone()   { return mNumFilesDone; }
+	int64_t GetNumBytesDone()   { return mNumBytesDone; }
+	size_t  GetNumDifferences() { return mNumDifferences; }
+
+	void PrintProgress()
+	{
+		wxString msg;
+		msg.Printf(_("Compared %d files (%s), %d differences"),
+			(int)mNumFilesDone,
+			ProgressPanel::FormatNumBytes(mNumBytesDone).c_str(),
+			(int)mNumDifferences);
+
+		mProgressModel.Update(wxGetLocalTimeMillis().GetValue(),
+			mNumFilesDone, mNumBytesDone, 0, 0);
+		if (mProgressModel.IsRateKnown())
+		{
+			wxString speed;
+			speed.Printf(_(", %.1f files/s, %s/s"),
+				mProgressModel.GetFilesPerSecond(),
+				ProgressPanel::FormatNumBytes((int64_t)
+					mProgressModel.GetBytesPerSecond()).c_str());
+			msg += speed;
+		}
+
+		PrintLine(stdout, msg);
+		mLastProgressTime = time(NULL);
+	}
+
+	virtual void AddDifference(const wxString& rMessage)
+	{
+		mNumDifferences++;
+		PrintLine(stdout, rMessage);
+	}
+
+	virtual void AddFileDone(int64_t NumBytes)
+	{
+		mNumFilesDone++;
+		mNumBytesDone += NumBytes;
+
+		if (time(NULL) - mLastProgressTime >= PROGRESS_INTERVAL_SECONDS)
+		{
+			PrintProgress();
+		}
+	}
+};
+
+// Adds a finished compare or restore to the run history in the client's
+// data directory, as the progress panels do, so that runs from cron show
+// up in the trends too. The caller fills in the kind, result, start time
+// and counts. Warns if the run was much slower than usual.
+static void RecordRun(ClientConfig* pConfig, RunHistory::Run& rRun,
+	wxLongLong startMillis)
+{
+	std::string dataDir;
+	if (!pConfig->DataDirectory.GetInto(dataDir))
+	{
+		return;
+	}
+
+	rRun.mDurationMillis  = (wxGetLocalTimeMillis() - startMillis)
+		.GetValue();
+	rRun.mPeakMemoryBytes = RunHistory::GetPeakMemoryBytes();
+
+	RunHistory history(dataDir + DIRECTORY_SEPARATOR RUN_HISTORY_FILE);
+
+	wxString warning, error;
+	if (history.RecordAndCheck(rRun, &warning, &error))
+	{
+		PrintLine(stdout, warning);
+	}
+
+	if (!error.IsEmpty())
+	{
+		PrintLine(stderr, error);
+	}
+}
+
+HeadlessRunner::HeadlessRunner(const wxString& rConfigFileName)
+: mConfigFileName(rConfigFileName)
+{ }
+
+HeadlessRunner::~HeadlessRunner()
+{ }
+
+// The configuration is only checked for what's needed to talk to the
+// store, so a simulation can use one that isn't complete yet.
+bool HeadlessRunner::LoadConfig(bool checkConfig)
+{
+	if (mapConfig.get())
+	{
+		return true;
+	}
+
+	try
+	{
+		mapConfig.reset(new ClientConfig(mConfigFileName));
+	}
+	catch (wxString* pMessage)
+	{
+		PrintLine(stderr, *pMessage);
+		delete pMessage;
+		return false;
+	}
+	catch (std::exception& e)
+	{
+		// such as a file that can't be opened
+		wxString msg;
+		msg.Printf(_("Error: failed to load configuration file "
+			"'%s': %s"), mConfigFileName.c_str(),
+			wxString(e.what(), wxConvBoxi).c_str());
+		PrintLine(stderr, msg);
+		return false;
+	}
+
+	wxString msg;
+	if (checkConfig && !mapConfig->Check(msg))
+	{
+		PrintLine(stderr, msg);
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HeadlessRunner::RunCompare(
+//			 const wxString& rLocationName, bool quickCompare,
+//			 const wxString& rReportFileName,
+//			 CompareReport::Format reportFormat)
+//		Purpose: Compares one location, or all locations if
+//			 rLocationName is empty, against the store. Returns
+//			 HR_EXIT_DIFFERENCES if any were found.
+//		Created: 2009/01/05
+//
+// --------------------------------------------------------------------------
+HeadlessRunner::ExitCode HeadlessRunner::RunCompare(
+	const wxString& rLocationName, bool quickCompare,
+	const wxString& rReportFileName, CompareReport::Format reportFormat)
+{
+	if (!LoadConfig())
+	{
+		return HR_EXIT_CONFIG_ERROR;
+	}
+
+	Configuration BoxConfig(mapConfig->GetBoxConfig());
+	const Configuration& rLocations(
+		BoxConfig.GetSubConfiguration("BackupLocations"));
+
+	std::vector<std::string> locNames;
+	if (rLocationName.IsEmpty())
+	{
+		locNames = rLocations.GetSubConfigurationNames();
+	}
+	else
+	{
+		wxCharBuffer buf = rLocationName.mb_str(wxConvBoxi);
+		if (!rLocations.SubConfigurationExists(buf.data()))
+		{
+			wxString msg;
+			msg.Printf(_("Error: no such location: %s"),
+				rLocationName.c_str());
+			PrintLine(stderr, msg);
+			return HR_EXIT_USAGE;
+		}
+		locNames.push_back(buf.data());
+	}
+
+	std::auto_ptr<CompareReport> apReport;
+	if (!rReportFileName.IsEmpty())
+	{
+		apReport.reset(new CompareReport(reportFormat));
+		wxCharBuffer buf = rReportFileName.mb_str(wxConvBoxi);
+		if (!apReport->Open(buf.data()))
+		{
+			wxString msg;
+			msg.Printf(_("Error: failed to open report file "
+				"'%s': %s"), rReportFileName.c_str(),
+				wxString(strerror(errno), wxConvBoxi).c_str());
+			PrintLine(stderr, msg);
+			return HR_EXIT_FAILED;
+		}
+	}
+
+	ServerConnection connection(mapConfig.get());
+	BackupProtocolClient* pClient = connection.GetProtocolClient(false);
+	if (!pClient)
+	{
+		wxString msg = _("Error: failed to connect to server: ");
+		msg.Append(connection.GetErrorMessage());
+		PrintLine(stderr, msg);
+		return HR_EXIT_CONNECTION_FAILED;
+	}
+
+	HeadlessCompareProgress progress;
+	ReportingCompareParams params(progress, apReport.get(), quickCompare,
+		false, false, GetCurrentBoxTime());
+
+	RunHistory::Run run(RunHistory::RK_COMPARE);
+	run.mStartTime = time(NULL);
+	wxLongLong startMillis = wxGetLocalTimeMillis();
+
+	try
+	{
+		BackupQueries queries(*pClient, BoxConfig, false);
+
+		for (std::vector<std::string>::iterator
+			pLocName  = locNames.begin();
+			pLocName != locNames.end();
+			pLocName++)
+		{
+			wxString msg;
+			msg.Printf(_("Comparing location %s"),
+				wxString(pLocName->c_str(), wxConvBoxi).c_str());
+			PrintLine(stdout, msg);
+
+			params.LoadExcludeLists(
+				rLocations.GetSubConfiguration(*pLocName));
+			queries.CompareLocation(*pLocName, params);
+		}
+	}
+	catch (ConnectionException& e)
+	{
+		wxString msg;
+		msg.Printf(_("Error: lost connection to server: %s"),
+			wxString(e.what(), wxConvBoxi).c_str());
+		PrintLine(stderr, msg);
+		run.mNumFilesScanned = progress.GetNumFilesDone();
+		run.mNumBytesScanned = progress.GetNumBytesDone();
+		RecordRun(mapConfig.get(), run, startMillis);
+		return HR_EXIT_CONNECTION_FAILED;
+	}
+	catch (std::exception& e)
+	{
+		wxString msg;
+		msg.Printf(_("Error: compare failed: %s"),
+			wxString(e.what(), wxConvBoxi).c_str());
+		PrintLine(stderr, msg);
+		run.mNumFilesScanned = progress.GetNumFilesDone();
+		run.mNumBytesScanned = progress.GetNumBytesDone();
+		RecordRun(mapConfig.get(), run, startMillis);
+		return HR_EXIT_FAILED;
+	}
+
+	connection.Disconnect();
+	progress.PrintProgress();
+
+	run.mResult = RunHistory::RR_SUCCEEDED;
+	run.mNumFilesScanned = progress.GetNumFilesDone();
+	run.mNumBytesScanned = progress.GetNumBytesDone();
+
+	if (apReport.get() && !apReport->Close())
+	{
+		wxString msg;
+		msg.Printf(_("Error: failed to write report file "
+			"'%s': %s"), rReportFileName.c_str(),
+			wxString(strerror(apReport->GetErrno()),
+				wxConvBoxi).c_str());
+		PrintLine(stderr, msg);
+		run.mResult = RunHistory::RR_FAILED;
+		RecordRun(mapConfig.get(), run, startMillis);
+		return HR_EXIT_FAILED;
+	}
+
+	RecordRun(mapConfig.get(), run, startMillis);
+
+	return (progress.GetNumDifferences() > 0) ? HR_EXIT_DIFFERENCES
+		: HR_EXIT_OK;
+}
+
+// Counts restored files for RunRestore, and prints progress now and then
+class HeadlessRestoreProgress
+{
+	public:
+	size_t mNumFilesDone;
+	time_t mLastProgressTime;
+	ProgressModel mProgressModel;
+
+	HeadlessRestoreProgress()
+	: mNumFilesDone(0),
+	  mLastProgressTime(time(NULL))
+	{
+		mProgressModel.Start(wxGetLocalTimeMillis().GetValue());
+	}
+
+	void PrintProgress()
+	{
+		wxString msg;
+		msg.Printf(_("Restored %d files"), (int)mNumFilesDone);
+
+		mProgressModel.Update(wxGetLocalTimeMillis().GetValue(),
+			mNumFilesDone, 0, 0, 0);
+		if (mProgressModel.IsRateKnown())
+		{
+			wxString speed;
+			speed.Printf(_(", %.1f files/s"),
+				mProgressModel.GetFilesPerSecond());
+			msg += speed;
+		}
+
+		PrintLine(stdout, msg);
+		mLastProgressTime = time(NULL);
+	}
+};
+
+static void HeadlessRestoreProgressCallback(RestoreState State,
+	std::string& rFileName, void* userData)
+{
+	if (State != RS_FINISH_FILE)
+	{
+		return;
+	}
+
+	HeadlessRestoreProgress* pProgress =
+		(HeadlessRestoreProgress *)userData;
+	pProgress->mNumFilesDone++;
+
+	if (time(NULL) - pProgress->mLastProgressTime >=
+		PROGRESS_INTERVAL_SECONDS)
+	{
+		pProgress->PrintProgress();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HeadlessRunner::RunRestore(const wxString& rStorePath,
+//			 const wxString& rLocalPath, bool resume)
+//		Purpose: Restores the store directory rStorePath, such as
+//			 "/home/docs", to rLocalPath, which must not exist
+//			 unless an interrupted restore is being resumed.
+//		Created: 2009/01/05
+//
+// --------------------------------------------------------------------------
+HeadlessRunner::ExitCode HeadlessRunner::RunRestore(
+	const wxString& rStorePath, const wxString& rLocalPath, bool resume)
+{
+	if (!LoadConfig())
+	{
+		return HR_EXIT_CONFIG_ERROR;
+	}
+
+	ServerConnection connection(mapConfig.get());
+	if (!connection.Connect(false))
+	{
+		wxString msg = _("Error: failed to connect to server: ");
+		msg.Append(connection.GetErrorMessage());
+		PrintLine(stderr, msg);
+		return HR_EXIT_CONNECTION_FAILED;
+	}
+
+	// Find the directory to restore, one path component at a time
+	int64_t directoryId = BackupProtocolListDirectory::RootDirectory;
+	wxStringTokenizer tkz(rStorePath, wxT("/"), wxTOKEN_STRTOK);
+
+	while (tkz.HasMoreTokens())
+	{
+		wxString component = tkz.GetNextToken();
+		BackupStoreDirectory dir;
+
+		if (!connection.ListDirectory(directoryId,
+			BackupProtocolListDirectory::Flags_EXCLUDE_NOTHING, dir))
+		{
+			wxString msg = _("Error: failed to list directory "
+				"on server: ");
+			msg.Append(connection.GetErrorMessage());
+			PrintLine(stderr, msg);
+			return HR_EXIT_CONNECTION_FAILED;
+		}
+
+		BackupStoreDirectory::Iterator i(dir);
+		wxCharBuffer buf = component.mb_str(wxConvBoxi);
+		BackupStoreFilenameClear fn(buf.data());
+		BackupStoreDirectory::Entry *en = i.FindMatchingClearName(fn,
+			BackupStoreDirectory::Entry::Flags_Dir);
+
+		if (en == 0)
+		{
+			wxString msg;
+			msg.Printf(_("Error: directory not found on server: "
+				"%s"), rStorePath.c_str());
+			PrintLine(stderr, msg);
+			return HR_EXIT_USAGE;
+		}
+
+		directoryId = en->GetObjectID();
+	}
+
+	HeadlessRestoreProgress progress;
+	wxCharBuffer destBuf = rLocalPath.mb_str(wxConvBoxi);
+	int result;
+
+	RunHistory::Run run(RunHistory::RK_RESTORE);
+	run.mStartTime = time(NULL);
+	wxLongLong startMillis = wxGetLocalTimeMillis();
+
+	try
+	{
+		result = connection.Restore(directoryId, destBuf.data(),
+			&HeadlessRestoreProgressCallback,
+			&progress, // user data for callback function
+			false, // restore deleted
+			false, // don't undelete after restore!
+			resume);
+	}
+	catch (BoxException& e)
+	{
+		wxString msg = _("Error: restore failed: ");
+		if (e.GetType()    == ConnectionException::ExceptionType &&
+			e.GetSubType() == ConnectionException::TLSReadFailed)
+		{
+			// protocol object has more details than just
+			// TLSReadFailed
+			msg.Append(wxString(connection.ErrorString(),
+				wxConvBoxi));
+		}
+		else
+		{
+			msg.Append(wxString(e.what(), wxConvBoxi));
+		}
+		PrintLine(stderr, msg);
+		run.mNumFilesScanned = progress.mNumFilesDone;
+		RecordRun(mapConfig.get(), run, startMillis);
+		return HR_EXIT_FAILED;
+	}
+	catch (std::exception& e)
+	{
+		wxString msg;
+		msg.Printf(_("Error: restore failed: %s"),
+			wxString(e.what(), wxConvBoxi).c_str());
+		PrintLine(stderr, msg);
+		run.mNumFilesScanned = progress.mNumFilesDone;
+		RecordRun(mapConfig.get(), run, startMillis);
+		return HR_EXIT_FAILED;
+	}
+
+	connection.Disconnect();
+
+	run.mResult = (result == Restore_Complete)
+		? RunHistory::RR_SUCCEEDED : RunHistory::RR_FAILED;
+	run.mNumFilesScanned = progress.mNumFilesDone;
+	RecordRun(mapConfig.get(), run, startMillis);
+
+	switch (result)
+	{
+		case Restore_Complete:
+		{
+			progress.PrintProgress();
+			PrintLine(stdout, _("Restore complete."));
+			return HR_EXIT_OK;
+		}
+
+		case Restore_ResumePossible:
+		{
+			PrintLine(stderr, _("Error: a previous restore to this "
+				"directory was interrupted. Use --resume to "
+				"continue it."));
+			return HR_EXIT_FAILED;
+		}
+
+		case Restore_TargetExists:
+		{
+			PrintLine(stderr, _("Error: the target directory "
+				"exists. You cannot restore over an existing "
+				"directory."));
+			return HR_EXIT_FAILED;
+		}
+	}
+
+	PrintLine(stderr, _("Error: unknown restore result."));
+	return HR_EXIT_FAILED;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HeadlessRunner::RunExcludeProfile(
+//			 const wxString& rLocationName)
+//		Purpose: Walks one location, or all locations if
+//			 rLocationName is empty, and prints how often each
+//			 exclude entry matches and what it costs. Does not
+//			 need the store.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+HeadlessRunner::ExitCode HeadlessRunner::RunExcludeProfile(
+	const wxString& rLocationName)
+{
+	if (!LoadConfig())
+	{
+		return HR_EXIT_CONFIG_ERROR;
+	}
+
+	if (!rLocationName.IsEmpty() && !mapConfig->GetLocation(rLocationName))
+	{
+		wxString msg;
+		msg.Printf(_("Error: no such location: %s"),
+			rLocationName.c_str());
+		PrintLine(stderr, msg);
+		return HR_EXIT_USAGE;
+	}
+
+	const BoxiLocation::List& rLocs = mapConfig->GetLocations();
+	bool first = true;
+
+	for (BoxiLocation::ConstIterator pLoc = rLocs.begin();
+		pLoc != rLocs.end(); pLoc++)
+	{
+		if (!rLocationName.IsEmpty() &&
+			!pLoc->GetName().IsSameAs(rLocationName))
+		{
+			continue;
+		}
+
+		if (!first)
+		{
+			PrintLine(stdout, wxEmptyString);
+		}
+		first = false;
+
+		BoxiExcludeProfiler profiler(*pLoc);
+		profiler.Run();
+
+		wxString report = profiler.GetReport();
+		PrintLine(stdout, report.Trim());
+	}
+
+	return HR_EXIT_OK;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HeadlessRunner::RunSimulation(
+//			 const wxString& rTraceFileName, long numClients,
+//			 const wxString& rReportFileName)
+//		Purpose: Replays the file changes in a trace, or a synthetic
+//			 trace if rTraceFileName is "synthetic", against the
+//			 timing and diffing settings in the configuration,
+//			 and prints what one client would upload and how
+//			 busy a store shared by numClients of them would be.
+//			 Writes each sync to rReportFileName as CSV, unless
+//			 it's empty. Does not need the store.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+HeadlessRunner::ExitCode HeadlessRunner::RunSimulation(
+	const wxString& rTraceFileName, long numClients,
+	const wxString& rReportFileName)
+{
+	if (!LoadConfig(false))
+	{
+		return HR_EXIT_CONFIG_ERROR;
+	}
+
+	// bbackupd's own defaults are used for anything not configured
+	ScheduleSimulator::Settings settings;
+	mapConfig->UpdateStoreInterval.GetInto(settings.mUpdateStoreInterval);
+	mapConfig->MinimumFileAge.GetInto(settings.mMinimumFileAge);
+	mapConfig->MaxUploadWait.GetInto(settings.mMaxUploadWait);
+	mapConfig->DiffingUploadSizeThreshold.GetInto(
+		settings.mDiffingUploadSizeThreshold);
+	mapConfig->MaximumDiffingTime.GetInto(settings.mMaximumDiffingTime);
+
+	ScheduleSimulator simulator;
+
+	if (rTraceFileName == wxS("synthetic"))
+	{
+		simulator.GenerateTrace(SIMULATE_SYNTHETIC_FILES,
+			SIMULATE_SYNTHETIC_SECONDS, 1);
+	}
+	else
+	{
+		wxCharBuffer buf = rTraceFileName.mb_str(wxConvBoxi);
+		std::string error;
+
+		if (!simulator.LoadTrace(buf.data(), &error))
+		{
+			PrintLine(stderr, _("Error: ") +
+				wxString(error.c_str(), wxConvBoxi));
+			return HR_EXIT_FAILED;
+		}
+	}
+
+	const std::vector<ScheduleSimulator::Change>& rTrace(
+		simulator.GetTrace());
+	if (rTrace.empty())
+	{
+		PrintLine(stderr, _("Error: the trace has no changes"));
+		return HR_EXIT_FAILED;
+	}
+
+	std::vector<ScheduleSimulator::Sync> syncs;
+	simulator.Run(settings, 0, &syncs);
+
+	size_t numUploading = 0, numFull = 0, numDiff = 0, numForced = 0;
+	int64_t numBytes = 0, maxBytes = 0;
+
+	for (std::vector<ScheduleSimulator::Sync>::iterator i = syncs.begin();
+		i != syncs.end(); i++)
+	{
+		if (i->mBytesUploaded > 0)
+		{
+			numUploading++;
+		}
+
+		numFull   += i->mNumFullUploads;
+		numDiff   += i->mNumDiffUploads;
+		numForced += i->mNumForcedUploads;
+		numBytes  += i->mBytesUploaded;
+
+		if (i->mBytesUploaded > maxBytes)
+		{
+			maxBytes = i->mBytesUploaded;
+		}
+	}
+
+	// a negative MinimumFileAge can leave no syncs at all
+	int64_t meanBytes = syncs.empty() ? 0 :
+		numBytes / (int64_t)syncs.size();
+
+	ScheduleSimulator::StoreLoad load;
+	simulator.GetStoreLoad(settings, numClients, &load);
+
+	wxString msg;
+	msg.Printf(_("Settings: UpdateStoreInterval %d, MinimumFileAge %d, "
+		"MaxUploadWait %d, DiffingUploadSizeThreshold %d, "
+		"MaximumDiffingTime %d"),
+		settings.mUpdateStoreInterval, settings.mMinimumFileAge,
+		settings.mMaxUploadWait, settings.mDiffingUploadSizeThreshold,
+		settings.mMaximumDiffingTime);
+	PrintLine(stdout, msg);
+
+	msg.Printf(_("Trace: %lu changes over %s"),
+		(unsigned long)rTrace.size(),
+		ProgressPanel::FormatDuration(rTrace.back().mTime -
+			rTrace.front().mTime).c_str());
+	PrintLine(stdout, msg);
+
+	msg.Printf(_("Syncs: %lu, of which %lu uploaded something"),
+		(unsigned long)syncs.size(), (unsigned long)numUploading);
+	PrintLine(stdout, msg);
+
+	msg.Printf(_("Files uploaded: %lu whole, %lu diffed, "
+		"%lu forced by MaxUploadWait"), (unsigned long)numFull,
+		(unsigned long)numDiff, (unsigned long)numForced);
+	PrintLine(stdout, msg);
+
+	msg.Printf(_("Bytes uploaded: %s in total, %s per sync on average, "
+		"%s in the largest sync"),
+		ProgressPanel::FormatNumBytes(numBytes).c_str(),
+		ProgressPanel::FormatNumBytes(meanBytes).c_str(),
+		ProgressPanel::FormatNumBytes(maxBytes).c_str());
+	PrintLine(stdout, msg);
+
+	msg.Printf(_("Store load with %ld clients: %s in the busiest minute, "
+		"%s after the start, and at most %lu clients uploading "
+		"in one minute"), numClients,
+		ProgressPanel::FormatNumBytes(load.mPeakBytesPerMinute).c_str(),
+		ProgressPanel::FormatDuration(load.mPeakTime -
+			rTrace.front().mTime).c_str(),
+		(unsigned long)load.mPeakUploadingClients);
+	PrintLine(stdout, msg);
+
+	if (!rReportFileName.IsEmpty())
+	{
+		wxCharBuffer buf = rReportFileName.mb_str(wxConvBoxi);
+		if (!ScheduleSimulator::WriteCsv(syncs, buf.data()))
+		{
+			msg.Printf(_("Error: failed to write report to %s"),
+				rReportFileName.c_str());
+			PrintLine(stderr, msg);
+			return HR_EXIT_FAILED;
+		}
+	}
+
+	return HR_EXIT_OK;
+}
@@ -29,7 +29,9 @@
 
 #include <wx/filename.h>
 #include <wx/log.h>
+#include <wx/thread.h>
 
+#include "ExcludeRules.h"
 #include "Location.h"
 #include "Utils.h"
 
@@ -46,7 +48,9 @@ BoxiExcludeType theExcludeTypes [] = {
 
 BoxiExcludeList::BoxiExcludeList(const Configuration& conf, 
 	LocationChangeListener* pListener) 
-: mpListener(pListener)
+: mpListener(pListener),
+  mpRules(NULL),
+  mGeneration(NewGeneration())
 {
 	for (size_t i = 0; i < sizeof(theExcludeTypes) / sizeof(BoxiExcludeType); i++)
 	{
@@ -76,6 +80,47 @@ inline void BoxiExcludeList::_AddSeparatedList(const std::string& entries,
 	}
 }
 
+// Exclude lists are also copied, and their generations read, by the size
+// estimator thread, so the counter is protected by a mutex.
+static wxMutex theGenerationMutex;
+static unsigned long theNextGeneration = 0;
+
+unsigned long BoxiExcludeList::NewGeneration()
+{
+	wxMutexLocker lock(theGenerationMutex);
+	return ++theNextGeneration;
+}
+
+void BoxiExcludeList::ClearRules()
+{
+	delete mpRules;
+	mpRules = NULL;
+}
+
+// Called after every change to the entries. The compiled rules point
+// into mEntries, so they must be thrown away and rebuilt on next use,
+// and anything cached from the old entries is now out of date.
+void BoxiExcludeList::OnChange()
+{
+	ClearRules();
+	mGeneration = NewGeneration();
+
+	if (mpListener)
+	{
+		mpListener->OnExcludeListChange(this);
+	}
+}
+
+const BoxiExcludeRules& BoxiExcludeList::GetRules() const
+{
+	if (!mpRules)
+	{
+		mpRules = new BoxiExcludeRules(mEntries);
+	}
+
+	return *mpRules;
+}
+
 void BoxiExcludeList::AddEntry(const BoxiExcludeEntry& rNewEntry) 
 {
 	for (BoxiExcludeEntry::ConstIterator 
@@ -90,10 +135,7 @@ void BoxiExcludeList::AddEntry(const BoxiExcludeEntry& rNewEntry)
 
 	mEntries.push_back(rNewEntry);
 	
-	if (mpListener)
-	{
-		mpListener->OnExcludeListChange(this);
-	}
+	OnChange();
 }
 
 void BoxiExcludeList::InsertEntry(int index, const BoxiExcludeEntry& rNewEntry) 
@@ -117,10 +159,7 @@ void BoxiExcludeList::InsertEntry(int index, const BoxiExcludeEntry& rNewEntry)
 
 	mEntries.insert(i, rNewEntry);
 	
-	if (mpListener)
-	{
-		mpListener->OnExcludeListChange(this);
-	}
+	OnChange();
 }
 
 void BoxiExcludeList::ReplaceEntry(const BoxiExcludeEntry& rOldEntry, 
@@ -132,10 +171,7 @@ void BoxiExcludeList::ReplaceEntry(const BoxiExcludeEntry& rOldEntry,
 		{ }
 	if (current == mEntries.end()) throw "item not found";
 	*current = rNewEntry;
-	if (mpListener)
-	{
-		mpListener->OnExcludeListChange(this);
-	}
+	OnChange();
 }
 
 /*
@@ -168,10 +204,7 @@ void BoxiExcludeList::RemoveEntry(const BoxiExcludeEntry& rOldEntry)
 		throw "index out of bounds";
 	}
 	mEntries.erase(current);
-	if (mpListener)
-	{
-		mpListener->OnExcludeListChange(this);
-	}
+	OnChange();
 }
 
 BoxiExcludeEntry* BoxiExcludeList::UnConstEntry(const BoxiExcludeEntry& rEntry)
@@ -207,9 +240,6 @@ ExcludedState BoxiLocation::GetExcludedState(const wxString& rLocalFileName,
 	//wxLogDebug(_(" checking whether %s is excluded..."), 
 	//	rLocalFileName.c_str());
 	
-	const std::list<BoxiExcludeEntry>& rExcludeList =
-		mExcluded.GetEntries();
-
 	wxFileName fn(rLocalFileName);
 	wxFileName locroot(GetPath());
 	wxFileName root(fn.GetPath());
@@ -235,115 +265,34 @@ ExcludedState BoxiLocation::GetExcludedState(const wxString& rLocalFileName,
 		return EST_NOLOC;
 	}
 	
-	ExcludedState isExcluded = EST_INCLUDED;
-	
-	// on pass 1, remove Excluded files
-	// on pass 2, re-add AlwaysInclude files
-	
-	for (int pass = 1; pass <= 2; pass++) 
-	{
-		// wxLogDebug(_(" pass %d"), pass);
+	// One pass over only the rules which could apply to this path:
+	// find the first Exclude entry that matches, and the first
+	// AlwaysInclude entry that matches, which overrides it.
+	wxCharBuffer buf = rLocalFileName.mb_str(wxConvBoxi);
+	const BoxiExcludeEntry* pExcludedBy = NULL;
+	const BoxiExcludeEntry* pIncludedBy = NULL;
+	mExcluded.GetRules().Match(buf.data(), mIsDirectory,
+		&pExcludedBy, &pIncludedBy);
 
-		for (BoxiExcludeEntry::ConstIterator 
-			pEntry  = rExcludeList.begin();
-			pEntry != rExcludeList.end(); pEntry++)
-		{
-			ExcludeMatch match = pEntry->GetMatch();
-			std::string  value = pEntry->GetValue();
-			wxString value2(value.c_str(), wxConvBoxi);
-			bool matched = false;
-
-			{
-				std::string name = pEntry->ToString();
-				wxString name2(name.c_str(), wxConvBoxi);
-				//wxLogDebug(_("  checking against %s"),
-				//	name2.c_str());
-			}
-
-			ExcludeSense sense = pEntry->GetSense();
-			
-			if (pass == 1 && sense != ES_EXCLUDE) 
-			{
-				//wxLogDebug(_("   not an Exclude entry"));
-				continue;
-			}
-			
-			if (pass == 2 && sense != ES_ALWAYSINCLUDE) 
-			{
-				//wxLogDebug(_("   not an AlwaysInclude entry"));
-				continue;
-			}
-			
-			ExcludeFileDir fileOrDir = pEntry->GetFileDir();
-			
-			if (fileOrDir == EFD_FILE && mIsDirectory) 
-			{
-				//wxLogDebug(_("   doesn't match directories"));
-				continue;
-			}
-			
-			if (fileOrDir == EFD_DIR && !mIsDirectory) 
-			{
-				//wxLogDebug(_("   doesn't match files"));
-				continue;
-			}
-			
-			if (match == EM_EXACT) 
-			{
-				if (rLocalFileName == value2) 
-				{
-					//wxLogDebug(_("    exact match"));
-					matched = true;
-				}
-			} 
-			else if (match == EM_REGEX) 
-			{
-				std::auto_ptr<regex_t> apr = 
-					std::auto_ptr<regex_t>(new regex_t);
-				if (::regcomp(apr.get(), value.c_str(),
-					REG_EXTENDED | REG_NOSUB) != 0) 
-				{
-					wxLogError(_("Regular expression compile failed (%s)"),
-						value2.c_str());
-				}
-				else
-				{
-					wxCharBuffer buf = rLocalFileName.mb_str(wxConvBoxi);
-					int result = regexec(apr.get(), buf.data(), 0, 0, 0);
-					matched = (result == 0);
-				}
-			}
+	ExcludedState isExcluded = EST_INCLUDED;
 
-			if (!matched) 
-			{
-				//wxLogDebug(_("   no match."));
-				continue;
-			}
+	if (pExcludedBy)
+	{
+		isExcluded = EST_EXCLUDED;
+		if (ppExcludedBy)
+			*ppExcludedBy = pExcludedBy;
+	}
 
-			if (pMatched)
-			{
-				*pMatched = true;
-			}
+	if (pIncludedBy)
+	{
+		isExcluded = EST_ALWAYSINCLUDED;
+		if (ppIncludedBy)
+			*ppIncludedBy = pIncludedBy;
+	}
 
-			//wxLogDebug(_("   matched!"));
-			
-			if (sense == ES_EXCLUDE)
-			{
-				isExcluded = EST_EXCLUDED;
-				if (ppExcludedBy)
-					*ppExcludedBy = &(*pEntry);
-			} 
-			else if (sense == ES_ALWAYSINCLUDE)
-			{
-				isExcluded = EST_ALWAYSINCLUDED;
-				if (ppIncludedBy)
-					*ppIncludedBy = &(*pEntry);
-			}
-			
-			// Now break out of this loop, since it doesn't matter
-			// if any other entry has the same effect as this one.
-			break;
-		}
+	if ((pExcludedBy || pIncludedBy) && pMatched)
+	{
+		*pMatched = true;
 	}
 	
 	if (isExcluded != EST_ALWAYSINCLUDED && ppIncludedBy)
@@ -376,6 +325,10 @@ ExcludeList* BoxiLocation::GetBoxExcludeList(bool listDirs) const
 	
 	const BoxiExcludeEntry::List& rEntries(mExcluded.GetEntries());
 	
+	// Regexes are collected and added together at the end, so that
+	// Box Backup only has to run one regexec() per list for each file.
+	std::vector<std::string> excludeRegexes, includeRegexes;
+	
 	try
 	{
 		for (BoxiExcludeEntry::ConstIterator 
@@ -389,13 +342,16 @@ ExcludeList* BoxiLocation::GetBoxExcludeList(bool listDirs) const
 				continue;
 			
 			ExcludeList* pList = NULL;
+			std::vector<std::string>* pRegexes = NULL;
 			if (pEntry->GetSense() == ES_EXCLUDE)
 			{
 				pList = pExclude;
+				pRegexes = &excludeRegexes;
 			}
 			else if (pEntry->GetSense() == ES_ALWAYSINCLUDE)
 			{
 				pList = pInclude;
+				pRegexes = &includeRegexes;
 			}
 			
 			if (pEntry->GetMatch() == EM_EXACT)
@@ -404,9 +360,12 @@ ExcludeList* BoxiLocation::GetBoxExcludeList(bool listDirs) const
 			}
 			else if (pEntry->GetMatch() == EM_REGEX)
 			{
-				pList->AddRegexEntries(pEntry->GetValue());
+				pRegexes->push_back(pEntry->GetValue());
 			}
 		}
+		
+		AddBoxRegexEntries(*pExclude, excludeRegexes);
+		AddBoxRegexEntries(*pInclude, includeRegexes);
 	}
 	catch(...)
 	{
@@ -418,3 +377,55 @@ ExcludeList* BoxiLocation::GetBoxExcludeList(bool listDirs) const
 
 	return pExclude;
 }
+
+// Adds the regexes to a Box Backup ExcludeList as a single combined
+// regex if possible, otherwise one by one, so that an invalid regex
+// is still reported by ExcludeList in the usual way.
+void BoxiLocation::AddBoxRegexEntries(ExcludeList& rList,
+	const std::vector<std::string>& rRegexes)
+{
+	if (rRegexes.empty())
+	{
+		return;
+	}
+	
+	// Only combine them if each one is valid by itself
+	bool allValid = true;
+	for (std::vector<std::string>::const_iterator i = rRegexes.begin();
+		allValid && i != rRegexes.end(); i++)
+	{
+		regex_t test;
+		if (::regcomp(&test, i->c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+		{
+			allValid = false;
+		}
+		else
+		{
+			::regfree(&test);
+		}
+	}
+	
+	std::string combined;
+	if (allValid && rRegexes.size() > 1)
+	{
+		combined = BoxiExcludeRules::CombinePatterns(rRegexes);
+	}
+	
+	if (!combined.empty())
+	{
+		regex_t test;
+		if (::regcomp(&test, combined.c_str(),
+			REG_EXTENDED | REG_NOSUB) == 0)
+		{
+			::regfree(&test);
+			rList.AddRegexEntries(combined);
+			return;
+		}
+	}
+	
+	for (std::vector<std::string>::const_iterator i = rRegexes.begin();
+		i != rRegexes.end(); i++)
+	{
+		rList.AddRegexEntries(*i);
+	}
+}
@@ -0,0 +1,148 @@
+/***************************************************************************
+ *            LocationIndex.cc
+ *
+ *  Wed Jan  7 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <wx/filename.h>
+
+#include "LocationIndex.h"
+
+// Copies the next path component, starting at rPos, into rComponent and
+// moves rPos past it. Returns false if there are no more components.
+static bool GetNextComponent(const wxString& rPath, size_t& rPos,
+	wxString& rComponent)
+{
+	while (rPos < rPath.Length() &&
+		wxFileName::IsPathSeparator(rPath.GetChar(rPos)))
+	{
+		rPos++;
+	}
+
+	size_t start = rPos;
+	while (rPos < rPath.Length() &&
+		!wxFileName::IsPathSeparator(rPath.GetChar(rPos)))
+	{
+		rPos++;
+	}
+
+	if (rPos == start)
+	{
+		return false;
+	}
+
+	rComponent = rPath.Mid(start, rPos - start);
+	return true;
+}
+
+BoxiLocationIndex::Node::~Node()
+{
+	for (std::map<wxString, Node*>::iterator i = mChildren.begin();
+		i != mChildren.end(); i++)
+	{
+		delete i->second;
+	}
+}
+
+BoxiLocationIndex::BoxiLocationIndex(BoxiLocation::List& rLocations)
+{
+	for (BoxiLocation::Iterator pLoc = rLocations.begin();
+		pLoc != rLocations.end(); pLoc++)
+	{
+		Node* pNode = &mRoot;
+		size_t pos = 0;
+		wxString component;
+
+		while (GetNextComponent(pLoc->GetPath(), pos, component))
+		{
+			Node*& rpChild(pNode->mChildren[component]);
+			if (!rpChild)
+			{
+				rpChild = new Node;
+			}
+			pNode = rpChild;
+		}
+
+		// If two locations have the same root, the first one
+		// wins, as it did when they were searched in order
+		if (!pNode->mpLocation)
+		{
+			pNode->mpLocation = &(*pLoc);
+		}
+	}
+}
+
+// Returns the node for the path, or NULL if no location root is at or
+// below it.
+const BoxiLocationIndex::Node* BoxiLocationIndex::FindNode(
+	const wxString& rPath) const
+{
+	const Node* pNode = &mRoot;
+	size_t pos = 0;
+	wxString component;
+
+	while (GetNextComponent(rPath, pos, component))
+	{
+		std::map<wxString, Node*>::const_iterator i =
+			pNode->mChildren.find(component);
+		if (i == pNode->mChildren.end())
+		{
+			return NULL;
+		}
+		pNode = i->second;
+	}
+
+	return pNode;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiLocationIndex::GetLocationAt(const wxString& rPath)
+//		Purpose: Returns the location whose root is exactly rPath,
+//			 or NULL if there is none.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+BoxiLocation* BoxiLocationIndex::GetLocationAt(const wxString& rPath) const
+{
+	const Node* pNode = FindNode(rPath);
+	return pNode ? pNode->mpLocation : NULL;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiLocationIndex::IsParentOfLocation(
+//			 const wxString& rPath)
+//		Purpose: Returns true if rPath is a directory above the
+//			 root of at least one location, and therefore
+//			 partly included in the backup.
+//		Created: 2009/01/07
+//
+// --------------------------------------------------------------------------
+bool BoxiLocationIndex::IsParentOfLocation(const wxString& rPath) const
+{
+	const Node* pNode = FindNode(rPath);
+	return pNode && !pNode->mChildren.empty();
+}
@@ -0,0 +1,224 @@
+/***************************************************************************
+ *            ProgressModel.cc
+ *
+ *  Sat Jan 10 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <stdio.h>
+
+#include "ProgressModel.h"
+
+ProgressModel::ProgressModel()
+{
+	Start(0);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ProgressModel::Start(int64_t nowMillis)
+//		Purpose: Forgets any previous run, and starts timing a new
+//			 one with nothing done yet.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+void ProgressModel::Start(int64_t nowMillis)
+{
+	mStartMillis = nowMillis;
+	mWindow.clear();
+	mWindow.push_back(Sample(nowMillis, 0, 0));
+	mRateKnown = false;
+	mFilesPerSecond = 0;
+	mBytesPerSecond = 0;
+	mSecondsRemaining = -1;
+
+	mHistory.clear();
+	mHistoryIntervalMillis = PROGRESS_HISTORY_INTERVAL_MILLIS;
+	mLatest = HistoryPoint();
+	AddHistory(mLatest);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ProgressModel::Update(int64_t nowMillis,
+//			 size_t numFilesDone, int64_t numBytesDone,
+//			 size_t numFilesTotal, int64_t numBytesTotal)
+//		Purpose: Records how much has been done so far, out of
+//			 how much, and recalculates the rates and the time
+//			 remaining. The totals may be estimates, and may
+//			 change from one call to the next.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+void ProgressModel::Update(int64_t nowMillis, size_t numFilesDone,
+	int64_t numBytesDone, size_t numFilesTotal, int64_t numBytesTotal)
+{
+	Sample sample(nowMillis, numFilesDone, numBytesDone);
+
+	if (mWindow.size() >= 2 && nowMillis -
+		mWindow[mWindow.size() - 2].mMillis < PROGRESS_SAMPLE_MILLIS)
+	{
+		mWindow.back() = sample;
+	}
+	else
+	{
+		mWindow.push_back(sample);
+	}
+
+	// Keep the last sample from before the window, so that the
+	// samples always span the whole of it
+	while (mWindow.size() > 2 &&
+		nowMillis - mWindow[1].mMillis >= PROGRESS_WINDOW_MILLIS)
+	{
+		mWindow.pop_front();
+	}
+
+	const Sample& rFirst(mWindow.front());
+	int64_t span = nowMillis - rFirst.mMillis;
+	mRateKnown = (span >= PROGRESS_MIN_SPAN_MILLIS);
+
+	if (mRateKnown)
+	{
+		mFilesPerSecond = ((double)numFilesDone -
+			(double)rFirst.mNumFiles) * 1000 / span;
+		mBytesPerSecond = ((double)numBytesDone -
+			(double)rFirst.mNumBytes) * 1000 / span;
+	}
+	else
+	{
+		mFilesPerSecond = 0;
+		mBytesPerSecond = 0;
+	}
+
+	mSecondsRemaining = -1;
+
+	if (mRateKnown && (numFilesTotal > 0 || numBytesTotal > 0))
+	{
+		double filesLeft = 0, bytesLeft = 0;
+
+		if (numFilesTotal > numFilesDone)
+		{
+			filesLeft = numFilesTotal - numFilesDone;
+		}
+
+		if (numBytesTotal > numBytesDone)
+		{
+			bytesLeft = numBytesTotal - numBytesDone;
+		}
+
+		double workLeft = bytesLeft +
+			filesLeft * PROGRESS_FILE_OVERHEAD_BYTES;
+		double workPerSecond = mBytesPerSecond +
+			mFilesPerSecond * PROGRESS_FILE_OVERHEAD_BYTES;
+
+		if (workPerSecond > 0)
+		{
+			mSecondsRemaining = (int64_t)(workLeft / workPerSecond
+				+ 0.5);
+		}
+	}
+
+	mLatest.mMillis           = nowMillis - mStartMillis;
+	mLatest.mNumFilesDone     = numFilesDone;
+	mLatest.mNumBytesDone     = numBytesDone;
+	mLatest.mFilesPerSecond   = mFilesPerSecond;
+	mLatest.mBytesPerSecond   = mBytesPerSecond;
+	mLatest.mSecondsRemaining = mSecondsRemaining;
+
+	if (mLatest.mMillis - mHistory.back().mMillis >= mHistoryIntervalMillis)
+	{
+		AddHistory(mLatest);
+	}
+}
+
+void ProgressModel::AddHistory(const HistoryPoint& rPoint)
+{
+	if (mHistory.size() >= PROGRESS_HISTORY_MAX_POINTS)
+	{
+		size_t numKept = 0;
+		for (size_t i = 0; i < mHistory.size(); i += 2)
+		{
+			mHistory[numKept++] = mHistory[i];
+		}
+		mHistory.resize(numKept);
+		mHistoryIntervalMillis *= 2;
+	}
+
+	mHistory.push_back(rPoint);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ProgressModel::WriteCsv(const std::string& rFileName)
+//		Purpose: Writes the history of the run so far to a CSV
+//			 file, one line per point, ending with the latest
+//			 update. The time remaining is left empty where it
+//			 wasn't known. Returns false if the file can't be
+//			 written.
+//		Created: 2009/01/10
+//
+// --------------------------------------------------------------------------
+bool ProgressModel::WriteCsv(const std::string& rFileName) const
+{
+	FILE* pFile = ::fopen(rFileName.c_str(), "w");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	::fputs("time_seconds,files_done,bytes_done,files_per_second,"
+		"bytes_per_second,seconds_remaining\n", pFile);
+
+	std::vector<HistoryPoint> points(mHistory);
+	if (mLatest.mMillis > points.back().mMillis)
+	{
+		points.push_back(mLatest);
+	}
+
+	for (std::vector<HistoryPoint>::const_iterator i = points.begin();
+		i != points.end(); i++)
+	{
+		::fprintf(pFile, "%.3f,%lu,%lld,%.2f,%.0f,",
+			(double)i->mMillis / 1000,
+			(unsigned long)i->mNumFilesDone,
+			(long long)i->mNumBytesDone,
+			i->mFilesPerSecond, i->mBytesPerSecond);
+
+		if (i->mSecondsRemaining >= 0)
+		{
+			::fprintf(pFile, "%lld", (long long)i->mSecondsRemaining);
+		}
+
+		::fputs("\n", pFile);
+	}
+
+	bool ok = !::ferror(pFile);
+	if (::fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+
+	return ok;
+}
@@ -26,19 +26,36 @@
 
 #include <errno.h>
 
+#include <algorithm>
+
 #include <wx/button.h>
+#include <wx/filename.h>
 #include <wx/gauge.h>
 #include <wx/intl.h>
 #include <wx/listbox.h>
 #include <wx/sizer.h>
 #include <wx/stattext.h>
 #include <wx/textctrl.h>
+#include <wx/timer.h>
 
 #include "BackupStoreException.h"
 
 #include "main.h"
 #include "BoxiApp.h"
+#include "ClientConfig.h"
+#include "ExcludeRules.h"
 #include "ProgressPanel.h"
+#include "TestFileDialog.h"
+#include "ThroughputChart.h"
+
+// how often the speed is refreshed, and the chart moved on, even when
+// no progress is being made
+#define PROGRESS_RATE_TIMER_MILLIS 1000
+
+BEGIN_EVENT_TABLE(ProgressPanel, wxPanel)
+	EVT_BUTTON(ID_Progress_Export_Button, ProgressPanel::OnExportClicked)
+	EVT_TIMER (ID_Progress_Rate_Timer,    ProgressPanel::OnRateTimer)
+END_EVENT_TABLE()
 
 ProgressPanel::ProgressPanel
 (
@@ -46,7 +63,11 @@ ProgressPanel::ProgressPanel
 	wxWindowID id,
 	const wxString& name
 )
-: wxPanel(parent, id, wxDefaultPosition, wxDefaultSize, wxTAB_TRAVERSAL, name)
+: wxPanel(parent, id, wxDefaultPosition, wxDefaultSize, wxTAB_TRAVERSAL, name),
+  mNumErrors(0),
+  mStartTime(0),
+  mpThroughputChart(NULL),
+  mRateTimer(this, ID_Progress_Rate_Timer)
 {
 	wxSizer* pMainSizer = new wxBoxSizer(wxVERTICAL);
 
@@ -128,15 +149,46 @@ ProgressPanel::ProgressPanel
 		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
 	pStatsGrid->Add(mpNumBytesTotal, 1, wxGROW, 0);
 
+	pStatsGrid->Add(new wxStaticText(this, wxID_ANY, _("Time")));
+
+	mpTimeElapsed = new wxTextCtrl(this, wxID_ANY, wxT(""), 
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	pStatsGrid->Add(mpTimeElapsed, 1, wxGROW, 0);
+	
+	mpTimeRemaining = new wxTextCtrl(this, wxID_ANY, wxT(""), 
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	pStatsGrid->Add(mpTimeRemaining, 1, wxGROW, 0);
+	
+	mpTimeTotal = new wxTextCtrl(this, wxID_ANY, wxT(""), 
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	pStatsGrid->Add(mpTimeTotal, 1, wxGROW, 0);
+
+	wxFlexGridSizer* pSpeedGrid = new wxFlexGridSizer(2, 4, 4);
+	pStatsBox->Add(pSpeedGrid, 0, wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 4);
+	pSpeedGrid->AddGrowableCol(1);
+
+	pSpeedGrid->Add(new wxStaticText(this, wxID_ANY, _("Speed")), 0,
+		wxALIGN_CENTER_VERTICAL, 0);
+
+	mpSpeed = new wxTextCtrl(this, wxID_ANY, wxT(""), 
+		wxDefaultPosition, wxDefaultSize, wxTE_READONLY);
+	pSpeedGrid->Add(mpSpeed, 1, wxGROW, 0);
+
 	wxSizer* pButtonSizer = new wxBoxSizer(wxHORIZONTAL);
 	pMainSizer->Add(pButtonSizer, 0, 
 		wxALIGN_RIGHT | wxLEFT | wxRIGHT | wxBOTTOM, 8);
 
+	mpExportButton = new wxButton(this, ID_Progress_Export_Button,
+		_("Export statistics..."));
+	pButtonSizer->Add(mpExportButton, 0, wxGROW | wxRIGHT, 8);
+
 	mpStopCloseButton = new wxButton(this, wxID_CANCEL, _("Close"));
 	pButtonSizer->Add(mpStopCloseButton, 0, wxGROW, 0);
 
 	mNumFilesCounted = 0;
 	mNumBytesCounted = 0;
+	mNumFilesDone = 0;
+	mNumBytesDone = 0;
 
 	SetSizer(pMainSizer);
 }
@@ -148,9 +200,10 @@ void ProgressPanel::NotifyMoreFilesCounted(size_t numAdditionalFiles,
 	mNumBytesCounted += numAdditionalBytes;
 
 	wxString str;
-	str.Printf(_("%d"), mNumFilesCounted);
+	str.Printf(_("%lu"), (unsigned long)mNumFilesCounted);
 	mpNumFilesTotal->SetValue(str);
 	mpNumBytesTotal->SetValue(FormatNumBytes(mNumBytesCounted));
+	UpdateRates();
 	wxYield();
 }
 
@@ -159,7 +212,30 @@ void ProgressPanel::NotifyMoreFilesDone(size_t numAdditionalFiles,
 {
 	mNumFilesDone += numAdditionalFiles;
 	mNumBytesDone += numAdditionalBytes;
+	UpdateDoneAndRemaining();
+	wxYield();
+}
 
+// Replaces the totals, for example an estimate with the real count,
+// and sets the progress gauge's range to match. The totals are never
+// set below what's already been done, so that nothing remaining is
+// negative and the gauge's value stays within its range.
+void ProgressPanel::SetTotals(size_t numFiles, int64_t numBytes)
+{
+	mNumFilesCounted = std::max(numFiles, mNumFilesDone);
+	mNumBytesCounted = std::max(numBytes, mNumBytesDone);
+
+	wxString str;
+	str.Printf(_("%lu"), (unsigned long)mNumFilesCounted);
+	mpNumFilesTotal->SetValue(str);
+	mpNumBytesTotal->SetValue(FormatNumBytes(mNumBytesCounted));
+
+	mpProgressGauge->SetRange(mNumFilesCounted);
+	UpdateDoneAndRemaining();
+}
+
+void ProgressPanel::UpdateDoneAndRemaining()
+{
 	wxString str;
 	str.Printf(_("%" wxLongLongFmtSpec "d"), (int64_t)mNumFilesDone);
 	mpNumFilesDone->SetValue(str);
@@ -173,33 +249,110 @@ void ProgressPanel::NotifyMoreFilesDone(size_t numAdditionalFiles,
 	mpNumBytesRemaining->SetValue(FormatNumBytes(numBytesRemaining));
 	
 	mpProgressGauge->SetValue(mNumFilesDone);
-	wxYield();
+	UpdateRates();
+}
+
+// Feeds the counters to the progress model, and shows the speed and
+// the time elapsed and remaining that it works out.
+void ProgressPanel::UpdateRates()
+{
+	mProgressModel.Update(wxGetLocalTimeMillis().GetValue(),
+		mNumFilesDone, mNumBytesDone,
+		mNumFilesCounted, mNumBytesCounted);
+
+	int64_t elapsed = mProgressModel.GetSecondsElapsed();
+	int64_t remaining = mProgressModel.GetSecondsRemaining();
+
+	mpTimeElapsed->SetValue(FormatDuration(elapsed));
+
+	if (remaining >= 0)
+	{
+		mpTimeRemaining->SetValue(FormatDuration(remaining));
+		mpTimeTotal->SetValue(FormatDuration(elapsed + remaining));
+	}
+	else
+	{
+		mpTimeRemaining->SetValue(wxT(""));
+		mpTimeTotal->SetValue(wxT(""));
+	}
+
+	if (mProgressModel.IsRateKnown())
+	{
+		wxString str;
+		str.Printf(_("%.1f files/s, %s/s"),
+			mProgressModel.GetFilesPerSecond(),
+			FormatNumBytes((int64_t)mProgressModel.GetBytesPerSecond())
+			.c_str());
+		mpSpeed->SetValue(str);
+	}
+	else
+	{
+		mpSpeed->SetValue(wxT(""));
+	}
 }
 
 wxString ProgressPanel::FormatNumBytes(int64_t bytes)
 {
-	wxString units = _("B");
-	
-	if (bytes > 1024)
+	wxString str;		
+
+	if (bytes < 1024 && bytes > -1024)
 	{
-		bytes >>= 10;
-		units = _("kB");
+		str.Printf(_("%" wxLongLongFmtSpec "d B"), bytes);
+		return str;
 	}
+
+	// Show one decimal place below 10 units, rather than rounding
+	// down to whole units, which made 1.9 GB look like 1 GB. Larger
+	// values are still shown in whole units, rounded down.
+	double value = (double)bytes / 1024;
+	wxString units = _("kB");
 	
-	if (bytes > 1024)
+	if (value >= 1024 || value <= -1024)
 	{
-		bytes >>= 10;
+		value /= 1024;
 		units = _("MB");
 	}
 
-	if (bytes > 1024)
+	if (value >= 1024 || value <= -1024)
 	{
-		bytes >>= 10;
+		value /= 1024;
 		units = _("GB");
 	}
 
+	if (value >= 1024 || value <= -1024)
+	{
+		value /= 1024;
+		units = _("TB");
+	}
+
+	if (value < 10 && value > -10)
+	{
+		str.Printf(_("%.1f %s"), value, units.c_str());
+	}
+	else
+	{
+		str.Printf(_("%" wxLongLongFmtSpec "d %s"), (int64_t)value,
+			units.c_str());
+	}
+
+	return str;
+}
+
+wxString ProgressPanel::FormatDuration(int64_t seconds)
+{
+	int hours   = (int)(seconds / 3600);
+	int minutes = (int)((seconds / 60) % 60);
+	int secs    = (int)(seconds % 60);
+
 	wxString str;		
-	str.Printf(_("%" wxLongLongFmtSpec "d %s"), bytes, units.c_str());
+	if (hours > 0)
+	{
+		str.Printf(wxT("%d:%02d:%02d"), hours, minutes, secs);
+	}
+	else
+	{
+		str.Printf(wxT("%d:%02d"), minutes, secs);
+	}
 	return str;
 }
 
@@ -208,6 +361,7 @@ void ProgressPanel::ReportFatalError(message_t messageId, wxString msg)
 	wxGetApp().ShowMessageBox(messageId, msg, _("Boxi Error"), 
 		wxOK | wxICON_ERROR, this);
 	mpErrorList->Append(msg);
+	mNumErrors++;
 }
 
 void LogToListBox::DoLog(wxLogLevel level, const wxChar *msg, 
@@ -238,9 +392,37 @@ void LogToListBox::DoLog(wxLogLevel level, const wxChar *msg,
 	}
 	
 	msgOut.Append(msg);
+
+	if (!wxThread::IsMain())
+	{
+		// take a deep copy, as wxString is not thread-safe
+		wxMutexLocker lock(mQueueMutex);
+		mQueued.Add(msgOut.c_str());
+		return;
+	}
+
 	mpTarget->Append(msgOut);
 }
 
+void LogToListBox::FlushQueued()
+{
+	wxArrayString messages;
+
+	{
+		wxMutexLocker lock(mQueueMutex);
+		for (size_t i = 0; i < mQueued.GetCount(); i++)
+		{
+			messages.Add(mQueued[i].c_str());
+		}
+		mQueued.Clear();
+	}
+
+	for (size_t i = 0; i < messages.GetCount(); i++)
+	{
+		mpTarget->Append(messages[i]);
+	}
+}
+
 int ProgressPanel::GetProgressMax() { return mpProgressGauge->GetRange(); }
 int ProgressPanel::GetProgressPos() { return mpProgressGauge->GetValue(); }
 
@@ -268,6 +450,8 @@ void ProgressPanel::ResetCounters()
 	mNumBytesCounted = 0;
 	mNumFilesDone = 0;
 	mNumBytesDone = 0;
+	mNumErrors = 0;
+	mStartTime = time(NULL);
 	
 	mpNumFilesTotal    ->SetValue(wxT(""));
 	mpNumBytesTotal    ->SetValue(wxT(""));
@@ -275,6 +459,120 @@ void ProgressPanel::ResetCounters()
 	mpNumBytesDone     ->SetValue(wxT(""));
 	mpNumFilesRemaining->SetValue(wxT(""));
 	mpNumBytesRemaining->SetValue(wxT(""));
+	mpTimeElapsed      ->SetValue(wxT(""));
+	mpTimeRemaining    ->SetValue(wxT(""));
+	mpTimeTotal        ->SetValue(wxT(""));
+	mpSpeed            ->SetValue(wxT(""));
+
+	mProgressModel.Start(wxGetLocalTimeMillis().GetValue());
+	mRateTimer.Start(PROGRESS_RATE_TIMER_MILLIS);
+
+	if (mpThroughputChart)
+	{
+		mpThroughputChart->Reset();
+	}
+}
+
+// Called when the backup, restore or compare has finished, to freeze
+// the time and speed where they are
+void ProgressPanel::StopTiming()
+{
+	mRateTimer.Stop();
+	UpdateRates();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ProgressPanel::RecordRun(ClientConfig* pConfig,
+//			 RunHistory::Run& rRun)
+//		Purpose: Fills in the times, counts and errors of the run
+//			 that has just finished, and adds it to the run
+//			 history in the client's data directory. The caller
+//			 sets the kind, the result and anything else that
+//			 only it knows, such as uploads. Warns in the error
+//			 list if the run was much slower than usual. Call
+//			 after StopTiming().
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+void ProgressPanel::RecordRun(ClientConfig* pConfig, RunHistory::Run& rRun)
+{
+	std::string dataDir;
+	if (!pConfig->DataDirectory.GetInto(dataDir))
+	{
+		return;
+	}
+
+	rRun.mStartTime       = mStartTime;
+	rRun.mDurationMillis  = mProgressModel.GetMillisElapsed();
+	rRun.mNumFilesScanned = mNumFilesDone;
+	rRun.mNumBytesScanned = mNumBytesDone;
+	rRun.mNumErrors       = mNumErrors;
+	rRun.mPeakMemoryBytes = RunHistory::GetPeakMemoryBytes();
+
+	RunHistory history(dataDir + DIRECTORY_SEPARATOR RUN_HISTORY_FILE);
+
+	wxString warning, error;
+	if (history.RecordAndCheck(rRun, &warning, &error))
+	{
+		mpErrorList->Append(warning);
+	}
+
+	if (!error.IsEmpty())
+	{
+		// only statistics, so not worth a message box
+		mpErrorList->Append(error);
+	}
+}
+
+void ProgressPanel::OnRateTimer(wxTimerEvent& rEvent)
+{
+	UpdateRates();
+
+	if (mpThroughputChart)
+	{
+		mpThroughputChart->AddSample(mProgressModel.GetBytesPerSecond(),
+			mProgressModel.GetFilesPerSecond());
+	}
+}
+
+// Adds a chart of the speed over the last minute, above the statistics
+void ProgressPanel::AddThroughputChart()
+{
+	wxStaticBoxSizer* pChartBox = new wxStaticBoxSizer(wxVERTICAL,
+		this, _("Speed History"));
+	// after the Summary, Current Action and Errors boxes
+	GetSizer()->Insert(3, pChartBox, 0,
+		wxGROW | wxLEFT | wxRIGHT | wxBOTTOM, 8);
+
+	mpThroughputChart = new ThroughputChart(this);
+	pChartBox->Add(mpThroughputChart, 1, wxGROW | wxALL, 4);
+	Layout();
+}
+
+void ProgressPanel::OnExportClicked(wxCommandEvent& rEvent)
+{
+	TestFileDialog saveFileDialog(
+		this, _("Export statistics"), wxT(""), _("progress.csv"),
+		_("CSV files (*.csv)|*.csv|All files (*)|*"),
+		wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+	if (wxGetApp().ShowFileDialog(saveFileDialog) != wxID_OK)
+		return;
+
+	wxFileName fn(saveFileDialog.GetDirectory(),
+		saveFileDialog.GetFilename());
+	wxString fileName = fn.GetFullPath();
+
+	if (!mProgressModel.WriteCsv(std::string(fileName.mb_str(wxConvBoxi))))
+	{
+		wxString msg;
+		msg.Printf(_("Failed to write statistics to '%s': %s"),
+			fileName.c_str(),
+			wxString(strerror(errno), wxConvBoxi).c_str());
+		mpErrorList->Append(msg);
+	}
 }
 
 void ProgressPanel::SetSummaryText(const wxString& rText)
@@ -310,7 +608,7 @@ void ProgressPanel::SetStopButtonLabel(const wxString& rLabel)
 //			 ExclusionOracle& rExclusionOracle,
 //			 const std::string &rLocalPath)
 //		Purpose: Recursively count files in a local directory
-//			 and subdirectories.
+//			 and subdirectories, skipping excluded ones.
 //		Created: 2003/10/08
 //
 // --------------------------------------------------------------------------
@@ -347,9 +645,6 @@ void ProgressPanel::CountLocalFiles(ExclusionOracle& rExclusionOracle,
 		std::string filename;
 		while((en = ::readdir(dirHandle)) != 0)
 		{
-			// Don't need to use LinuxWorkaround_FinishDirentStruct(en, rLocalPath.c_str());
-			// on Linux, as a stat is performed to get all this info
-
 			if(en->d_name[0] == '.' && 
 				(en->d_name[1] == '\0' || (en->d_name[1] == '.' && en->d_name[2] == '\0')))
 			{
@@ -357,24 +652,37 @@ void ProgressPanel::CountLocalFiles(ExclusionOracle& rExclusionOracle,
 				continue;
 			}
 
-			// Stat file to get info
 			filename = rLocalPath + DIRECTORY_SEPARATOR + en->d_name;
-			if(EMU_LSTAT(filename.c_str(), &st) != 0)
+
+			// Where the directory entry says what type it is,
+			// check the exclude lists on the name alone, so that
+			// excluded files are never stat()ed, and excluded
+			// directories never opened.
+			int type = 0;
+			bool statDone = false;
+
+#ifdef HAVE_VALID_DIRENT_D_TYPE
+			switch(en->d_type)
+			{
+				case DT_REG: type = S_IFREG; break;
+				case DT_LNK: type = S_IFLNK; break;
+				case DT_DIR: type = S_IFDIR; break;
+				case DT_UNKNOWN: break;
+				default: continue; // devices, sockets and pipes
+			}
+#endif
+
+			if(type == 0)
 			{
-				/*
-				rParams.GetProgressNotifier().NotifyFileStatFailed(
-					(BackupClientDirectoryRecord*)NULL, 
-					filename, strerror(errno));
-				THROW_EXCEPTION(CommonException, OSFileError)
-				*/
-				wxString msg;
-				msg.Printf(_("Error counting files in '%s': %s"),
-					wxString(filename.c_str(), wxConvBoxi).c_str(),
-					wxString(strerror(errno),  wxConvBoxi).c_str());
-				mpErrorList->Append(msg);
+				if(EMU_LSTAT(filename.c_str(), &st) != 0)
+				{
+					NotifyCountStatFailed(filename);
+					continue;
+				}
+				statDone = true;
+				type = st.st_mode & S_IFMT;
 			}
 
-			int type = st.st_mode & S_IFMT;
 			if(type == S_IFREG || type == S_IFLNK)
 			{
 				// File or symbolic link
@@ -386,6 +694,13 @@ void ProgressPanel::CountLocalFiles(ExclusionOracle& rExclusionOracle,
 					continue;
 				}
 
+				// Stat file to get its size
+				if(!statDone && EMU_LSTAT(filename.c_str(), &st) != 0)
+				{
+					NotifyCountStatFailed(filename);
+					continue;
+				}
+
 				filesCounted++;
 				bytesCounted += st.st_size;
 			}
@@ -426,3 +741,25 @@ void ProgressPanel::CountLocalFiles(ExclusionOracle& rExclusionOracle,
 
 	NotifyMoreFilesCounted(filesCounted, bytesCounted);
 }
+
+void ProgressPanel::NotifyCountStatFailed(const std::string& rFileName)
+{
+	wxString msg;
+	msg.Printf(_("Error counting files in '%s': %s"),
+		wxString(rFileName.c_str(), wxConvBoxi).c_str(),
+		wxString(strerror(errno),  wxConvBoxi).c_str());
+	mpErrorList->Append(msg);
+	mNumErrors++;
+}
+
+bool ProgressPanel::RulesExclusionOracle::IsExcludedFile(
+	const std::string& rFileName)
+{
+	return mrRules.IsExcluded(rFileName, false);
+}
+
+bool ProgressPanel::RulesExclusionOracle::IsExcludedDir(
+	const std::string& rDirName)
+{
+	return mrRules.IsExcluded(rDirName, true);
+}
@@ -0,0 +1,293 @@
+/***************************************************************************
+ *            ReportingCompareParams.cc
+ *
+ *  Wed Jan 14 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sstream>
+
+#include <wx/intl.h>
+
+#include "main.h"
+#include "ReportingCompareParams.h"
+
+ReportingCompareParams::ReportingCompareParams(Sink& rSink,
+	CompareReport* pReport, bool QuickCompare, bool IgnoreExcludes,
+	bool IgnoreAttributes, box_time_t LatestFileUploadTime)
+: BoxBackupCompareParams(QuickCompare, IgnoreExcludes, IgnoreAttributes,
+	LatestFileUploadTime),
+  mrSink(rSink),
+  mpReport(pReport)
+{ }
+
+wxString ReportingCompareParams::GetNativeErrorMessage()
+{
+#ifdef WIN32
+	return wxString(GetErrorMessage(GetLastError()).c_str(),
+		wxConvBoxi);
+#else
+	std::ostringstream _box_log_line;
+	_box_log_line << strerror(errno) << " (" << errno << ")";
+	return wxString(_box_log_line.str().c_str(), wxConvBoxi);
+#endif
+}
+
+void ReportingCompareParams::AddDifference(const wxString& rMessage,
+	CompareReport::Kind kind, const std::string& rLocalPath,
+	const std::string& rRemotePath, bool isDirectory,
+	int64_t numBytes, bool modifiedAfterLastSync,
+	const std::string& rDetail)
+{
+	mrSink.AddDifference(rMessage);
+
+	if (mpReport)
+	{
+		mpReport->Add(kind, rLocalPath, rRemotePath, isDirectory,
+			numBytes, modifiedAfterLastSync, rDetail);
+	}
+}
+
+void ReportingCompareParams::NotifyLocalDirMissing(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	wxString msg;
+	msg.Printf(_("Local directory '%s' does not exist, "
+		"but remote directory does."),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_LOCAL_DIR_MISSING,
+		rLocalPath, rRemotePath, true);
+}
+
+void ReportingCompareParams::NotifyLocalDirAccessFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	wxString error = GetNativeErrorMessage();
+	wxString msg;
+	msg.Printf(_("Failed to access local directory '%s': %s"),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+		error.c_str());
+	AddDifference(msg, CompareReport::CRK_LOCAL_DIR_ACCESS_FAILED,
+		rLocalPath, rRemotePath, true, -1, false,
+		std::string(error.mb_str(wxConvBoxi)));
+}
+
+void ReportingCompareParams::NotifyStoreDirMissingAttributes(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	wxString msg;
+	msg.Printf(_("Store directory '%s' doesn't have attributes."),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_STORE_DIR_MISSING_ATTRIBUTES,
+		rLocalPath, rRemotePath, true);
+}
+
+void ReportingCompareParams::NotifyRemoteFileMissing(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	bool modifiedAfterLastSync)
+{
+	wxString msg;
+	msg.Printf(_("Local file '%s' exists, but remote file '%s' "
+		"does not."),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	if (modifiedAfterLastSync)
+	{
+		msg += _(" (modified since the last backup)");
+	}
+	AddDifference(msg, CompareReport::CRK_REMOTE_FILE_MISSING,
+		rLocalPath, rRemotePath, false, -1, modifiedAfterLastSync);
+}
+
+void ReportingCompareParams::NotifyLocalFileMissing(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	wxString msg;
+	msg.Printf(_("Remote file '%s' exists, but local file '%s' "
+		"does not."),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_LOCAL_FILE_MISSING,
+		rLocalPath, rRemotePath, false);
+}
+
+void ReportingCompareParams::NotifyExcludedFileNotDeleted(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	wxString msg;
+	msg.Printf(_("Local file '%s' is excluded, but remote file "
+		"'%s' still exists."),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_EXCLUDED_FILE_NOT_DELETED,
+		rLocalPath, rRemotePath, false);
+}
+
+void ReportingCompareParams::NotifyDownloadFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes, BoxException& rException)
+{
+	wxString msg;
+	msg.Printf(_("Failed to download remote file '%s': %s (%d/%d)"),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
+		wxString(rException.what(), wxConvBoxi).c_str(),
+		rException.GetType(), rException.GetSubType());
+	AddDifference(msg, CompareReport::CRK_DOWNLOAD_FAILED,
+		rLocalPath, rRemotePath, false, NumBytes, false,
+		rException.what());
+}
+
+void ReportingCompareParams::NotifyDownloadFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes, std::exception& rException)
+{
+	wxString msg;
+	msg.Printf(_("Failed to download remote file '%s': %s"),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
+		wxString(rException.what(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_DOWNLOAD_FAILED,
+		rLocalPath, rRemotePath, false, NumBytes, false,
+		rException.what());
+}
+
+void ReportingCompareParams::NotifyDownloadFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes)
+{
+	wxString msg;
+	msg.Printf(_("Failed to download remote file '%s'"),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_DOWNLOAD_FAILED,
+		rLocalPath, rRemotePath, false, NumBytes);
+}
+
+void ReportingCompareParams::NotifyLocalFileReadFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes, std::exception& rException)
+{
+	wxString msg;
+	msg.Printf(_("Failed to download remote file '%s': %s"),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str(),
+		wxString(rException.what(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_LOCAL_FILE_READ_FAILED,
+		rLocalPath, rRemotePath, false, NumBytes, false,
+		rException.what());
+}
+
+void ReportingCompareParams::NotifyLocalFileReadFailed(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes)
+{
+	wxString msg;
+	msg.Printf(_("Failed to download remote file '%s'"),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	AddDifference(msg, CompareReport::CRK_LOCAL_FILE_READ_FAILED,
+		rLocalPath, rRemotePath, false, NumBytes);
+}
+
+void ReportingCompareParams::NotifyDirComparing(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	mrSink.NotifyComparing(wxString(rLocalPath.c_str(), wxConvBoxi),
+		false);
+}
+
+void ReportingCompareParams::NotifyDirCompared(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	bool HasDifferentAttributes, bool modifiedAfterLastSync)
+{
+	if (!HasDifferentAttributes)
+	{
+		return;
+	}
+
+	wxString msg;
+	msg.Printf(_("Local directory '%s' has different "
+		"attributes to store directory '%s'."),
+		wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+		wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+	if (modifiedAfterLastSync)
+	{
+		msg += _(" (modified since the last backup)");
+	}
+	AddDifference(msg, CompareReport::CRK_DIFFERENT_ATTRIBUTES,
+		rLocalPath, rRemotePath, true, -1, modifiedAfterLastSync);
+}
+
+void ReportingCompareParams::NotifyFileComparing(
+	const std::string& rLocalPath, const std::string& rRemotePath)
+{
+	mrSink.NotifyComparing(wxString(rLocalPath.c_str(), wxConvBoxi),
+		true);
+}
+
+void ReportingCompareParams::NotifyFileCompared(
+	const std::string& rLocalPath, const std::string& rRemotePath,
+	int64_t NumBytes, bool HasDifferentAttributes,
+	bool HasDifferentContents, bool modifiedAfterLastSync,
+	bool newAttributesApplied)
+{
+	if (HasDifferentAttributes)
+	{
+		wxString msg;
+		msg.Printf(_("Local file '%s' has different attributes "
+			"to store file '%s'."),
+			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+		if (modifiedAfterLastSync)
+		{
+			msg += _(" (modified since the last backup)");
+		}
+		else if (newAttributesApplied)
+		{
+			msg += _(" (new attributes applied)");
+		}
+		AddDifference(msg, CompareReport::CRK_DIFFERENT_ATTRIBUTES,
+			rLocalPath, rRemotePath, false, NumBytes,
+			modifiedAfterLastSync, newAttributesApplied
+			? "new attributes applied" : "");
+	}
+
+	if (HasDifferentContents)
+	{
+		wxString msg;
+		msg.Printf(_("Local file '%s' has different contents "
+			"to store file '%s'."),
+			wxString(rLocalPath.c_str(), wxConvBoxi).c_str(),
+			wxString(rRemotePath.c_str(), wxConvBoxi).c_str());
+		if (modifiedAfterLastSync)
+		{
+			msg += _(" (modified since the last backup)");
+		}
+		AddDifference(msg, CompareReport::CRK_DIFFERENT_CONTENTS,
+			rLocalPath, rRemotePath, false, NumBytes,
+			modifiedAfterLastSync);
+	}
+
+	mrSink.AddFileDone(NumBytes);
+}
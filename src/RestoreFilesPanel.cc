@@ -24,7 +24,9 @@
 
 #include "SandBox.h"
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 #include <wx/filename.h>
 #include <wx/splitter.h>
@@ -101,11 +103,43 @@ void RestoreSpec::Remove(const RestoreSpecEntry& rOldEntry)
 class RestoreTreeNode : public FileNode
 {
 	private:
+	// A child of the cache node, with the key that it's sorted by
+	// worked out once, instead of on every comparison. The child is
+	// held by its index, because GetChildren() may list the directory
+	// again between pages. That only adds children at the end, but
+	// may move the existing ones, which would leave a pointer dangling.
+	class SortedChild
+	{
+		public:
+		bool             mIsDirectory;
+		wxString         mFileName;
+		size_t           mIndex;
+
+		SortedChild(ServerCacheNode& rCacheNode, size_t index)
+		: mIsDirectory(rCacheNode.GetMostRecent() &&
+			rCacheNode.GetMostRecent()->IsDirectory()),
+		  mFileName(rCacheNode.GetFileName()),
+		  mIndex(index)
+		{ }
+
+		// directories first, then by name
+		bool operator<(const SortedChild& rOther) const
+		{
+			if (mIsDirectory != rOther.mIsDirectory)
+			{
+				return mIsDirectory;
+			}
+			return mFileName.Cmp(rOther.mFileName) < 0;
+		}
+	};
+
 	ServerCacheNode&         mrCacheNode;
 	ServerSettings*          mpServerSettings;
 	const RestoreSpec&       mrRestoreSpec;
 	const RestoreSpecEntry*  mpMatchingEntry;
 	bool                     mIncluded;
+	std::vector<SortedChild> mSortedChildren; // until all are added
+	ServerCacheNode::SafeVector* mpChildren;  // what they're indexes into
 
 	public:
 	RestoreTreeNode
@@ -119,7 +153,8 @@ class RestoreTreeNode : public FileNode
 		mpServerSettings(pServerSettings),
 		mrRestoreSpec   (rRestoreSpec),
 		mpMatchingEntry (NULL),
-		mIncluded       (FALSE)
+		mIncluded       (FALSE),
+		mpChildren      (NULL)
 	{ }
 
 	RestoreTreeNode
@@ -132,7 +167,8 @@ class RestoreTreeNode : public FileNode
 		mpServerSettings(pParent->mpServerSettings),
 		mrRestoreSpec   (pParent->mrRestoreSpec),
 		mpMatchingEntry (NULL),
-		mIncluded       (FALSE)
+		mIncluded       (FALSE),
+		mpChildren      (NULL)
 	{ }
 
 	// bool ShowChildren(wxListCtrl *targetList);
@@ -174,6 +210,13 @@ class RestoreTreeNode : public FileNode
 	bool AddChildren(bool recurse);
 	virtual int UpdateState(FileImageList& rImageList, bool updateParents);
 
+	protected:
+	virtual FileNode* AddChild(FileTree* pTreeCtrl, size_t index);
+	virtual void OnPagingFinished()
+	{
+		std::vector<SortedChild>().swap(mSortedChildren);
+	}
+
 	private:
 	virtual bool _AddChildrenSlow(wxTreeCtrl* pTreeCtrl, bool recurse);
 };
@@ -182,6 +225,7 @@ bool RestoreTreeNode::_AddChildrenSlow(wxTreeCtrl* pTreeCtrl, bool recursive)
 {
 	// delete any existing children of the parent
 	pTreeCtrl->DeleteChildren(GetId());
+	StopPaging();
 
 	ServerCacheNode::SafeVector* pChildren = mrCacheNode.GetChildren();
 	wxASSERT(pChildren);
@@ -190,47 +234,20 @@ bool RestoreTreeNode::_AddChildrenSlow(wxTreeCtrl* pTreeCtrl, bool recursive)
 		return false;
 	}
 
+	mpChildren = pChildren;
+	size_t index = 0;
+
 	for (ServerCacheNode::Iterator i = pChildren->begin();
-		i != pChildren->end(); i++)
+		i != pChildren->end(); i++, index++)
 	{
-		RestoreTreeNode *pNewNode = new RestoreTreeNode(this, *i);
-
-		wxTreeItemId newId = pTreeCtrl->AppendItem(GetId(),
-				pNewNode->GetFileName(), -1, -1, pNewNode);
-		pNewNode->SetId(newId);
-
-		if (pNewNode->IsDeleted())
-		{
-			pTreeCtrl->SetItemTextColour(newId,
-				wxSystemSettings::GetColour(wxSYS_COLOUR_GRAYTEXT));
-		}
-		else
-		{
-			pTreeCtrl->SetItemTextColour(newId,
-				wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOWTEXT));
-		}
-
-		if (pNewNode->IsDirectory())
-		{
-			if (recursive)
-			{
-				bool result = pNewNode->_AddChildrenSlow(pTreeCtrl, false);
-				if (!result)
-				{
-					return false;
-				}
-			}
-			else
-			{
-				pTreeCtrl->SetItemHasChildren(newId, true);
-			}
-		}
+		mSortedChildren.push_back(SortedChild(*i, index));
 	}
 
-	// sort the kids out
-	pTreeCtrl->SortChildren(GetId());
+	// sort the kids out, once, before any are added to the tree
+	std::sort(mSortedChildren.begin(), mSortedChildren.end());
 
-	return TRUE;
+	return StartPaging((FileTree*)pTreeCtrl, mSortedChildren.size(),
+		recursive);
 }
 
 int RestoreTreeNode::UpdateState(FileImageList& rImageList, bool updateParents)
@@ -335,40 +352,39 @@ class RestoreTreeCtrl : public FileTree
 		wxWindowID id,
 		RestoreTreeNode* pRootNode
 	)
-	:	FileTree(pParent, id, pRootNode, _("/ (server root)"))
+	:	FileTree(pParent, id, pRootNode, _("/ (server root)")),
+		mDeletedColour(wxSystemSettings::GetColour(wxSYS_COLOUR_GRAYTEXT))
 	{ }
 
+	const wxColour& GetDeletedColour() const { return mDeletedColour; }
+
 	private:
-	virtual int OnCompareItems(const wxTreeItemId& item1,
-		const wxTreeItemId& item2);
+	wxColour mDeletedColour;
 };
 
-int RestoreTreeCtrl::OnCompareItems(
-	const wxTreeItemId& item1,
-	const wxTreeItemId& item2)
+FileNode* RestoreTreeNode::AddChild(FileTree* pTreeCtrl, size_t index)
 {
-	RestoreTreeNode *pNode1 = (RestoreTreeNode*)GetItemData(item1);
-	RestoreTreeNode *pNode2 = (RestoreTreeNode*)GetItemData(item2);
+	ServerCacheNode& rChild = *(mpChildren->begin() +
+		mSortedChildren[index].mIndex);
+	RestoreTreeNode *pNewNode = new RestoreTreeNode(this, rChild);
 
-	{
-		bool dir1 = pNode1->IsDirectory();
-		bool dir2 = pNode2->IsDirectory();
+	wxTreeItemId newId = pTreeCtrl->AppendItem(GetId(),
+			pNewNode->GetFileName(), -1, -1, pNewNode);
+	pNewNode->SetId(newId);
 
-		if ( dir1 && !dir2 )
-		{
-			return -1;
-		}
-
-		if ( dir2 && !dir1 )
-		{
-			return 1;
-		}
+	// items are drawn in the normal colour unless told otherwise
+	if (pNewNode->IsDeleted())
+	{
+		pTreeCtrl->SetItemTextColour(newId,
+			((RestoreTreeCtrl*)pTreeCtrl)->GetDeletedColour());
 	}
 
-	wxString name1 = pNode1->GetFileName();
-	wxString name2 = pNode2->GetFileName();
+	if (mSortedChildren[index].mIsDirectory)
+	{
+		pTreeCtrl->SetItemHasChildren(newId, true);
+	}
 
-	return name1.CompareTo(name2.wx_str());
+	return pNewNode;
 }
 
 BEGIN_EVENT_TABLE(RestoreFilesPanel, wxPanel)
@@ -571,6 +587,15 @@ void RestoreFilesPanel::OnTreeNodeActivate(wxTreeEvent& event)
 	wxTreeItemId item = event.GetItem();
 	RestoreTreeNode *pNode = (RestoreTreeNode *)(mpTreeCtrl->GetItemData(item));
 
+	if (!pNode)
+	{
+		// placeholder for more entries, added as it comes into view
+		return;
+	}
+
+	// the node's state must be current, to know what to change
+	mpTreeCtrl->FlushStateIcons();
+
 	const RestoreSpecEntry* pEntry = pNode->GetMatchingEntry();
 
 	// does the entry apply specifically to this item?
@@ -56,7 +56,7 @@
 //DECLARE_EVENT_TYPE(myEVT_CLIENT_NOTIFY, -1)
 //DEFINE_EVENT_TYPE(myEVT_CLIENT_NOTIFY)
 
-BEGIN_EVENT_TABLE(RestoreProgressPanel, wxPanel)
+BEGIN_EVENT_TABLE(RestoreProgressPanel, ProgressPanel)
 EVT_BUTTON(wxID_CANCEL, RestoreProgressPanel::OnStopCloseClicked)
 END_EVENT_TABLE()
 
@@ -72,6 +72,7 @@ RestoreProgressPanel::RestoreProgressPanel
   mRestoreRunning(false),
   mRestoreStopRequested(false)
 {
+	AddThroughputChart();
 }
 
 wxFileName MakeLocalPath(wxFileName& base, ServerCacheNode* pTargetNode)
@@ -214,6 +215,8 @@ void RestoreProgressPanel::StartRestore(const RestoreSpec& rSpec,
 
 	Layout();
 	wxYield();
+
+	RunHistory::Run run(RunHistory::RK_RESTORE);
 	
 	try 
 	{
@@ -332,6 +335,7 @@ void RestoreProgressPanel::StartRestore(const RestoreSpec& rSpec,
 			SetSummaryText(_("Restore Interrupted"));
 			ReportFatalError(BM_BACKUP_FAILED_INTERRUPTED,
 				_("Restore interrupted by user"));
+			run.mResult = RunHistory::RR_STOPPED;
 		}
 		else if (!succeeded)
 		{
@@ -342,6 +346,7 @@ void RestoreProgressPanel::StartRestore(const RestoreSpec& rSpec,
 		{
 			SetSummaryText(_("Restore Finished"));
 			mpErrorList->Append(_("Restore Finished"));
+			run.mResult = RunHistory::RR_SUCCEEDED;
 		}
 		
 		mpProgressGauge->Hide();
@@ -374,6 +379,8 @@ void RestoreProgressPanel::StartRestore(const RestoreSpec& rSpec,
 	SetCurrentText(_("Idle (nothing to do)"));
 	mRestoreRunning = false;
 	mRestoreStopRequested = false;
+	StopTiming();
+	RecordRun(mpConfig, run);
 	SetStopButtonLabel(_("Close"));
 }
 
@@ -521,6 +528,7 @@ bool RestoreProgressPanel::RestoreFilesRecursive
 			msg.Printf(_("Failed to restore '%s': not found on server"),
 				pNode->GetFullPath().c_str());
 			mpErrorList->Append(msg);
+			NotifyErrors(1);
 			return false;
 		}
 	}
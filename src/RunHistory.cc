@@ -0,0 +1,442 @@
+/***************************************************************************
+ *            RunHistory.cc
+ *
+ *  Sun Jan 11 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+
+#include <wx/intl.h>
+
+#include "main.h"
+#include "RunHistory.h"
+
+// bumped if the fields on each line ever change
+#define RUN_HISTORY_VERSION 1
+// kept for each kind of run; older ones are dropped
+#define RUN_HISTORY_MAX_RUNS 500
+// past runs that a new one is compared with
+#define RUN_HISTORY_USUAL_RUNS 10
+// a run needs at least this many past runs to compare with
+#define RUN_HISTORY_MIN_USUAL_RUNS 3
+// and must have done this much to be worth comparing
+#define RUN_HISTORY_MIN_FILES 100
+#define RUN_HISTORY_MIN_MILLIS 10000
+// slower than this fraction of the usual speed is worth a warning
+#define RUN_HISTORY_SLOW_RATIO 0.67
+
+double RunHistory::Run::GetFilesPerSecond() const
+{
+	if (mDurationMillis <= 0)
+	{
+		return 0;
+	}
+
+	return (double)mNumFilesScanned * 1000 / mDurationMillis;
+}
+
+RunHistory::RunHistory(const std::string& rFileName)
+: mFileName(rFileName)
+{ }
+
+const char* RunHistory::GetKindName(Kind kind)
+{
+	switch (kind)
+	{
+		case RK_BACKUP:  return "backup";
+		case RK_RESTORE: return "restore";
+		case RK_COMPARE: return "compare";
+	}
+
+	return "unknown";
+}
+
+void RunHistory::WriteRun(FILE* pFile, const Run& rRun)
+{
+	::fprintf(pFile, "%d %d %d %lld %lld %lu %lld %lu %lld %lu %lu %lld\n",
+		RUN_HISTORY_VERSION, (int)rRun.mKind, (int)rRun.mResult,
+		(long long)rRun.mStartTime,
+		(long long)rRun.mDurationMillis,
+		(unsigned long)rRun.mNumFilesScanned,
+		(long long)rRun.mNumBytesScanned,
+		(unsigned long)rRun.mNumFilesUploaded,
+		(long long)rRun.mNumBytesUploaded,
+		(unsigned long)rRun.mNumPatchUploads,
+		(unsigned long)rRun.mNumErrors,
+		(long long)rRun.mPeakMemoryBytes);
+}
+
+bool RunHistory::ReadRun(const char* pLine, Run* pRun)
+{
+	int version, kind, result;
+	long long startTime, duration, bytesScanned, bytesUploaded, peakMemory;
+	unsigned long filesScanned, filesUploaded, patchUploads, errors;
+
+	if (::sscanf(pLine, "%d %d %d %lld %lld %lu %lld %lu %lld %lu %lu %lld",
+		&version, &kind, &result, &startTime, &duration,
+		&filesScanned, &bytesScanned, &filesUploaded, &bytesUploaded,
+		&patchUploads, &errors, &peakMemory) != 12)
+	{
+		return false;
+	}
+
+	if (version != RUN_HISTORY_VERSION ||
+		kind < RK_BACKUP || kind > RK_COMPARE ||
+		result < RR_SUCCEEDED || result > RR_STOPPED)
+	{
+		return false;
+	}
+
+	pRun->mKind             = (Kind)kind;
+	pRun->mResult           = (Result)result;
+	pRun->mStartTime        = (time_t)startTime;
+	pRun->mDurationMillis   = duration;
+	pRun->mNumFilesScanned  = filesScanned;
+	pRun->mNumBytesScanned  = bytesScanned;
+	pRun->mNumFilesUploaded = filesUploaded;
+	pRun->mNumBytesUploaded = bytesUploaded;
+	pRun->mNumPatchUploads  = patchUploads;
+	pRun->mNumErrors        = errors;
+	pRun->mPeakMemoryBytes  = peakMemory;
+	return true;
+}
+
+// A missing file is just an empty history. Lines that can't be read,
+// such as a partial line from a crash, are skipped.
+bool RunHistory::ReadAll(std::vector<Run>* pRuns) const
+{
+	pRuns->clear();
+
+	FILE* pFile = ::fopen(mFileName.c_str(), "r");
+	if (pFile == NULL)
+	{
+		return true;
+	}
+
+	char line[256];
+	while (::fgets(line, sizeof(line), pFile) != NULL)
+	{
+		Run run;
+		if (ReadRun(line, &run))
+		{
+			pRuns->push_back(run);
+		}
+	}
+
+	bool ok = !::ferror(pFile);
+	::fclose(pFile);
+	return ok;
+}
+
+// Writes a new file alongside the old one and renames it into place,
+// so that a crash part way through doesn't lose the whole history.
+bool RunHistory::WriteAll(const std::vector<Run>& rRuns) const
+{
+	std::string tempName = mFileName + ".new";
+
+	FILE* pFile = ::fopen(tempName.c_str(), "w");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	for (std::vector<Run>::const_iterator i = rRuns.begin();
+		i != rRuns.end(); i++)
+	{
+		WriteRun(pFile, *i);
+	}
+
+	bool ok = !::ferror(pFile);
+	if (::fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+
+	if (!ok)
+	{
+		::remove(tempName.c_str());
+		return false;
+	}
+
+	#ifdef WIN32
+	// rename() won't replace an existing file on Windows
+	::remove(mFileName.c_str());
+	#endif
+
+	return ::rename(tempName.c_str(), mFileName.c_str()) == 0;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHistory::Add(const Run& rRun)
+//		Purpose: Records a finished run, at the end of the history.
+//			 Once there are more than twice as many runs of its
+//			 kind as are kept, the oldest are dropped, so the
+//			 file only has to be rewritten now and then. Returns
+//			 false if the history can't be written.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool RunHistory::Add(const Run& rRun)
+{
+	FILE* pFile = ::fopen(mFileName.c_str(), "a");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	WriteRun(pFile, rRun);
+
+	bool ok = !::ferror(pFile);
+	if (::fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+
+	if (!ok)
+	{
+		return false;
+	}
+
+	std::vector<Run> runs;
+	if (!ReadAll(&runs))
+	{
+		return false;
+	}
+
+	size_t numOfKind = 0;
+	for (std::vector<Run>::const_iterator i = runs.begin();
+		i != runs.end(); i++)
+	{
+		if (i->mKind == rRun.mKind)
+		{
+			numOfKind++;
+		}
+	}
+
+	if (numOfKind <= RUN_HISTORY_MAX_RUNS * 2)
+	{
+		return true;
+	}
+
+	// Keep the newest RUN_HISTORY_MAX_RUNS of this kind, and all
+	// of the others, in their original order
+	size_t numToDrop = numOfKind - RUN_HISTORY_MAX_RUNS;
+	std::vector<Run> kept;
+
+	for (std::vector<Run>::const_iterator i = runs.begin();
+		i != runs.end(); i++)
+	{
+		if (i->mKind == rRun.mKind && numToDrop > 0)
+		{
+			numToDrop--;
+			continue;
+		}
+
+		kept.push_back(*i);
+	}
+
+	return WriteAll(kept);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHistory::GetRuns(Kind kind, time_t since,
+//			 std::vector<Run>* pRuns)
+//		Purpose: Fills pRuns with the recorded runs of the given
+//			 kind that started at or after since, oldest first.
+//			 Returns false if the history exists but can't be
+//			 read.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool RunHistory::GetRuns(Kind kind, time_t since, std::vector<Run>* pRuns)
+	const
+{
+	std::vector<Run> runs;
+	if (!ReadAll(&runs))
+	{
+		return false;
+	}
+
+	pRuns->clear();
+
+	for (std::vector<Run>::const_iterator i = runs.begin();
+		i != runs.end(); i++)
+	{
+		if (i->mKind == kind && i->mStartTime >= since)
+		{
+			pRuns->push_back(*i);
+		}
+	}
+
+	return true;
+}
+
+static bool IsComparable(const RunHistory::Run& rRun)
+{
+	return rRun.mResult == RunHistory::RR_SUCCEEDED &&
+		rRun.mNumFilesScanned >= RUN_HISTORY_MIN_FILES &&
+		rRun.mDurationMillis >= RUN_HISTORY_MIN_MILLIS;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHistory::IsSlowerThanUsual(const Run& rRun,
+//			 double* pUsualFilesPerSecond)
+//		Purpose: Compares the speed of a run, in files scanned per
+//			 second, with the median of the last few successful
+//			 runs of the same kind, and returns true if it was
+//			 much slower. The median is returned in
+//			 *pUsualFilesPerSecond, or 0 if there weren't enough
+//			 runs to tell. Short runs and ones that didn't
+//			 finish are never compared, because their speed
+//			 doesn't mean much.
+//
+//			 Should be called before the run itself is added.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+bool RunHistory::IsSlowerThanUsual(const Run& rRun,
+	double* pUsualFilesPerSecond) const
+{
+	*pUsualFilesPerSecond = 0;
+
+	if (!IsComparable(rRun))
+	{
+		return false;
+	}
+
+	std::vector<Run> runs;
+	if (!GetRuns(rRun.mKind, 0, &runs))
+	{
+		return false;
+	}
+
+	std::vector<double> speeds;
+
+	for (std::vector<Run>::reverse_iterator i = runs.rbegin();
+		i != runs.rend() && speeds.size() < RUN_HISTORY_USUAL_RUNS; i++)
+	{
+		if (IsComparable(*i))
+		{
+			speeds.push_back(i->GetFilesPerSecond());
+		}
+	}
+
+	if (speeds.size() < RUN_HISTORY_MIN_USUAL_RUNS)
+	{
+		return false;
+	}
+
+	std::sort(speeds.begin(), speeds.end());
+	size_t middle = speeds.size() / 2;
+	double median = (speeds.size() % 2) ? speeds[middle]
+		: (speeds[middle - 1] + speeds[middle]) / 2;
+
+	*pUsualFilesPerSecond = median;
+	return rRun.GetFilesPerSecond() < median * RUN_HISTORY_SLOW_RATIO;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHistory::RecordAndCheck(const Run& rRun,
+//			 wxString* pWarning, wxString* pError)
+//		Purpose: Compares a finished run with the usual speed of
+//			 its kind, and then adds it to the history. Returns
+//			 true if it was much slower than usual, with a
+//			 message to show the user in *pWarning. If the run
+//			 can't be recorded, says why in *pError. Both are
+//			 left empty otherwise.
+//		Created: 2009/01/23
+//
+// --------------------------------------------------------------------------
+bool RunHistory::RecordAndCheck(const Run& rRun, wxString* pWarning,
+	wxString* pError)
+{
+	pWarning->Clear();
+	pError->Clear();
+
+	double usualFilesPerSecond;
+	bool isSlow = IsSlowerThanUsual(rRun, &usualFilesPerSecond);
+
+	if (isSlow)
+	{
+		pWarning->Printf(_("Warning: this %s ran at %.1f files per "
+			"second, much slower than the usual %.1f"),
+			wxString(GetKindName(rRun.mKind), wxConvBoxi).c_str(),
+			rRun.GetFilesPerSecond(), usualFilesPerSecond);
+	}
+
+	if (!Add(rRun))
+	{
+		pError->Printf(_("Failed to record this run in the history: "
+			"%s"), wxString(strerror(errno), wxConvBoxi).c_str());
+	}
+
+	return isSlow;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHistory::GetPeakMemoryBytes()
+//		Purpose: Returns the most memory that this process has used
+//			 so far, in bytes, or -1 if that can't be found out
+//			 on this platform. It never goes down, so the peak
+//			 recorded for a run is the highest of that run and
+//			 any before it in the same session.
+//		Created: 2009/01/11
+//
+// --------------------------------------------------------------------------
+int64_t RunHistory::GetPeakMemoryBytes()
+{
+	#ifdef WIN32
+	return -1;
+	#else
+	struct rusage usage;
+	if (::getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return -1;
+	}
+
+	#ifdef __APPLE__
+	return usage.ru_maxrss;
+	#else
+	// in kilobytes on Linux and the BSDs
+	return (int64_t)usage.ru_maxrss * 1024;
+	#endif
+	#endif
+}
@@ -0,0 +1,487 @@
+/***************************************************************************
+ *            ScheduleSimulator.cc
+ *
+ *  Tue Jan 13 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "ScheduleSimulator.h"
+
+// how fast bbackupd is assumed to diff a file, for MaximumDiffingTime
+#define SIM_DIFF_BYTES_PER_SECOND (4 * 1024 * 1024)
+// clients are simulated in at most this many groups, each group
+// syncing at a different point in the interval
+#define SIM_MAX_CLIENT_GROUPS 60
+#define SIM_STORE_LOAD_BUCKET_SECONDS 60
+
+ScheduleSimulator::ScheduleSimulator()
+{ }
+
+static bool ChangeTimeLess(const ScheduleSimulator::Change& rA,
+	const ScheduleSimulator::Change& rB)
+{
+	return rA.mTime < rB.mTime;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ScheduleSimulator::LoadTrace(
+//			 const std::string& rFileName, std::string* pError)
+//		Purpose: Replaces the trace with the one in the named file.
+//			 Returns false, with a message in *pError, if the
+//			 file can't be read or a line isn't understood.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+bool ScheduleSimulator::LoadTrace(const std::string& rFileName,
+	std::string* pError)
+{
+	FILE* pFile = ::fopen(rFileName.c_str(), "r");
+	if (pFile == NULL)
+	{
+		*pError = rFileName + ": " + strerror(errno);
+		return false;
+	}
+
+	mTrace.clear();
+
+	char buffer[4096];
+	int lineNum = 0;
+	bool ok = true;
+
+	while (::fgets(buffer, sizeof(buffer), pFile) != NULL)
+	{
+		lineNum++;
+
+		size_t length = strlen(buffer);
+		while (length > 0 && (buffer[length - 1] == '\n' ||
+			buffer[length - 1] == '\r'))
+		{
+			buffer[--length] = 0;
+		}
+
+		size_t start = strspn(buffer, " \t");
+		if (buffer[start] == 0 || buffer[start] == '#')
+		{
+			continue;
+		}
+
+		long long time, size, changedBytes;
+		int pathStart = 0;
+
+		if (::sscanf(buffer, "%lld %lld %lld %n", &time, &size,
+			&changedBytes, &pathStart) != 3 || pathStart == 0 ||
+			buffer[pathStart] == 0 || size < 0 ||
+			changedBytes < 0 || changedBytes > size)
+		{
+			char message[64];
+			::sprintf(message, ": line %d is not a valid change",
+				lineNum);
+			*pError = rFileName + message;
+			ok = false;
+			break;
+		}
+
+		mTrace.push_back(Change(time, size, changedBytes,
+			buffer + pathStart));
+	}
+
+	if (ok && ::ferror(pFile))
+	{
+		*pError = rFileName + ": " + strerror(errno);
+		ok = false;
+	}
+
+	::fclose(pFile);
+
+	std::stable_sort(mTrace.begin(), mTrace.end(), ChangeTimeLess);
+	return ok;
+}
+
+// A small generator of our own, so that the same seed gives the same
+// trace everywhere. Returns a number from 0 up to but not including 1.
+static double NextRandom(uint32_t* pState)
+{
+	*pState = *pState * 1664525 + 1013904223;
+	return (double)(*pState >> 8) / (1 << 24);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ScheduleSimulator::GenerateTrace(size_t numFiles,
+//			 int64_t durationSeconds, unsigned int seed)
+//		Purpose: Replaces the trace with a made-up one, of numFiles
+//			 files changing over durationSeconds. Sizes range
+//			 from 1 kB to 64 MB, evenly on a log scale. Most
+//			 files change about once a week, some about once a
+//			 day, and a few (like mailboxes) every 20 minutes or
+//			 so, and never stay still for long. One in ten is
+//			 created during the trace rather than being on the
+//			 store already.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+void ScheduleSimulator::GenerateTrace(size_t numFiles,
+	int64_t durationSeconds, unsigned int seed)
+{
+	uint32_t state = seed;
+	mTrace.clear();
+
+	for (size_t i = 0; i < numFiles; i++)
+	{
+		char path[32];
+		::sprintf(path, "synthetic/%06lu", (unsigned long)i);
+
+		int64_t size = (int64_t)exp(log(1024.0) +
+			NextRandom(&state) * (log(64.0 * 1024 * 1024) -
+			log(1024.0)));
+
+		double kind = NextRandom(&state);
+		double meanInterval = 7 * 86400;
+		double changeFraction = 0.05;
+
+		if (kind < 0.05)
+		{
+			meanInterval = 20 * 60;
+			changeFraction = 0.01;
+		}
+		else if (kind < 0.25)
+		{
+			meanInterval = 86400;
+		}
+
+		double time = 0;
+
+		if (NextRandom(&state) < 0.1)
+		{
+			time = NextRandom(&state) * durationSeconds;
+			mTrace.push_back(Change((int64_t)time, size, size,
+				path));
+		}
+
+		while (true)
+		{
+			time -= log(1 - NextRandom(&state)) * meanInterval;
+			if (time >= durationSeconds)
+			{
+				break;
+			}
+
+			int64_t changed = (int64_t)(size * changeFraction *
+				(0.5 + NextRandom(&state))) + 1;
+			if (changed > size)
+			{
+				changed = size;
+			}
+
+			mTrace.push_back(Change((int64_t)time, size, changed,
+				path));
+		}
+	}
+
+	std::stable_sort(mTrace.begin(), mTrace.end(), ChangeTimeLess);
+}
+
+// A file that has changed since it was last uploaded
+class PendingFile
+{
+	public:
+	int64_t mLastChanged;
+	int64_t mFirstDeferred; // or -1 if not deferred yet
+	int64_t mSize;
+	int64_t mChangedBytes;
+	bool    mOnStore;
+
+	PendingFile()
+	: mLastChanged(0),
+	  mFirstDeferred(-1),
+	  mSize(0),
+	  mChangedBytes(0),
+	  mOnStore(false)
+	{ }
+};
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ScheduleSimulator::Run(const Settings& rSettings,
+//			 int64_t syncOffset, std::vector<Sync>* pSyncs)
+//		Purpose: Replays the trace for one client, whose syncs
+//			 start syncOffset seconds after the first change,
+//			 and returns what each sync would upload. Runs on
+//			 until everything changed has been uploaded.
+//
+//			 As in bbackupd, a file is uploaded once it hasn't
+//			 changed for MinimumFileAge, or once MaxUploadWait
+//			 has passed since a sync first put it off. A file
+//			 already on the store is diffed if it's at least
+//			 DiffingUploadSizeThreshold bytes, unless diffing it
+//			 would take longer than MaximumDiffingTime, and then
+//			 only the changed bytes are counted.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+void ScheduleSimulator::Run(const Settings& rSettings, int64_t syncOffset,
+	std::vector<Sync>* pSyncs) const
+{
+	pSyncs->clear();
+
+	if (mTrace.empty())
+	{
+		return;
+	}
+
+	int64_t interval = rSettings.mUpdateStoreInterval;
+	if (interval < 1)
+	{
+		interval = 1;
+	}
+
+	int64_t start = mTrace.front().mTime;
+	int64_t end = mTrace.back().mTime + rSettings.mMinimumFileAge +
+		interval;
+
+	std::map<std::string, PendingFile> pending;
+	std::set<std::string> uploaded;
+	std::vector<Change>::const_iterator pNext = mTrace.begin();
+
+	for (int64_t now = start + syncOffset; now <= end; now += interval)
+	{
+		for (; pNext != mTrace.end() && pNext->mTime <= now; pNext++)
+		{
+			std::pair<std::map<std::string, PendingFile>::iterator,
+				bool> inserted = pending.insert(std::make_pair(
+				pNext->mPath, PendingFile()));
+			PendingFile& rFile(inserted.first->second);
+
+			if (inserted.second)
+			{
+				rFile.mOnStore = uploaded.count(pNext->mPath) > 0
+					|| pNext->mChangedBytes < pNext->mSize;
+			}
+
+			rFile.mLastChanged = pNext->mTime;
+			rFile.mSize = pNext->mSize;
+			rFile.mChangedBytes += pNext->mChangedBytes;
+			if (rFile.mChangedBytes > rFile.mSize)
+			{
+				rFile.mChangedBytes = rFile.mSize;
+			}
+		}
+
+		Sync sync(now);
+
+		for (std::map<std::string, PendingFile>::iterator
+			i = pending.begin(); i != pending.end(); )
+		{
+			PendingFile& rFile(i->second);
+			bool forced = false;
+
+			if (now - rFile.mLastChanged < rSettings.mMinimumFileAge)
+			{
+				if (rFile.mFirstDeferred == -1)
+				{
+					rFile.mFirstDeferred = now;
+				}
+
+				if (now - rFile.mFirstDeferred <
+					rSettings.mMaxUploadWait)
+				{
+					sync.mNumDeferred++;
+					i++;
+					continue;
+				}
+
+				forced = true;
+			}
+
+			bool diff = rFile.mOnStore && rFile.mSize >=
+				rSettings.mDiffingUploadSizeThreshold;
+
+			if (diff && rSettings.mMaximumDiffingTime > 0 &&
+				rFile.mSize > (int64_t)rSettings.mMaximumDiffingTime
+				* SIM_DIFF_BYTES_PER_SECOND)
+			{
+				diff = false;
+			}
+
+			if (diff)
+			{
+				sync.mNumDiffUploads++;
+				sync.mBytesUploaded += rFile.mChangedBytes;
+			}
+			else
+			{
+				sync.mNumFullUploads++;
+				sync.mBytesUploaded += rFile.mSize;
+			}
+
+			if (forced)
+			{
+				sync.mNumForcedUploads++;
+			}
+
+			uploaded.insert(i->first);
+			pending.erase(i++);
+		}
+
+		pSyncs->push_back(sync);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ScheduleSimulator::GetStoreLoad(
+//			 const Settings& rSettings, size_t numClients,
+//			 StoreLoad* pLoad)
+//		Purpose: Estimates the load on a store shared by numClients
+//			 clients, all making the same changes at the same
+//			 times, but with their syncs spread evenly over the
+//			 interval, as they would be if started at random.
+//			 Each sync's upload is counted in the minute that it
+//			 starts.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+void ScheduleSimulator::GetStoreLoad(const Settings& rSettings,
+	size_t numClients, StoreLoad* pLoad) const
+{
+	*pLoad = StoreLoad();
+	pLoad->mNumClients = numClients;
+
+	if (mTrace.empty() || numClients == 0)
+	{
+		return;
+	}
+
+	size_t numGroups = numClients;
+	if (numGroups > SIM_MAX_CLIENT_GROUPS)
+	{
+		numGroups = SIM_MAX_CLIENT_GROUPS;
+	}
+
+	int64_t interval = rSettings.mUpdateStoreInterval;
+	if (interval < 1)
+	{
+		interval = 1;
+	}
+
+	int64_t start = mTrace.front().mTime;
+
+	// bytes and uploading clients, by minute since the start
+	std::map<int64_t, std::pair<int64_t, size_t> > buckets;
+	std::vector<Sync> syncs;
+
+	for (size_t group = 0; group < numGroups; group++)
+	{
+		size_t groupSize = numClients / numGroups +
+			(group < numClients % numGroups ? 1 : 0);
+		Run(rSettings, interval * group / numGroups, &syncs);
+
+		for (std::vector<Sync>::iterator i = syncs.begin();
+			i != syncs.end(); i++)
+		{
+			if (i->mBytesUploaded == 0)
+			{
+				continue;
+			}
+
+			std::pair<int64_t, size_t>& rBucket(buckets[(i->mTime -
+				start) / SIM_STORE_LOAD_BUCKET_SECONDS]);
+			rBucket.first  += i->mBytesUploaded * groupSize;
+			rBucket.second += groupSize;
+		}
+	}
+
+	for (std::map<int64_t, std::pair<int64_t, size_t> >::iterator
+		i = buckets.begin(); i != buckets.end(); i++)
+	{
+		if (i->second.first > pLoad->mPeakBytesPerMinute)
+		{
+			pLoad->mPeakBytesPerMinute = i->second.first;
+			pLoad->mPeakTime = start +
+				i->first * SIM_STORE_LOAD_BUCKET_SECONDS;
+		}
+
+		if (i->second.second > pLoad->mPeakUploadingClients)
+		{
+			pLoad->mPeakUploadingClients = i->second.second;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    ScheduleSimulator::WriteCsv(
+//			 const std::vector<Sync>& rSyncs,
+//			 const std::string& rFileName)
+//		Purpose: Writes the result of Run() to a CSV file, one line
+//			 per sync. Returns false if the file can't be
+//			 written.
+//		Created: 2009/01/13
+//
+// --------------------------------------------------------------------------
+bool ScheduleSimulator::WriteCsv(const std::vector<Sync>& rSyncs,
+	const std::string& rFileName)
+{
+	FILE* pFile = ::fopen(rFileName.c_str(), "w");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+
+	::fputs("time_seconds,full_uploads,diff_uploads,forced_uploads,"
+		"deferred_files,bytes_uploaded\n", pFile);
+
+	for (std::vector<Sync>::const_iterator i = rSyncs.begin();
+		i != rSyncs.end(); i++)
+	{
+		::fprintf(pFile, "%lld,%lu,%lu,%lu,%lu,%lld\n",
+			(long long)i->mTime,
+			(unsigned long)i->mNumFullUploads,
+			(unsigned long)i->mNumDiffUploads,
+			(unsigned long)i->mNumForcedUploads,
+			(unsigned long)i->mNumDeferred,
+			(long long)i->mBytesUploaded);
+	}
+
+	bool ok = !::ferror(pFile);
+	if (::fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+
+	return ok;
+}
@@ -74,8 +74,15 @@ void ServerConnection::HandleException(message_t code, const wxString& when,
 		msg.Append(wxString(e.what(), wxConvBoxi));
 	}
 
-	wxGetApp().ShowMessageBox(code, msg, _("Boxi Error"),
-		wxOK | wxICON_ERROR, NULL);
+	mErrorMessage = msg;
+
+	// There is no application object when running headless from
+	// the command line, so the caller must report the error.
+	if (wxTheApp != NULL)
+	{
+		wxGetApp().ShowMessageBox(code, msg, _("Boxi Error"),
+			wxOK | wxICON_ERROR, NULL);
+	}
 
 	if (e.GetType() == ConnectionException::ExceptionType &&
 		e.GetSubType() == ConnectionException::TLSReadFailed)
@@ -0,0 +1,461 @@
+/***************************************************************************
+ *            SizeEstimator.cc
+ *
+ *  Thu Jan  8 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Contains software developed by Ben Summers.
+ * YOU MUST NOT REMOVE THIS ATTRIBUTION!
+ */
+
+#include "SandBox.h"
+
+#include <memory>
+
+#include <wx/log.h>
+
+#include "main.h"
+#include "ExcludeRules.h"
+#include "SizeEstimator.h"
+
+BoxiSizeEstimator::ScannedDir::~ScannedDir()
+{
+	for (std::vector<ScannedDir*>::iterator i = mSubDirs.begin();
+		i != mSubDirs.end(); i++)
+	{
+		delete *i;
+	}
+}
+
+BoxiSizeEstimator::Job::Job(const BoxiLocation& rLocation)
+: mName(wxCharBuffer(rLocation.GetName().mb_str(wxConvBoxi)).data()),
+  mPath(wxCharBuffer(rLocation.GetPath().mb_str(wxConvBoxi)).data()),
+  mEntries(rLocation.GetExcludeList().GetEntries()),
+  mRulesGeneration(rLocation.GetExcludeList().GetGeneration()),
+  mpRules(NULL)
+{
+	mpRules = new BoxiExcludeRules(mEntries);
+}
+
+BoxiSizeEstimator::Job::~Job()
+{
+	delete mpRules;
+}
+
+BoxiSizeEstimator::BoxiSizeEstimator()
+: wxThread(wxTHREAD_JOINABLE),
+  mMutex(),
+  mCondition(mMutex),
+  mScansInvalid(false),
+  mStopRequested(false),
+  mStarted(false),
+  mStartFailed(false)
+{ }
+
+BoxiSizeEstimator::~BoxiSizeEstimator()
+{
+	Stop();
+	ClearScans();
+
+	for (std::map<std::string, Job*>::iterator i = mPendingJobs.begin();
+		i != mPendingJobs.end(); i++)
+	{
+		delete i->second;
+	}
+}
+
+void BoxiSizeEstimator::ClearScans()
+{
+	for (std::map<std::string, ScannedDir*>::iterator i = mScans.begin();
+		i != mScans.end(); i++)
+	{
+		delete i->second;
+	}
+
+	mScans.clear();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiSizeEstimator::Request(const BoxiLocation& rLocation)
+//		Purpose: Asks for the location to be estimated with its
+//			 current exclude entries, unless that has already
+//			 been done or asked for. A request replaces any
+//			 earlier one for the same location which hasn't
+//			 started yet. Starts the worker thread on first use.
+//			 Returns false if the worker couldn't be started.
+//		Created: 2009/01/08
+//
+// --------------------------------------------------------------------------
+bool BoxiSizeEstimator::Request(const BoxiLocation& rLocation)
+{
+	if (mStartFailed)
+	{
+		return false;
+	}
+
+	std::string name =
+		wxCharBuffer(rLocation.GetName().mb_str(wxConvBoxi)).data();
+	unsigned long generation = rLocation.GetExcludeList().GetGeneration();
+
+	{
+		wxMutexLocker lock(mMutex);
+
+		std::map<std::string, Estimate>::iterator done =
+			mEstimates.find(name);
+		if (done != mEstimates.end() &&
+			done->second.mRulesGeneration == generation)
+		{
+			return true;
+		}
+
+		std::map<std::string, Job*>::iterator pending =
+			mPendingJobs.find(name);
+		if (pending != mPendingJobs.end() &&
+			pending->second->mRulesGeneration == generation)
+		{
+			return true;
+		}
+	}
+
+	// compiling the rules may take a while, and log errors, so do it
+	// without holding the lock
+	Job* pJob = new Job(rLocation);
+
+	{
+		wxMutexLocker lock(mMutex);
+
+		Job*& rpPending = mPendingJobs[name];
+		delete rpPending;
+		rpPending = pJob;
+		mCondition.Signal();
+	}
+
+	if (!mStarted)
+	{
+		if (Create() != wxTHREAD_NO_ERROR ||
+			Run() != wxTHREAD_NO_ERROR)
+		{
+			wxLogError(_("Failed to start the backup size "
+				"estimator thread"));
+			mStartFailed = true;
+			return false;
+		}
+
+		mStarted = true;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiSizeEstimator::Invalidate()
+//		Purpose: Forgets all estimates, and the cached directory
+//			 trees, so that the next request for each location
+//			 reads it from disk again. Called when the locations
+//			 change, as a location's path may have changed.
+//		Created: 2009/01/08
+//
+// --------------------------------------------------------------------------
+void BoxiSizeEstimator::Invalidate()
+{
+	wxMutexLocker lock(mMutex);
+	mEstimates.clear();
+	mScansInvalid = true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BoxiSizeEstimator::GetEstimate(
+//			 const wxString& rLocationName, Estimate* pEstimate)
+//		Purpose: Copies the most recent estimate for the named
+//			 location into *pEstimate, and returns true, or
+//			 returns false if there isn't one yet. Compare its
+//			 mRulesGeneration with the exclude list's to see
+//			 whether it's up to date.
+//		Created: 2009/01/08
+//
+// --------------------------------------------------------------------------
+bool BoxiSizeEstimator::GetEstimate(const wxString& rLocationName,
+	Estimate* pEstimate)
+{
+	std::string name = wxCharBuffer(rLocationName.mb_str(wxConvBoxi)).data();
+
+	wxMutexLocker lock(mMutex);
+
+	std::map<std::string, Estimate>::iterator i = mEstimates.find(name);
+	if (i == mEstimates.end())
+	{
+		return false;
+	}
+
+	*pEstimate = i->second;
+	return true;
+}
+
+// Stops the worker, abandoning any scan in progress, and waits for it.
+void BoxiSizeEstimator::Stop()
+{
+	if (!mStarted)
+	{
+		return;
+	}
+
+	{
+		wxMutexLocker lock(mMutex);
+		mStopRequested = true;
+		mCondition.Broadcast();
+	}
+
+	Wait();
+	mStarted = false;
+}
+
+bool BoxiSizeEstimator::IsStopRequested()
+{
+	wxMutexLocker lock(mMutex);
+	return mStopRequested;
+}
+
+void* BoxiSizeEstimator::Entry()
+{
+	while (true)
+	{
+		std::auto_ptr<Job> apJob;
+		bool scansInvalid;
+
+		{
+			wxMutexLocker lock(mMutex);
+			while (mPendingJobs.empty() && !mStopRequested)
+			{
+				mCondition.Wait();
+			}
+
+			if (mStopRequested)
+			{
+				break;
+			}
+
+			apJob.reset(mPendingJobs.begin()->second);
+			mPendingJobs.erase(mPendingJobs.begin());
+
+			scansInvalid = mScansInvalid;
+			mScansInvalid = false;
+		}
+
+		if (scansInvalid)
+		{
+			ClearScans();
+		}
+
+		ScannedDir* pRoot = GetScan(apJob->mPath);
+		if (!pRoot)
+		{
+			// stopped while scanning
+			break;
+		}
+
+		std::map<const BoxiExcludeEntry*, size_t> indexes;
+		size_t index = 0;
+		for (BoxiExcludeEntry::ConstIterator
+			pEntry  = apJob->mEntries.begin();
+			pEntry != apJob->mEntries.end(); pEntry++, index++)
+		{
+			indexes[&(*pEntry)] = index;
+		}
+
+		Estimate estimate;
+		estimate.mRulesGeneration = apJob->mRulesGeneration;
+		estimate.mRuleNumFiles.resize(apJob->mEntries.size(), 0);
+		estimate.mRuleNumBytes.resize(apJob->mEntries.size(), 0);
+		Evaluate(apJob->mPath, *pRoot, *(apJob->mpRules), indexes,
+			&estimate);
+
+		wxMutexLocker lock(mMutex);
+		if (!mScansInvalid)
+		{
+			// otherwise it may be based on an out of date scan
+			mEstimates[apJob->mName] = estimate;
+		}
+	}
+
+	return NULL;
+}
+
+// Returns the cached tree for the path, reading it from disk the first
+// time, or NULL if the worker was asked to stop while reading it.
+BoxiSizeEstimator::ScannedDir* BoxiSizeEstimator::GetScan(
+	const std::string& rPath)
+{
+	std::map<std::string, ScannedDir*>::iterator i = mScans.find(rPath);
+	if (i != mScans.end())
+	{
+		return i->second;
+	}
+
+	ScannedDir* pRoot = new ScannedDir(rPath);
+	if (!ScanDirectory(rPath, pRoot))
+	{
+		delete pRoot;
+		return NULL;
+	}
+
+	mScans[rPath] = pRoot;
+	return pRoot;
+}
+
+bool BoxiSizeEstimator::ScanDirectory(const std::string& rLocalPath,
+	ScannedDir* pDir)
+{
+	if (IsStopRequested())
+	{
+		return false;
+	}
+
+	DIR *dirHandle = ::opendir(rLocalPath.c_str());
+	if (dirHandle == 0)
+	{
+		// Ignore this directory, as CountLocalFiles does.
+		return true;
+	}
+
+	bool completed = true;
+
+	try
+	{
+		struct dirent *en = 0;
+		EMU_STRUCT_STAT st;
+
+		while ((en = ::readdir(dirHandle)) != 0)
+		{
+			if (en->d_name[0] == '.' &&
+				(en->d_name[1] == '\0' ||
+				(en->d_name[1] == '.' && en->d_name[2] == '\0')))
+			{
+				// ignore, it's . or ..
+				continue;
+			}
+
+			std::string localPath = rLocalPath +
+				DIRECTORY_SEPARATOR + en->d_name;
+
+			if (EMU_LSTAT(localPath.c_str(), &st) != 0)
+			{
+				continue;
+			}
+
+			if ((st.st_mode & S_IFMT) == S_IFDIR)
+			{
+				ScannedDir* pSubDir = new ScannedDir(en->d_name);
+				pDir->mSubDirs.push_back(pSubDir);
+
+				if (!ScanDirectory(localPath, pSubDir))
+				{
+					completed = false;
+					break;
+				}
+
+				pDir->mTotalFiles += pSubDir->mTotalFiles;
+				pDir->mTotalBytes += pSubDir->mTotalBytes;
+			}
+			else
+			{
+				pDir->mFiles.push_back(ScannedFile(en->d_name,
+					st.st_size));
+				pDir->mTotalFiles++;
+				pDir->mTotalBytes += st.st_size;
+			}
+		}
+	}
+	catch (...)
+	{
+		::closedir(dirHandle);
+		throw;
+	}
+
+	::closedir(dirHandle);
+	return completed;
+}
+
+// Applies the rules to the cached tree as bbackupd would, without
+// looking inside excluded directories. The whole contents of a
+// directory are charged to the entry that excluded it or, if an
+// AlwaysInclude entry saved it, to that entry, even though some of
+// its contents may still be excluded by other entries.
+void BoxiSizeEstimator::Evaluate(const std::string& rLocalPath,
+	const ScannedDir& rDir, const BoxiExcludeRules& rRules,
+	const std::map<const BoxiExcludeEntry*, size_t>& rIndexes,
+	Estimate* pEstimate)
+{
+	const BoxiExcludeEntry* pExcludedBy;
+	const BoxiExcludeEntry* pIncludedBy;
+
+	for (std::vector<ScannedFile>::const_iterator i = rDir.mFiles.begin();
+		i != rDir.mFiles.end(); i++)
+	{
+		std::string localPath = rLocalPath + DIRECTORY_SEPARATOR +
+			i->mName;
+		rRules.Match(localPath, false, &pExcludedBy, &pIncludedBy);
+
+		if (pExcludedBy)
+		{
+			size_t index = rIndexes.find(pIncludedBy
+				? pIncludedBy : pExcludedBy)->second;
+			pEstimate->mRuleNumFiles[index]++;
+			pEstimate->mRuleNumBytes[index] += i->mSize;
+
+			if (!pIncludedBy)
+			{
+				continue;
+			}
+		}
+
+		pEstimate->mNumFiles++;
+		pEstimate->mNumBytes += i->mSize;
+	}
+
+	for (std::vector<ScannedDir*>::const_iterator i = rDir.mSubDirs.begin();
+		i != rDir.mSubDirs.end(); i++)
+	{
+		const ScannedDir& rSubDir(**i);
+		std::string localPath = rLocalPath + DIRECTORY_SEPARATOR +
+			rSubDir.mName;
+		rRules.Match(localPath, true, &pExcludedBy, &pIncludedBy);
+
+		if (pExcludedBy)
+		{
+			size_t index = rIndexes.find(pIncludedBy
+				? pIncludedBy : pExcludedBy)->second;
+			pEstimate->mRuleNumFiles[index] += rSubDir.mTotalFiles;
+			pEstimate->mRuleNumBytes[index] += rSubDir.mTotalBytes;
+
+			if (!pIncludedBy)
+			{
+				continue;
+			}
+		}
+
+		Evaluate(localPath, rSubDir, rRules, rIndexes, pEstimate);
+	}
+}
@@ -41,6 +41,7 @@
 #include "main.h"
 #include "BoxiApp.h"
 #include "ClientConfig.h"
+#include "FileTree.h"
 #include "MainFrame.h"
 #include "TestBackupConfig.h"
 
@@ -204,7 +205,7 @@ void TestBackupConfig::RunTest()
 	#endif
 	
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(), 
-		mpTree->GetItemImage(rootId));
+		GetStateIcon(mpTree, rootId));
 		
 	mpLocationsListBox = wxDynamicCast
 	(
@@ -342,6 +343,14 @@ void TestBackupConfig::RunTest()
 	mTestDataDir = wxFileName(mTestDataDir.GetFullPath(), wxT(""));
 	wxCharBuffer buf = mTestDataDir.GetFullPath().mb_str();
 	CPPUNIT_ASSERT_MESSAGE(buf.data(), mTestDataDir.Mkdir(0700));
+
+	// another location next to testdata, whose nodes should not be
+	// affected by changes to the testdata location
+	mTestOtherDir = wxFileName(mTempDir.GetFullPath(), _("other"));
+	mTestOtherDir = wxFileName(mTestOtherDir.GetFullPath(), wxT(""));
+	CPPUNIT_ASSERT(mTestOtherDir.Mkdir(0700));
+	CPPUNIT_ASSERT(wxFile().Create(wxFileName(mTestOtherDir.GetFullPath(),
+		_("otherfile")).GetFullPath()));
 	
 	// will be changed in the block below
 	mTestDataDirItem = rootId;
@@ -432,6 +441,16 @@ void TestBackupConfig::RunTest()
 		{
 			mpTree->Expand(mTestDataDirItem);
 		}
+
+		// large directories are only added a page at a time,
+		// so add the rest of the entries before searching them
+		LocalFileNode* pNode = (LocalFileNode*)
+			mpTree->GetItemData(mTestDataDirItem);
+		while (pNode->GetMoreItemId().IsOk())
+		{
+			CPPUNIT_ASSERT(pNode->AddNextPage((LocalFileTree*)mpTree,
+				false));
+		}
 		
 		bool found = false;
 		wxTreeItemIdValue cookie;
@@ -568,6 +587,8 @@ void TestBackupConfig::RunTest()
 
 	TestAddAndRemoveSimpleLocationInTree();		
 	TestAddLocationInTree();		
+	TestExcludeCacheIsPrecise();
+	TestPagedDirectoryInTree();
 	TestSimpleExcludeInTree();		
 	TestDeepIncludePattern();
 	TestAlwaysIncludeFileDeepInTree();
@@ -643,6 +664,7 @@ void TestBackupConfig::RunTest()
 		
 	// clean up
 	DeleteRecursive(mTestDataDir);
+	DeleteRecursive(mTestOtherDir);
 	CPPUNIT_ASSERT_MESSAGE_WX(mTempDir.GetPath(), mTempDir.Rmdir());
 }
 
@@ -651,7 +673,7 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	ActivateTreeItemWaitEvent(mpTree, mTestDataDirItem);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 
 	const BoxiLocation::List& rLocations = 
 		mpConfig->GetLocations();
@@ -702,26 +724,26 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	CPPUNIT_ASSERT_EQUAL((size_t)3, rEntries.size());
 	
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mAnother));
+		GetStateIcon(mpTree, mAnother));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir1));
+		GetStateIcon(mpTree, mDir1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile1));
+		GetStateIcon(mpTree, mFile1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir2));
+		GetStateIcon(mpTree, mDir2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile2));
+		GetStateIcon(mpTree, mFile2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 
 	// Now add another entry to AlwaysInclude mDepth2
 	// by regex. Make sure that its children are still
@@ -741,21 +763,21 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir1));
+		GetStateIcon(mpTree, mDir1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile1));
+		GetStateIcon(mpTree, mFile1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir2));
+		GetStateIcon(mpTree, mDir2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile2));
+		GetStateIcon(mpTree, mFile2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 
 	// Include a file and a dir using the wrong kinds of
 	// rules. Check that they don't show up as included.
@@ -779,9 +801,9 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir1));
+		GetStateIcon(mpTree, mDir1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile1));
+		GetStateIcon(mpTree, mFile1));
 
 	// Include a file inside an excluded directory. Check
 	// that it doesn't show up as included, because it will
@@ -806,9 +828,9 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile3));
+		GetStateIcon(mpTree, mFile3));
 
 	// Remove the location by clicking in the tree.
 
@@ -819,7 +841,7 @@ void TestBackupConfig::TestAddAndRemoveSimpleLocationInTree()
 	MessageBoxCheckFired();
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 		
 	CPPUNIT_ASSERT_EQUAL((size_t)0, rLocations.size());
 }
@@ -832,13 +854,13 @@ void TestBackupConfig::TestAddLocationInTree()
 	ActivateTreeItemWaitEvent(mpTree, mTestDataDirItem);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 
 	for (wxTreeItemId nodeId = mpTree->GetItemParent(mTestDataDirItem);
 		nodeId.IsOk(); nodeId = mpTree->GetItemParent(nodeId))
 	{
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(), 
-			mpTree->GetItemImage(nodeId));
+			GetStateIcon(mpTree, nodeId));
 	}
 	
 	for (wxTreeItemId nodeId = mDepth6; 
@@ -846,7 +868,7 @@ void TestBackupConfig::TestAddLocationInTree()
 		nodeId = mpTree->GetItemParent(nodeId))
 	{
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-			mpTree->GetItemImage(nodeId));
+			GetStateIcon(mpTree, nodeId));
 	}
 	
 	// check that the entry details are shown in the
@@ -888,16 +910,16 @@ void TestBackupConfig::TestSimpleExcludeInTree()
 	CPPUNIT_ASSERT_EQUAL(1, mpExcludeListBox->GetCount());
 	CPPUNIT_ASSERT_EQUAL(0, mpExcludeListBox->GetSelection());
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 	for (wxTreeItemId nodeId = mDepth6; !(nodeId == mDepth2); 
 		nodeId = mpTree->GetItemParent(nodeId))
 	{
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-			mpTree->GetItemImage(nodeId));
+			GetStateIcon(mpTree, nodeId));
 	}
 }
 
@@ -965,47 +987,47 @@ void TestBackupConfig::TestDeepIncludePattern()
 	rExcludeList.AddEntry(t8);
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mAnother));
+		GetStateIcon(mpTree, mAnother));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDir1));
+		GetStateIcon(mpTree, mDir1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mFile1));
+		GetStateIcon(mpTree, mFile1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir2));
+		GetStateIcon(mpTree, mDir2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile2));
+		GetStateIcon(mpTree, mFile2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth5));
+		GetStateIcon(mpTree, mDepth5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile3));
+		GetStateIcon(mpTree, mFile3));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth6));
+		GetStateIcon(mpTree, mDepth6));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDir4));
+		GetStateIcon(mpTree, mDir4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mFile4));
+		GetStateIcon(mpTree, mFile4));
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDir5));
+		GetStateIcon(mpTree, mDir5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mFile5));
+		GetStateIcon(mpTree, mFile5));
 
 	rExcludeList.AddEntry(t0);
 	rExcludeList.RemoveEntry(t1);
@@ -1057,33 +1079,33 @@ void TestBackupConfig::TestAlwaysIncludeFileDeepInTree()
 		mpExcludeLocsListBox->GetString(0));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth5));
+		GetStateIcon(mpTree, mDepth5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mFile3));
+		GetStateIcon(mpTree, mFile3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth6));
+		GetStateIcon(mpTree, mDepth6));
 	// mFile4 is grey because its parent is excluded,
 	// even though it matches an Exclude entry itself.
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile4));
+		GetStateIcon(mpTree, mFile4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir4));
+		GetStateIcon(mpTree, mDir4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile5));
+		GetStateIcon(mpTree, mFile5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir5));
+		GetStateIcon(mpTree, mDir5));
 
 	// deactivate mFile3 again, check that its alwaysinclude
 	// is removed, but not its parents
@@ -1113,33 +1135,33 @@ void TestBackupConfig::TestAlwaysIncludeFileDeepInTree()
 		mpExcludeLocsListBox->GetString(0));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth5));
+		GetStateIcon(mpTree, mDepth5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile3));
+		GetStateIcon(mpTree, mFile3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth6));
+		GetStateIcon(mpTree, mDepth6));
 	// mFile4 is grey because its parent is excluded,
 	// even though it matches an Exclude entry itself.
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile4));
+		GetStateIcon(mpTree, mFile4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir4));
+		GetStateIcon(mpTree, mDir4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile5));
+		GetStateIcon(mpTree, mFile5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir5));
+		GetStateIcon(mpTree, mDir5));
 }
 
 // Remaining tests are in TestBackupConfig2.cc
@@ -24,6 +24,13 @@
 
 #include "SandBox.h"
 
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <set>
+
 #include <wx/button.h>
 #include <wx/dir.h>
 #include <wx/file.h>
@@ -39,6 +46,9 @@
 #include "main.h"
 #include "BoxiApp.h"
 #include "ClientConfig.h"
+#include "ExcludeProfiler.h"
+#include "FileTree.h"
+#include "SizeEstimator.h"
 #include "MainFrame.h"
 #include "TestBackupConfig.h"
 
@@ -85,35 +95,35 @@ void TestBackupConfig::TestAddAlwaysIncludeInTree()
 		mpExcludeLocsListBox->GetString(0));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDepth5));
+		GetStateIcon(mpTree, mDepth5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mFile3));
+		GetStateIcon(mpTree, mFile3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth6));
+		GetStateIcon(mpTree, mDepth6));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir4));
+		GetStateIcon(mpTree, mDir4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile4));
+		GetStateIcon(mpTree, mFile4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDir5));
+		GetStateIcon(mpTree, mDir5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mFile5));
+		GetStateIcon(mpTree, mFile5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDir6));
+		GetStateIcon(mpTree, mDir6));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mFile6));
+		GetStateIcon(mpTree, mFile6));
 }
 
 void TestBackupConfig::TestExcludeUnderAlwaysIncludePromptsToRemove()
@@ -170,11 +180,11 @@ void TestBackupConfig::TestExcludeUnderAlwaysIncludePromptsToRemove()
 		mpExcludeLocsListBox->GetString(0));
 		
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mDir3));
+		GetStateIcon(mpTree, mDir3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDir6));
+		GetStateIcon(mpTree, mDir6));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetAlwaysImageId(), 
-		mpTree->GetItemImage(mFile6));
+		GetStateIcon(mpTree, mFile6));
 }
 
 void TestBackupConfig::TestRemoveMultipleAlwaysIncludesInTree()
@@ -406,19 +416,19 @@ void TestBackupConfig::TestAddHigherExcludeInTree()
 	CPPUNIT_ASSERT_EQUAL(0, mpExcludeListBox->GetSelection());
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-		mpTree->GetItemImage(mTestDataDirItem));
+		GetStateIcon(mpTree, mTestDataDirItem));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(), 
-		mpTree->GetItemImage(mDepth1));
+		GetStateIcon(mpTree, mDepth1));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(), 
-		mpTree->GetItemImage(mDepth2));
+		GetStateIcon(mpTree, mDepth2));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth3));
+		GetStateIcon(mpTree, mDepth3));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth4));
+		GetStateIcon(mpTree, mDepth4));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth5));
+		GetStateIcon(mpTree, mDepth5));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(), 
-		mpTree->GetItemImage(mDepth6));
+		GetStateIcon(mpTree, mDepth6));
 }
 
 void TestBackupConfig::TestRemoveEntriesFromTree()
@@ -441,6 +451,271 @@ void TestBackupConfig::TestRemoveEntriesFromTree()
 		mpExcludeLocsListBox->GetSelection());
 }
 
+void TestBackupConfig::TestExcludeCacheIsPrecise()
+{
+	// Changing one location's exclude list should only work out the
+	// states of the nodes in that location again, once each, and
+	// leave those in other locations, and outside any location,
+	// as they were.
+
+	FileTree* pTree = (FileTree*)mpTree;
+
+	BoxiLocation otherLoc(_("other"), mTestOtherDir.GetPath(), mpConfig);
+	mpConfig->AddLocation(otherLoc);
+	BoxiLocation* pOtherLoc = mpConfig->GetLocation(otherLoc);
+	CPPUNIT_ASSERT(pOtherLoc);
+
+	wxTreeItemId tempDirItem = mpTree->GetItemParent(mTestDataDirItem);
+	wxTreeItemIdValue cookie;
+	wxTreeItemId otherItem = mpTree->GetFirstChild(tempDirItem, cookie);
+	CPPUNIT_ASSERT(otherItem.IsOk());
+	CPPUNIT_ASSERT_EQUAL(wxString(_("other")),
+		mpTree->GetItemText(otherItem));
+
+	mpTree->Expand(otherItem);
+	wxTreeItemId otherFileItem = mpTree->GetFirstChild(otherItem, cookie);
+	CPPUNIT_ASSERT(otherFileItem.IsOk());
+	CPPUNIT_ASSERT_EQUAL(wxString(_("otherfile")),
+		mpTree->GetItemText(otherFileItem));
+
+	pTree->FlushStateIcons();
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
+		GetStateIcon(mpTree, otherItem));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, otherFileItem));
+
+	wxTreeItemId outside[] = { tempDirItem, otherItem, otherFileItem };
+	const size_t numOutside = sizeof(outside) / sizeof(*outside);
+	wxTreeItemId inside[] = { mTestDataDirItem, mAnother, mDepth1,
+		mDir1, mFile1, mDepth2, mDir2, mFile2, mDepth3, mDepth4,
+		mDepth5, mDir3, mFile3, mDepth6, mDir4, mFile4, mDir5,
+		mFile5, mDir6, mFile6 };
+	const size_t numInside = sizeof(inside) / sizeof(*inside);
+
+	#define NUM_CHECKS(item) \
+		((FileNode*)mpTree->GetItemData(item))->GetNumStateChecks()
+
+	size_t outsideChecks[numOutside], insideChecks[numInside];
+
+	#define SAVE_CHECKS() \
+	for (size_t i = 0; i < numOutside; i++) \
+		outsideChecks[i] = NUM_CHECKS(outside[i]); \
+	for (size_t i = 0; i < numInside; i++) \
+		insideChecks[i] = NUM_CHECKS(inside[i]);
+
+	// nodes inside the testdata location have been checked the
+	// given number of times since SAVE_CHECKS(), the others not at all
+	#define CHECK_CHECKS(n) \
+	for (size_t i = 0; i < numOutside; i++) \
+		CPPUNIT_ASSERT_EQUAL(outsideChecks[i], \
+			NUM_CHECKS(outside[i])); \
+	for (size_t i = 0; i < numInside; i++) \
+		CPPUNIT_ASSERT_EQUAL(insideChecks[i] + n, \
+			NUM_CHECKS(inside[i]));
+
+	const BoxiLocation::List& rLocations = mpConfig->GetLocations();
+	BoxiLocation* pTestDataLocation = mpConfig->GetLocation(
+		*(rLocations.begin()));
+	CPPUNIT_ASSERT(pTestDataLocation);
+	BoxiExcludeList& rExcludeList = pTestDataLocation->GetExcludeList();
+
+	SAVE_CHECKS();
+	BoxiExcludeEntry exclude(ET_EXCLUDE_DIR, mTestDepth2Dir.GetPath());
+	rExcludeList.AddEntry(exclude);
+	pTree->FlushStateIcons();
+	CHECK_CHECKS(1);
+
+	// only the excluded subtree has changed
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
+		GetStateIcon(mpTree, mTestDataDirItem));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, mDepth1));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, mFile1));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
+		GetStateIcon(mpTree, mDepth2));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(),
+		GetStateIcon(mpTree, mFile2));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(),
+		GetStateIcon(mpTree, mFile6));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
+		GetStateIcon(mpTree, otherItem));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, otherFileItem));
+
+	// updating the whole tree again doesn't work anything out again
+	SAVE_CHECKS();
+	pTree->UpdateStateIcon((FileNode*)mpTree->GetItemData(
+		mpTree->GetRootItem()), false, true);
+	pTree->FlushStateIcons();
+	CHECK_CHECKS(0);
+
+	SAVE_CHECKS();
+	rExcludeList.RemoveEntry(exclude);
+	pTree->FlushStateIcons();
+	CHECK_CHECKS(1);
+
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, mDepth2));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
+		GetStateIcon(mpTree, mFile6));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
+		GetStateIcon(mpTree, otherItem));
+
+	// Marking many nodes, with their parents and children, works
+	// nothing out until the flush, which works out each one once.
+	SAVE_CHECKS();
+	rExcludeList.AddEntry(exclude);
+	for (size_t i = 0; i < numInside; i++)
+	{
+		pTree->UpdateStateIcon((FileNode*)mpTree->GetItemData(
+			inside[i]), true, true);
+	}
+	for (size_t i = 0; i < numOutside; i++)
+	{
+		pTree->UpdateStateIcon((FileNode*)mpTree->GetItemData(
+			outside[i]), true, true);
+	}
+	CHECK_CHECKS(0);
+	pTree->FlushStateIcons();
+	CHECK_CHECKS(1);
+
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
+		GetStateIcon(mpTree, mDepth2));
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(),
+		GetStateIcon(mpTree, mFile6));
+
+	rExcludeList.RemoveEntry(exclude);
+	pTree->FlushStateIcons();
+
+	#undef CHECK_CHECKS
+	#undef SAVE_CHECKS
+	#undef NUM_CHECKS
+
+	mpConfig->RemoveLocation(*pOtherLoc);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, mpConfig->GetLocations().size());
+	CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
+		GetStateIcon(mpTree, otherItem));
+}
+
+void TestBackupConfig::TestPagedDirectoryInTree()
+{
+	// A directory with more than a page of entries is added to the
+	// tree a page at a time, with a placeholder for the rest, and
+	// each entry is added once, in order, even if adding the
+	// children of one of them fails.
+
+	const size_t numEntries = FILE_TREE_PAGE_SIZE * 2 + 500;
+	const size_t unreadable = FILE_TREE_PAGE_SIZE * 3 / 2;
+
+	wxFileName pagedDir(mTestOtherDir.GetFullPath(), _("paged"));
+	pagedDir = wxFileName(pagedDir.GetFullPath(), wxT(""));
+	CPPUNIT_ASSERT(pagedDir.Mkdir(0700));
+
+	for (size_t i = 0; i < numEntries; i++)
+	{
+		wxString name;
+		name.Printf(_("d%04d"), (int)i);
+		CPPUNIT_ASSERT(wxMkdir(MakeAbsolutePath(pagedDir, name)
+			.GetFullPath(), 0700));
+	}
+
+	// the entry whose children can't be read, if we can make one
+	bool canRead = true;
+
+	#ifndef WIN32
+	wxString unreadableName;
+	unreadableName.Printf(_("d%04d"), (int)unreadable);
+	wxCharBuffer unreadablePath = MakeAbsolutePath(pagedDir,
+		unreadableName).GetFullPath().mb_str(wxConvBoxi);
+	CPPUNIT_ASSERT_EQUAL(0, ::chmod(unreadablePath.data(), 0));
+	canRead = (::access(unreadablePath.data(), R_OK) == 0);
+	#endif
+
+	// re-read the other location, to find the new directory
+	wxTreeItemId tempDirItem = mpTree->GetItemParent(mTestDataDirItem);
+	wxTreeItemIdValue cookie;
+	wxTreeItemId otherItem = mpTree->GetFirstChild(tempDirItem, cookie);
+	CPPUNIT_ASSERT_EQUAL(wxString(_("other")),
+		mpTree->GetItemText(otherItem));
+	mpTree->Collapse(otherItem);
+	mpTree->Expand(otherItem);
+
+	wxTreeItemId pagedItem = mpTree->GetFirstChild(otherItem, cookie);
+	CPPUNIT_ASSERT(pagedItem.IsOk());
+	CPPUNIT_ASSERT_EQUAL(wxString(_("paged")),
+		mpTree->GetItemText(pagedItem));
+
+	FileTree* pTree = (FileTree*)mpTree;
+	FileNode* pPagedNode = (FileNode*)mpTree->GetItemData(pagedItem);
+
+	// checks that the tree holds the first numAdded entries, in
+	// order, followed by a placeholder if there are any more
+	#define CHECK_PAGED_CHILDREN(numAdded) \
+	{ \
+		size_t numChildren = mpTree->GetChildrenCount(pagedItem, false); \
+		bool more = ((numAdded) < numEntries); \
+		CPPUNIT_ASSERT_EQUAL((size_t)(numAdded) + (more ? 1 : 0), \
+			numChildren); \
+		CPPUNIT_ASSERT_EQUAL(more, \
+			pPagedNode->GetMoreItemId().IsOk()); \
+		\
+		std::set<wxString> seen; \
+		size_t index = 0; \
+		for (wxTreeItemId child = mpTree->GetFirstChild(pagedItem, \
+			cookie); child.IsOk(); \
+			child = mpTree->GetNextChild(pagedItem, cookie), index++) \
+		{ \
+			if (index == (numAdded)) \
+			{ \
+				wxString label; \
+				label.Printf(_("(%d more entries...)"), \
+					(int)(numEntries - (numAdded))); \
+				CPPUNIT_ASSERT_EQUAL(label, \
+					mpTree->GetItemText(child)); \
+				CPPUNIT_ASSERT(child == \
+					pPagedNode->GetMoreItemId()); \
+				CPPUNIT_ASSERT(!mpTree->GetItemData(child)); \
+				continue; \
+			} \
+			wxString name; \
+			name.Printf(_("d%04d"), (int)index); \
+			CPPUNIT_ASSERT_EQUAL(name, mpTree->GetItemText(child)); \
+			CPPUNIT_ASSERT(seen.insert(name).second); \
+		} \
+	}
+
+	mpTree->Expand(pagedItem);
+	CHECK_PAGED_CHILDREN(FILE_TREE_PAGE_SIZE);
+
+	// the child that can't be read is in the tree, and counted,
+	// even though adding its own children failed
+	size_t numAdded = canRead ? FILE_TREE_PAGE_SIZE * 2 : unreadable + 1;
+	{
+		// failing to read a directory is logged as an error
+		wxLogNull nolog;
+		CPPUNIT_ASSERT_EQUAL(canRead,
+			pPagedNode->AddNextPage(pTree, true));
+	}
+	CHECK_PAGED_CHILDREN(numAdded);
+
+	wxTreeItemId firstNewId;
+	CPPUNIT_ASSERT(pPagedNode->AddNextPage(pTree, false, &firstNewId));
+	CHECK_PAGED_CHILDREN(numEntries);
+	wxString firstNewName;
+	firstNewName.Printf(_("d%04d"), (int)numAdded);
+	CPPUNIT_ASSERT_EQUAL(firstNewName, mpTree->GetItemText(firstNewId));
+
+	#undef CHECK_PAGED_CHILDREN
+
+	#ifndef WIN32
+	CPPUNIT_ASSERT_EQUAL(0, ::chmod(unreadablePath.data(), 0700));
+	#endif
+
+	mpTree->Collapse(otherItem);
+	DeleteRecursive(pagedDir);
+}
+
 void TestBackupConfig::TestAddTwoLocations()
 {
 	// add two locations using the Locations panel,
@@ -465,6 +740,17 @@ void TestBackupConfig::TestAddTwoLocations()
 		mpLocationNameCtrl->GetValue());
 	CPPUNIT_ASSERT_EQUAL((wxString)_("/etc"), 
 		mpLocationPathCtrl->GetValue());
+
+	// the location index must have been rebuilt to include both
+	const BoxiLocationIndex& rIndex = mpConfig->GetLocationIndex();
+	CPPUNIT_ASSERT(rIndex.GetLocationAt(_("/tmp")));
+	CPPUNIT_ASSERT_EQUAL((wxString)_("etc"),
+		rIndex.GetLocationAt(_("/etc/"))->GetName());
+	CPPUNIT_ASSERT(!rIndex.GetLocationAt(_("/etc/passwd")));
+	CPPUNIT_ASSERT(!rIndex.GetLocationAt(_("/")));
+	CPPUNIT_ASSERT(rIndex.IsParentOfLocation(_("/")));
+	CPPUNIT_ASSERT(!rIndex.IsParentOfLocation(_("/etc")));
+	CPPUNIT_ASSERT(!rIndex.IsParentOfLocation(_("/usr")));
 }
 
 void TestBackupConfig::TestAddExcludeEntry()
@@ -866,7 +1152,7 @@ void TestBackupConfig::TestComplexExcludes()
 		CPPUNIT_ASSERT_EQUAL((size_t)1, 
 			mpConfig->GetLocations().size());
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-			mpTree->GetItemImage(mTestDataDirItem));
+			GetStateIcon(mpTree, mTestDataDirItem));
 		BoxiLocation* pNewLoc = mpConfig->GetLocation(mTestDirLoc);
 		CPPUNIT_ASSERT(pNewLoc);
 		
@@ -895,7 +1181,7 @@ void TestBackupConfig::TestComplexExcludes()
 		CPPUNIT_ASSERT_EQUAL((wxString)_(name), \
 			mpTree->GetItemText(item)); \
 		CPPUNIT_ASSERT_EQUAL(mapImages->Get ## image ## ImageId(), \
-			mpTree->GetItemImage(item))
+			GetStateIcon(mpTree, item))
 		
 		wxTreeItemId item = mTestDataDirItem;
 		CHECK_ITEM("testdata", Checked);
@@ -912,7 +1198,7 @@ void TestBackupConfig::TestComplexExcludes()
 		CPPUNIT_ASSERT_EQUAL((size_t)1, 
 			mpConfig->GetLocations().size());
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(), 
-			mpTree->GetItemImage(mTestDataDirItem));
+			GetStateIcon(mpTree, mTestDataDirItem));
 		BoxiLocation* pNewLoc = mpConfig->GetLocation(mTestDirLoc);
 		CPPUNIT_ASSERT(pNewLoc);
 		
@@ -985,7 +1271,7 @@ void TestBackupConfig::TestComplexExcludes()
 		CPPUNIT_ASSERT_EQUAL((wxString)_(name), \
 			mpTree->GetItemText(item)); \
 		CPPUNIT_ASSERT_EQUAL(mapImages->Get ## image ## ImageId(), \
-			mpTree->GetItemImage(item))
+			GetStateIcon(mpTree, item))
 		
 		item = mpTree->GetFirstChild(mDir1, cookie1);
 		CHECK_ITEM("another", CheckedGrey);
@@ -1039,6 +1325,140 @@ void TestBackupConfig::TestComplexExcludes()
 		CPPUNIT_ASSERT(!item.IsOk());
 		
 		#undef CHECK_ITEM
+
+		// a dry run should match each entry against the same
+		// paths, in list order
+		{
+			BoxiExcludeProfiler profiler(*pNewLoc);
+			profiler.Run();
+
+			const BoxiExcludeProfiler::RuleStats::Vector& rStats =
+				profiler.GetRuleStats();
+			CPPUNIT_ASSERT_EQUAL((size_t)9, rStats.size());
+
+			for (size_t i = 0; i < rStats.size(); i++)
+			{
+				CPPUNIT_ASSERT(!rStats[i].IsNeverMatched());
+				CPPUNIT_ASSERT(!rStats[i].IsShadowed());
+			}
+
+			// _excludethis$ matches two files, but the
+			// AlwaysIncludeFile keeps one of them
+			CPPUNIT_ASSERT_EQUAL((size_t)2, rStats[2].mNumMatches);
+			CPPUNIT_ASSERT_EQUAL((size_t)1, rStats[2].mNumFiles);
+			CPPUNIT_ASSERT_EQUAL((size_t)1, rStats[4].mNumFiles);
+
+			// not_this_dir matches two directories, one of
+			// which is kept by AlwaysIncludeDirsRegex
+			CPPUNIT_ASSERT_EQUAL((size_t)2, rStats[7].mNumMatches);
+			CPPUNIT_ASSERT_EQUAL((size_t)1, rStats[8].mNumMatches);
+
+			CPPUNIT_ASSERT_EQUAL((size_t)4,
+				profiler.GetNumFilesExcluded());
+		}
+
+		// an entry that only matches what an earlier one
+		// already matched is reported as shadowed
+		{
+			BoxiExcludeEntry shadowed(
+				theExcludeTypes[ETI_EXCLUDE_FILES_REGEX],
+				wxString(_("EXCLUDEu$")));
+			unsigned long generation = rExcludes.GetGeneration();
+			unsigned long locationsGeneration =
+				mpConfig->GetLocationsGeneration();
+			rExcludes.AddEntry(shadowed);
+
+			// tree nodes cache their state until one of these
+			// changes, and only the exclude list has changed
+			CPPUNIT_ASSERT(generation != rExcludes.GetGeneration());
+			CPPUNIT_ASSERT_EQUAL(locationsGeneration,
+				mpConfig->GetLocationsGeneration());
+
+			BoxiExcludeProfiler profiler(*pNewLoc);
+			profiler.Run();
+
+			const BoxiExcludeProfiler::RuleStats::Vector& rStats =
+				profiler.GetRuleStats();
+			CPPUNIT_ASSERT_EQUAL((size_t)10, rStats.size());
+			CPPUNIT_ASSERT(rStats[9].IsShadowed());
+			CPPUNIT_ASSERT(!rStats[3].IsShadowed());
+			CPPUNIT_ASSERT(profiler.GetReport().Contains(
+				_("Warning: shadowed")));
+
+			rExcludes.RemoveEntry(shadowed);
+		}
+
+		// the background estimate should agree with a dry run, and
+		// follow edits to the entries without rescanning
+		{
+			BoxiExcludeProfiler profiler(*pNewLoc);
+			profiler.Run();
+
+			BoxiSizeEstimator estimator;
+			BoxiSizeEstimator::Estimate estimate;
+
+			#define WAIT_FOR_ESTIMATE() \
+			for (int i = 0; i < 1000; i++) \
+			{ \
+				if (estimator.GetEstimate(pNewLoc->GetName(), \
+					&estimate) && estimate.mRulesGeneration == \
+					rExcludes.GetGeneration()) break; \
+				wxMilliSleep(10); \
+			} \
+			CPPUNIT_ASSERT_EQUAL(rExcludes.GetGeneration(), \
+				estimate.mRulesGeneration)
+
+			CPPUNIT_ASSERT(estimator.Request(*pNewLoc));
+			WAIT_FOR_ESTIMATE();
+
+			CPPUNIT_ASSERT_EQUAL(profiler.GetNumFilesScanned() -
+				profiler.GetNumFilesExcluded(), estimate.mNumFiles);
+			CPPUNIT_ASSERT_EQUAL(profiler.GetNumBytesScanned() -
+				profiler.GetNumBytesExcluded(), estimate.mNumBytes);
+			CPPUNIT_ASSERT_EQUAL((size_t)9, estimate.mRuleNumFiles.size());
+			CPPUNIT_ASSERT_EQUAL((size_t)1, estimate.mRuleNumFiles[2]);
+			CPPUNIT_ASSERT_EQUAL((size_t)1, estimate.mRuleNumFiles[4]);
+
+			size_t numFiles = estimate.mNumFiles;
+
+			BoxiExcludeEntry excludeAll(
+				theExcludeTypes[ETI_EXCLUDE_FILES_REGEX],
+				wxString(_(".")));
+			rExcludes.AddEntry(excludeAll);
+			CPPUNIT_ASSERT(estimator.Request(*pNewLoc));
+			WAIT_FOR_ESTIMATE();
+
+			CPPUNIT_ASSERT_EQUAL((size_t)10, estimate.mRuleNumFiles.size());
+			CPPUNIT_ASSERT_EQUAL(numFiles - estimate.mNumFiles,
+				estimate.mRuleNumFiles[9]);
+			CPPUNIT_ASSERT(estimate.mRuleNumFiles[9] > 0);
+
+			rExcludes.RemoveEntry(excludeAll);
+
+			// a new file is only seen once the cached tree
+			// has been invalidated
+			wxFileName newFile(mTestDataDir.GetFullPath(),
+				_("estimate_new_file"));
+			{
+				wxFile f;
+				CPPUNIT_ASSERT(f.Create(newFile.GetFullPath()));
+			}
+
+			CPPUNIT_ASSERT(estimator.Request(*pNewLoc));
+			WAIT_FOR_ESTIMATE();
+			CPPUNIT_ASSERT_EQUAL(numFiles, estimate.mNumFiles);
+
+			estimator.Invalidate();
+			CPPUNIT_ASSERT(!estimator.GetEstimate(pNewLoc->GetName(),
+				&estimate));
+			CPPUNIT_ASSERT(estimator.Request(*pNewLoc));
+			WAIT_FOR_ESTIMATE();
+			CPPUNIT_ASSERT_EQUAL(numFiles + 1, estimate.mNumFiles);
+
+			CPPUNIT_ASSERT(wxRemoveFile(newFile.GetFullPath()));
+			
+			#undef WAIT_FOR_ESTIMATE
+		}
 		
 		#define DELETE_FILE(dir, name) \
 		CPPUNIT_ASSERT(wxRemoveFile(dir ## _ ## name.GetFullPath()))
@@ -0,0 +1,429 @@
+/***************************************************************************
+ *            TestCommandSocket.cc
+ *
+ *  Sat Jan 17 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "CommandSocketClient.h"
+#include "CommandSocketEventQueue.h"
+#include "CommandSocketParser.h"
+#include "CommandSocketPoller.h"
+#include "TestCommandSocket.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestCommandSocket, "WxGuiTest");
+
+CppUnit::Test *TestCommandSocket::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestCommandSocket");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestCommandSocket>(
+			"TestCommandSocket",
+			&TestCommandSocket::RunTest));
+	return suiteOfTests;
+}
+
+// The command socket code is only built where there are Unix sockets
+void TestCommandSocket::RunTest()
+{
+#ifndef WIN32
+	TestWake();
+	TestPartialReads();
+	TestFullBuffer();
+	TestLongLine();
+	TestParser();
+	TestQueuedEvents();
+#endif
+	TestEventQueue();
+}
+
+#ifndef WIN32
+void TestCommandSocket::TestWake()
+{
+	CommandSocketPoller poller;
+	std::vector<CommandSocketClient*> noClients;
+
+	// nothing to wake it, so it times out
+	CPPUNIT_ASSERT(!poller.Wait(noClients, 0));
+
+	// any number of wakes before it waits only wake it once
+	poller.Wake();
+	poller.Wake();
+	poller.Wake();
+	CPPUNIT_ASSERT(poller.Wait(noClients, 10000));
+	CPPUNIT_ASSERT(!poller.Wait(noClients, 0));
+}
+
+// Attaches the client to one end of a new socketpair(), and returns
+// the other end, for the test to play the daemon.
+int TestCommandSocket::ConnectClient(CommandSocketClient& rClient)
+{
+	int handles[2];
+	CPPUNIT_ASSERT_EQUAL(0,
+		::socketpair(AF_UNIX, SOCK_STREAM, 0, handles));
+	rClient.Attach(handles[0]);
+	CPPUNIT_ASSERT(rClient.IsConnected());
+	return handles[1];
+}
+
+void TestCommandSocket::WriteToClient(int handle, const char* pData,
+	CommandSocketPoller& rPoller, CommandSocketClient& rClient)
+{
+	std::vector<CommandSocketClient*> clients;
+	clients.push_back(&rClient);
+
+	size_t length = strlen(pData);
+	CPPUNIT_ASSERT_EQUAL((ssize_t)length, ::write(handle, pData, length));
+	CPPUNIT_ASSERT(!rPoller.Wait(clients, 10000));
+}
+
+void TestCommandSocket::AssertLine(CommandSocketClient& rClient,
+	const char* pExpected)
+{
+	const char* pLine;
+	size_t length;
+	CPPUNIT_ASSERT(rClient.GetLine(&pLine, &length));
+	CPPUNIT_ASSERT_EQUAL(strlen(pExpected), length);
+	CPPUNIT_ASSERT_EQUAL(std::string(pExpected), std::string(pLine));
+}
+
+void TestCommandSocket::TestPartialReads()
+{
+	CommandSocketPoller poller;
+	CommandSocketClient client;
+	int daemon = ConnectClient(client);
+
+	const char* pLine;
+	size_t length;
+
+	// nothing until the end of the line arrives
+	WriteToClient(daemon, "sta", poller, client);
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+
+	// one line finished, and the start of the next
+	WriteToClient(daemon, "te 1\nsync-st", poller, client);
+	AssertLine(client, "state 1");
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+
+	WriteToClient(daemon, "art\n", poller, client);
+	AssertLine(client, "sync-start");
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+
+	// a CRLF split between reads is still one line ending
+	WriteToClient(daemon, "ok\r", poller, client);
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+	WriteToClient(daemon, "\nerror\r\n", poller, client);
+	AssertLine(client, "ok");
+	AssertLine(client, "error");
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+
+	// commands go the other way with a newline on the end
+	CPPUNIT_ASSERT(client.SendCommand("force-sync"));
+	CPPUNIT_ASSERT(!client.HasPendingOutput());
+	char buffer[32];
+	CPPUNIT_ASSERT_EQUAL((ssize_t)11,
+		::read(daemon, buffer, sizeof(buffer)));
+	CPPUNIT_ASSERT_EQUAL(std::string("force-sync\n"),
+		std::string(buffer, 11));
+
+	// the daemon going away isn't an error
+	::close(daemon);
+	std::vector<CommandSocketClient*> clients;
+	clients.push_back(&client);
+	CPPUNIT_ASSERT(!poller.Wait(clients, 10000));
+	CPPUNIT_ASSERT(!client.IsConnected());
+	CPPUNIT_ASSERT_EQUAL(0, client.GetLastErrno());
+}
+
+// The client's buffer holds 16384 bytes, which is 2048 of these lines
+#define TEST_LINE "state 1\n"
+#define TEST_LINES_TO_FILL 2048
+
+void TestCommandSocket::TestFullBuffer()
+{
+	CommandSocketPoller poller;
+	CommandSocketClient client;
+	int daemon = ConnectClient(client);
+
+	std::string lines;
+	for (int i = 0; i < 64; i++)
+	{
+		lines += TEST_LINE;
+	}
+
+	for (int i = 0; i < TEST_LINES_TO_FILL / 64; i++)
+	{
+		WriteToClient(daemon, lines.c_str(), poller, client);
+	}
+
+	CPPUNIT_ASSERT(client.IsConnected());
+	CPPUNIT_ASSERT(!client.WantsInput());
+
+	// with the buffer full, the next line is left in the socket
+	std::vector<CommandSocketClient*> clients;
+	clients.push_back(&client);
+	CPPUNIT_ASSERT_EQUAL((ssize_t)6, ::write(daemon, "error\n", 6));
+	CPPUNIT_ASSERT(!poller.Wait(clients, 0));
+	CPPUNIT_ASSERT(client.IsConnected());
+	CPPUNIT_ASSERT(!client.WantsInput());
+	char buffer[16];
+	CPPUNIT_ASSERT_EQUAL((ssize_t)6, ::recv(client.GetFileHandle(),
+		buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT));
+
+	// until a line is taken, which makes room for it
+	AssertLine(client, "state 1");
+	CPPUNIT_ASSERT(client.WantsInput());
+	CPPUNIT_ASSERT(!poller.Wait(clients, 10000));
+	CPPUNIT_ASSERT_EQUAL((ssize_t)-1, ::recv(client.GetFileHandle(),
+		buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT));
+
+	for (int i = 1; i < TEST_LINES_TO_FILL; i++)
+	{
+		AssertLine(client, "state 1");
+	}
+	AssertLine(client, "error");
+
+	const char* pLine;
+	size_t length;
+	CPPUNIT_ASSERT(!client.GetLine(&pLine, &length));
+	CPPUNIT_ASSERT(client.IsConnected());
+
+	::close(daemon);
+}
+
+void TestCommandSocket::TestLongLine()
+{
+	CommandSocketPoller poller;
+	CommandSocketClient client;
+	int daemon = ConnectClient(client);
+
+	std::string chunk(512, 'x');
+	for (int i = 0; i < 32 && client.IsConnected(); i++)
+	{
+		WriteToClient(daemon, chunk.c_str(), poller, client);
+	}
+
+	// a line that doesn't fit in the buffer can't be from a bbackupd
+	CPPUNIT_ASSERT(!client.IsConnected());
+	CPPUNIT_ASSERT_EQUAL(EPROTO, client.GetLastErrno());
+
+	::close(daemon);
+}
+
+void TestCommandSocket::TestParser()
+{
+	CommandSocketPoller poller;
+	CommandSocketClient client;
+	CommandSocketParser parser(client);
+	CommandSocketEvent event;
+	int daemon = ConnectClient(client);
+
+	CPPUNIT_ASSERT(!parser.GetEvent(&event));
+	CPPUNIT_ASSERT(!parser.HasSummary());
+
+	WriteToClient(daemon, "bbackupd: 1 3600 21600 86400\r\n"
+		"ok\nerror\nstate 2\nstate x\nstate \n"
+		"state 4294967297\nstate 99999999999999999999\nstart-sync\nfinish-sync\n"
+		"bbackupd: 1 2 3 4\nfoo\n", poller, client);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_SUMMARY, event.mType);
+	CPPUNIT_ASSERT(event.mAutomaticBackup);
+	CPPUNIT_ASSERT_EQUAL(3600,  event.mUpdateStoreInterval);
+	CPPUNIT_ASSERT_EQUAL(21600, event.mMinimumFileAge);
+	CPPUNIT_ASSERT_EQUAL(86400, event.mMaxUploadWait);
+	CPPUNIT_ASSERT(event.mTime != 0);
+	CPPUNIT_ASSERT(parser.HasSummary());
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_OK, event.mType);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_ERROR, event.mType);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_STATE, event.mType);
+	CPPUNIT_ASSERT_EQUAL(2, event.mState);
+
+	// bad states, including one too big for an int, are malformed
+	const char* malformed[] = { "state x", "state ",
+		"state 4294967297", "state 99999999999999999999" };
+	for (size_t i = 0; i < sizeof(malformed) / sizeof(*malformed); i++)
+	{
+		CPPUNIT_ASSERT(parser.GetEvent(&event));
+		CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_MALFORMED,
+			event.mType);
+		CPPUNIT_ASSERT_EQUAL(std::string(malformed[i]),
+			std::string(event.mpText, event.mTextLength));
+	}
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_SYNC_START, event.mType);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_SYNC_FINISH,
+		event.mType);
+
+	// only the first line of a connection is a summary
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_UNKNOWN, event.mType);
+	CPPUNIT_ASSERT_EQUAL(std::string("bbackupd: 1 2 3 4"),
+		std::string(event.mpText, event.mTextLength));
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_UNKNOWN, event.mType);
+	CPPUNIT_ASSERT_EQUAL(std::string("foo"),
+		std::string(event.mpText, event.mTextLength));
+
+	CPPUNIT_ASSERT(!parser.GetEvent(&event));
+
+	// a summary that doesn't parse is still the summary
+	parser.Reset();
+	CPPUNIT_ASSERT(!parser.HasSummary());
+	WriteToClient(daemon, "bbackupd: 1 x\nbbackupd: 1 2 3 4\n",
+		poller, client);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_MALFORMED, event.mType);
+	CPPUNIT_ASSERT(parser.HasSummary());
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_UNKNOWN, event.mType);
+
+	::close(daemon);
+}
+
+// Events that the GUI is given are copied out of a queue long after
+// their lines have been overwritten, so they mustn't point into them.
+void TestCommandSocket::TestQueuedEvents()
+{
+	CommandSocketPoller poller;
+	CommandSocketClient client;
+	CommandSocketParser parser(client);
+	CommandSocketEventQueue queue(4);
+	std::vector<CommandSocketEvent> events;
+	CommandSocketEvent event;
+	int daemon = ConnectClient(client);
+
+	WriteToClient(daemon, "bbackupd: 1 3600 21600 86400\n"
+		"state 2\nstart-sync\n", poller, client);
+
+	for (int i = 0; i < 3; i++)
+	{
+		CPPUNIT_ASSERT(parser.GetEvent(&event));
+		CPPUNIT_ASSERT(event.mpText == NULL);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, event.mTextLength);
+		queue.Push(event);
+	}
+	CPPUNIT_ASSERT(!parser.GetEvent(&event));
+
+	// lines that take the place of the queued ones
+	WriteToClient(daemon, "foo bar baz\nstate x\n", poller, client);
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_UNKNOWN, event.mType);
+	CPPUNIT_ASSERT_EQUAL(std::string("foo bar baz"),
+		std::string(event.mpText, event.mTextLength));
+
+	CPPUNIT_ASSERT(parser.GetEvent(&event));
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_MALFORMED, event.mType);
+	CPPUNIT_ASSERT_EQUAL(std::string("state x"),
+		std::string(event.mpText, event.mTextLength));
+
+	CPPUNIT_ASSERT_EQUAL((size_t)0, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)3, events.size());
+
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_SUMMARY,
+		events[0].mType);
+	CPPUNIT_ASSERT_EQUAL(3600, events[0].mUpdateStoreInterval);
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_STATE, events[1].mType);
+	CPPUNIT_ASSERT_EQUAL(2, events[1].mState);
+	CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_SYNC_START,
+		events[2].mType);
+
+	for (int i = 0; i < 3; i++)
+	{
+		CPPUNIT_ASSERT(events[i].mpText == NULL);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, events[i].mTextLength);
+	}
+
+	::close(daemon);
+}
+#endif // !WIN32
+
+void TestCommandSocket::TestEventQueue()
+{
+	CommandSocketEventQueue queue(3);
+	std::vector<CommandSocketEvent> events;
+	CommandSocketEvent event;
+	event.mType = CommandSocketEvent::CSE_STATE;
+
+	CPPUNIT_ASSERT_EQUAL((size_t)0, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, events.size());
+
+	// only the first event needs the reader to be told
+	for (int i = 1; i <= 5; i++)
+	{
+		event.mState = i;
+		CPPUNIT_ASSERT_EQUAL(i == 1, queue.Push(event));
+	}
+
+	// the oldest were dropped to make room, and counted
+	CPPUNIT_ASSERT_EQUAL((size_t)2, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)3, events.size());
+	for (int i = 0; i < 3; i++)
+	{
+		CPPUNIT_ASSERT_EQUAL(CommandSocketEvent::CSE_STATE,
+			events[i].mType);
+		CPPUNIT_ASSERT_EQUAL(i + 3, events[i].mState);
+	}
+
+	CPPUNIT_ASSERT_EQUAL((size_t)0, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, events.size());
+
+	// and it starts again once drained
+	event.mState = 6;
+	CPPUNIT_ASSERT(queue.Push(event));
+	event.mState = 7;
+	CPPUNIT_ASSERT(!queue.Push(event));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)2, events.size());
+	CPPUNIT_ASSERT_EQUAL(6, events[0].mState);
+	CPPUNIT_ASSERT_EQUAL(7, events[1].mState);
+
+	queue.Push(event);
+	queue.Clear();
+	CPPUNIT_ASSERT_EQUAL((size_t)0, queue.Drain(&events));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, events.size());
+}
@@ -35,8 +35,10 @@
 #include <wx/dirctrl.h>
 #include <wx/file.h>
 #include <wx/filename.h>
+#include <wx/listctrl.h>
 #include <wx/spinctrl.h>
 #include <wx/splitter.h>
+#include <wx/textfile.h>
 #include <wx/treectrl.h>
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
@@ -58,7 +60,10 @@
 #include "BoxiApp.h"
 #include "ClientConfig.h"
 #include "ComparePanel.h"
+#include "CompareReport.h"
+#include "CompareSampler.h"
 #include "FileTree.h"
+#include "HeadlessRunner.h"
 #include "TestBackup.h"
 #include "TestBackupConfig.h"
 #include "TestCompare.h"
@@ -144,6 +149,14 @@ void TestCompare::AssertCompareOK(int files, const std::string& rBytes)
 		mpErrorList->GetString(0));	
 	BOXI_ASSERT_EQUAL(1, mpErrorList->GetCount());
 	
+	wxListCtrl* pDifferencesList = wxDynamicCast
+	(
+		mpProgressPanel->FindWindow(ID_Compare_Differences_List), 
+		wxListCtrl
+	);
+	BOXI_ASSERT(pDifferencesList);
+	BOXI_ASSERT_EQUAL(0, pDifferencesList->GetItemCount());
+	
 	ClickButtonWaitEvent(ID_Compare_Progress_Panel, wxID_CANCEL);
 	BOXI_ASSERT(!mpProgressPanel->IsShown());
 	
@@ -168,6 +181,90 @@ void TestCompare::AssertCompareOK(int files, const std::string& rBytes)
 	BOXI_ASSERT_EQUAL(files, mpProgressPanel->GetProgressMax());
 }
 
+// Runs --compare and --restore as cron would, against the store that
+// was just backed up to, and checks the exit codes.
+void TestCompare::TestHeadlessExitCodes()
+{
+	wxFileName configFile(mConfDir.GetFullPath(), _("bbackupd.conf"));
+	CPPUNIT_ASSERT(mpConfig->Save(configFile.GetFullPath()));
+
+	{
+		HeadlessRunner runner(configFile.GetFullPath());
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_OK,
+			runner.RunCompare(wxEmptyString, false, wxEmptyString,
+				CompareReport::CRF_CSV));
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_OK,
+			runner.RunCompare(mpTestDataLocation->GetName(), true,
+				wxEmptyString, CompareReport::CRF_CSV));
+	}
+
+	// a local file that isn't on the store is a difference
+	wxFileName newFile(mTestDataDir.GetFullPath(), _("headless.new"));
+	{
+		wxFile file;
+		CPPUNIT_ASSERT(file.Create(newFile.GetFullPath()));
+		CPPUNIT_ASSERT(file.Write(_("not backed up yet\n")));
+	}
+
+	{
+		HeadlessRunner runner(configFile.GetFullPath());
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_DIFFERENCES,
+			runner.RunCompare(wxEmptyString, false, wxEmptyString,
+				CompareReport::CRF_CSV));
+	}
+
+	CPPUNIT_ASSERT(wxRemoveFile(newFile.GetFullPath()));
+
+	// errors
+	{
+		HeadlessRunner runner(configFile.GetFullPath());
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_USAGE,
+			runner.RunCompare(_("nonexistent"), false,
+				wxEmptyString, CompareReport::CRF_CSV));
+
+		wxFileName badReport(mBaseDir.GetFullPath(), _("report.csv"));
+		badReport.AppendDir(_("nonexistent"));
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_FAILED,
+			runner.RunCompare(wxEmptyString, false,
+				badReport.GetFullPath(),
+				CompareReport::CRF_CSV));
+
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_USAGE,
+			runner.RunRestore(_("/nonexistent"),
+				mBaseDir.GetFullPath(), false));
+
+		// restoring over an existing directory is refused
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_FAILED,
+			runner.RunRestore(_("/testdata"),
+				mBaseDir.GetFullPath(), false));
+	}
+
+	{
+		wxFileName missingConfig(mConfDir.GetFullPath(),
+			_("nonexistent.conf"));
+		HeadlessRunner runner(missingConfig.GetFullPath());
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_CONFIG_ERROR,
+			runner.RunCompare(wxEmptyString, false, wxEmptyString,
+				CompareReport::CRF_CSV));
+	}
+
+	{
+		wxFileName badConfig(mConfDir.GetFullPath(), _("bad.conf"));
+		wxFile file;
+		CPPUNIT_ASSERT(file.Create(badConfig.GetFullPath()));
+		CPPUNIT_ASSERT(file.Write(_("NoSuchKey = 1\n")));
+		file.Close();
+
+		HeadlessRunner runner(badConfig.GetFullPath());
+		CPPUNIT_ASSERT_EQUAL(HeadlessRunner::HR_EXIT_CONFIG_ERROR,
+			runner.RunRestore(_("/testdata"),
+				mBaseDir.GetFullPath(), false));
+		CPPUNIT_ASSERT(wxRemoveFile(badConfig.GetFullPath()));
+	}
+
+	CPPUNIT_ASSERT(wxRemoveFile(configFile.GetFullPath()));
+}
+
 void TestCompare::RunTest()
 {
 	CPPUNIT_ASSERT(!mpBackupPanel->IsShown());	
@@ -363,6 +460,95 @@ void TestCompare::RunTest()
 
 	AssertCompareOK(32, "224 kB"); /* + 4 excluded files = 36 */
 
+	// a quick compare checks the same files against the block index
+	// on the store, and should find no differences either
+	wxCheckBox* pQuickCompareCheck = wxDynamicCast
+	(
+		pComparePanel->FindWindow(
+			ID_Compare_Panel_Quick_Compare_Checkbox), 
+		wxCheckBox
+	);
+	CPPUNIT_ASSERT(pQuickCompareCheck);
+	CPPUNIT_ASSERT(!pQuickCompareCheck->GetValue());
+	CheckBoxWaitEvent(pQuickCompareCheck, true);
+	AssertCompareOK(32, "224 kB");
+	CheckBoxWaitEvent(pQuickCompareCheck, false);
+
+	// write a CSV report, which should contain only the header line
+	// as there are no differences
+	wxTextCtrl* pReportFileText = wxDynamicCast
+	(
+		pComparePanel->FindWindow(ID_Compare_Panel_Report_File_Text), 
+		wxTextCtrl
+	);
+	CPPUNIT_ASSERT(pReportFileText);
+	
+	wxChoice* pReportFormatChoice = wxDynamicCast
+	(
+		pComparePanel->FindWindow(
+			ID_Compare_Panel_Report_Format_Choice), 
+		wxChoice
+	);
+	CPPUNIT_ASSERT(pReportFormatChoice);
+	
+	wxFileName reportFile(mBaseDir.GetFullPath(), 
+		_("compare-report.csv"));
+	CPPUNIT_ASSERT(!reportFile.FileExists());
+	pReportFileText->SetValue(reportFile.GetFullPath());
+	pReportFormatChoice->SetSelection(CompareReport::CRF_CSV);
+	AssertCompareOK(32, "224 kB");
+	CPPUNIT_ASSERT(reportFile.FileExists());
+	
+	{
+		wxTextFile report(reportFile.GetFullPath());
+		CPPUNIT_ASSERT(report.Open());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, report.GetLineCount());
+	}
+	
+	CPPUNIT_ASSERT(wxRemoveFile(reportFile.GetFullPath()));
+	pReportFileText->SetValue(wxEmptyString);
+
+	// a sample of 100% verifies every file, and should be certain
+	// that none differ
+	wxCheckBox* pSampleCheck = wxDynamicCast
+	(
+		pComparePanel->FindWindow(ID_Compare_Panel_Sample_Checkbox),
+		wxCheckBox
+	);
+	CPPUNIT_ASSERT(pSampleCheck);
+
+	wxSpinCtrl* pSamplePercentSpin = wxDynamicCast
+	(
+		pComparePanel->FindWindow(
+			ID_Compare_Panel_Sample_Percent_Spin),
+		wxSpinCtrl
+	);
+	CPPUNIT_ASSERT(pSamplePercentSpin);
+
+	pSamplePercentSpin->SetValue(100);
+	CheckBoxWaitEvent(pSampleCheck, true);
+	ClickButtonWaitEvent(ID_Compare_Panel, ID_Function_Start_Button);
+	BOXI_ASSERT(mpProgressPanel->IsShown());
+	BOXI_ASSERT_EQUAL(2, mpErrorList->GetCount());
+	BOXI_ASSERT_EQUAL(wxString(_("Compare Finished")),
+		mpErrorList->GetString(0));
+	BOXI_ASSERT_EQUAL(wxString(_("Compared a sample of 32 out of 32 "
+		"files, of which 0 differed. With 95% confidence, no more "
+		"than 0.00% of all files differ.")),
+		mpErrorList->GetString(1));
+	ClickButtonWaitEvent(ID_Compare_Progress_Panel, wxID_CANCEL);
+	mpMainFrame->GetConnection()->Disconnect();
+	CheckBoxWaitEvent(pSampleCheck, false);
+
+	CPPUNIT_ASSERT_EQUAL(0.0,
+		CompareSampler::GetDifferenceRateUpperBound(32, 0, 32));
+	CPPUNIT_ASSERT_EQUAL(1.0,
+		CompareSampler::GetDifferenceRateUpperBound(0, 0, 32));
+	CPPUNIT_ASSERT(CompareSampler::GetDifferenceRateUpperBound(
+		100, 0, 10000) < 0.05);
+
+	TestHeadlessExitCodes();
+
 	/*
 	wxTreeCtrl* pCompareTree = wxDynamicCast
 	(
@@ -422,7 +608,7 @@ void TestCompare::RunTest()
 		CPPUNIT_ASSERT_EQUAL(expected, label);
 		CPPUNIT_ASSERT_EQUAL_MESSAGE(buf.data(), 
 			images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(entry));
+			GetStateIcon(pRestoreTree, entry));
 		CPPUNIT_ASSERT_MESSAGE(buf.data(),
 			pRestoreTree->GetItemTextColour(entry) ==
 			wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOWTEXT));
@@ -434,7 +620,7 @@ void TestCompare::RunTest()
 			ActivateTreeItemWaitEvent(pRestoreTree, entry);
 			CPPUNIT_ASSERT_EQUAL_MESSAGE(buf.data(),
 				images.GetCheckedImageId(),
-				pRestoreTree->GetItemImage(entry));
+				GetStateIcon(pRestoreTree, entry));
 		}
 	}
 	
@@ -455,9 +641,9 @@ void TestCompare::RunTest()
 	}
 
 	CPPUNIT_ASSERT_EQUAL(images.GetPartialImageId(),
-		pRestoreTree->GetItemImage(loc));
+		GetStateIcon(pRestoreTree, loc));
 	CPPUNIT_ASSERT_EQUAL(images.GetPartialImageId(),
-		pRestoreTree->GetItemImage(rootId));
+		GetStateIcon(pRestoreTree, rootId));
 	
 	CPPUNIT_ASSERT_EQUAL(1, pLocsList->GetCount());
 	CPPUNIT_ASSERT_EQUAL(wxString(_("+ /testdata/df9834.dsf")),
@@ -557,17 +743,17 @@ void TestCompare::RunTest()
 		{
 			ActivateTreeItemWaitEvent(pRestoreTree, entry);
 			CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-				pRestoreTree->GetItemImage(entry));
+				GetStateIcon(pRestoreTree, entry));
 		}
 		else if (pRestoreTree->GetItemText(entry).IsSameAs(_("df9834.dsf")))
 		{
 			CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-				pRestoreTree->GetItemImage(entry));
+				GetStateIcon(pRestoreTree, entry));
 		}
 		else
 		{
 			CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-				pRestoreTree->GetItemImage(entry));
+				GetStateIcon(pRestoreTree, entry));
 		}
 	}
 	
@@ -605,34 +791,34 @@ void TestCompare::RunTest()
 		_("sub23"));
 	CPPUNIT_ASSERT(sub23id.IsOk());
 	CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-		pRestoreTree->GetItemImage(sub23id));
+		GetStateIcon(pRestoreTree, sub23id));
 	
 	wxTreeItemId dhsfdss = GetItemIdFromPath(pRestoreTree, loc, 
 		_("sub23/dhsfdss"));
 	CPPUNIT_ASSERT(dhsfdss.IsOk());
 	CPPUNIT_ASSERT_EQUAL(images.GetCheckedGreyImageId(),
-		pRestoreTree->GetItemImage(dhsfdss));
+		GetStateIcon(pRestoreTree, dhsfdss));
 
 	// create a weird configuration, with an item included under
 	// another included item (i.e. double included)
 	{		
 		ActivateTreeItemWaitEvent(pRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(pRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		
 		ActivateTreeItemWaitEvent(pRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(images.GetPartialImageId(),
-			pRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(pRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 
 		ActivateTreeItemWaitEvent(pRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(pRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedGreyImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 	}
 
 	{
@@ -665,9 +851,9 @@ void TestCompare::RunTest()
 	{
 		ActivateTreeItemWaitEvent(pRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(pRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 	}
 
 	{
@@ -713,25 +899,25 @@ void TestCompare::RunTest()
 	// both are restored properly.
 	{
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedGreyImageId(),
-			pRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(pRestoreTree, bfdlink_h));
 	
 		ActivateTreeItemWaitEvent(pRestoreTree, bfdlink_h);
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(pRestoreTree, bfdlink_h));
 
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedGreyImageId(),
-			pRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(pRestoreTree, dfsfd));
 	
 		ActivateTreeItemWaitEvent(pRestoreTree, dfsfd);
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(pRestoreTree, dfsfd));
 
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedGreyImageId(),
-			pRestoreTree->GetItemImage(a_out_h));
+			GetStateIcon(pRestoreTree, a_out_h));
 	}
 
 	{
@@ -771,43 +957,43 @@ void TestCompare::RunTest()
 	// clear all entries, select the server root
 	{
 		CPPUNIT_ASSERT_EQUAL(images.GetCrossedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		ActivateTreeItemWaitEvent(pRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedGreyImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(sub23id));		
+			GetStateIcon(pRestoreTree, sub23id));		
 		ActivateTreeItemWaitEvent(pRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(images.GetPartialImageId(),
-			pRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(pRestoreTree, sub23id));
 
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		ActivateTreeItemWaitEvent(pRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(images.GetPartialImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 		
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(pRestoreTree, bfdlink_h));
 		ActivateTreeItemWaitEvent(pRestoreTree, bfdlink_h);
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(pRestoreTree, bfdlink_h));
 	
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(pRestoreTree, dfsfd));
 		ActivateTreeItemWaitEvent(pRestoreTree, dfsfd);
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(pRestoreTree, dfsfd));
 	
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(pRestoreTree, dhsfdss));
 
 		CPPUNIT_ASSERT_EQUAL(images.GetEmptyImageId(),
-			pRestoreTree->GetItemImage(rootId));
+			GetStateIcon(pRestoreTree, rootId));
 		ActivateTreeItemWaitEvent(pRestoreTree, rootId);
 		CPPUNIT_ASSERT_EQUAL(images.GetCheckedImageId(),
-			pRestoreTree->GetItemImage(rootId));
+			GetStateIcon(pRestoreTree, rootId));
 	}
 
 	RestoreSpec& rRestoreSpec(pRestorePanel->GetRestoreSpec());
@@ -0,0 +1,234 @@
+/***************************************************************************
+ *            TestDaemonMonitor.cc
+ *
+ *  Sun Jan 18 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <wx/filename.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "main.h"
+#include "ClientConnection.h"
+#ifndef WIN32
+#include "DaemonMonitor.h"
+#endif
+#include "TestDaemonMonitor.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestDaemonMonitor, "WxGuiTest");
+
+CppUnit::Test *TestDaemonMonitor::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestDaemonMonitor");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestDaemonMonitor>(
+			"TestDaemonMonitor",
+			&TestDaemonMonitor::RunTest));
+	return suiteOfTests;
+}
+
+// The monitor is only built where there are Unix command sockets
+void TestDaemonMonitor::RunTest()
+{
+#ifndef WIN32
+	TestStates();
+	TestSyncs();
+	TestErrors();
+	TestAddDaemons();
+#endif
+}
+
+#ifndef WIN32
+static CommandSocketEvent MakeEvent(CommandSocketEvent::Type type,
+	time_t time)
+{
+	CommandSocketEvent event;
+	event.mType = type;
+	event.mTime = time;
+	return event;
+}
+
+static CommandSocketEvent MakeStateEvent(int state)
+{
+	CommandSocketEvent event = MakeEvent(CommandSocketEvent::CSE_STATE,
+		1000);
+	event.mState = state;
+	return event;
+}
+
+void TestDaemonMonitor::TestStates()
+{
+	DaemonMonitor::Status status;
+	CPPUNIT_ASSERT_EQUAL((int)ClientConnection::CS_UNKNOWN,
+		status.mClientState);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_IDLE)));
+	CPPUNIT_ASSERT_EQUAL((int)ClientConnection::CS_IDLE,
+		status.mClientState);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, status.mNumErrors);
+
+	// the same state again is no change
+	CPPUNIT_ASSERT(!DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_IDLE)));
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_CONNECTED)));
+	CPPUNIT_ASSERT_EQUAL((int)ClientConnection::CS_CONNECTED,
+		status.mClientState);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, status.mNumErrors);
+
+	// states that this version doesn't know are errors, and
+	// leave the state as it was
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_STORELIMIT + 1)));
+	CPPUNIT_ASSERT_EQUAL((int)ClientConnection::CS_CONNECTED,
+		status.mClientState);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL(std::string("Bad state from daemon"),
+		status.mLastError);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_UNKNOWN)));
+	CPPUNIT_ASSERT_EQUAL((int)ClientConnection::CS_CONNECTED,
+		status.mClientState);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, status.mNumErrors);
+}
+
+void TestDaemonMonitor::TestSyncs()
+{
+	DaemonMonitor::Status status;
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_SYNC_START, 1000)));
+	CPPUNIT_ASSERT(status.mSyncing);
+	CPPUNIT_ASSERT_EQUAL((time_t)1000, status.mLastSyncStarted);
+	CPPUNIT_ASSERT_EQUAL((time_t)0, status.mLastSyncFinished);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, status.mNumSyncs);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_SYNC_FINISH, 1060)));
+	CPPUNIT_ASSERT(!status.mSyncing);
+	CPPUNIT_ASSERT_EQUAL((time_t)1000, status.mLastSyncStarted);
+	CPPUNIT_ASSERT_EQUAL((time_t)1060, status.mLastSyncFinished);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, status.mNumSyncs);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_SYNC_START, 2000)));
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_SYNC_FINISH, 2030)));
+	CPPUNIT_ASSERT_EQUAL((time_t)2000, status.mLastSyncStarted);
+	CPPUNIT_ASSERT_EQUAL((time_t)2030, status.mLastSyncFinished);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, status.mNumSyncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, status.mNumErrors);
+}
+
+void TestDaemonMonitor::TestErrors()
+{
+	DaemonMonitor::Status status;
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_ERROR)));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL(std::string("Sync failed"), status.mLastError);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeStateEvent(ClientConnection::CS_STORELIMIT)));
+	CPPUNIT_ASSERT_EQUAL((size_t)2, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL(std::string("Store limit exceeded"),
+		status.mLastError);
+
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_ERROR, 1000)));
+	CPPUNIT_ASSERT_EQUAL((size_t)3, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL(std::string("Command failed"),
+		status.mLastError);
+
+	const char* pLine = "state x";
+	CommandSocketEvent malformed =
+		MakeEvent(CommandSocketEvent::CSE_MALFORMED, 1000);
+	malformed.mpText = pLine;
+	malformed.mTextLength = strlen(pLine);
+	CPPUNIT_ASSERT(DaemonMonitor::HandleEvent(&status, malformed));
+	CPPUNIT_ASSERT_EQUAL((size_t)4, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL(std::string("Bad response: state x"),
+		status.mLastError);
+
+	// none of these change anything
+	CPPUNIT_ASSERT(!DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_OK, 1000)));
+	CPPUNIT_ASSERT(!DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_SUMMARY, 1000)));
+	CPPUNIT_ASSERT(!DaemonMonitor::HandleEvent(&status,
+		MakeEvent(CommandSocketEvent::CSE_UNKNOWN, 1000)));
+	CPPUNIT_ASSERT_EQUAL((size_t)4, status.mNumErrors);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, status.mNumSyncs);
+}
+
+void TestDaemonMonitor::TestAddDaemons()
+{
+	wxFileName tempFile;
+	tempFile.AssignTempFileName(_("boxi-daemonList-"));
+	std::string listFileName(tempFile.GetFullPath().mb_str(wxConvBoxi));
+
+	FILE* pFile = ::fopen(listFileName.c_str(), "w");
+	CPPUNIT_ASSERT(pFile != NULL);
+	::fputs("# name and command socket of each daemon\n"
+		"\n"
+		"/var/run/bbackupd.sock\n"
+		"home /home/bbackupd.sock\n"
+		"  work \t /var/run/box backup/bbackupd.sock \r\n",
+		pFile);
+	CPPUNIT_ASSERT(::fclose(pFile) == 0);
+
+	DaemonMonitor monitor(NULL);
+	CPPUNIT_ASSERT(monitor.AddDaemons(listFileName));
+	::remove(listFileName.c_str());
+
+	std::vector<DaemonMonitor::Status> status;
+	monitor.GetStatus(&status);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, status.size());
+
+	// without a name, the path is used as the name
+	CPPUNIT_ASSERT_EQUAL(std::string("/var/run/bbackupd.sock"),
+		status[0].mName);
+	CPPUNIT_ASSERT_EQUAL(std::string("/var/run/bbackupd.sock"),
+		status[0].mSocketPath);
+	CPPUNIT_ASSERT_EQUAL(std::string("home"), status[1].mName);
+	CPPUNIT_ASSERT_EQUAL(std::string("/home/bbackupd.sock"),
+		status[1].mSocketPath);
+
+	// the name ends at the first space, so the path can have spaces
+	CPPUNIT_ASSERT_EQUAL(std::string("work"), status[2].mName);
+	CPPUNIT_ASSERT_EQUAL(std::string("/var/run/box backup/bbackupd.sock"),
+		status[2].mSocketPath);
+
+	// a list that isn't there can't be read
+	CPPUNIT_ASSERT(!monitor.AddDaemons(listFileName));
+}
+#endif // !WIN32
@@ -0,0 +1,328 @@
+/***************************************************************************
+ *            TestExcludeRules.cc
+ *
+ *  Tue Jan 20 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <regex.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "ExcludeRules.h"
+#include "TestExcludeRules.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestExcludeRules, "WxGuiTest");
+
+CppUnit::Test *TestExcludeRules::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestExcludeRules");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestExcludeRules>(
+			"TestExcludeRules",
+			&TestExcludeRules::RunTest));
+	return suiteOfTests;
+}
+
+void TestExcludeRules::RunTest()
+{
+	TestCombinePatterns();
+	TestMatchesOneByOne();
+	TestFallback();
+}
+
+static std::string Combine(const char* pFirst, const char* pSecond)
+{
+	std::vector<std::string> patterns;
+	patterns.push_back(pFirst);
+	if (pSecond)
+	{
+		patterns.push_back(pSecond);
+	}
+	return BoxiExcludeRules::CombinePatterns(patterns);
+}
+
+void TestExcludeRules::TestCombinePatterns()
+{
+	std::vector<std::string> none;
+	CPPUNIT_ASSERT_EQUAL(std::string(""),
+		BoxiExcludeRules::CombinePatterns(none));
+
+	CPPUNIT_ASSERT_EQUAL(std::string("(a)|(b|c)"), Combine("a", "b|c"));
+
+	// groups of their own are fine, as nothing refers to them
+	CPPUNIT_ASSERT_EQUAL(std::string("((a|b)c)|(d)"),
+		Combine("(a|b)c", "d"));
+
+	// escaped parentheses, and those in bracket expressions,
+	// aren't groups at all
+	CPPUNIT_ASSERT_EQUAL(std::string("(\\(a)|([(]b)"),
+		Combine("\\(a", "[(]b"));
+	CPPUNIT_ASSERT_EQUAL(std::string("([]a)])|([^])])"),
+		Combine("[]a)]", "[^])]"));
+	CPPUNIT_ASSERT_EQUAL(std::string("([[:alpha:])])"),
+		Combine("[[:alpha:])]", NULL));
+
+	// an escaped backslash followed by a digit isn't a back-reference
+	CPPUNIT_ASSERT_EQUAL(std::string("(a\\\\1)"),
+		Combine("a\\\\1", NULL));
+
+	// back-references would be renumbered by the extra groups
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("a", "(b)\\1"));
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("(b)\\1", NULL));
+
+	// unbalanced parentheses would pair up with the extra ones
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("a)", "b"));
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("a", "a)|(b"));
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("(a", NULL));
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("[a", NULL));
+	CPPUNIT_ASSERT_EQUAL(std::string(""), Combine("[[:alpha", NULL));
+}
+
+// The first entry in the list with the given sense that matches the
+// path, found by trying every entry in turn, as GetExcludedState did
+// before the list was compiled into BoxiExcludeRules.
+static const BoxiExcludeEntry* MatchOneByOne(
+	const BoxiExcludeEntry::List& rEntries, const std::string& rPath,
+	bool isDirectory, ExcludeSense sense)
+{
+	for (BoxiExcludeEntry::ConstIterator
+		pEntry  = rEntries.begin();
+		pEntry != rEntries.end(); pEntry++)
+	{
+		if (pEntry->GetSense() != sense)
+		{
+			continue;
+		}
+
+		if (pEntry->GetFileDir() != (isDirectory ? EFD_DIR : EFD_FILE))
+		{
+			continue;
+		}
+
+		bool matched = false;
+
+		if (pEntry->GetMatch() == EM_EXACT)
+		{
+			matched = (rPath == pEntry->GetValue());
+		}
+		else if (pEntry->GetMatch() == EM_REGEX)
+		{
+			regex_t regex;
+			if (::regcomp(&regex, pEntry->GetValue().c_str(),
+				REG_EXTENDED | REG_NOSUB) == 0)
+			{
+				matched = (::regexec(&regex, rPath.c_str(),
+					0, 0, 0) == 0);
+				::regfree(&regex);
+			}
+		}
+
+		if (matched)
+		{
+			return &(*pEntry);
+		}
+	}
+
+	return NULL;
+}
+
+void TestExcludeRules::CheckPath(const BoxiExcludeEntry::List& rEntries,
+	const BoxiExcludeRules& rRules, const std::string& rPath,
+	bool isDirectory)
+{
+	const BoxiExcludeEntry* pExcludedBy = NULL;
+	const BoxiExcludeEntry* pIncludedBy = NULL;
+	rRules.Match(rPath, isDirectory, &pExcludedBy, &pIncludedBy);
+
+	const BoxiExcludeEntry* pExpectedExcludedBy = MatchOneByOne(rEntries,
+		rPath, isDirectory, ES_EXCLUDE);
+	const BoxiExcludeEntry* pExpectedIncludedBy = MatchOneByOne(rEntries,
+		rPath, isDirectory, ES_ALWAYSINCLUDE);
+
+	CPPUNIT_ASSERT_MESSAGE(rPath, pExcludedBy == pExpectedExcludedBy);
+	CPPUNIT_ASSERT_MESSAGE(rPath, pIncludedBy == pExpectedIncludedBy);
+	CPPUNIT_ASSERT_EQUAL(pExcludedBy != NULL && pIncludedBy == NULL,
+		rRules.IsExcluded(rPath, isDirectory));
+}
+
+bool TestExcludeRules::HasCombinedRegex(const BoxiExcludeRules& rRules,
+	ExcludeSense sense, ExcludeFileDir fileDir)
+{
+	return rRules.mGroups
+		[sense   == ES_ALWAYSINCLUDE ? 1 : 0]
+		[fileDir == EFD_DIR          ? 1 : 0].mpCombinedRegex != NULL;
+}
+
+void TestExcludeRules::TestMatchesOneByOne()
+{
+	BoxiExcludeEntry::List entries;
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("\\.tmp$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILE,
+		std::string("/home/alice/notes.txt")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("notes\\.txt$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("^/home/(alice|bob)/cache/")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("/c)$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILE,
+		std::string("/home/alice/notes.txt")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_DIRS_REGEX,
+		std::string("/(x+)\\1$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_DIR,
+		std::string("/home/bob/build")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_DIRS_REGEX,
+		std::string("^/home/[^/]*/(build|obj)$")));
+	entries.push_back(BoxiExcludeEntry(ET_ALWAYS_INCLUDE_FILES_REGEX,
+		std::string("important\\.tmp$")));
+	entries.push_back(BoxiExcludeEntry(ET_ALWAYS_INCLUDE_FILE,
+		std::string("/home/alice/cache/keep.tmp")));
+	entries.push_back(BoxiExcludeEntry(ET_ALWAYS_INCLUDE_FILES_REGEX,
+		std::string("^/home/(alice)/cache/k")));
+	entries.push_back(BoxiExcludeEntry(ET_ALWAYS_INCLUDE_DIRS_REGEX,
+		std::string("/obj$")));
+	entries.push_back(BoxiExcludeEntry(ET_ALWAYS_INCLUDE_DIR,
+		std::string("/home/alice/obj")));
+
+	BoxiExcludeRules rules(entries);
+
+	// the always-include file regexes have groups of their own, but
+	// can still be combined; the exclude directory regexes can't,
+	// because one has a back-reference
+	CPPUNIT_ASSERT(HasCombinedRegex(rules, ES_ALWAYSINCLUDE, EFD_FILE));
+	CPPUNIT_ASSERT(!HasCombinedRegex(rules, ES_EXCLUDE, EFD_DIR));
+	CPPUNIT_ASSERT(!HasCombinedRegex(rules, ES_ALWAYSINCLUDE, EFD_DIR));
+
+	const char* paths[] =
+	{
+		"/home/alice/notes.txt",
+		"/home/bob/notes.txt",
+		"/home/alice/notes.txt.tmp",
+		"/home/alice/cache/data",
+		"/home/alice/cache/keep.tmp",
+		"/home/alice/cache/keeper",
+		"/home/bob/cache/keep.tmp",
+		"/home/bob/cache/important.tmp",
+		"/home/carol/cache/data",
+		"/home/alice/c)",
+		"/home/alice/c",
+		"/home/alice/xx",
+		"/home/alice/xxxx",
+		"/home/alice/xxx",
+		"/home/alice/build",
+		"/home/bob/build",
+		"/home/bob/obj",
+		"/home/alice/obj",
+		"/home/alice/src",
+		"/",
+		"",
+		NULL
+	};
+
+	for (const char** ppPath = paths; *ppPath; ppPath++)
+	{
+		CheckPath(entries, rules, *ppPath, false);
+		CheckPath(entries, rules, *ppPath, true);
+	}
+
+	// a few that depend on the order of the entries, not only on
+	// which of them match
+	const BoxiExcludeEntry* pExcludedBy;
+	const BoxiExcludeEntry* pIncludedBy;
+
+	// the earlier of two identical exact entries
+	rules.Match("/home/alice/notes.txt", false, &pExcludedBy,
+		&pIncludedBy);
+	CPPUNIT_ASSERT(pExcludedBy == &(*(++entries.begin())));
+	CPPUNIT_ASSERT(pIncludedBy == NULL);
+
+	// a regex before the exact entry beats it
+	rules.Match("/home/alice/cache/keep.tmp", false, &pExcludedBy,
+		&pIncludedBy);
+	CPPUNIT_ASSERT(pExcludedBy == &(*entries.begin()));
+	CPPUNIT_ASSERT(pIncludedBy != NULL);
+	CPPUNIT_ASSERT_EQUAL(EM_EXACT, pIncludedBy->GetMatch());
+	CPPUNIT_ASSERT(!rules.IsExcluded("/home/alice/cache/keep.tmp", false));
+	CPPUNIT_ASSERT(rules.IsExcluded("/home/alice/cache/data", false));
+
+	// the back-reference only matches a repeated group
+	CPPUNIT_ASSERT(rules.IsExcluded("/home/alice/xxxx", true));
+	CPPUNIT_ASSERT(!rules.IsExcluded("/home/alice/xxx", true));
+	CPPUNIT_ASSERT(!rules.IsExcluded("/home/alice/xxxx", false));
+}
+
+void TestExcludeRules::TestFallback()
+{
+	// Each of these regexes compiles by itself, but they can't be
+	// combined, so they must be tried one at a time, and must still
+	// match what they did alone.
+	BoxiExcludeEntry::List entries;
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_DIRS_REGEX,
+		std::string("^/(ab|cd)/\\1$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_DIRS_REGEX,
+		std::string("^/tmp$")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("a)")));
+	entries.push_back(BoxiExcludeEntry(ET_EXCLUDE_FILES_REGEX,
+		std::string("^/b$")));
+
+	regex_t regex;
+	bool unbalancedCompiles = (::regcomp(&regex, "a)",
+		REG_EXTENDED | REG_NOSUB) == 0);
+	if (unbalancedCompiles)
+	{
+		::regfree(&regex);
+	}
+
+	BoxiExcludeRules rules(entries);
+	CPPUNIT_ASSERT(!HasCombinedRegex(rules, ES_EXCLUDE, EFD_DIR));
+	if (unbalancedCompiles)
+	{
+		CPPUNIT_ASSERT(!HasCombinedRegex(rules, ES_EXCLUDE, EFD_FILE));
+	}
+
+	CPPUNIT_ASSERT( rules.IsExcluded("/ab/ab", true));
+	CPPUNIT_ASSERT( rules.IsExcluded("/cd/cd", true));
+	CPPUNIT_ASSERT(!rules.IsExcluded("/ab/cd", true));
+	CPPUNIT_ASSERT( rules.IsExcluded("/tmp",   true));
+	CPPUNIT_ASSERT(!rules.IsExcluded("/ab/ab", false));
+	CPPUNIT_ASSERT( rules.IsExcluded("/b",     false));
+	CPPUNIT_ASSERT(!rules.IsExcluded("/a",     false));
+	CPPUNIT_ASSERT_EQUAL(unbalancedCompiles,
+		rules.IsExcluded("/a)", false));
+
+	const char* paths[] =
+	{
+		"/ab/ab", "/cd/cd", "/ab/cd", "/tmp", "/b", "/a", "/a)",
+		"/a)|(b", NULL
+	};
+
+	for (const char** ppPath = paths; *ppPath; ppPath++)
+	{
+		CheckPath(entries, rules, *ppPath, false);
+		CheckPath(entries, rules, *ppPath, true);
+	}
+}
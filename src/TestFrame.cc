@@ -41,6 +41,7 @@
 #define TLS_CLASS_IMPLEMENTATION_CPP
 
 #include "Box.h"
+#include "FileTree.h"
 #include "MainFrame.h"
 #include "TestFrame.h"
 
@@ -793,6 +794,16 @@ void GuiTestBase::CollapseTreeItemWaitEvent(wxTreeCtrl* pTree, wxTreeItemId& rIt
 	pTree->GetEventHandler()->ProcessEvent(click);
 }
 
+int GuiTestBase::GetStateIcon(wxTreeCtrl* pTree, const wxTreeItemId& rItem)
+{
+	FileTree* pFileTree = wxDynamicCast(pTree, FileTree);
+	BOXI_ASSERT(pFileTree);
+	BOXI_ASSERT(rItem.IsOk());
+
+	pFileTree->FlushStateIcons(true);
+	return pTree->GetItemImage(rItem);
+}
+
 void GuiTestBase::SetTextCtrlValue(wxTextCtrl* pTextCtrl, const wxString& rValue)
 {
 	BOXI_ASSERT(pTextCtrl);
@@ -0,0 +1,261 @@
+/***************************************************************************
+ *            TestPoints.cc
+ *
+ *  Thu Jan 15 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <wx/intl.h>
+
+#include "SandBox.h"
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "TestPoints.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestPoints, "WxGuiTest");
+
+CppUnit::Test *TestPoints::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestPoints");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestPoints>(
+			"TestPoints",
+			&TestPoints::RunTest));
+	return suiteOfTests;
+}
+
+void TestPoints::RunTest()
+{
+	TestRingBuffer();
+	TestDownsample();
+	TestDownsampleLttb();
+}
+
+void TestPoints::AssertInXOrder(const ListPoints& rPoints)
+{
+	for (size_t i = 1; i < rPoints.GetCount(); i++)
+	{
+		CPPUNIT_ASSERT(rPoints.Item(i - 1).m_xval <
+			rPoints.Item(i).m_xval);
+	}
+}
+
+void TestPoints::TestRingBuffer()
+{
+	wxPoints points;
+	points.SetCapacity(3);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCapacity());
+
+	// in xval order, so the oldest is overwritten in place once the
+	// ring is full
+	points.Add(wxEmptyString, 0, 10);
+	points.Add(wxEmptyString, 1, 50);
+	points.Add(wxEmptyString, 2, 20);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(10.0, points.GetMinY());
+	CPPUNIT_ASSERT_EQUAL(50.0, points.GetMaxY());
+
+	points.Add(wxEmptyString, 3, 30);
+	points.Add(wxEmptyString, 4, 40);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(2.0, points.GetMinX());
+	CPPUNIT_ASSERT_EQUAL(4.0, points.GetMaxX());
+	CPPUNIT_ASSERT_EQUAL(2.0, points.GetXVal(0));
+	CPPUNIT_ASSERT_EQUAL(3.0, points.GetXVal(1));
+	CPPUNIT_ASSERT_EQUAL(4.0, points.GetXVal(2));
+	CPPUNIT_ASSERT_EQUAL(20.0, points.GetYVal(0));
+	CPPUNIT_ASSERT_EQUAL(40.0, points.GetYVal(2));
+
+	// the min and max were dropped, so must be worked out again
+	CPPUNIT_ASSERT_EQUAL(20.0, points.GetMinY());
+	CPPUNIT_ASSERT_EQUAL(40.0, points.GetMaxY());
+
+	// out of order: inserted in its place, and the point with the
+	// smallest xval dropped
+	points.Add(wxEmptyString, 2.5, 5);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(2.5, points.GetXVal(0));
+	CPPUNIT_ASSERT_EQUAL(3.0, points.GetXVal(1));
+	CPPUNIT_ASSERT_EQUAL(4.0, points.GetXVal(2));
+	CPPUNIT_ASSERT_EQUAL(5.0,  points.GetMinY());
+	CPPUNIT_ASSERT_EQUAL(40.0, points.GetMaxY());
+
+	// older than every point kept, so it's dropped straight away
+	points.Add(wxEmptyString, 1, 100);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(2.5, points.GetMinX());
+	CPPUNIT_ASSERT_EQUAL(40.0, points.GetMaxY());
+
+	// in order again, after the ring was straightened out
+	points.Add(wxEmptyString, 5, 60);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(3.0, points.GetXVal(0));
+	CPPUNIT_ASSERT_EQUAL(5.0, points.GetXVal(2));
+	CPPUNIT_ASSERT_EQUAL(30.0, points.GetMinY());
+	CPPUNIT_ASSERT_EQUAL(60.0, points.GetMaxY());
+
+	// shrinking keeps the newest points
+	points.SetCapacity(2);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(4.0, points.GetXVal(0));
+	CPPUNIT_ASSERT_EQUAL(5.0, points.GetXVal(1));
+	CPPUNIT_ASSERT_EQUAL(40.0, points.GetMinY());
+
+	// no limit
+	points.SetCapacity(0);
+	for (int i = 6; i < 16; i++)
+	{
+		points.Add(wxEmptyString, i, i);
+	}
+	CPPUNIT_ASSERT_EQUAL((size_t)12, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(4.0,  points.GetMinX());
+	CPPUNIT_ASSERT_EQUAL(15.0, points.GetMaxX());
+
+	points.Clear();
+	CPPUNIT_ASSERT_EQUAL((size_t)0, points.GetCount());
+	CPPUNIT_ASSERT_EQUAL(0.0, points.GetMaxY());
+	CPPUNIT_ASSERT_EQUAL(0.0, points.GetXVal(0));
+}
+
+void TestPoints::TestDownsample()
+{
+	// a sawtooth with one peak and one trough that must survive
+	wxPoints points;
+	for (int i = 0; i < 100; i++)
+	{
+		ChartValue y = i % 10;
+		if (i == 37) y = 100;
+		if (i == 62) y = -5;
+		points.Add(wxEmptyString, i, y);
+	}
+
+	ListPoints out;
+	points.Downsample(0, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, out.GetCount());
+
+	// no more points than asked for: all copied
+	points.Downsample(100, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)100, out.GetCount());
+	AssertInXOrder(out);
+
+	// five intervals, with a different lowest and highest point in
+	// each, in xval order
+	points.Downsample(10, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)10, out.GetCount());
+	AssertInXOrder(out);
+
+	bool foundPeak = false, foundTrough = false;
+	for (size_t i = 0; i < out.GetCount(); i++)
+	{
+		if (out.Item(i).m_xval == 37)
+		{
+			CPPUNIT_ASSERT_EQUAL(100.0, out.Item(i).m_yval);
+			foundPeak = true;
+		}
+		else if (out.Item(i).m_xval == 62)
+		{
+			CPPUNIT_ASSERT_EQUAL(-5.0, out.Item(i).m_yval);
+			foundTrough = true;
+		}
+	}
+	CPPUNIT_ASSERT(foundPeak);
+	CPPUNIT_ASSERT(foundTrough);
+
+	// no room for both, so only the highest
+	points.Downsample(1, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, out.GetCount());
+	CPPUNIT_ASSERT_EQUAL(37.0,  out.Item(0).m_xval);
+	CPPUNIT_ASSERT_EQUAL(100.0, out.Item(0).m_yval);
+
+	// a ring that has wrapped around is read from its oldest point
+	wxPoints ring;
+	ring.SetCapacity(50);
+	for (int i = 0; i < 100; i++)
+	{
+		ring.Add(wxEmptyString, i, i % 7);
+	}
+	ring.Downsample(50, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)50, out.GetCount());
+	CPPUNIT_ASSERT_EQUAL(50.0, out.Item(0).m_xval);
+	CPPUNIT_ASSERT_EQUAL(99.0, out.Item(49).m_xval);
+
+	ring.Downsample(6, wxPOINTS_MINMAX, out);
+	CPPUNIT_ASSERT(out.GetCount() <= 6);
+	AssertInXOrder(out);
+	CPPUNIT_ASSERT(out.Item(0).m_xval >= 50);
+}
+
+void TestPoints::TestDownsampleLttb()
+{
+	// a flat line with one peak and one trough that must survive
+	wxPoints points;
+	for (int i = 0; i < 100; i++)
+	{
+		ChartValue y = 0;
+		if (i == 37) y = 100;
+		if (i == 62) y = -50;
+		points.Add(wxEmptyString, i, y);
+	}
+
+	// exactly the number asked for, starting and ending with the
+	// first and last points, and in xval order
+	ListPoints out;
+	points.Downsample(10, wxPOINTS_LTTB, out);
+	CPPUNIT_ASSERT_EQUAL((size_t)10, out.GetCount());
+	AssertInXOrder(out);
+	CPPUNIT_ASSERT_EQUAL(0.0,  out.Item(0).m_xval);
+	CPPUNIT_ASSERT_EQUAL(99.0, out.Item(9).m_xval);
+
+	bool foundPeak = false, foundTrough = false;
+	for (size_t i = 0; i < out.GetCount(); i++)
+	{
+		if (out.Item(i).m_xval == 37)
+		{
+			CPPUNIT_ASSERT_EQUAL(100.0, out.Item(i).m_yval);
+			foundPeak = true;
+		}
+		else if (out.Item(i).m_xval == 62)
+		{
+			CPPUNIT_ASSERT_EQUAL(-50.0, out.Item(i).m_yval);
+			foundTrough = true;
+		}
+		else
+		{
+			CPPUNIT_ASSERT_EQUAL(0.0, out.Item(i).m_yval);
+		}
+	}
+	CPPUNIT_ASSERT(foundPeak);
+	CPPUNIT_ASSERT(foundTrough);
+
+	// no room for a bucket between the ends, so min/max is used
+	ListPoints minMax;
+	points.Downsample(2, wxPOINTS_LTTB, out);
+	points.Downsample(2, wxPOINTS_MINMAX, minMax);
+	CPPUNIT_ASSERT_EQUAL(minMax.GetCount(), out.GetCount());
+	for (size_t i = 0; i < out.GetCount(); i++)
+	{
+		CPPUNIT_ASSERT_EQUAL(minMax.Item(i).m_xval, out.Item(i).m_xval);
+	}
+}
@@ -0,0 +1,256 @@
+/***************************************************************************
+ *            TestProgressModel.cc
+ *
+ *  Thu Jan 22 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <wx/filename.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "main.h"
+#include "ProgressModel.h"
+#include "TestProgressModel.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestProgressModel, "WxGuiTest");
+
+CppUnit::Test *TestProgressModel::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestProgressModel");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestProgressModel>(
+			"TestProgressModel",
+			&TestProgressModel::RunTest));
+	return suiteOfTests;
+}
+
+void TestProgressModel::RunTest()
+{
+	TestRate();
+	TestTimeRemaining();
+	TestWindowExpiry();
+	TestHistoryThinning();
+	TestWriteCsv();
+}
+
+void TestProgressModel::TestRate()
+{
+	ProgressModel model;
+	model.Start(5000);
+	CPPUNIT_ASSERT(!model.IsRateKnown());
+	CPPUNIT_ASSERT_EQUAL((int64_t)-1, model.GetSecondsRemaining());
+
+	// not known until the samples span long enough
+	model.Update(5500, 5, 5000, 100, 100000);
+	CPPUNIT_ASSERT(!model.IsRateKnown());
+	CPPUNIT_ASSERT_EQUAL(0.0, model.GetFilesPerSecond());
+	CPPUNIT_ASSERT_EQUAL((int64_t)-1, model.GetSecondsRemaining());
+	CPPUNIT_ASSERT_EQUAL((int64_t)500, model.GetMillisElapsed());
+
+	model.Update(5000 + PROGRESS_MIN_SPAN_MILLIS, 10, 10000, 100,
+		100000);
+	CPPUNIT_ASSERT(model.IsRateKnown());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(10.0,    model.GetFilesPerSecond(), 0.001);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(10000.0, model.GetBytesPerSecond(), 0.001);
+	CPPUNIT_ASSERT_EQUAL((int64_t)1, model.GetSecondsElapsed());
+
+	// An update less than PROGRESS_SAMPLE_MILLIS after the sample
+	// before the latest replaces the latest, rather than adding
+	// another, and the rate is still measured from the start.
+	model.Update(6100, 12, 12000, 100, 100000);
+	model.Update(6200, 13, 13000, 100, 100000);
+	CPPUNIT_ASSERT_EQUAL((size_t)4, model.mWindow.size());
+	CPPUNIT_ASSERT_EQUAL((int64_t)6200, model.mWindow.back().mMillis);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(13000.0 / 1.2, model.GetBytesPerSecond(),
+		0.001);
+}
+
+void TestProgressModel::TestTimeRemaining()
+{
+	// Small files, quickly: 10 files of 100 bytes in the first
+	// second, with 10 more to go, one of them huge. Counting bytes
+	// alone would say 1000 seconds, and counting files alone 1
+	// second. Each file counts as PROGRESS_FILE_OVERHEAD_BYTES of
+	// work on top of its size.
+	ProgressModel model;
+	model.Start(0);
+	model.Update(1000, 10, 1000, 20, 1001000);
+
+	double workLeft = 1000000.0 + 10 * PROGRESS_FILE_OVERHEAD_BYTES;
+	double workPerSecond = 1000.0 + 10 * PROGRESS_FILE_OVERHEAD_BYTES;
+	int64_t expected = (int64_t)(workLeft / workPerSecond + 0.5);
+	CPPUNIT_ASSERT_EQUAL((int64_t)25, expected);
+	CPPUNIT_ASSERT_EQUAL(expected, model.GetSecondsRemaining());
+
+	// totals that have been passed count as nothing left to do
+	model.Update(2000, 30, 2000000, 20, 1001000);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, model.GetSecondsRemaining());
+
+	// and without any totals, the time remaining isn't known
+	model.Start(0);
+	model.Update(1000, 10, 1000, 0, 0);
+	CPPUNIT_ASSERT(model.IsRateKnown());
+	CPPUNIT_ASSERT_EQUAL((int64_t)-1, model.GetSecondsRemaining());
+}
+
+void TestProgressModel::TestWindowExpiry()
+{
+	// 10 files a second for 10 seconds, then nothing
+	ProgressModel model;
+	model.Start(0);
+
+	for (int64_t now = 1000; now <= 10000; now += 1000)
+	{
+		model.Update(now, now / 100, now * 100, 200, 2000000);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(10.0, model.GetFilesPerSecond(),
+			0.001);
+	}
+
+	// Half way through the next window, the rate is measured over
+	// the last PROGRESS_WINDOW_MILLIS, half of which was idle.
+	for (int64_t now = 11000; now <= 15000; now += 1000)
+	{
+		model.Update(now, 100, 1000000, 200, 2000000);
+	}
+	CPPUNIT_ASSERT(model.IsRateKnown());
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0, model.GetFilesPerSecond(), 0.001);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(50000.0, model.GetBytesPerSecond(),
+		0.001);
+	CPPUNIT_ASSERT_EQUAL((int64_t)15000 - PROGRESS_WINDOW_MILLIS,
+		model.mWindow.front().mMillis);
+
+	// Once the whole window has been idle, the rate is zero, and the
+	// time remaining isn't known.
+	for (int64_t now = 16000; now <= 20000; now += 1000)
+	{
+		model.Update(now, 100, 1000000, 200, 2000000);
+	}
+	CPPUNIT_ASSERT(model.IsRateKnown());
+	CPPUNIT_ASSERT_EQUAL(0.0, model.GetFilesPerSecond());
+	CPPUNIT_ASSERT_EQUAL(0.0, model.GetBytesPerSecond());
+	CPPUNIT_ASSERT_EQUAL((int64_t)-1, model.GetSecondsRemaining());
+}
+
+void TestProgressModel::TestHistoryThinning()
+{
+	ProgressModel model;
+	model.Start(0);
+
+	// one point at the start, and one for every interval since
+	int64_t interval = PROGRESS_HISTORY_INTERVAL_MILLIS;
+	size_t numUpdates = PROGRESS_HISTORY_MAX_POINTS - 1;
+	for (size_t i = 1; i <= numUpdates; i++)
+	{
+		model.Update(i * interval, i, i, 0, 0);
+	}
+	CPPUNIT_ASSERT_EQUAL((size_t)PROGRESS_HISTORY_MAX_POINTS,
+		model.mHistory.size());
+	CPPUNIT_ASSERT_EQUAL(interval, model.mHistoryIntervalMillis);
+
+	// The next one finds it full, so every other point is dropped,
+	// and the interval doubled, to keep the shape of the whole run.
+	numUpdates++;
+	model.Update(numUpdates * interval, numUpdates, numUpdates, 0, 0);
+	CPPUNIT_ASSERT_EQUAL((size_t)PROGRESS_HISTORY_MAX_POINTS / 2 + 1,
+		model.mHistory.size());
+	CPPUNIT_ASSERT_EQUAL(interval * 2, model.mHistoryIntervalMillis);
+
+	for (size_t i = 0; i < model.mHistory.size(); i++)
+	{
+		CPPUNIT_ASSERT_EQUAL((int64_t)(i * interval * 2),
+			model.mHistory[i].mMillis);
+		CPPUNIT_ASSERT_EQUAL(i * 2, model.mHistory[i].mNumFilesDone);
+	}
+
+	// points are now only added at the new interval
+	numUpdates++;
+	model.Update(numUpdates * interval, numUpdates, numUpdates, 0, 0);
+	CPPUNIT_ASSERT_EQUAL((size_t)PROGRESS_HISTORY_MAX_POINTS / 2 + 1,
+		model.mHistory.size());
+	numUpdates++;
+	model.Update(numUpdates * interval, numUpdates, numUpdates, 0, 0);
+	CPPUNIT_ASSERT_EQUAL((size_t)PROGRESS_HISTORY_MAX_POINTS / 2 + 2,
+		model.mHistory.size());
+}
+
+static std::vector<std::string> ReadLines(const std::string& rFileName)
+{
+	std::vector<std::string> lines;
+	FILE* pFile = ::fopen(rFileName.c_str(), "r");
+	CPPUNIT_ASSERT(pFile != NULL);
+
+	char buf[256];
+	while (::fgets(buf, sizeof(buf), pFile))
+	{
+		std::string line(buf);
+		CPPUNIT_ASSERT(line.size() > 0);
+		CPPUNIT_ASSERT_EQUAL('\n', line[line.size() - 1]);
+		lines.push_back(line.substr(0, line.size() - 1));
+	}
+
+	CPPUNIT_ASSERT_EQUAL(0, ::fclose(pFile));
+	return lines;
+}
+
+void TestProgressModel::TestWriteCsv()
+{
+	wxFileName tempFile;
+	tempFile.AssignTempFileName(_("boxi-progress-"));
+	std::string fileName(tempFile.GetFullPath().mb_str(wxConvBoxi));
+
+	ProgressModel model;
+	model.Start(0);
+	model.Update(1000, 10, 10000, 20, 20000);
+	// not a history point yet, but written as the latest one
+	model.Update(1500, 15, 15000, 20, 20000);
+
+	CPPUNIT_ASSERT(model.WriteCsv(fileName));
+	std::vector<std::string> lines = ReadLines(fileName);
+	CPPUNIT_ASSERT_EQUAL((size_t)4, lines.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("time_seconds,files_done,"
+		"bytes_done,files_per_second,bytes_per_second,"
+		"seconds_remaining"), lines[0]);
+	// the time remaining wasn't known at the start
+	CPPUNIT_ASSERT_EQUAL(std::string("0.000,0,0,0.00,0,"), lines[1]);
+	CPPUNIT_ASSERT_EQUAL(std::string("1.000,10,10000,10.00,10000,1"),
+		lines[2]);
+	CPPUNIT_ASSERT_EQUAL(std::string("1.500,15,15000,10.00,10000,1"),
+		lines[3]);
+
+	CPPUNIT_ASSERT_EQUAL(0, ::remove(fileName.c_str()));
+
+	// a file that can't be written is reported
+	wxFileName missingDir(tempFile.GetPath(), wxT(""));
+	missingDir.AppendDir(_("boxi-no-such-dir"));
+	CPPUNIT_ASSERT(!missingDir.DirExists());
+	std::string badName(missingDir.GetPath().mb_str(wxConvBoxi));
+	badName += DIRECTORY_SEPARATOR "progress.csv";
+	CPPUNIT_ASSERT(!model.WriteCsv(badName));
+}
@@ -0,0 +1,418 @@
+/***************************************************************************
+ *            TestProgressPanel.cc
+ *
+ *  Wed Jan 21 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <stdio.h>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/listbox.h>
+#include <wx/stattext.h>
+#include <wx/stopwatch.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "main.h"
+#include "BackupProgressPanel.h"
+#include "ClientConfig.h"
+#include "MainFrame.h"
+#include "ProgressPanel.h"
+#include "TestBackupConfig.h"
+#include "TestProgressPanel.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestProgressPanel, "WxGuiTest");
+
+CppUnit::Test *TestProgressPanel::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestProgressPanel");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestProgressPanel>(
+			"TestProgressPanel",
+			&TestProgressPanel::RunTest));
+	return suiteOfTests;
+}
+
+void TestProgressPanel::RunTest()
+{
+	TestCountLocalFiles();
+	TestQueuedBackupProgress();
+	TestLastBackupTotals();
+	TestBackupCountModes();
+}
+
+// Counts files as a backup would, remembering which directories it
+// counted, instead of showing them.
+class CountingProgressPanel : public ProgressPanel
+{
+	public:
+	std::vector<std::string> mDirsCounted;
+	std::vector<std::string> mStatFailed;
+
+	CountingProgressPanel(wxWindow* pParent)
+	: ProgressPanel(pParent)
+	{ }
+
+	void Count(ExclusionOracle& rOracle, const std::string& rLocalPath)
+	{
+		ResetCounters();
+		CountLocalFiles(rOracle, rLocalPath);
+	}
+
+	size_t  GetFilesCounted() { return GetNumFilesTotal(); }
+	int64_t GetBytesCounted() { return GetNumBytesTotal(); }
+
+	protected:
+	virtual bool IsStopRequested() { return false; }
+	virtual void NotifyCountDirectory(const std::string& rLocalPath)
+	{
+		mDirsCounted.push_back(rLocalPath);
+	}
+	virtual void NotifyCountStatFailed(const std::string& rFileName)
+	{
+		mStatFailed.push_back(rFileName);
+	}
+};
+
+// Excludes one directory, and files whose names end in ".skip", and
+// remembers every path that it was asked about.
+class RecordingExclusionOracle : public ProgressPanel::ExclusionOracle
+{
+	public:
+	std::string mExcludedDir;
+	std::vector<std::string> mAsked;
+
+	RecordingExclusionOracle(const std::string& rExcludedDir)
+	: mExcludedDir(rExcludedDir)
+	{ }
+
+	virtual bool IsExcludedFile(const std::string& rFileName)
+	{
+		mAsked.push_back(rFileName);
+		return rFileName.size() >= 5 &&
+			rFileName.compare(rFileName.size() - 5, 5, ".skip") == 0;
+	}
+
+	virtual bool IsExcludedDir(const std::string& rDirName)
+	{
+		mAsked.push_back(rDirName);
+		return rDirName == mExcludedDir;
+	}
+};
+
+static void MakeFile(const std::string& rPath, size_t size)
+{
+	FILE* pFile = ::fopen(rPath.c_str(), "wb");
+	CPPUNIT_ASSERT(pFile != NULL);
+	for (size_t i = 0; i < size; i++)
+	{
+		CPPUNIT_ASSERT(::fputc('x', pFile) != EOF);
+	}
+	CPPUNIT_ASSERT_EQUAL(0, ::fclose(pFile));
+}
+
+static void MakeDir(const std::string& rPath)
+{
+	CPPUNIT_ASSERT(wxMkdir(wxString(rPath.c_str(), wxConvBoxi), 0700));
+}
+
+void TestProgressPanel::TestCountLocalFiles()
+{
+	wxFileName tempDir;
+	tempDir.AssignTempFileName(_("boxi-count-"));
+	tempDir = wxFileName(tempDir.GetLongPath(), wxT(""));
+	CPPUNIT_ASSERT(wxRemoveFile(tempDir.GetPath()));
+	CPPUNIT_ASSERT(tempDir.Mkdir(0700));
+
+	std::string root(tempDir.GetPath().mb_str(wxConvBoxi));
+	std::string sub      = root + DIRECTORY_SEPARATOR "sub";
+	std::string excluded = root + DIRECTORY_SEPARATOR "excluded";
+	std::string deeper   = excluded + DIRECTORY_SEPARATOR "deeper";
+
+	MakeFile(root + DIRECTORY_SEPARATOR "a", 3);
+	MakeFile(root + DIRECTORY_SEPARATOR "b.skip", 5);
+	MakeDir(sub);
+	MakeFile(sub + DIRECTORY_SEPARATOR "c", 7);
+	MakeFile(sub + DIRECTORY_SEPARATOR "d.skip", 11);
+	MakeDir(excluded);
+	MakeFile(excluded + DIRECTORY_SEPARATOR "e", 13);
+	MakeDir(deeper);
+	MakeFile(deeper + DIRECTORY_SEPARATOR "f", 17);
+
+	size_t  expectedFiles = 2;
+	int64_t expectedBytes = 3 + 7;
+
+	std::vector<std::string> expectedAsked;
+	expectedAsked.push_back(root + DIRECTORY_SEPARATOR "a");
+	expectedAsked.push_back(root + DIRECTORY_SEPARATOR "b.skip");
+	expectedAsked.push_back(sub);
+	expectedAsked.push_back(sub + DIRECTORY_SEPARATOR "c");
+	expectedAsked.push_back(sub + DIRECTORY_SEPARATOR "d.skip");
+	expectedAsked.push_back(excluded);
+
+	#ifndef WIN32
+	// a symbolic link is counted as a file, with the size of the
+	// link itself, whether or not readdir() gives the type; and a
+	// named pipe isn't counted, or even checked against the rules
+	std::string link = root + DIRECTORY_SEPARATOR "link";
+	CPPUNIT_ASSERT_EQUAL(0, ::symlink("a", link.c_str()));
+	expectedAsked.push_back(link);
+	expectedFiles += 1;
+	expectedBytes += 1;
+
+	std::string pipe = root + DIRECTORY_SEPARATOR "pipe";
+	CPPUNIT_ASSERT_EQUAL(0, ::mkfifo(pipe.c_str(), 0600));
+	#endif
+
+	CountingProgressPanel* pPanel =
+		new CountingProgressPanel(GetMainFrame());
+	RecordingExclusionOracle oracle(excluded);
+	pPanel->Count(oracle, root);
+
+	CPPUNIT_ASSERT_EQUAL(expectedFiles, pPanel->GetFilesCounted());
+	CPPUNIT_ASSERT_EQUAL(expectedBytes, pPanel->GetBytesCounted());
+	CPPUNIT_ASSERT_EQUAL((size_t)0, pPanel->mStatFailed.size());
+
+	// the excluded directory was never opened
+	std::vector<std::string> expectedDirs;
+	expectedDirs.push_back(root);
+	expectedDirs.push_back(sub);
+	std::sort(pPanel->mDirsCounted.begin(), pPanel->mDirsCounted.end());
+	std::sort(expectedDirs.begin(), expectedDirs.end());
+	CPPUNIT_ASSERT(expectedDirs == pPanel->mDirsCounted);
+
+	// and nothing in it was checked against the rules, while
+	// everything else was checked once
+	std::sort(oracle.mAsked.begin(), oracle.mAsked.end());
+	std::sort(expectedAsked.begin(), expectedAsked.end());
+	CPPUNIT_ASSERT_EQUAL(expectedAsked.size(), oracle.mAsked.size());
+	CPPUNIT_ASSERT(expectedAsked == oracle.mAsked);
+
+	pPanel->Destroy();
+	DeleteRecursive(tempDir);
+}
+
+void TestProgressPanel::TestQueuedBackupProgress()
+{
+	BackupProgressPanel* pPanel = new BackupProgressPanel(
+		GetMainFrame()->GetConfig(), NULL, GetMainFrame());
+	pPanel->mCountMode = BackupProgressPanel::BCM_COUNT_FIRST;
+	pPanel->ResetCounters();
+
+	// Progress from the backup thread is only queued, and none of it
+	// reaches the panel until it's flushed.
+	size_t numErrors = (size_t)pPanel->mpErrorList->GetCount();
+	wxString oldText = pPanel->mpCurrentText->GetLabel();
+
+	pPanel->NotifyMoreFilesCounted(3, 300);
+	pPanel->NotifyMoreFilesCounted(4, 400);
+	pPanel->SetCurrentAction(wxT("Scanning directory '%s'"), "/a");
+	pPanel->SetCurrentAction(wxT("Scanning directory '%s'"), "/b");
+	pPanel->AddError(wxT("first error"));
+	pPanel->AddError(wxT("second error"));
+
+	CPPUNIT_ASSERT_EQUAL(0, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, pPanel->GetNumBytesTotal());
+	CPPUNIT_ASSERT_EQUAL(numErrors,
+		(size_t)pPanel->mpErrorList->GetCount());
+	CPPUNIT_ASSERT_EQUAL(oldText, pPanel->mpCurrentText->GetLabel());
+
+	// One flush applies all of it, keeping only the latest action
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(7, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)700, pPanel->GetNumBytesTotal());
+	CPPUNIT_ASSERT_EQUAL(numErrors + 2,
+		(size_t)pPanel->mpErrorList->GetCount());
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("first error")),
+		pPanel->mpErrorList->GetString(numErrors));
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("second error")),
+		pPanel->mpErrorList->GetString(numErrors + 1));
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("Scanning directory '/b'")),
+		pPanel->mpCurrentText->GetLabel());
+
+	// and nothing is applied twice
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(7, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL(numErrors + 2,
+		(size_t)pPanel->mpErrorList->GetCount());
+
+	// The GUI thread waits for a whole interval between flushes while
+	// the backup is running (allowing for a timer that's a little
+	// early), but no longer once it has finished.
+	pPanel->mWorkerFinished = false;
+	{
+		wxStopWatch timer;
+		CPPUNIT_ASSERT(pPanel->WaitForProgress(
+			BACKUP_PROGRESS_FLUSH_MILLIS));
+		CPPUNIT_ASSERT(timer.Time() >=
+			BACKUP_PROGRESS_FLUSH_MILLIS * 3 / 4);
+	}
+
+	pPanel->NotifyWorkerFinished();
+	{
+		wxStopWatch timer;
+		CPPUNIT_ASSERT(!pPanel->WaitForProgress(
+			BACKUP_PROGRESS_FLUSH_MILLIS * 10));
+		CPPUNIT_ASSERT(timer.Time() < BACKUP_PROGRESS_FLUSH_MILLIS);
+	}
+
+	// A stop from the user stops both the backup and the count, and
+	// stopping the count alone doesn't stop the backup.
+	CPPUNIT_ASSERT(!pPanel->IsStopRequested());
+	pPanel->SetStopRequested(&pPanel->mCountStopRequested, true);
+	CPPUNIT_ASSERT(pPanel->IsStopRequested());
+	CPPUNIT_ASSERT(!pPanel->StopRun());
+	pPanel->SetStopRequested(&pPanel->mCountStopRequested, false);
+	pPanel->SetStopRequested(&pPanel->mBackupStopRequested, true);
+	CPPUNIT_ASSERT(pPanel->IsStopRequested());
+	CPPUNIT_ASSERT(pPanel->StopRun());
+
+	pPanel->Destroy();
+}
+
+void TestProgressPanel::TestLastBackupTotals()
+{
+	wxFileName tempDir;
+	tempDir.AssignTempFileName(_("boxi-totals-"));
+	tempDir = wxFileName(tempDir.GetLongPath(), wxT(""));
+	CPPUNIT_ASSERT(wxRemoveFile(tempDir.GetPath()));
+	CPPUNIT_ASSERT(tempDir.Mkdir(0700));
+
+	std::string totalsFile(tempDir.GetPath().mb_str(wxConvBoxi));
+	totalsFile += DIRECTORY_SEPARATOR BACKUP_LAST_TOTALS_FILE;
+
+	ClientConfig config;
+	BackupProgressPanel* pPanel = new BackupProgressPanel(&config, NULL,
+		GetMainFrame());
+	pPanel->ResetCounters();
+
+	size_t  numFiles = 1;
+	int64_t numBytes = 1;
+
+	// nowhere to keep the totals
+	CPPUNIT_ASSERT(!pPanel->ReadLastTotals(&numFiles, &numBytes));
+	pPanel->WriteLastTotals();
+
+	config.DataDirectory.Set(tempDir.GetPath());
+
+	// no totals kept yet
+	CPPUNIT_ASSERT(!pPanel->ReadLastTotals(&numFiles, &numBytes));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, numFiles);
+	CPPUNIT_ASSERT_EQUAL((int64_t)1, numBytes);
+
+	// The totals done are written, and read back exactly, even if
+	// they're too big for 32 bits.
+	pPanel->NotifyMoreFilesDone(12, 5000000000LL);
+	pPanel->WriteLastTotals();
+	CPPUNIT_ASSERT(pPanel->ReadLastTotals(&numFiles, &numBytes));
+	CPPUNIT_ASSERT_EQUAL((size_t)12, numFiles);
+	CPPUNIT_ASSERT_EQUAL((int64_t)5000000000LL, numBytes);
+
+	// a corrupt file is ignored
+	CPPUNIT_ASSERT_EQUAL(0, ::unlink(totalsFile.c_str()));
+	MakeFile(totalsFile, 3);
+	numFiles = 1;
+	numBytes = 1;
+	CPPUNIT_ASSERT(!pPanel->ReadLastTotals(&numFiles, &numBytes));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, numFiles);
+	CPPUNIT_ASSERT_EQUAL((int64_t)1, numBytes);
+
+	// and so is a missing one
+	CPPUNIT_ASSERT_EQUAL(0, ::unlink(totalsFile.c_str()));
+	CPPUNIT_ASSERT(!pPanel->ReadLastTotals(&numFiles, &numBytes));
+
+	pPanel->Destroy();
+	DeleteRecursive(tempDir);
+}
+
+void TestProgressPanel::TestBackupCountModes()
+{
+	ClientConfig config;
+	BackupProgressPanel* pPanel = new BackupProgressPanel(&config, NULL,
+		GetMainFrame());
+
+	// Counting alongside the backup, the estimate stands until the
+	// count is complete, and is then replaced by it.
+	pPanel->mCountMode = BackupProgressPanel::BCM_COUNT_ALONGSIDE;
+	pPanel->ResetCounters();
+	pPanel->SetTotals(10, 1000);
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("10")),
+		pPanel->GetNumFilesTotalString());
+
+	pPanel->NotifyMoreFilesCounted(3, 300);
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(10, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)1000, pPanel->GetNumBytesTotal());
+
+	{
+		wxMutexLocker lock(pPanel->mProgressMutex);
+		pPanel->mCountFinished = true;
+	}
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(3, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)300, pPanel->GetNumBytesTotal());
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("3")),
+		pPanel->GetNumFilesTotalString());
+
+	// Without a count, the estimate only grows when the backup does
+	// more than it expected.
+	pPanel->mCountMode = BackupProgressPanel::BCM_DONT_COUNT;
+	pPanel->ResetCounters();
+	pPanel->SetTotals(10, 1000);
+
+	{
+		wxMutexLocker lock(pPanel->mProgressMutex);
+		pPanel->mPendingFilesDone = 4;
+		pPanel->mPendingBytesDone = 400;
+	}
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(10, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)1000, pPanel->GetNumBytesTotal());
+	CPPUNIT_ASSERT_EQUAL((size_t)4, pPanel->GetNumFilesDone());
+
+	{
+		wxMutexLocker lock(pPanel->mProgressMutex);
+		pPanel->mPendingFilesDone = 8;
+		pPanel->mPendingBytesDone = 200;
+	}
+	pPanel->FlushProgress();
+	CPPUNIT_ASSERT_EQUAL(12, pPanel->GetNumFilesTotal());
+	CPPUNIT_ASSERT_EQUAL((int64_t)1000, pPanel->GetNumBytesTotal());
+	CPPUNIT_ASSERT_EQUAL((size_t)12, pPanel->GetNumFilesDone());
+	CPPUNIT_ASSERT_EQUAL(wxString(wxT("12")),
+		pPanel->GetNumFilesTotalString());
+
+	pPanel->Destroy();
+}
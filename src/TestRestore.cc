@@ -27,6 +27,8 @@
 #include <sys/time.h> // for utimes()
 #include <utime.h> // for utime()
 
+#include <set>
+
 #include <openssl/ssl.h>
 
 #include <wx/button.h>
@@ -301,7 +303,7 @@ void TestRestore::RunTest()
 		CPPUNIT_ASSERT_EQUAL(expected, label);
 		CPPUNIT_ASSERT_EQUAL_MESSAGE(buf.data(),
 			mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(entry));
+			GetStateIcon(mpRestoreTree, entry));
 		CPPUNIT_ASSERT_MESSAGE(buf.data(),
 			mpRestoreTree->GetItemTextColour(entry) ==
 			wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOWTEXT));
@@ -313,7 +315,7 @@ void TestRestore::RunTest()
 			ActivateTreeItemWaitEvent(mpRestoreTree, entry);
 			CPPUNIT_ASSERT_EQUAL_MESSAGE(buf.data(),
 				mapImages->GetCheckedImageId(),
-				mpRestoreTree->GetItemImage(entry));
+				GetStateIcon(mpRestoreTree, entry));
 		}
 	}
 
@@ -334,9 +336,9 @@ void TestRestore::RunTest()
 	}
 
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(),
-		mpRestoreTree->GetItemImage(mLocationId));
+		GetStateIcon(mpRestoreTree, mLocationId));
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(),
-		mpRestoreTree->GetItemImage(mRootId));
+		GetStateIcon(mpRestoreTree, mRootId));
 
 	CPPUNIT_ASSERT_EQUAL(1, pLocsList->GetCount());
 	CPPUNIT_ASSERT_EQUAL(wxString(_("+ /testdata/df9834.dsf")),
@@ -410,6 +412,7 @@ void TestRestore::RunTest()
 	TestRestoreServerRoot();
 	TestOldAndDeletedFilesNotRestored();
 	TestRestoreToDate();
+	TestPagedServerDirectory();
 	CleanUp();
 }
 
@@ -425,17 +428,17 @@ void TestRestore::TestRestoreWholeDir()
 		{
 			ActivateTreeItemWaitEvent(mpRestoreTree, entry);
 			CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-				mpRestoreTree->GetItemImage(entry));
+				GetStateIcon(mpRestoreTree, entry));
 		}
 		else if (mpRestoreTree->GetItemText(entry).IsSameAs(_("df9834.dsf")))
 		{
 			CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-				mpRestoreTree->GetItemImage(entry));
+				GetStateIcon(mpRestoreTree, entry));
 		}
 		else
 		{
 			CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-				mpRestoreTree->GetItemImage(entry));
+				GetStateIcon(mpRestoreTree, entry));
 		}
 	}
 
@@ -475,13 +478,13 @@ void TestRestore::TestRestoreSpec()
 	sub23id = GetItemIdFromPath(mpRestoreTree, mLocationId, _("sub23"));
 	CPPUNIT_ASSERT(sub23id.IsOk());
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-		mpRestoreTree->GetItemImage(sub23id));
+		GetStateIcon(mpRestoreTree, sub23id));
 
 	dhsfdss = GetItemIdFromPath(mpRestoreTree, mLocationId,
 		_("sub23/dhsfdss"));
 	CPPUNIT_ASSERT(dhsfdss.IsOk());
 	CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
-		mpRestoreTree->GetItemImage(dhsfdss));
+		GetStateIcon(mpRestoreTree, dhsfdss));
 }
 
 void TestRestore::TestDoubleIncludes()
@@ -491,21 +494,21 @@ void TestRestore::TestDoubleIncludes()
 	{
 		ActivateTreeItemWaitEvent(mpRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 
 		ActivateTreeItemWaitEvent(mpRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 
 		ActivateTreeItemWaitEvent(mpRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 	}
 
 	{
@@ -541,9 +544,9 @@ void TestRestore::TestDoubleAndConflictingIncludes()
 	{
 		ActivateTreeItemWaitEvent(mpRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 	}
 
 	{
@@ -591,25 +594,25 @@ void TestRestore::TestIncludeInsideExclude()
 	// both are restored properly.
 	{
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(),
-			mpRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(mpRestoreTree, bfdlink_h));
 
 		ActivateTreeItemWaitEvent(mpRestoreTree, bfdlink_h);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(mpRestoreTree, bfdlink_h));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedGreyImageId(),
-			mpRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(mpRestoreTree, dfsfd));
 
 		ActivateTreeItemWaitEvent(mpRestoreTree, dfsfd);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(mpRestoreTree, dfsfd));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
-			mpRestoreTree->GetItemImage(a_out_h));
+			GetStateIcon(mpRestoreTree, a_out_h));
 	}
 
 	{
@@ -652,43 +655,43 @@ void TestRestore::TestRestoreServerRoot()
 	// clear all entries, select the server root
 	{
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCrossedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 		ActivateTreeItemWaitEvent(mpRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedGreyImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 		ActivateTreeItemWaitEvent(mpRestoreTree, sub23id);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(),
-			mpRestoreTree->GetItemImage(sub23id));
+			GetStateIcon(mpRestoreTree, sub23id));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 		ActivateTreeItemWaitEvent(mpRestoreTree, dhsfdss);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetPartialImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(mpRestoreTree, bfdlink_h));
 		ActivateTreeItemWaitEvent(mpRestoreTree, bfdlink_h);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(bfdlink_h));
+			GetStateIcon(mpRestoreTree, bfdlink_h));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(mpRestoreTree, dfsfd));
 		ActivateTreeItemWaitEvent(mpRestoreTree, dfsfd);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(dfsfd));
+			GetStateIcon(mpRestoreTree, dfsfd));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(dhsfdss));
+			GetStateIcon(mpRestoreTree, dhsfdss));
 
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetEmptyImageId(),
-			mpRestoreTree->GetItemImage(mRootId));
+			GetStateIcon(mpRestoreTree, mRootId));
 		ActivateTreeItemWaitEvent(mpRestoreTree, mRootId);
 		CPPUNIT_ASSERT_EQUAL(mapImages->GetCheckedImageId(),
-			mpRestoreTree->GetItemImage(mRootId));
+			GetStateIcon(mpRestoreTree, mRootId));
 	}
 
 	{
@@ -901,6 +904,146 @@ void TestRestore::TestRestoreToDate()
 	DeleteRecursive(expectedRestoreDir);
 }
 
+void TestRestore::TestPagedServerDirectory()
+{
+	// A server directory with more than a page of entries is added to
+	// the tree a page at a time, and each entry is added once, in
+	// order, even if the directory is listed again between pages.
+	// With the usual doubling growth, 2048 entries fill the cache
+	// node's vector of children exactly, so listing one more moves
+	// them all.
+
+	const size_t numEntries = 2048;
+	CPPUNIT_ASSERT(numEntries > FILE_TREE_PAGE_SIZE * 2);
+
+	wxFileName pagedDir(mTestDataDir.GetFullPath(), _("paged"));
+	pagedDir = wxFileName(pagedDir.GetFullPath(), wxT(""));
+	CPPUNIT_ASSERT(pagedDir.Mkdir(0700));
+
+	for (size_t i = 0; i < numEntries; i++)
+	{
+		wxString name;
+		name.Printf(_("d%04d"), (int)i);
+		CPPUNIT_ASSERT(wxMkdir(MakeAbsolutePath(pagedDir, name)
+			.GetFullPath(), 0700));
+	}
+
+	CHECK_BACKUP_OK();
+	mpMainFrame->GetConnection()->Disconnect();
+
+	FileTree* pTree = wxDynamicCast(mpRestoreTree, FileTree);
+	CPPUNIT_ASSERT(pTree);
+
+	// re-read the location, to find the new directory
+	mpRestoreTree->Collapse(mLocationId);
+	wxTreeItemId pagedId = GetItemIdFromPath(mpRestoreTree, mLocationId,
+		_("paged"));
+	CPPUNIT_ASSERT(pagedId.IsOk());
+
+	// Find its cache node, by selecting it for restore and then
+	// deselecting it again.
+	ServerCacheNode* pPagedCache = NULL;
+	{
+		RestoreSpec& rRestoreSpec(mpRestorePanel->GetRestoreSpec());
+		size_t numSpecEntries = rRestoreSpec.GetEntries().size();
+		ActivateTreeItemWaitEvent(mpRestoreTree, pagedId);
+
+		const RestoreSpecEntry::Vector& entries =
+			rRestoreSpec.GetEntries();
+		CPPUNIT_ASSERT_EQUAL(numSpecEntries + 1, entries.size());
+		for (RestoreSpecEntry::ConstIterator i = entries.begin();
+			i != entries.end(); i++)
+		{
+			if (i->GetNode().GetFullPath().IsSameAs(
+				_("/testdata/paged")))
+			{
+				pPagedCache = &(i->GetNode());
+			}
+		}
+
+		ActivateTreeItemWaitEvent(mpRestoreTree, pagedId);
+		CPPUNIT_ASSERT_EQUAL(numSpecEntries,
+			rRestoreSpec.GetEntries().size());
+	}
+	CPPUNIT_ASSERT(pPagedCache);
+
+	FileNode* pPagedNode = (FileNode*)mpRestoreTree->GetItemData(pagedId);
+	CPPUNIT_ASSERT(pPagedNode);
+
+	#define CHECK_PAGED_CHILDREN(numAdded) \
+	{ \
+		size_t numChildren = (numAdded < numEntries) \
+			? (numAdded + 1) : numAdded; \
+		CPPUNIT_ASSERT_EQUAL(numChildren, \
+			mpRestoreTree->GetChildrenCount(pagedId, false)); \
+		CPPUNIT_ASSERT_EQUAL(numAdded < numEntries, \
+			pPagedNode->GetMoreItemId().IsOk()); \
+		std::set<wxString> seen; \
+		wxTreeItemIdValue cookie; \
+		wxTreeItemId child = mpRestoreTree->GetFirstChild(pagedId, \
+			cookie); \
+		for (size_t i = 0; i < numAdded; i++) \
+		{ \
+			CPPUNIT_ASSERT(child.IsOk()); \
+			wxString expected; \
+			expected.Printf(_("d%04d"), (int)i); \
+			wxString label = mpRestoreTree->GetItemText(child); \
+			CPPUNIT_ASSERT_EQUAL(expected, label); \
+			CPPUNIT_ASSERT(seen.insert(label).second); \
+			child = mpRestoreTree->GetNextChild(pagedId, cookie); \
+		} \
+		if (numAdded < numEntries) \
+		{ \
+			CPPUNIT_ASSERT(child == pPagedNode->GetMoreItemId()); \
+			CPPUNIT_ASSERT(!mpRestoreTree->GetItemData(child)); \
+			wxString expected; \
+			expected.Printf(_("(%d more entries...)"), \
+				(int)(numEntries - numAdded)); \
+			CPPUNIT_ASSERT_EQUAL(expected, \
+				mpRestoreTree->GetItemText(child)); \
+			child = mpRestoreTree->GetNextChild(pagedId, cookie); \
+		} \
+		CPPUNIT_ASSERT(!child.IsOk()); \
+	}
+
+	mpRestoreTree->Expand(pagedId);
+	CHECK_PAGED_CHILDREN(FILE_TREE_PAGE_SIZE);
+
+	// Back up another entry, and list the directory again on a new
+	// connection, as anything looking at the cache node would.
+	CPPUNIT_ASSERT(wxMkdir(MakeAbsolutePath(pagedDir, _("d9999"))
+		.GetFullPath(), 0700));
+	CHECK_BACKUP_OK();
+	mpMainFrame->GetConnection()->Disconnect();
+
+	{
+		ServerCacheNode::SafeVector* pChildren =
+			pPagedCache->GetChildren();
+		CPPUNIT_ASSERT(pChildren);
+		size_t numCached = 0;
+		for (ServerCacheNode::Iterator i = pChildren->begin();
+			i != pChildren->end(); i++)
+		{
+			numCached++;
+		}
+		CPPUNIT_ASSERT_EQUAL(numEntries + 1, numCached);
+	}
+
+	// The rest of the entries listed when the node was expanded are
+	// still added, once each, and in order.
+	CPPUNIT_ASSERT(pPagedNode->AddNextPage(pTree, false));
+	CHECK_PAGED_CHILDREN(FILE_TREE_PAGE_SIZE * 2);
+	CPPUNIT_ASSERT(pPagedNode->AddNextPage(pTree, false));
+	CHECK_PAGED_CHILDREN(numEntries);
+
+	#undef CHECK_PAGED_CHILDREN
+
+	// Throw away the nodes that refer to the old cache entries
+	mpRestoreTree->Collapse(mLocationId);
+	mpRestoreTree->Expand(mLocationId);
+	DeleteRecursive(pagedDir);
+}
+
 void TestRestore::CleanUp()
 {
 	DeleteRecursive(mTestDataDir);
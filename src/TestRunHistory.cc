@@ -0,0 +1,315 @@
+/***************************************************************************
+ *            TestRunHistory.cc
+ *
+ *  Fri Jan 16 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <wx/intl.h>
+
+#include "SandBox.h"
+
+#include <stdio.h>
+
+#include <wx/filename.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "main.h"
+#include "TestRunHistory.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestRunHistory, "WxGuiTest");
+
+CppUnit::Test *TestRunHistory::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestRunHistory");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestRunHistory>(
+			"TestRunHistory",
+			&TestRunHistory::RunTest));
+	return suiteOfTests;
+}
+
+void TestRunHistory::RunTest()
+{
+	wxFileName tempFile;
+	tempFile.AssignTempFileName(_("boxi-runHistory-"));
+	mFileName = std::string(tempFile.GetFullPath().mb_str(wxConvBoxi));
+
+	TestAddAndGetRuns();
+	TestCompaction();
+	TestSlowerThanUsual();
+	TestRecordAndCheck();
+
+	ClearHistory();
+}
+
+void TestRunHistory::ClearHistory()
+{
+	::remove(mFileName.c_str());
+	CPPUNIT_ASSERT(!wxFileName::FileExists(wxString(mFileName.c_str(),
+		wxConvBoxi)));
+}
+
+void TestRunHistory::AddRun(RunHistory& rHistory, RunHistory::Kind kind,
+	RunHistory::Result result, time_t startTime, int64_t durationMillis,
+	size_t numFiles)
+{
+	RunHistory::Run run(kind);
+	run.mResult          = result;
+	run.mStartTime       = startTime;
+	run.mDurationMillis  = durationMillis;
+	run.mNumFilesScanned = numFiles;
+	CPPUNIT_ASSERT(rHistory.Add(run));
+}
+
+void TestRunHistory::TestAddAndGetRuns()
+{
+	ClearHistory();
+	RunHistory history(mFileName);
+
+	// a missing file is an empty history
+	std::vector<RunHistory::Run> runs;
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, runs.size());
+
+	RunHistory::Run run(RunHistory::RK_BACKUP);
+	run.mResult           = RunHistory::RR_SUCCEEDED;
+	run.mStartTime        = 1000;
+	run.mDurationMillis   = 12345;
+	run.mNumFilesScanned  = 100;
+	run.mNumBytesScanned  = 0x123456789LL;
+	run.mNumFilesUploaded = 20;
+	run.mNumBytesUploaded = 4096;
+	run.mNumPatchUploads  = 5;
+	run.mNumErrors        = 2;
+	run.mPeakMemoryBytes  = 1 << 24;
+	CPPUNIT_ASSERT(history.Add(run));
+
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_STOPPED,
+		1500, 100, 10);
+	AddRun(history, RunHistory::RK_BACKUP, RunHistory::RR_FAILED,
+		2000, 100, 10);
+	AddRun(history, RunHistory::RK_RESTORE, RunHistory::RR_SUCCEEDED,
+		2500, 100, 10);
+
+	// a partial line, as if written by a crash, is skipped
+	FILE* pFile = ::fopen(mFileName.c_str(), "a");
+	CPPUNIT_ASSERT(pFile != NULL);
+	::fprintf(pFile, "1 0 0 3000 10");
+	CPPUNIT_ASSERT_EQUAL(0, ::fclose(pFile));
+
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)2, runs.size());
+	CPPUNIT_ASSERT_EQUAL(RunHistory::RR_SUCCEEDED, runs[0].mResult);
+	CPPUNIT_ASSERT_EQUAL((time_t)1000, runs[0].mStartTime);
+	CPPUNIT_ASSERT_EQUAL((int64_t)12345, runs[0].mDurationMillis);
+	CPPUNIT_ASSERT_EQUAL((size_t)100, runs[0].mNumFilesScanned);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0x123456789LL, runs[0].mNumBytesScanned);
+	CPPUNIT_ASSERT_EQUAL((size_t)20, runs[0].mNumFilesUploaded);
+	CPPUNIT_ASSERT_EQUAL((int64_t)4096, runs[0].mNumBytesUploaded);
+	CPPUNIT_ASSERT_EQUAL((size_t)5, runs[0].mNumPatchUploads);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, runs[0].mNumErrors);
+	CPPUNIT_ASSERT_EQUAL((int64_t)(1 << 24), runs[0].mPeakMemoryBytes);
+	CPPUNIT_ASSERT_EQUAL(RunHistory::RR_FAILED, runs[1].mResult);
+	CPPUNIT_ASSERT_EQUAL((time_t)2000, runs[1].mStartTime);
+
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_COMPARE, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, runs.size());
+	CPPUNIT_ASSERT_EQUAL(RunHistory::RR_STOPPED, runs[0].mResult);
+
+	// only those that started at or after the given time
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 2000, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)2000, runs[0].mStartTime);
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_RESTORE, 2501, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)0, runs.size());
+}
+
+void TestRunHistory::TestCompaction()
+{
+	ClearHistory();
+	RunHistory history(mFileName);
+	std::vector<RunHistory::Run> runs;
+
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		1, 100, 10);
+
+	// up to twice as many as are kept, nothing is dropped
+	for (int i = 1; i <= 1000; i++)
+	{
+		AddRun(history, RunHistory::RK_BACKUP,
+			RunHistory::RR_SUCCEEDED, i, 100, 10);
+	}
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)1000, runs.size());
+
+	// one more, and only the newest 500 backups are kept
+	AddRun(history, RunHistory::RK_BACKUP, RunHistory::RR_SUCCEEDED,
+		1001, 100, 10);
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)500, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)502,  runs[0].mStartTime);
+	CPPUNIT_ASSERT_EQUAL((time_t)1001, runs[499].mStartTime);
+
+	// but runs of other kinds are left alone
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_COMPARE, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)1, runs[0].mStartTime);
+
+	// and the compacted file can still be added to
+	AddRun(history, RunHistory::RK_BACKUP, RunHistory::RR_SUCCEEDED,
+		1002, 100, 10);
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_BACKUP, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)501, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)1002, runs[500].mStartTime);
+}
+
+void TestRunHistory::TestSlowerThanUsual()
+{
+	ClearHistory();
+	RunHistory history(mFileName);
+	double usual;
+
+	RunHistory::Run slow(RunHistory::RK_COMPARE);
+	slow.mResult          = RunHistory::RR_SUCCEEDED;
+	slow.mDurationMillis  = 10000;
+	slow.mNumFilesScanned = 1500; // 150 files per second
+
+	// two comparable runs aren't enough to tell
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		1, 10000, 1000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		2, 10000, 2000);
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(0.0, usual);
+
+	// nor are failed, short or small runs, or runs of other kinds
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_FAILED,
+		3, 10000, 100000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_STOPPED,
+		4, 10000, 100000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		5, 9999, 100000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		6, 10000, 99);
+	AddRun(history, RunHistory::RK_BACKUP, RunHistory::RR_SUCCEEDED,
+		7, 10000, 100000);
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(0.0, usual);
+
+	// 100, 200 and 300 files per second: the median is 200, and
+	// 150 isn't much slower than that
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		8, 10000, 3000);
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(200.0, usual);
+
+	// 100 to 500: the median is 300, and 150 is much slower
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		9, 10000, 4000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		10, 10000, 5000);
+	CPPUNIT_ASSERT(history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(300.0, usual);
+
+	// an even number: the mean of the middle two
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		11, 10000, 6000);
+	CPPUNIT_ASSERT(history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(350.0, usual);
+
+	// a run that was too short to mean much is never slow
+	RunHistory::Run shortRun(slow);
+	shortRun.mDurationMillis  = 1000;
+	shortRun.mNumFilesScanned = 150;
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(shortRun, &usual));
+	CPPUNIT_ASSERT_EQUAL(0.0, usual);
+
+	// only the last ten comparable runs count: these push the
+	// earlier, slower ones out
+	for (int i = 0; i < 10; i++)
+	{
+		AddRun(history, RunHistory::RK_COMPARE,
+			RunHistory::RR_SUCCEEDED, 12 + i, 10000, 1600);
+	}
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(slow, &usual));
+	CPPUNIT_ASSERT_EQUAL(160.0, usual);
+
+	// another kind has its own history
+	RunHistory::Run backup(slow);
+	backup.mKind = RunHistory::RK_BACKUP;
+	CPPUNIT_ASSERT(!history.IsSlowerThanUsual(backup, &usual));
+	CPPUNIT_ASSERT_EQUAL(0.0, usual);
+}
+
+void TestRunHistory::TestRecordAndCheck()
+{
+	ClearHistory();
+	RunHistory history(mFileName);
+	std::vector<RunHistory::Run> runs;
+	wxString warning, error;
+
+	RunHistory::Run slow(RunHistory::RK_COMPARE);
+	slow.mResult          = RunHistory::RR_SUCCEEDED;
+	slow.mStartTime       = 10;
+	slow.mDurationMillis  = 10000;
+	slow.mNumFilesScanned = 1500; // 150 files per second
+
+	// with nothing to compare with, the run is only recorded
+	CPPUNIT_ASSERT(!history.RecordAndCheck(slow, &warning, &error));
+	CPPUNIT_ASSERT(warning.IsEmpty());
+	CPPUNIT_ASSERT(error.IsEmpty());
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_COMPARE, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)1, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)10, runs[0].mStartTime);
+
+	// 150, 300, 400 and 500 files per second: the median is 350,
+	// so another run at 150 is much slower, and is checked against
+	// the runs before it and then recorded
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		11, 10000, 3000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		12, 10000, 4000);
+	AddRun(history, RunHistory::RK_COMPARE, RunHistory::RR_SUCCEEDED,
+		13, 10000, 5000);
+
+	slow.mStartTime = 14;
+	CPPUNIT_ASSERT(history.RecordAndCheck(slow, &warning, &error));
+	CPPUNIT_ASSERT(error.IsEmpty());
+	CPPUNIT_ASSERT_EQUAL(wxString(_("Warning: this compare ran at "
+		"150.0 files per second, much slower than the usual 350.0")),
+		warning);
+	CPPUNIT_ASSERT(history.GetRuns(RunHistory::RK_COMPARE, 0, &runs));
+	CPPUNIT_ASSERT_EQUAL((size_t)5, runs.size());
+	CPPUNIT_ASSERT_EQUAL((time_t)14, runs[4].mStartTime);
+
+	// a history that can't be written is reported as an error,
+	// and the old warning isn't left behind
+	RunHistory unwritable(mFileName + "/nonexistent/history");
+	slow.mNumFilesScanned = 1;
+	CPPUNIT_ASSERT(!unwritable.RecordAndCheck(slow, &warning, &error));
+	CPPUNIT_ASSERT(warning.IsEmpty());
+	CPPUNIT_ASSERT(!error.IsEmpty());
+}
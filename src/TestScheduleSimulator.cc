@@ -0,0 +1,228 @@
+/***************************************************************************
+ *            TestScheduleSimulator.cc
+ *
+ *  Mon Jan 19 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <stdio.h>
+
+#include <wx/filename.h>
+
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "main.h"
+#include "TestScheduleSimulator.h"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestScheduleSimulator, "WxGuiTest");
+
+CppUnit::Test *TestScheduleSimulator::suite()
+{
+	CppUnit::TestSuite *suiteOfTests =
+		new CppUnit::TestSuite("TestScheduleSimulator");
+	suiteOfTests->addTest(
+		new CppUnit::TestCaller<TestScheduleSimulator>(
+			"TestScheduleSimulator",
+			&TestScheduleSimulator::RunTest));
+	return suiteOfTests;
+}
+
+void TestScheduleSimulator::RunTest()
+{
+	wxFileName tempFile;
+	tempFile.AssignTempFileName(_("boxi-trace-"));
+	mFileName = std::string(tempFile.GetFullPath().mb_str(wxConvBoxi));
+
+	// short times, so that the traces can be worked through by hand
+	mSettings.mUpdateStoreInterval = 100;
+	mSettings.mMinimumFileAge = 300;
+	mSettings.mMaxUploadWait = 1000;
+	mSettings.mDiffingUploadSizeThreshold = 8192;
+	mSettings.mMaximumDiffingTime = 0;
+
+	TestMinimumFileAge();
+	TestMaxUploadWait();
+	TestDiffingThreshold();
+	TestMaximumDiffingTime();
+	TestStoreLoad();
+
+	::remove(mFileName.c_str());
+}
+
+// Writes a trace, one change per line, and loads it
+void TestScheduleSimulator::LoadTrace(ScheduleSimulator& rSimulator,
+	const std::string& rTrace)
+{
+	FILE* pFile = ::fopen(mFileName.c_str(), "w");
+	CPPUNIT_ASSERT(pFile != NULL);
+	CPPUNIT_ASSERT(::fputs(rTrace.c_str(), pFile) >= 0);
+	CPPUNIT_ASSERT_EQUAL(0, ::fclose(pFile));
+
+	std::string error;
+	CPPUNIT_ASSERT(rSimulator.LoadTrace(mFileName, &error));
+}
+
+void TestScheduleSimulator::TestMinimumFileAge()
+{
+	ScheduleSimulator simulator;
+	LoadTrace(simulator, "# time size changed path\n"
+		"\n"
+		"0 10000 100 a\n");
+	CPPUNIT_ASSERT_EQUAL((size_t)1, simulator.GetTrace().size());
+
+	// syncs every 100 seconds from the change until MinimumFileAge
+	// and one more interval have passed
+	std::vector<ScheduleSimulator::Sync> syncs;
+	simulator.Run(mSettings, 0, &syncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)5, syncs.size());
+
+	for (size_t i = 0; i < syncs.size(); i++)
+	{
+		CPPUNIT_ASSERT_EQUAL((int64_t)(i * 100), syncs[i].mTime);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, syncs[i].mNumForcedUploads);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, syncs[i].mNumFullUploads);
+
+		// held back until it's 300 seconds old
+		CPPUNIT_ASSERT_EQUAL((size_t)(i < 3 ? 1 : 0),
+			syncs[i].mNumDeferred);
+		CPPUNIT_ASSERT_EQUAL((size_t)(i == 3 ? 1 : 0),
+			syncs[i].mNumDiffUploads);
+		CPPUNIT_ASSERT_EQUAL((int64_t)(i == 3 ? 100 : 0),
+			syncs[i].mBytesUploaded);
+	}
+}
+
+void TestScheduleSimulator::TestMaxUploadWait()
+{
+	// a file that changes every 50 seconds, so never gets old enough
+	std::string trace;
+	for (int time = 0; time <= 2000; time += 50)
+	{
+		char line[32];
+		::sprintf(line, "%d 10000 10 mailbox\n", time);
+		trace += line;
+	}
+
+	ScheduleSimulator simulator;
+	LoadTrace(simulator, trace);
+
+	std::vector<ScheduleSimulator::Sync> syncs;
+	simulator.Run(mSettings, 0, &syncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)25, syncs.size());
+
+	for (size_t i = 0; i < syncs.size(); i++)
+	{
+		// forced out 1000 seconds after it was first put off,
+		// with all the changes made until then
+		int64_t time = syncs[i].mTime;
+		bool forced = (time == 1000 || time == 2100);
+		CPPUNIT_ASSERT_EQUAL((size_t)(forced ? 1 : 0),
+			syncs[i].mNumForcedUploads);
+		CPPUNIT_ASSERT_EQUAL((size_t)(forced ? 1 : 0),
+			syncs[i].mNumDiffUploads);
+		CPPUNIT_ASSERT_EQUAL((size_t)(!forced && time < 2100 ? 1 : 0),
+			syncs[i].mNumDeferred);
+		CPPUNIT_ASSERT_EQUAL((int64_t)(time == 1000 ? 210 :
+			time == 2100 ? 200 : 0), syncs[i].mBytesUploaded);
+	}
+}
+
+void TestScheduleSimulator::TestDiffingThreshold()
+{
+	ScheduleSimulator simulator;
+	LoadTrace(simulator,
+		"0 8191 1 below\n"
+		"0 8192 1 at\n"
+		"0 100000 100000 new\n");
+
+	ScheduleSimulator::Settings settings(mSettings);
+	settings.mMinimumFileAge = 0;
+
+	// files on the store are diffed from the threshold up, and new
+	// files are always sent whole
+	std::vector<ScheduleSimulator::Sync> syncs;
+	simulator.Run(settings, 0, &syncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, syncs.size());
+	CPPUNIT_ASSERT_EQUAL((size_t)2, syncs[0].mNumFullUploads);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, syncs[0].mNumDiffUploads);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, syncs[0].mNumDeferred);
+	CPPUNIT_ASSERT_EQUAL((int64_t)(8191 + 1 + 100000),
+		syncs[0].mBytesUploaded);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, syncs[1].mBytesUploaded);
+}
+
+void TestScheduleSimulator::TestMaximumDiffingTime()
+{
+	// one second's diffing is 4 MB
+	ScheduleSimulator simulator;
+	LoadTrace(simulator,
+		"0 4194304 10 fits\n"
+		"0 4194305 10 toobig\n");
+
+	ScheduleSimulator::Settings settings(mSettings);
+	settings.mMinimumFileAge = 0;
+
+	std::vector<ScheduleSimulator::Sync> syncs;
+	simulator.Run(settings, 0, &syncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, syncs[0].mNumFullUploads);
+	CPPUNIT_ASSERT_EQUAL((size_t)2, syncs[0].mNumDiffUploads);
+	CPPUNIT_ASSERT_EQUAL((int64_t)20, syncs[0].mBytesUploaded);
+
+	settings.mMaximumDiffingTime = 1;
+	simulator.Run(settings, 0, &syncs);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, syncs[0].mNumFullUploads);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, syncs[0].mNumDiffUploads);
+	CPPUNIT_ASSERT_EQUAL((int64_t)(10 + 4194305),
+		syncs[0].mBytesUploaded);
+}
+
+void TestScheduleSimulator::TestStoreLoad()
+{
+	ScheduleSimulator simulator;
+	LoadTrace(simulator, "0 1000 1000 new\n");
+
+	ScheduleSimulator::Settings settings(mSettings);
+	settings.mUpdateStoreInterval = 600;
+	settings.mMinimumFileAge = 0;
+
+	ScheduleSimulator::StoreLoad load;
+	simulator.GetStoreLoad(settings, 0, &load);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, load.mNumClients);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, load.mPeakBytesPerMinute);
+
+	// three clients sync 200 seconds apart, in different minutes
+	simulator.GetStoreLoad(settings, 3, &load);
+	CPPUNIT_ASSERT_EQUAL((size_t)3, load.mNumClients);
+	CPPUNIT_ASSERT_EQUAL((int64_t)1000, load.mPeakBytesPerMinute);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, load.mPeakTime);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, load.mPeakUploadingClients);
+
+	// 121 clients are simulated in 60 groups, 10 seconds apart, of
+	// two each except the first, which has three: so 13 clients
+	// upload in the first minute, and 12 in each after
+	simulator.GetStoreLoad(settings, 121, &load);
+	CPPUNIT_ASSERT_EQUAL((size_t)121, load.mNumClients);
+	CPPUNIT_ASSERT_EQUAL((int64_t)13000, load.mPeakBytesPerMinute);
+	CPPUNIT_ASSERT_EQUAL((int64_t)0, load.mPeakTime);
+	CPPUNIT_ASSERT_EQUAL((size_t)13, load.mPeakUploadingClients);
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *            ThroughputChart.cc
+ *
+ *  Sat Jan 10 2009
+ *  Copyright 2006-2009 Chris Wilson
+ *  chris-boxisource@qwirx.com
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "SandBox.h"
+
+#include <wx/intl.h>
+
+#include "wx/barchartpoints.h"
+#include "wx/chartcolors.h"
+
+#include "ThroughputChart.h"
+
+// one sample a second, so about a minute of history
+#define THROUGHPUT_CHART_SAMPLES 60
+
+ThroughputChart::ThroughputChart(wxWindow* pParent, wxWindowID id)
+: wxChartCtrl(pParent, id, (STYLE)(USE_AXIS_X | USE_LEGEND),
+	wxDefaultPosition, wxSize(-1, 150), wxSUNKEN_BORDER),
+  mNumSamples(0)
+{
+	mBytesPerSecond.SetCapacity(THROUGHPUT_CHART_SAMPLES);
+	mFilesPerSecond.SetCapacity(THROUGHPUT_CHART_SAMPLES);
+	Redraw();
+}
+
+void ThroughputChart::Reset()
+{
+	mBytesPerSecond.Clear();
+	mFilesPerSecond.Clear();
+	mNumSamples = 0;
+	Redraw();
+}
+
+void ThroughputChart::AddSample(double bytesPerSecond, double filesPerSecond)
+{
+	mBytesPerSecond.Add(wxEmptyString, mNumSamples, bytesPerSecond / 1024);
+	mFilesPerSecond.Add(wxEmptyString, mNumSamples, filesPerSecond);
+	mNumSamples++;
+	Redraw();
+}
+
+// wxChart can't change the points of a series once it's added, so
+// both series are rebuilt on every change, with the oldest sample at
+// x = 0. There are never more than THROUGHPUT_CHART_SAMPLES of each.
+// Each series is scaled so that its own peak is at 100.
+void ThroughputChart::Redraw()
+{
+	Clear();
+
+	ChartValue bytesPeak = mBytesPerSecond.GetMaxY();
+	ChartValue filesPeak = mFilesPerSecond.GetMaxY();
+	ChartValue bytesScale = (bytesPeak > 0) ? 100 / bytesPeak : 0;
+	ChartValue filesScale = (filesPeak > 0) ? 100 / filesPeak : 0;
+
+	wxString bytesLabel, filesLabel;
+	bytesLabel.Printf(_("kB/s (%% of peak %.0f)"), bytesPeak);
+	filesLabel.Printf(_("Files/s (%% of peak %.0f)"), filesPeak);
+
+	wxBarChartPoints* pBytes = wxBarChartPoints::CreateWxBarChartPoints(
+		bytesLabel, wxCHART_ROYALBLUE);
+	wxBarChartPoints* pFiles = wxBarChartPoints::CreateWxBarChartPoints(
+		filesLabel, wxCHART_GOLD);
+
+	ChartValue first = mBytesPerSecond.GetMinX();
+
+	for (size_t i = 0; i < mBytesPerSecond.GetCount(); i++)
+	{
+		pBytes->Add(wxEmptyString, mBytesPerSecond.GetXVal(i) - first,
+			mBytesPerSecond.GetYVal(i) * bytesScale);
+		pFiles->Add(wxEmptyString, mFilesPerSecond.GetXVal(i) - first,
+			mFilesPerSecond.GetYVal(i) * filesScale);
+	}
+
+	Add(pBytes);
+	Add(pFiles);
+	Resize();
+}
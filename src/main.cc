@@ -55,6 +55,10 @@
 #endif
 
 #include "main.h"
+#ifndef WIN32
+#include "DaemonMonitorFrame.h"
+#endif
+#include "HeadlessRunner.h"
 #include "MainFrame.h"
 #include "TestFrame.h"
 #include "TestFileDialog.h"
@@ -67,7 +71,15 @@
 	x(TestBackup); \
 	x(TestConfig); \
 	x(TestRestore); \
-	x(TestCompare);
+	x(TestCompare); \
+	x(TestPoints); \
+	x(TestRunHistory); \
+	x(TestCommandSocket); \
+	x(TestDaemonMonitor); \
+	x(TestScheduleSimulator); \
+	x(TestExcludeRules); \
+	x(TestProgressPanel); \
+	x(TestProgressModel);
 
 #include "TestWizard.h"
 #include "TestBackupConfig.h"
@@ -75,6 +87,14 @@
 #include "TestConfig.h"
 #include "TestRestore.h"
 #include "TestCompare.h"
+#include "TestPoints.h"
+#include "TestRunHistory.h"
+#include "TestCommandSocket.h"
+#include "TestDaemonMonitor.h"
+#include "TestScheduleSimulator.h"
+#include "TestExcludeRules.h"
+#include "TestProgressPanel.h"
+#include "TestProgressModel.h"
 
 #include "SSLLib.h"
 
@@ -106,11 +126,43 @@ static wxCmdLineEntryDesc theCmdLineParams[] =
 		_("<bbackupd-config-file>"),
 		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_OPTION, _("t"), _("test"),
-		_("run the specified unit test.\n\t\t\tAvailable tests are: TestWizard, TestBackupConfig, TestBackup, TestConfig, TestRestore, TestCompare, all"),
+		_("run the specified unit test.\n\t\t\tAvailable tests are: TestWizard, TestBackupConfig, TestBackup, TestConfig, TestRestore, TestCompare, TestPoints, TestRunHistory, TestCommandSocket, TestDaemonMonitor, TestScheduleSimulator, TestExcludeRules, TestProgressPanel, TestProgressModel, all"),
 		wxCMD_LINE_VAL_STRING, 0 },
 	{ wxCMD_LINE_OPTION, _("l"), _("lang"),
 		_("load the specified language or translation"),
 		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("compare"),
+		_("compare the named location, or all, with the store and exit,\n\t\t\twithout opening any windows"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_SWITCH, _(""), _("quick"),
+		_("with --compare, check block checksums only"),
+		wxCMD_LINE_VAL_NONE, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("report"),
+		_("with --compare, write differences to the specified file,\n\t\t\tin CSV format if it ends with .csv, otherwise JSON Lines;\n\t\t\twith --simulate, write each sync to it in CSV format"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("restore"),
+		_("restore the specified store directory and exit,\n\t\t\twithout opening any windows"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("dest"),
+		_("with --restore, the local directory to restore into"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_SWITCH, _(""), _("resume"),
+		_("with --restore, continue an interrupted restore"),
+		wxCMD_LINE_VAL_NONE, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("profile-excludes"),
+		_("report how often each exclude entry of the named location,\n\t\t\tor all, matches and how long it takes, and exit"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("simulate"),
+		_("predict what bbackupd would upload with the configured\n\t\t\tsettings, replaying the changes in the specified trace\n\t\t\tfile, or a synthetic trace if it's \"synthetic\", and exit"),
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, _(""), _("clients"),
+		_("with --simulate, the number of clients sharing the store"),
+		wxCMD_LINE_VAL_NUMBER, 0 },
+#ifndef WIN32
+	{ wxCMD_LINE_OPTION, _(""), _("monitor"),
+		_("watch the bbackupd command sockets listed in the specified\n\t\t\tfile, one per line, each optionally after a name"),
+		wxCMD_LINE_VAL_STRING, 0 },
+#endif
 	{ wxCMD_LINE_SWITCH, _("h"), _("help"),
 		_("displays this help text"),
 		wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
@@ -126,11 +178,43 @@ static wxCmdLineEntryDesc theCmdLineParams[] =
 		"<bbackupd-config-file>",
 		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_OPTION, "t", "test",
-		"run the specified unit test.\n\t\t\tAvailable tests are: TestWizard, TestBackupConfig, TestBackup, TestConfig, TestRestore, TestCompare, all",
+		"run the specified unit test.\n\t\t\tAvailable tests are: TestWizard, TestBackupConfig, TestBackup, TestConfig, TestRestore, TestCompare, TestPoints, TestRunHistory, TestCommandSocket, TestDaemonMonitor, TestScheduleSimulator, TestExcludeRules, TestProgressPanel, TestProgressModel, all",
 		wxCMD_LINE_VAL_STRING, 0 },
 	{ wxCMD_LINE_OPTION, "l", "lang",
 		"load the specified language or translation",
 		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, "", "compare",
+		"compare the named location, or all, with the store and exit,\n\t\t\twithout opening any windows",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_SWITCH, "", "quick",
+		"with --compare, check block checksums only",
+		wxCMD_LINE_VAL_NONE, 0 },
+	{ wxCMD_LINE_OPTION, "", "report",
+		"with --compare, write differences to the specified file,\n\t\t\tin CSV format if it ends with .csv, otherwise JSON Lines;\n\t\t\twith --simulate, write each sync to it in CSV format",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, "", "restore",
+		"restore the specified store directory and exit,\n\t\t\twithout opening any windows",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, "", "dest",
+		"with --restore, the local directory to restore into",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_SWITCH, "", "resume",
+		"with --restore, continue an interrupted restore",
+		wxCMD_LINE_VAL_NONE, 0 },
+	{ wxCMD_LINE_OPTION, "", "profile-excludes",
+		"report how often each exclude entry of the named location,\n\t\t\tor all, matches and how long it takes, and exit",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, "", "simulate",
+		"predict what bbackupd would upload with the configured\n\t\t\tsettings, replaying the changes in the specified trace\n\t\t\tfile, or a synthetic trace if it's \"synthetic\", and exit",
+		wxCMD_LINE_VAL_STRING, 0 },
+	{ wxCMD_LINE_OPTION, "", "clients",
+		"with --simulate, the number of clients sharing the store",
+		wxCMD_LINE_VAL_NUMBER, 0 },
+#ifndef WIN32
+	{ wxCMD_LINE_OPTION, "", "monitor",
+		"watch the bbackupd command sockets listed in the specified\n\t\t\tfile, one per line, each optionally after a name",
+		wxCMD_LINE_VAL_STRING, 0 },
+#endif
 	{ wxCMD_LINE_SWITCH, "h", "help",
 		"displays this help text",
 		wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
@@ -148,6 +232,126 @@ BEGIN_EVENT_TABLE(BoxiApp, wxApp)
     EVT_IDLE(BoxiApp::OnIdle)
 END_EVENT_TABLE()
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RunHeadless(wxCmdLineParser& rParser)
+//		Purpose: Runs a compare, restore, exclude profile or
+//			 schedule simulation requested on the command line,
+//			 without starting the GUI. Returns the exit code for
+//			 the process.
+//		Created: 2009/01/05
+//
+// --------------------------------------------------------------------------
+static int RunHeadless(wxCmdLineParser& rParser)
+{
+	if (rParser.GetParamCount() != 1)
+	{
+		::fprintf(stderr, "A bbackupd configuration file must be "
+			"specified with --compare, --restore, "
+			"--profile-excludes or --simulate\n");
+		return HeadlessRunner::HR_EXIT_USAGE;
+	}
+
+	wxString compareLocation, restorePath, destPath, reportFile;
+	wxString profileLocation, traceFile;
+	bool compare = rParser.Found(wxS("compare"), &compareLocation);
+	bool restore = rParser.Found(wxS("restore"), &restorePath);
+	bool profile = rParser.Found(wxS("profile-excludes"),
+		&profileLocation);
+	bool simulate = rParser.Found(wxS("simulate"), &traceFile);
+
+	if ((compare ? 1 : 0) + (restore ? 1 : 0) + (profile ? 1 : 0) +
+		(simulate ? 1 : 0) > 1)
+	{
+		::fprintf(stderr, "Only one of --compare, --restore, "
+			"--profile-excludes and --simulate may be used "
+			"at a time\n");
+		return HeadlessRunner::HR_EXIT_USAGE;
+	}
+
+	long numClients = 1;
+	if (rParser.Found(wxS("clients"), &numClients) && numClients < 1)
+	{
+		::fprintf(stderr, "--clients must be at least 1\n");
+		return HeadlessRunner::HR_EXIT_USAGE;
+	}
+
+	if (simulate)
+	{
+		// doesn't need the store, or even a complete configuration
+		HeadlessRunner runner(rParser.GetParam());
+		rParser.Found(wxS("report"), &reportFile);
+		return runner.RunSimulation(traceFile, numClients,
+			reportFile);
+	}
+
+	if (restore && !rParser.Found(wxS("dest"), &destPath))
+	{
+		::fprintf(stderr, "--restore requires --dest\n");
+		return HeadlessRunner::HR_EXIT_USAGE;
+	}
+
+	#ifdef WIN32
+	WSADATA info;
+
+	if (WSAStartup(0x0101, &info) == SOCKET_ERROR)
+	{
+		// will not run without sockets
+		::fprintf(stderr, "Failed to initialise "
+			"Windows Sockets");
+		return HeadlessRunner::HR_EXIT_FAILED;
+	}
+	#else
+	// a store that drops the connection must give an exit code,
+	// rather than killing us with SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+	#endif
+
+	SSLLib::Initialise();
+
+	HeadlessRunner runner(rParser.GetParam());
+	int result;
+
+	if (compare)
+	{
+		if (compareLocation == wxS("all"))
+		{
+			compareLocation = wxEmptyString;
+		}
+
+		CompareReport::Format format = CompareReport::CRF_JSON_LINES;
+		if (rParser.Found(wxS("report"), &reportFile) &&
+			reportFile.Lower().EndsWith(wxS(".csv")))
+		{
+			format = CompareReport::CRF_CSV;
+		}
+
+		result = runner.RunCompare(compareLocation,
+			rParser.Found(wxS("quick")), reportFile, format);
+	}
+	else if (profile)
+	{
+		if (profileLocation == wxS("all"))
+		{
+			profileLocation = wxEmptyString;
+		}
+
+		result = runner.RunExcludeProfile(profileLocation);
+	}
+	else
+	{
+		result = runner.RunRestore(restorePath, destPath,
+			rParser.Found(wxS("resume")));
+	}
+
+	#ifdef WIN32
+	WSACleanup();
+	#endif
+
+	return result;
+}
+
 int main(int argc, char **argv)
 {
 	// ensure that parser/usage messages at this stage get sent to stderr
@@ -173,6 +377,14 @@ int main(int argc, char **argv)
 		return 2; // invalid command line
 	}
 
+	if (cmdParser.Found(wxS("compare")) ||
+		cmdParser.Found(wxS("restore")) ||
+		cmdParser.Found(wxS("profile-excludes")) ||
+		cmdParser.Found(wxS("simulate")))
+	{
+		return RunHeadless(cmdParser);
+	}
+
 	wxString testName;
 	if (cmdParser.Found(wxS("t"), &testName))
 	{
@@ -360,10 +572,24 @@ bool BoxiApp::OnInit()
 	signal(SIGPIPE, sigpipe_handler);
 	#endif
 
+	#ifndef WIN32
+	// the monitor watches Unix command sockets
+	wxString monitorListFile;
+	#endif
+
 	if (cmdParser.Found(wxS("t")))
 	{
 		mTesting = true;
 	}
+	#ifndef WIN32
+	else if (cmdParser.Found(wxS("monitor"), &monitorListFile))
+	{
+		wxFrame *frame = new DaemonMonitorFrame(monitorListFile,
+			wxPoint(50, 50), wxSize(900, 500));
+		frame->SetIcon(wxIcon(boxi_xpm));
+		frame->Show(TRUE);
+	}
+	#endif
 	else
 	{
 		wxFrame *frame = new MainFrame
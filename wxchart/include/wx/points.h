@@ -54,6 +54,19 @@ struct Point
 //----------------------------------------------------------------------------
 WX_DECLARE_OBJARRAY(Point, ListPoints);
 
+//----------------------------------------------------------------------------
+// Ways to reduce a series to fewer points for drawing
+//----------------------------------------------------------------------------
+enum wxPOINTS_DOWNSAMPLE
+{
+    // the lowest and highest point in each x interval: keeps every
+    // peak and trough, at up to two points per interval
+    wxPOINTS_MINMAX,
+    // Largest-Triangle-Three-Buckets: one point per interval, chosen to
+    // keep the shape of the line
+    wxPOINTS_LTTB
+};
+
 //+++-S-cd-------------------------------------------------------------------
 //	NAME:		CPoints
 //	DESC:		points implementation with list
@@ -76,6 +89,20 @@ public:
 	//--------------------------
 	void Clear();
 
+	// Limit the number of points (0 = no limit). When full, adding a
+	// point drops the one with the smallest xval, so a series that
+	// grows along x keeps a sliding window of its latest points in
+	// fixed memory
+	//--------------------------------------------------------------
+	void SetCapacity(size_t n);
+	size_t GetCapacity() const;
+
+	// Get at most n points that look the same when drawn, for example
+	// one or two per pixel of the width they're drawn in
+	//-----------------------------------------------------------------
+	void Downsample(size_t n, wxPOINTS_DOWNSAMPLE mode, 
+					ListPoints& out) const;
+
 	// Get points (vals) from vector
 	//------------------------------
 	Point GetPoint(size_t n) const;
@@ -98,11 +125,25 @@ public:
 
 private:
 
+	// A ring buffer once m_Capacity points have been added: the one
+	// with the smallest xval is at m_First, not 0
 	ListPoints m_vPoints;
+	size_t m_First;
+	size_t m_Capacity;
+
+	// min and max yval, kept up to date as points are added, and 
+	// worked out again only when one of them is dropped
+	mutable bool m_StatsValid;
+	mutable ChartValue m_MinY;
+	mutable ChartValue m_MaxY;
 
 	// Utility list manipolation
 	//--------------------------
+	const Point& Item(size_t n) const;
 	size_t GetInsertPosition(const Point& p);
+	void Linearize();
+	void ForgetStats(const Point& p);
+	void UpdateStats() const;
 	//size_t GetPosition(int n);
 
 	// copy ctor & op= NOT allow
@@ -333,10 +333,18 @@ void wxBarChartPoints::Draw(
     CHART_HRECT hr
 )
 {
+    //-----------------------------------------------------------------------
+    // Never draw more bars than the window is pixels wide: if there are
+    // more, draw only the lowest and highest in each run of them, so that
+    // drawing takes as long however many points there are
+    //-----------------------------------------------------------------------
+    ListPoints points;
+    m_Points.Downsample( hr->w > 0 ? hr->w : 1, wxPOINTS_MINMAX, points );
+
     //-----------------------------------------------------------------------
     // get number of bars
     //-----------------------------------------------------------------------
-    double iNodes = ceil( static_cast<double>(GetCount()) );
+    double iNodes = ceil( static_cast<double>(points.GetCount()) );
 
     //-----------------------------------------------------------------------
     // get max height
@@ -359,7 +367,8 @@ void wxBarChartPoints::Draw(
         //-------------------------------------------------------------------
         // Get x-position for iNode bar
         //-------------------------------------------------------------------
-        double xVal  = ceil( GetXVal(iNode) );
+        const Point& point = points.Item( iNode );
+        double xVal  = ceil( point.m_xval );
         x = hr->x + GetZoom() * xVal * ( sizes.wbar * sizes.nbar + 
                                          sizes.wbar3d * sizes.nbar3d + 
                                          sizes.gap);
@@ -367,7 +376,7 @@ void wxBarChartPoints::Draw(
         //-------------------------------------------------------------------
         // Get y-position for iNode bar
         //-------------------------------------------------------------------
-        y = hr->y + ( (hr->h - sizes.s_height)* GetYVal(iNode) ) / ValMax ;
+        y = hr->y + ( (hr->h - sizes.s_height)* point.m_yval ) / ValMax ;
 
         hp->DrawRectangle( static_cast<int>(ceil(x)),
                            static_cast<int>(ceil(hr->h - y)),
@@ -393,7 +402,7 @@ void wxBarChartPoints::Draw(
                         UP);
             break;
         case YVALUE:
-            lbl.Printf( wxT("%d"), static_cast<int>(GetYVal(iNode)));
+            lbl.Printf( wxT("%d"), static_cast<int>(point.m_yval));
             wxLbl.Draw( hp, static_cast<int>(ceil(x)), 
                         static_cast<int>(ceil(hr->h - y)), 
                         GetColor(),
@@ -401,7 +410,7 @@ void wxBarChartPoints::Draw(
                         UP );
             break;
         case NAME:
-            lbl = GetName(iNode).c_str();
+            lbl = point.m_name.c_str();
             wxLbl.Draw( hp, static_cast<int>(ceil(x)), 
                         static_cast<int>(ceil(hr->h - y)), 
                         GetColor(),
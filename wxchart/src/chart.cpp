@@ -50,19 +50,7 @@ wxChart::wxChart()
 //----------------------------------------------------------------------E-+++
 wxChart::~wxChart() 
 {
-	wxChartPoints* cptmp;
-
-    size_t num = m_LCP.GetCount();
-    
-    for ( size_t loop = 0; 
-          loop < num; 
-          loop++ ) 
-    {
-        cptmp = m_LCP.Item(loop);
-        delete cptmp;
-    }
-
-	m_LCP.Clear();
+	Clear();
 }
 
 //+++-S-cf-------------------------------------------------------------------
@@ -80,12 +68,25 @@ void wxChart::Add(
 
 //+++-S-cf-------------------------------------------------------------------
 //	NAME:		Clear()
-//	DESC:		
+//	DESC:		Remove and delete all the chartpoints, which belong to
+//				the chart once added
 //	PARAMETERS:	None
 //	RETURN:		None
 //----------------------------------------------------------------------E-+++
 void wxChart::Clear() 
 { 
+	wxChartPoints* cptmp;
+
+    size_t num = m_LCP.GetCount();
+    
+    for ( size_t loop = 0; 
+          loop < num; 
+          loop++ ) 
+    {
+        cptmp = m_LCP.Item(loop);
+        delete cptmp;
+    }
+
 	m_LCP.Clear();
 }
 
@@ -24,6 +24,8 @@
 #pragma hdrstop
 #endif
 
+#include <math.h>
+
 #include "wx/points.h"
 
 //----------------------------------------------------------------------------
@@ -61,6 +63,11 @@ Point::Point(
 //	RETURN:		None
 //----------------------------------------------------------------------E-+++
 wxPoints::wxPoints()
+:	m_First(0),
+	m_Capacity(0),
+	m_StatsValid(true),
+	m_MinY(0),
+	m_MaxY(0)
 {
 }
 
@@ -85,7 +92,42 @@ void wxPoints::Add(
 	const Point &p
 )
 {
+    size_t num = m_vPoints.GetCount();
+
+	//-----------------------------------------------------------------------
+	// Points are usually added in xval order, so check for that first
+	//-----------------------------------------------------------------------
+	if ( num == 0 || p.m_xval >= Item(num - 1).m_xval )
+	{
+		if ( m_Capacity > 0 && num >= m_Capacity )
+		{
+			// overwrite the oldest, which is now the newest
+			ForgetStats( m_vPoints.Item(m_First) );
+			m_vPoints.Item( m_First ) = p;
+			m_First = ( m_First + 1 ) % num;
+		}
+		else
+		{
+			m_vPoints.Add( p );
+		}
+
+		if ( m_StatsValid )
+		{
+			if ( GetCount() == 1 || p.m_yval < m_MinY )
+				m_MinY = p.m_yval;
+			if ( GetCount() == 1 || p.m_yval > m_MaxY )
+				m_MaxY = p.m_yval;
+		}
+
+		return;
+	}
+
+	Linearize();
 	m_vPoints.Insert( p, GetInsertPosition(p) );
+	m_StatsValid = false;
+
+	if ( m_Capacity > 0 && m_vPoints.GetCount() > m_Capacity )
+		m_vPoints.RemoveAt( 0 );
 }
 
 //+++-S-cf-------------------------------------------------------------------
@@ -117,6 +159,10 @@ void wxPoints::Add(
 void wxPoints::Clear()
 {
 	m_vPoints.Clear();
+	m_First = 0;
+	m_StatsValid = true;
+	m_MinY = 0;
+	m_MaxY = 0;
 }
 
 //+++-S-cf-------------------------------------------------------------------
@@ -133,7 +179,7 @@ Point wxPoints::GetPoint(
     size_t num = m_vPoints.GetCount();
     
     if ( num > n )
-        return m_vPoints.Item( n );
+        return Item( n );
 
     return Point( wxEmptyString, 0, 0 );
 }
@@ -151,7 +197,7 @@ wxString wxPoints::GetName(
     size_t num = m_vPoints.GetCount();
     
     if ( num > n )
-        return m_vPoints.Item( n ).m_name;
+        return Item( n ).m_name;
 	
     return ( wxEmptyString );
 }
@@ -169,7 +215,7 @@ ChartValue wxPoints::GetXVal(
     size_t num = m_vPoints.GetCount();
     
     if ( num > n )
-        return m_vPoints.Item( n ).m_xval;
+        return Item( n ).m_xval;
 
 	return ( 0 );
 
@@ -188,7 +234,7 @@ ChartValue wxPoints::GetYVal(
     size_t num = m_vPoints.GetCount();
     
     if ( num > n )
-        return m_vPoints.Item( n ).m_yval;
+        return Item( n ).m_yval;
 
 	return ( 0 );
 }
@@ -206,7 +252,7 @@ ChartColor wxPoints::GetColor(
     size_t num = m_vPoints.GetCount();
     
     if ( num > n )
-        return m_vPoints.Item( n ).m_col;
+        return Item( n ).m_col;
 
 	return ( 0 );
 }
@@ -233,7 +279,7 @@ ChartValue wxPoints::GetMaxX() const
 	int n = GetCount();
 
 	if ( n > 0 )
-		return m_vPoints.Item( n - 1 ).m_xval;
+		return Item( n - 1 ).m_xval;
 
 	return 0;
 }
@@ -249,7 +295,7 @@ ChartValue wxPoints::GetMinX() const
 	int n = GetCount();
 
     if ( n > 0 )
-        return m_vPoints.Item( 0 ).m_xval;
+        return Item( 0 ).m_xval;
 
 	return 0;
 }
@@ -262,17 +308,11 @@ ChartValue wxPoints::GetMinX() const
 //----------------------------------------------------------------------E-+++
 ChartValue wxPoints::GetMaxY() const
 {
-    ChartValue iRes = 0;
+	UpdateStats();
 
-	for ( size_t iLoop = 0;
-		  iLoop < GetCount();
-		  ++iLoop )
-	{
-		if ( GetYVal(iLoop) > iRes )
-			iRes = GetYVal( iLoop );
-	}
-
-	return ( iRes );
+	if ( m_MaxY > 0 )
+		return ( m_MaxY );
+	return ( 0 );
 }
 
 //+++-S-cf-------------------------------------------------------------------
@@ -283,20 +323,9 @@ ChartValue wxPoints::GetMaxY() const
 //----------------------------------------------------------------------E-+++
 ChartValue wxPoints::GetMinY() const
 {
-    ChartValue iRes = 0;
+	UpdateStats();
 
-	for ( size_t iLoop = 0;
-		  iLoop < GetCount();
-		  ++iLoop )
-	{
-		if ( iLoop == 0 )
-			iRes = GetYVal(iLoop);
-		else
-			if ( GetYVal(iLoop) < iRes )
-				iRes = GetYVal( iLoop );
-	}
-
-	return ( iRes );
+	return ( m_MinY );
 }
 
 //+++-S-cf-------------------------------------------------------------------
@@ -311,19 +340,307 @@ size_t wxPoints::GetInsertPosition(
 	const Point& p
 )
 {
+	//-----------------------------------------------------------------------
+	// Binary search for the first point with a greater xval, so that
+	// points with the same xval stay in the order they were added
+	//-----------------------------------------------------------------------
+    size_t lo = 0;
+    size_t hi = GetCount();
+
+    while ( lo < hi )
+	{
+		size_t mid = lo + ( hi - lo ) / 2;
+		if ( Item(mid).m_xval > p.m_xval )
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return ( lo );
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		Item()
+//	DESC:		Get the n-th point in xval order, wherever the ring 
+//				buffer starts
+//	PARAMETERS:	size_t n
+//	RETURN:		const Point&
+//----------------------------------------------------------------------E-+++
+const Point& wxPoints::Item(
+	size_t n
+) const
+{
+	return m_vPoints.Item( (m_First + n) % m_vPoints.GetCount() );
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		Linearize()
+//	DESC:		Rotate the ring buffer so that the first point is at 0
+//	PARAMETERS:	None
+//	RETURN:		None
+//----------------------------------------------------------------------E-+++
+void wxPoints::Linearize()
+{
+	if ( m_First == 0 )
+		return;
 
+	ListPoints tmp;
     size_t num = m_vPoints.GetCount();
-    size_t loop;
-    
-    for ( loop = 0; 
+    tmp.Alloc( num );
+
+    for ( size_t loop = 0; 
+          loop < num; 
+          loop++ ) 
+	{
+		tmp.Add( Item(loop) );
+	}
+
+	m_vPoints.Clear();
+	m_vPoints.Alloc( num );
+    for ( size_t loop = 0; 
+          loop < num; 
+          loop++ ) 
+	{
+		m_vPoints.Add( tmp.Item(loop) );
+	}
+
+	m_First = 0;
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		ForgetStats()
+//	DESC:		Called before a point is dropped. If it was the min or
+//				max yval, they must be worked out again
+//	PARAMETERS:	const Point& p
+//	RETURN:		None
+//----------------------------------------------------------------------E-+++
+void wxPoints::ForgetStats(
+	const Point& p
+)
+{
+	if ( p.m_yval <= m_MinY || p.m_yval >= m_MaxY )
+		m_StatsValid = false;
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		UpdateStats()
+//	DESC:		Work out the min and max yval again, if needed
+//	PARAMETERS:	None
+//	RETURN:		None
+//----------------------------------------------------------------------E-+++
+void wxPoints::UpdateStats() const
+{
+	if ( m_StatsValid )
+		return;
+
+	m_MinY = 0;
+	m_MaxY = 0;
+
+    size_t num = m_vPoints.GetCount();
+    for ( size_t loop = 0; 
           loop < num; 
           loop++ ) 
 	{
-		if ( m_vPoints.Item( loop ).m_xval > p.m_xval )
-			break;
+		ChartValue y = m_vPoints.Item( loop ).m_yval;
+		if ( loop == 0 || y < m_MinY )
+			m_MinY = y;
+		if ( loop == 0 || y > m_MaxY )
+			m_MaxY = y;
+	}
+
+	m_StatsValid = true;
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		SetCapacity()
+//	DESC:		Limit the number of points kept (0 = no limit). If there
+//				are more already, the ones with the smallest xval go
+//	PARAMETERS:	size_t n
+//	RETURN:		None
+//----------------------------------------------------------------------E-+++
+void wxPoints::SetCapacity(
+	size_t n
+)
+{
+	Linearize();
+	m_Capacity = n;
+
+    size_t num = m_vPoints.GetCount();
+	if ( n > 0 && num > n )
+	{
+		m_vPoints.RemoveAt( 0, num - n );
+		m_StatsValid = false;
+	}
+
+	if ( n > 0 )
+		m_vPoints.Alloc( n );
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		GetCapacity()
+//	DESC:		
+//	PARAMETERS:	None
+//	RETURN:		size_t, or 0 if there is no limit
+//----------------------------------------------------------------------E-+++
+size_t wxPoints::GetCapacity() const
+{
+	return ( m_Capacity );
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		GetBucket()
+//	DESC:		Which of n equal intervals of the xval range x falls in
+//	PARAMETERS:	ChartValue x,
+//				ChartValue minX,
+//				ChartValue range,
+//				size_t n
+//	RETURN:		size_t
+//----------------------------------------------------------------------E-+++
+static size_t GetBucket(
+	ChartValue x, 
+	ChartValue minX, 
+	ChartValue range, 
+	size_t n
+)
+{
+	if ( range <= 0 )
+		return ( 0 );
+
+	size_t bucket = static_cast<size_t>( (x - minX) / range * n );
+	if ( bucket >= n )
+		bucket = n - 1;
+	return ( bucket );
+}
+
+//+++-S-cf-------------------------------------------------------------------
+//	NAME:		Downsample()
+//	DESC:		Get at most n points, in xval order, that look like the 
+//				whole series when drawn. If there are no more than n 
+//				points, they are all copied.
+//	PARAMETERS:	size_t n,
+//				wxPOINTS_DOWNSAMPLE mode,
+//				ListPoints& out
+//	RETURN:		None
+//----------------------------------------------------------------------E-+++
+void wxPoints::Downsample(
+	size_t n, 
+	wxPOINTS_DOWNSAMPLE mode, 
+	ListPoints& out
+) const
+{
+	out.Clear();
+	if ( n == 0 )
+		return;
+
+    size_t num = GetCount();
+	if ( num <= n )
+	{
+		out.Alloc( num );
+		for ( size_t loop = 0; loop < num; loop++ )
+			out.Add( Item(loop) );
+		return;
+	}
+
+	out.Alloc( n );
+
+	if ( mode == wxPOINTS_LTTB && n >= 3 )
+	{
+		//-------------------------------------------------------------------
+		// Keep the first and last points. Split the rest into n - 2 
+		// buckets, and from each keep the point that makes the largest 
+		// triangle with the point kept from the bucket before and the 
+		// average of the bucket after.
+		//-------------------------------------------------------------------
+		double every = static_cast<double>(num - 2) / (n - 2);
+		size_t a = 0;
+		out.Add( Item(0) );
+
+		for ( size_t bucket = 0; bucket < n - 2; bucket++ )
+		{
+			size_t start = static_cast<size_t>(bucket * every) + 1;
+			size_t end = static_cast<size_t>((bucket + 1) * every) + 1;
+			if ( end > num - 1 )
+				end = num - 1;
+
+			size_t nextStart = end;
+			size_t nextEnd = static_cast<size_t>((bucket + 2) * every) + 1;
+			if ( nextEnd > num )
+				nextEnd = num;
+
+			double avgX = 0, avgY = 0;
+			for ( size_t loop = nextStart; loop < nextEnd; loop++ )
+			{
+				avgX += Item(loop).m_xval;
+				avgY += Item(loop).m_yval;
+			}
+			avgX /= ( nextEnd - nextStart );
+			avgY /= ( nextEnd - nextStart );
+
+			const Point& pa = Item( a );
+			double maxArea = -1;
+			size_t chosen = start;
+
+			for ( size_t loop = start; loop < end; loop++ )
+			{
+				const Point& pb = Item( loop );
+				double area = fabs( (pa.m_xval - avgX) * (pb.m_yval - pa.m_yval) -
+					(pa.m_xval - pb.m_xval) * (avgY - pa.m_yval) );
+				if ( area > maxArea )
+				{
+					maxArea = area;
+					chosen = loop;
+				}
+			}
+
+			out.Add( Item(chosen) );
+			a = chosen;
+		}
+
+		out.Add( Item(num - 1) );
+		return;
 	}
 
-	return ( loop );
+	//-----------------------------------------------------------------------
+	// Min/max: split the xval range into n / 2 equal intervals, and 
+	// from each keep the points with the lowest and highest yval, in 
+	// xval order
+	//-----------------------------------------------------------------------
+	size_t buckets = n / 2;
+	if ( buckets == 0 )
+		buckets = 1;
+
+	ChartValue minX = GetMinX();
+	ChartValue range = GetMaxX() - minX;
+
+	size_t loop = 0;
+	while ( loop < num )
+	{
+		size_t bucket = GetBucket( Item(loop).m_xval, minX, range, buckets );
+		size_t iMin = loop, iMax = loop;
+
+		for ( loop++; loop < num; loop++ )
+		{
+			if ( GetBucket(Item(loop).m_xval, minX, range, buckets) != bucket )
+				break;
+
+			if ( Item(loop).m_yval < Item(iMin).m_yval )
+				iMin = loop;
+			if ( Item(loop).m_yval > Item(iMax).m_yval )
+				iMax = loop;
+		}
+
+		if ( n == 1 )
+		{
+			// no room for both
+			out.Add( Item(iMax) );
+		}
+		else
+		{
+			out.Add( Item(iMin < iMax ? iMin : iMax) );
+			if ( iMin != iMax )
+				out.Add( Item(iMin < iMax ? iMax : iMin) );
+		}
+	}
 }
 
 //+++-S-cf-------------------------------------------------------------------